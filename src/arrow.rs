@@ -0,0 +1,511 @@
+use std::ffi::{c_char, c_void, CString};
+use std::ptr;
+
+use crate::fetch::{cell_to_f64, cell_to_i64};
+use crate::handle::*;
+use crate::types::*;
+
+/// Rows per record batch when the caller passes 0
+pub const ARROW_BATCH_ROWS: usize = 65536;
+
+const ARROW_FLAG_NULLABLE: i64 = 2;
+const MICROS_PER_DAY: i64 = 86_400_000_000;
+
+/// `struct ArrowSchema` of the Arrow C Data Interface
+#[repr(C)]
+pub struct ArrowSchema {
+    pub format: *const c_char,
+    pub name: *const c_char,
+    pub metadata: *const c_char,
+    pub flags: i64,
+    pub n_children: i64,
+    pub children: *mut *mut ArrowSchema,
+    pub dictionary: *mut ArrowSchema,
+    pub release: Option<unsafe extern "C" fn(*mut ArrowSchema)>,
+    pub private_data: *mut c_void,
+}
+
+/// `struct ArrowArray` of the Arrow C Data Interface
+#[repr(C)]
+pub struct ArrowArray {
+    pub length: i64,
+    pub null_count: i64,
+    pub offset: i64,
+    pub n_buffers: i64,
+    pub n_children: i64,
+    pub buffers: *mut *const c_void,
+    pub children: *mut *mut ArrowArray,
+    pub dictionary: *mut ArrowArray,
+    pub release: Option<unsafe extern "C" fn(*mut ArrowArray)>,
+    pub private_data: *mut c_void,
+}
+
+/// Arrow type a column is exported as, from the SQL type
+/// sql_type_from_column chose for it. Anything without a closer match
+/// (including sql_variant and datetimeoffset) goes out as text, the way
+/// SQLGetData renders it as SQL_C_CHAR.
+#[derive(Clone, Copy, PartialEq)]
+enum ArrowType {
+    Boolean,
+    UInt8,
+    Int16,
+    Int32,
+    Int64,
+    Float32,
+    Float64,
+    Decimal { precision: u8, scale: u8 },
+    Date32,
+    Time64,
+    Timestamp,
+    Utf8,
+    Binary,
+}
+
+impl ArrowType {
+    fn of(col: &ColumnDesc) -> Self {
+        match col.sql_type {
+            SQL_BIT => Self::Boolean,
+            SQL_TINYINT => Self::UInt8,
+            SQL_SMALLINT => Self::Int16,
+            SQL_INTEGER => Self::Int32,
+            SQL_BIGINT => Self::Int64,
+            SQL_REAL => Self::Float32,
+            SQL_FLOAT | SQL_DOUBLE => Self::Float64,
+            SQL_DECIMAL | SQL_NUMERIC => {
+                let precision = col.size.clamp(1, 38) as u8;
+                let scale = (col.decimal_digits.max(0) as u8).min(precision);
+                Self::Decimal { precision, scale }
+            }
+            SQL_TYPE_DATE => Self::Date32,
+            SQL_TYPE_TIME => Self::Time64,
+            SQL_TYPE_TIMESTAMP => Self::Timestamp,
+            SQL_BINARY | SQL_VARBINARY | SQL_LONGVARBINARY => Self::Binary,
+            _ => Self::Utf8,
+        }
+    }
+
+    /// Format string. Strings and binaries use 64-bit offsets, so one batch
+    /// of wide rows cannot overflow them.
+    fn format(self) -> String {
+        match self {
+            Self::Boolean => "b".to_string(),
+            Self::UInt8 => "C".to_string(),
+            Self::Int16 => "s".to_string(),
+            Self::Int32 => "i".to_string(),
+            Self::Int64 => "l".to_string(),
+            Self::Float32 => "f".to_string(),
+            Self::Float64 => "g".to_string(),
+            Self::Decimal { precision, scale } => format!("d:{},{}", precision, scale),
+            Self::Date32 => "tdD".to_string(),
+            Self::Time64 => "ttn".to_string(),
+            Self::Timestamp => "tsu:".to_string(),
+            Self::Utf8 => "U".to_string(),
+            Self::Binary => "Z".to_string(),
+        }
+    }
+}
+
+/// Value buffers of one exported column, typed so each is aligned for its
+/// element type
+enum Values {
+    Bits(Vec<u8>),
+    U8(Vec<u8>),
+    I16(Vec<i16>),
+    I32(Vec<i32>),
+    I64(Vec<i64>),
+    F32(Vec<f32>),
+    F64(Vec<f64>),
+    I128(Vec<i128>),
+    Var { offsets: Vec<i64>, data: Vec<u8> },
+}
+
+/// One column of a record batch being built
+struct ColumnBuilder {
+    ty: ArrowType,
+    validity: Vec<u8>,
+    null_count: usize,
+    len: usize,
+    values: Values,
+}
+
+impl ColumnBuilder {
+    fn new(ty: ArrowType, rows: usize) -> Self {
+        let values = match ty {
+            ArrowType::Boolean => Values::Bits(Vec::with_capacity(rows.div_ceil(8))),
+            ArrowType::UInt8 => Values::U8(Vec::with_capacity(rows)),
+            ArrowType::Int16 => Values::I16(Vec::with_capacity(rows)),
+            ArrowType::Int32 | ArrowType::Date32 => Values::I32(Vec::with_capacity(rows)),
+            ArrowType::Int64 | ArrowType::Time64 | ArrowType::Timestamp => {
+                Values::I64(Vec::with_capacity(rows))
+            }
+            ArrowType::Float32 => Values::F32(Vec::with_capacity(rows)),
+            ArrowType::Float64 => Values::F64(Vec::with_capacity(rows)),
+            ArrowType::Decimal { .. } => Values::I128(Vec::with_capacity(rows)),
+            ArrowType::Utf8 | ArrowType::Binary => {
+                let mut offsets = Vec::with_capacity(rows + 1);
+                offsets.push(0);
+                Values::Var {
+                    offsets,
+                    data: Vec::new(),
+                }
+            }
+        };
+        Self {
+            ty,
+            validity: Vec::with_capacity(rows.div_ceil(8)),
+            null_count: 0,
+            len: 0,
+            values,
+        }
+    }
+
+    /// Append one cell. NULLs, and the odd value with no sensible
+    /// conversion to the column's type, go in as nulls.
+    fn push(&mut self, cell: Cell<'_>) {
+        // NULLs still take a placeholder slot in the value buffers
+        let valid = self.push_value(cell) && !matches!(cell, Cell::Null);
+        push_bit(&mut self.validity, self.len, valid);
+        if !valid {
+            self.null_count += 1;
+        }
+        self.len += 1;
+    }
+
+    /// Append the value of a cell, or a placeholder for a NULL or a value
+    /// that does not convert. Returns false if a non-NULL value did not.
+    fn push_value(&mut self, cell: Cell<'_>) -> bool {
+        let len = self.len;
+        match (&mut self.values, self.ty) {
+            (Values::Bits(bits), _) => {
+                let v = match cell {
+                    Cell::Bool(b) => b,
+                    _ => cell_to_i64(cell) != 0,
+                };
+                push_bit(bits, len, v);
+                true
+            }
+            (Values::U8(v), _) => {
+                v.push(cell_to_i64(cell) as u8);
+                true
+            }
+            (Values::I16(v), _) => {
+                v.push(cell_to_i64(cell) as i16);
+                true
+            }
+            (Values::I32(v), ArrowType::Date32) => {
+                let days = match cell {
+                    Cell::Date { days } => Some(days),
+                    Cell::DateTime { micros } | Cell::DateTimeOffset { micros, .. } => {
+                        Some(micros.div_euclid(MICROS_PER_DAY) as i32)
+                    }
+                    _ => None,
+                };
+                v.push(days.unwrap_or(0));
+                days.is_some()
+            }
+            (Values::I32(v), _) => {
+                v.push(cell_to_i64(cell) as i32);
+                true
+            }
+            (Values::I64(v), ArrowType::Time64) => {
+                let nanos = match cell {
+                    Cell::Time { nanos } => Some(nanos),
+                    Cell::DateTime { micros } | Cell::DateTimeOffset { micros, .. } => {
+                        Some(micros.rem_euclid(MICROS_PER_DAY) * 1000)
+                    }
+                    _ => None,
+                };
+                v.push(nanos.unwrap_or(0));
+                nanos.is_some()
+            }
+            (Values::I64(v), ArrowType::Timestamp) => {
+                let micros = match cell {
+                    Cell::DateTime { micros } | Cell::DateTimeOffset { micros, .. } => Some(micros),
+                    Cell::Date { days } => Some(days as i64 * MICROS_PER_DAY),
+                    _ => None,
+                };
+                v.push(micros.unwrap_or(0));
+                micros.is_some()
+            }
+            (Values::I64(v), _) => {
+                v.push(cell_to_i64(cell));
+                true
+            }
+            (Values::F32(v), _) => {
+                v.push(match cell {
+                    Cell::F32(f) => f,
+                    _ => cell_to_f64(cell) as f32,
+                });
+                true
+            }
+            (Values::F64(v), _) => {
+                v.push(cell_to_f64(cell));
+                true
+            }
+            (Values::I128(v), ArrowType::Decimal { scale, .. }) => {
+                let value = decimal_value(cell, scale);
+                v.push(value.unwrap_or(0));
+                value.is_some()
+            }
+            (Values::I128(v), _) => {
+                v.push(0);
+                false
+            }
+            (Values::Var { offsets, data }, ty) => {
+                let pushed = match cell {
+                    Cell::Bytes(b) if ty == ArrowType::Binary => {
+                        data.extend_from_slice(b);
+                        true
+                    }
+                    _ => match cell.text(&mut TextBuf::new()) {
+                        Some(s) => {
+                            data.extend_from_slice(s.as_bytes());
+                            true
+                        }
+                        None => false,
+                    },
+                };
+                offsets.push(data.len() as i64);
+                pushed
+            }
+        }
+    }
+
+    /// Move the column into a child ArrowArray
+    fn finish(self) -> ArrowArray {
+        let validity = if self.null_count == 0 {
+            ptr::null()
+        } else {
+            self.validity.as_ptr() as *const c_void
+        };
+        let mut buffers = vec![validity];
+        match &self.values {
+            Values::Bits(v) | Values::U8(v) => buffers.push(v.as_ptr() as *const c_void),
+            Values::I16(v) => buffers.push(v.as_ptr() as *const c_void),
+            Values::I32(v) => buffers.push(v.as_ptr() as *const c_void),
+            Values::I64(v) => buffers.push(v.as_ptr() as *const c_void),
+            Values::F32(v) => buffers.push(v.as_ptr() as *const c_void),
+            Values::F64(v) => buffers.push(v.as_ptr() as *const c_void),
+            Values::I128(v) => buffers.push(v.as_ptr() as *const c_void),
+            Values::Var { offsets, data } => {
+                buffers.push(offsets.as_ptr() as *const c_void);
+                buffers.push(data.as_ptr() as *const c_void);
+            }
+        }
+        ArrayPrivate {
+            buffers,
+            children: Vec::new(),
+            _validity: self.validity,
+            _values: Some(self.values),
+        }
+        .into_array(self.len, self.null_count)
+    }
+}
+
+/// Append bit `i` to a bitmap holding `i` bits so far (LSB first, as Arrow
+/// packs them)
+fn push_bit(bits: &mut Vec<u8>, i: usize, v: bool) {
+    if i / 8 == bits.len() {
+        bits.push(0);
+    }
+    if v {
+        bits[i / 8] |= 1 << (i % 8);
+    }
+}
+
+/// Value of a decimal, integer or float cell as an integer scaled by
+/// 10^`scale`, rounding half away from zero where digits are dropped
+fn decimal_value(cell: Cell<'_>, scale: u8) -> Option<i128> {
+    let pow = |n: u8| 10i128.checked_pow(n as u32);
+    match cell {
+        Cell::Decimal {
+            value, scale: from, ..
+        } if from <= scale => value.checked_mul(pow(scale - from)?),
+        Cell::Decimal {
+            value, scale: from, ..
+        } => {
+            let div = pow(from - scale)?;
+            let (q, r) = (value / div, value % div);
+            Some(if r.abs() * 2 >= div {
+                q + value.signum()
+            } else {
+                q
+            })
+        }
+        Cell::F32(_) | Cell::F64(_) => {
+            let v = cell_to_f64(cell) * 10f64.powi(scale as i32);
+            v.is_finite().then(|| v.round() as i128)
+        }
+        Cell::Bool(_) | Cell::U8(_) | Cell::I16(_) | Cell::I32(_) | Cell::I64(_) => {
+            (cell_to_i64(cell) as i128).checked_mul(pow(scale)?)
+        }
+        _ => None,
+    }
+}
+
+/// Everything an exported array points into, freed by its release callback
+struct ArrayPrivate {
+    buffers: Vec<*const c_void>,
+    children: Vec<*mut ArrowArray>,
+    _validity: Vec<u8>,
+    _values: Option<Values>,
+}
+
+impl ArrayPrivate {
+    fn into_array(self, length: usize, null_count: usize) -> ArrowArray {
+        let mut private = Box::new(self);
+        ArrowArray {
+            length: length as i64,
+            null_count: null_count as i64,
+            offset: 0,
+            n_buffers: private.buffers.len() as i64,
+            n_children: private.children.len() as i64,
+            buffers: private.buffers.as_mut_ptr(),
+            children: private.children.as_mut_ptr(),
+            dictionary: ptr::null_mut(),
+            release: Some(release_array),
+            private_data: Box::into_raw(private) as *mut c_void,
+        }
+    }
+}
+
+unsafe extern "C" fn release_array(array: *mut ArrowArray) {
+    if array.is_null() || (*array).release.is_none() {
+        return;
+    }
+    let private = Box::from_raw((*array).private_data as *mut ArrayPrivate);
+    for &child in &private.children {
+        // A consumer that moved a child out marked it released
+        if let Some(release) = (*child).release {
+            release(child);
+        }
+        drop(Box::from_raw(child));
+    }
+    (*array).release = None;
+}
+
+/// Strings and children an exported schema points into
+struct SchemaPrivate {
+    format: CString,
+    name: CString,
+    children: Vec<*mut ArrowSchema>,
+}
+
+impl SchemaPrivate {
+    fn new(format: &str, name: &str, children: Vec<*mut ArrowSchema>) -> Self {
+        // Column names cannot hold NUL; drop any rather than fail the export
+        let name = CString::new(name.replace('\0', "")).unwrap_or_default();
+        Self {
+            format: CString::new(format).unwrap_or_default(),
+            name,
+            children,
+        }
+    }
+
+    fn into_schema(self, flags: i64) -> ArrowSchema {
+        let mut private = Box::new(self);
+        ArrowSchema {
+            format: private.format.as_ptr(),
+            name: private.name.as_ptr(),
+            metadata: ptr::null(),
+            flags,
+            n_children: private.children.len() as i64,
+            children: private.children.as_mut_ptr(),
+            dictionary: ptr::null_mut(),
+            release: Some(release_schema),
+            private_data: Box::into_raw(private) as *mut c_void,
+        }
+    }
+}
+
+unsafe extern "C" fn release_schema(schema: *mut ArrowSchema) {
+    if schema.is_null() || (*schema).release.is_none() {
+        return;
+    }
+    let private = Box::from_raw((*schema).private_data as *mut SchemaPrivate);
+    for &child in &private.children {
+        if let Some(release) = (*child).release {
+            release(child);
+        }
+        drop(Box::from_raw(child));
+    }
+    (*schema).release = None;
+}
+
+/// Schema of the current result set: a struct with one field per column
+fn export_schema(columns: &[ColumnDesc]) -> ArrowSchema {
+    let children = columns
+        .iter()
+        .map(|c| {
+            let flags = if c.nullable == SQL_NO_NULLS {
+                0
+            } else {
+                ARROW_FLAG_NULLABLE
+            };
+            let child = SchemaPrivate::new(&ArrowType::of(c).format(), &c.name, Vec::new())
+                .into_schema(flags);
+            Box::into_raw(Box::new(child))
+        })
+        .collect();
+    SchemaPrivate::new("+s", "", children).into_schema(0)
+}
+
+/// Fetch the next rowset of up to `max_rows` rows (0 = ARROW_BATCH_ROWS) as
+/// an Arrow record batch: a struct array with one child per column, built
+/// column by column straight from the decoded rows. `schema`, if not null,
+/// receives the result set's schema, also on SQL_NO_DATA so an empty result
+/// set still has one. `array` is only filled when rows are returned. Both
+/// follow the C Data Interface ownership rules: the caller releases them.
+pub fn fetch_arrow(
+    stmt: &mut Statement,
+    max_rows: usize,
+    array: *mut ArrowArray,
+    schema: *mut ArrowSchema,
+) -> SQLRETURN {
+    if !stmt.executed || stmt.columns.is_empty() {
+        stmt.diagnostics.push(DiagRecord {
+            state: "24000".to_string(),
+            native_error: 0,
+            message: "Invalid cursor state: no result set".to_string(),
+        });
+        return SQL_ERROR;
+    }
+    stmt.read_offsets.clear();
+
+    let max_rows = if max_rows == 0 {
+        ARROW_BATCH_ROWS
+    } else {
+        max_rows
+    };
+    let ret = crate::fetch::next_rowset(stmt, max_rows);
+    if !schema.is_null() && ret != SQL_ERROR {
+        unsafe { schema.write(export_schema(&stmt.columns)) };
+    }
+    if stmt.rowset_len == 0 || array.is_null() {
+        return ret;
+    }
+
+    let base = stmt.row_index as usize;
+    let n = stmt.rowset_len;
+    let children = stmt
+        .columns
+        .iter()
+        .enumerate()
+        .map(|(col_idx, c)| {
+            let mut builder = ColumnBuilder::new(ArrowType::of(c), n);
+            for row in base..base + n {
+                builder.push(stmt.rows.cell(row, col_idx).unwrap_or(Cell::Null));
+            }
+            Box::into_raw(Box::new(builder.finish()))
+        })
+        .collect();
+    let batch = ArrayPrivate {
+        buffers: vec![ptr::null()],
+        children,
+        _validity: Vec::new(),
+        _values: None,
+    }
+    .into_array(n, 0);
+    unsafe { array.write(batch) };
+    ret
+}
@@ -0,0 +1,260 @@
+use std::collections::VecDeque;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Condvar, Mutex, OnceLock};
+use std::time::Duration;
+
+use crate::handle::*;
+use crate::types::*;
+
+/// Most worker threads an engine runs; calls beyond that wait their turn
+const MAX_WORKERS: usize = 64;
+/// Idle workers exit after this long, so a quiet environment holds none
+const IDLE_TIMEOUT: Duration = Duration::from_secs(30);
+
+/// Functions that can run asynchronously (SQL_ATTR_ASYNC_ENABLE)
+#[derive(Clone, Copy, PartialEq, Eq)]
+pub enum AsyncFn {
+    ExecDirect,
+    Execute,
+    Fetch,
+    MoreResults,
+}
+
+/// SQL_ASYNC_NOTIFICATION_CALLBACK, installed by an ODBC 3.8 driver manager
+/// through SQL_ATTR_ASYNC_STMT_PCALLBACK
+pub type NotifyCallback = unsafe extern "C" fn(context: SQLPOINTER, last: i32) -> SQLRETURN;
+
+/// Outcome of a call handed to a worker
+#[derive(Default)]
+struct Completion {
+    result: Mutex<Option<SQLRETURN>>,
+    cancelled: AtomicBool,
+}
+
+/// The call in flight on a statement. Only the application's thread reads
+/// or replaces it; the worker reports back through `completion`.
+pub struct AsyncOp {
+    func: AsyncFn,
+    completion: Arc<Completion>,
+}
+
+type Job = Box<dyn FnOnce() + Send>;
+
+#[derive(Default)]
+struct Queue {
+    jobs: VecDeque<Job>,
+    workers: usize,
+    idle: usize,
+}
+
+/// Worker threads shared by every connection of an environment. tabby's
+/// client blocks on the socket for the duration of a call, so each call in
+/// flight occupies a worker; the pool grows with the number of concurrent
+/// calls up to MAX_WORKERS and shrinks again when they stop.
+#[derive(Default)]
+pub struct Engine {
+    queue: Mutex<Queue>,
+    ready: Condvar,
+}
+
+/// The application guarantees a statement is not used, except to poll or
+/// cancel, while its asynchronous call runs
+struct StmtPtr(*mut Statement);
+unsafe impl Send for StmtPtr {}
+
+impl Engine {
+    fn submit(self: &Arc<Self>, job: Job) {
+        let mut q = self.queue.lock().unwrap();
+        q.jobs.push_back(job);
+        if q.idle > 0 || q.workers >= MAX_WORKERS {
+            self.ready.notify_one();
+            return;
+        }
+        q.workers += 1;
+        drop(q);
+        let engine = self.clone();
+        std::thread::spawn(move || engine.work());
+    }
+
+    fn work(&self) {
+        let mut q = self.queue.lock().unwrap();
+        loop {
+            if let Some(job) = q.jobs.pop_front() {
+                drop(q);
+                job();
+                q = self.queue.lock().unwrap();
+                continue;
+            }
+            q.idle += 1;
+            let (guard, wait) = self.ready.wait_timeout(q, IDLE_TIMEOUT).unwrap();
+            q = guard;
+            q.idle -= 1;
+            if wait.timed_out() && q.jobs.is_empty() {
+                q.workers -= 1;
+                return;
+            }
+        }
+    }
+}
+
+/// Engine for a statement's environment; statements of connections
+/// allocated without one share a process-wide engine
+fn engine(stmt: &Statement) -> Arc<Engine> {
+    static DETACHED: OnceLock<Arc<Engine>> = OnceLock::new();
+    let env = if stmt.conn.is_null() {
+        std::ptr::null_mut()
+    } else {
+        unsafe { (*stmt.conn).env }
+    };
+    if env.is_null() {
+        DETACHED.get_or_init(Default::default).clone()
+    } else {
+        unsafe { (*env).engine.clone() }
+    }
+}
+
+fn function_sequence_error(stmt: &mut Statement) -> SQLRETURN {
+    stmt.diagnostics.push(DiagRecord {
+        state: "HY010".to_string(),
+        native_error: 0,
+        message: "Function sequence error".to_string(),
+    });
+    SQL_ERROR
+}
+
+/// Call `func` again while it runs asynchronously: SQL_STILL_EXECUTING until
+/// it completes, then its return code. Returns None when no asynchronous
+/// call is in flight, so the caller starts `func` afresh.
+pub fn poll(stmt: &mut Statement, func: AsyncFn) -> Option<SQLRETURN> {
+    let op = stmt.async_op.as_ref()?;
+    // The running call owns the statement's diagnostics, so a call out of
+    // sequence cannot report one
+    if op.func != func {
+        return Some(SQL_ERROR);
+    }
+    let ret = (*op.completion.result.lock().unwrap())?;
+    Some(finish(stmt, ret))
+}
+
+fn finish(stmt: &mut Statement, ret: SQLRETURN) -> SQLRETURN {
+    stmt.async_op = None;
+    if !stmt.conn.is_null() {
+        unsafe { (*stmt.conn).async_stmt = std::ptr::null_mut() };
+    }
+    ret
+}
+
+/// Whether an asynchronous call is still running on the statement. A
+/// completed call the application never collected is dropped, as when the
+/// statement is closed or freed.
+pub fn busy(stmt: &mut Statement) -> bool {
+    if running(stmt) {
+        return true;
+    }
+    if stmt.async_op.is_some() {
+        finish(stmt, SQL_SUCCESS);
+    }
+    false
+}
+
+/// Like `busy`, for whichever statement of the connection has a call
+pub fn conn_busy_any(conn: &mut Connection) -> bool {
+    !conn.async_stmt.is_null() && busy(unsafe { &mut *conn.async_stmt })
+}
+
+/// Whether the statement's asynchronous call is still running, so its
+/// diagnostics belong to the worker
+pub fn running(stmt: &Statement) -> bool {
+    stmt.async_op
+        .as_ref()
+        .is_some_and(|op| op.completion.result.lock().unwrap().is_none())
+}
+
+/// Whether another statement of the connection has an asynchronous call in
+/// flight and so owns the wire
+pub fn conn_busy(conn: &Connection, stmt: *const Statement) -> bool {
+    !conn.async_stmt.is_null() && !std::ptr::eq(conn.async_stmt, stmt)
+}
+
+/// SQLCancel of an asynchronous call. A call still queued fails with HY008
+/// when it reaches a worker; one waiting on the server is interrupted by the
+/// attention signal the caller sends.
+pub fn cancel(stmt: &Statement) {
+    if let Some(op) = stmt.async_op.as_ref() {
+        op.completion.cancelled.store(true, Ordering::SeqCst);
+    }
+}
+
+/// Run `f` as `func`: on the calling thread, or with SQL_ATTR_ASYNC_ENABLE
+/// on a worker of the environment's engine, returning SQL_STILL_EXECUTING.
+/// Completion is signalled through the SQL_ATTR_ASYNC_STMT_PCALLBACK
+/// callback or, without one, the SQL_ATTR_ASYNC_STMT_EVENT eventfd.
+pub fn run(
+    stmt: &mut Statement,
+    func: AsyncFn,
+    f: impl FnOnce(&mut Statement) -> SQLRETURN + Send + 'static,
+) -> SQLRETURN {
+    if !stmt.conn.is_null() && conn_busy(unsafe { &*stmt.conn }, stmt) {
+        return function_sequence_error(stmt);
+    }
+    if !stmt.async_enable {
+        return f(stmt);
+    }
+    let completion = Arc::new(Completion::default());
+    stmt.async_op = Some(AsyncOp {
+        func,
+        completion: completion.clone(),
+    });
+    if !stmt.conn.is_null() {
+        unsafe { (*stmt.conn).async_stmt = stmt };
+    }
+    let callback = stmt.async_callback;
+    let context = stmt.async_context as usize;
+    let event = stmt.async_event as usize;
+    let target = StmtPtr(stmt);
+    engine(stmt).submit(Box::new(move || {
+        let target = target;
+        let stmt = unsafe { &mut *target.0 };
+        let ret = if completion.cancelled.load(Ordering::SeqCst) {
+            stmt.diagnostics.push(DiagRecord {
+                state: "HY008".to_string(),
+                native_error: 0,
+                message: "Operation canceled".to_string(),
+            });
+            SQL_ERROR
+        } else {
+            let _lock = stmt.lock();
+            f(stmt)
+        };
+        *completion.result.lock().unwrap() = Some(ret);
+        notify(callback, context as SQLPOINTER, event);
+    }));
+    SQL_STILL_EXECUTING
+}
+
+fn notify(callback: Option<NotifyCallback>, context: SQLPOINTER, event: usize) {
+    if let Some(callback) = callback {
+        // The call's only notification, hence the last
+        unsafe { callback(context, 1) };
+    } else if event != 0 {
+        signal_eventfd(event as i32);
+    }
+}
+
+/// Unix stand-in for the Windows event of SQL_ATTR_ASYNC_STMT_EVENT: the
+/// attribute carries an eventfd (or pipe) descriptor, which is written once
+#[cfg(unix)]
+fn signal_eventfd(fd: i32) {
+    use std::io::Write;
+    use std::os::fd::FromRawFd;
+    let mut file = std::mem::ManuallyDrop::new(unsafe { std::fs::File::from_raw_fd(fd) });
+    let _ = file.write_all(&1u64.to_ne_bytes());
+}
+
+#[cfg(not(unix))]
+fn signal_eventfd(_fd: i32) {}
+
+/// Parse SQL_ATTR_ASYNC_STMT_PCALLBACK
+pub fn callback_from(value: SQLPOINTER) -> Option<NotifyCallback> {
+    (!value.is_null()).then(|| unsafe { std::mem::transmute::<SQLPOINTER, NotifyCallback>(value) })
+}
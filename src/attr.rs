@@ -16,6 +16,45 @@ pub fn set_env_attr(
     }
 }
 
+pub fn get_connect_attr(
+    conn: &crate::handle::Connection,
+    attribute: SQLINTEGER,
+    value: SQLPOINTER,
+    buffer_length: SQLINTEGER,
+    string_length: *mut SQLINTEGER,
+) -> SQLRETURN {
+    let write_ulen = |v: SQLULEN| {
+        if !value.is_null() {
+            unsafe { *(value as *mut SQLULEN) = v };
+        }
+        SQL_SUCCESS
+    };
+    match attribute {
+        SQL_ATTR_AUTOCOMMIT => write_ulen(if conn.autocommit { 1 } else { 0 }),
+        SQL_ATTR_LOGIN_TIMEOUT => write_ulen(conn.login_timeout),
+        SQL_ATTR_PACKET_SIZE => write_ulen(conn.packet_size),
+        SQL_ATTR_ASYNC_ENABLE => write_ulen(conn.async_enable as SQLULEN),
+        SQL_ATTR_FB_POOL_HITS | SQL_ATTR_FB_POOL_MISSES => {
+            if conn.env.is_null() {
+                return write_ulen(0);
+            }
+            let pool = unsafe { &*conn.env }.pool.lock().unwrap();
+            write_ulen(if attribute == SQL_ATTR_FB_POOL_HITS {
+                pool.hits
+            } else {
+                pool.misses
+            } as SQLULEN)
+        }
+        SQL_ATTR_FB_STATS => crate::stats::write(
+            &crate::stats::connection_stats(conn),
+            value,
+            buffer_length,
+            string_length,
+        ),
+        _ => SQL_SUCCESS,
+    }
+}
+
 pub fn set_connect_attr(
     conn: &mut crate::handle::Connection,
     attribute: SQLINTEGER,
@@ -33,7 +72,7 @@ pub fn set_connect_attr(
                         let result = {
                             let mut w = crate::handle::StringRowWriter::new();
                             client
-                                .batch_into("COMMIT", &mut w)
+                                .batch_into(crate::execute::COMMIT, &mut w)
                                 .map_err(|e| e.to_string())
                         };
                         if result.is_err() {
@@ -46,7 +85,35 @@ pub fn set_connect_attr(
             }
             SQL_SUCCESS
         }
-        SQL_ATTR_LOGIN_TIMEOUT | SQL_ATTR_CONNECTION_TIMEOUT => SQL_SUCCESS,
+        SQL_ATTR_LOGIN_TIMEOUT => {
+            conn.login_timeout = value as SQLULEN;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_PACKET_SIZE if conn.connected => {
+            conn.diagnostics.push(crate::handle::DiagRecord {
+                state: "HY011".to_string(),
+                native_error: 0,
+                message: "Attribute cannot be set now".to_string(),
+            });
+            SQL_ERROR
+        }
+        SQL_ATTR_PACKET_SIZE => {
+            conn.packet_size = value as SQLULEN;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_CONNECTION_TIMEOUT => SQL_SUCCESS,
+        SQL_ATTR_ASYNC_ENABLE => {
+            // Applies to the connection's statements, present and future
+            conn.async_enable = value as SQLULEN == SQL_ASYNC_ENABLE_ON;
+            for &stmt in &conn.statements {
+                unsafe { (*stmt).async_enable = conn.async_enable };
+            }
+            SQL_SUCCESS
+        }
+        SQL_ATTR_FB_STATS if value.is_null() => {
+            crate::stats::reset_connection(conn);
+            SQL_SUCCESS
+        }
         _ => SQL_SUCCESS,
     }
 }
@@ -150,10 +217,22 @@ pub fn get_info(
         SQL_MAX_COLUMN_NAME_LEN => write_u16(128),
         SQL_MAX_IDENTIFIER_LEN => write_u16(128),
         SQL_GETDATA_EXTENSIONS => write_u32(SQL_GD_ANY_COLUMN | SQL_GD_ANY_ORDER),
+        SQL_SCROLL_OPTIONS => {
+            write_u32(SQL_SO_FORWARD_ONLY | SQL_SO_KEYSET_DRIVEN | SQL_SO_DYNAMIC | SQL_SO_STATIC)
+        }
+        SQL_SCROLL_CONCURRENCY => write_u32(
+            SQL_SCCO_READ_ONLY | SQL_SCCO_LOCK | SQL_SCCO_OPT_ROWVER | SQL_SCCO_OPT_VALUES,
+        ),
         SQL_TXN_ISOLATION_OPTION => write_u32(0x0F),
         SQL_DEFAULT_TXN_ISOLATION => write_u32(2), // READ_COMMITTED
         SQL_SUBQUERIES => write_u32(0x1F),
         SQL_UNION => write_u32(3),
+        SQL_PARAM_ARRAY_ROW_COUNTS => write_u32(SQL_PARC_NO_BATCH),
+        SQL_PARAM_ARRAY_SELECTS => write_u32(SQL_PAS_NO_SELECT),
+        SQL_ASYNC_MODE => write_u32(SQL_AM_STATEMENT),
+        // One asynchronous call at a time per connection, which owns the wire
+        SQL_MAX_ASYNC_CONCURRENT_STATEMENTS => write_u32(1),
+        SQL_ASYNC_NOTIFICATION => write_u32(SQL_ASYNC_NOTIFICATION_CAPABLE),
         _ => write_str(""),
     }
 }
@@ -162,37 +241,299 @@ pub fn set_stmt_attr(
     stmt: &mut crate::handle::Statement,
     attribute: SQLINTEGER,
     value: SQLPOINTER,
-    _string_length: SQLINTEGER,
+    string_length: SQLINTEGER,
+    wide: bool,
 ) -> SQLRETURN {
-    const SQL_ATTR_PARAMSET_SIZE: SQLINTEGER = 22;
     match attribute {
         SQL_ATTR_PARAMSET_SIZE => {
             let size = value as usize;
-            if size > 1 {
-                // Array parameter binding (fast_executemany) not supported
+            if size == 0 {
+                stmt.diagnostics.push(crate::handle::DiagRecord {
+                    state: "HY024".to_string(),
+                    native_error: 0,
+                    message: "Invalid attribute value (paramset size must be > 0)".to_string(),
+                });
+                return SQL_ERROR;
+            }
+            stmt.paramset_size = size;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_PARAM_BIND_TYPE => {
+            stmt.param_bind_type = value as SQLULEN;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_QUERY_TIMEOUT => {
+            let conn = unsafe { stmt.conn.as_ref() };
+            let signals = conn
+                .and_then(|c| c.attention.as_ref())
+                .is_none_or(|a| a.can_signal());
+            if value as SQLULEN != 0 && !signals {
                 stmt.diagnostics.push(crate::handle::DiagRecord {
                     state: "HYC00".to_string(),
                     native_error: 0,
-                    message: "Array parameter binding (paramset_size > 1) not supported"
+                    message: "Query timeout is not supported on an encrypted connection"
                         .to_string(),
                 });
                 return SQL_ERROR;
             }
-            stmt.paramset_size = 1;
+            stmt.query_timeout = value as SQLULEN;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_FB_PREFETCH_BYTES => {
+            let bytes = value as usize;
+            if bytes == 0 {
+                stmt.diagnostics.push(crate::handle::DiagRecord {
+                    state: "HY024".to_string(),
+                    native_error: 0,
+                    message: "Invalid attribute value (prefetch budget must be > 0)".to_string(),
+                });
+                return SQL_ERROR;
+            }
+            stmt.prefetch_bytes = bytes;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_FB_READ_AHEAD => {
+            stmt.read_ahead = value as SQLULEN != 0;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_FB_PARTITIONS => {
+            let n = value as usize;
+            if n > crate::partition::MAX_PARTITIONS {
+                return invalid_value(stmt, "too many partitions");
+            }
+            stmt.partitions = n;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_FB_PARTITION_KEY => {
+            stmt.partition_key = unsafe { read_str(value, string_length, wide) };
+            SQL_SUCCESS
+        }
+        SQL_ATTR_FB_PARTITION_ORDERED => {
+            stmt.partition_ordered = value as SQLULEN != 0;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_FB_STATS if value.is_null() => {
+            stmt.stats = Default::default();
+            SQL_SUCCESS
+        }
+        SQL_ATTR_FB_STATS => invalid_value(stmt, "counters can only be reset"),
+        SQL_ATTR_ASYNC_ENABLE => {
+            stmt.async_enable = value as SQLULEN == SQL_ASYNC_ENABLE_ON;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_ASYNC_STMT_EVENT => {
+            stmt.async_event = value;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_ASYNC_STMT_PCALLBACK => {
+            stmt.async_callback = crate::asyncexec::callback_from(value);
+            SQL_SUCCESS
+        }
+        SQL_ATTR_ASYNC_STMT_PCONTEXT => {
+            stmt.async_context = value;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_PARAM_BIND_OFFSET_PTR => {
+            stmt.param_bind_offset_ptr = value as *mut SQLULEN;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_PARAM_OPERATION_PTR => {
+            stmt.param_operation_ptr = value as *mut SQLUSMALLINT;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_PARAM_STATUS_PTR => {
+            stmt.param_status_ptr = value as *mut SQLUSMALLINT;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_PARAMS_PROCESSED_PTR => {
+            stmt.params_processed_ptr = value as *mut SQLULEN;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_ROW_ARRAY_SIZE => {
+            let size = value as usize;
+            if size == 0 {
+                stmt.diagnostics.push(crate::handle::DiagRecord {
+                    state: "HY024".to_string(),
+                    native_error: 0,
+                    message: "Invalid attribute value (row array size must be > 0)".to_string(),
+                });
+                return SQL_ERROR;
+            }
+            stmt.row_array_size = size;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_ROW_BIND_TYPE => {
+            stmt.row_bind_type = value as SQLULEN;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_ROW_BIND_OFFSET_PTR => {
+            stmt.row_bind_offset_ptr = value as *mut SQLULEN;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_ROWS_FETCHED_PTR => {
+            stmt.rows_fetched_ptr = value as *mut SQLULEN;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_ROW_STATUS_PTR => {
+            stmt.row_status_ptr = value as *mut SQLUSMALLINT;
+            SQL_SUCCESS
+        }
+        SQL_ATTR_CURSOR_TYPE => match value as SQLULEN {
+            t @ (SQL_CURSOR_FORWARD_ONLY
+            | SQL_CURSOR_KEYSET_DRIVEN
+            | SQL_CURSOR_DYNAMIC
+            | SQL_CURSOR_STATIC) => {
+                stmt.cursor_type = t;
+                SQL_SUCCESS
+            }
+            _ => invalid_value(stmt, "cursor type"),
+        },
+        SQL_ATTR_CONCURRENCY => match value as SQLULEN {
+            c
+            @ (SQL_CONCUR_READ_ONLY | SQL_CONCUR_LOCK | SQL_CONCUR_ROWVER | SQL_CONCUR_VALUES) => {
+                stmt.concurrency = c;
+                SQL_SUCCESS
+            }
+            _ => invalid_value(stmt, "concurrency"),
+        },
+        // A scrollable cursor is a static one unless a type was chosen
+        SQL_ATTR_CURSOR_SCROLLABLE => {
+            match value as SQLULEN {
+                SQL_NONSCROLLABLE => stmt.cursor_type = SQL_CURSOR_FORWARD_ONLY,
+                SQL_SCROLLABLE if stmt.cursor_type == SQL_CURSOR_FORWARD_ONLY => {
+                    stmt.cursor_type = SQL_CURSOR_STATIC
+                }
+                SQL_SCROLLABLE => {}
+                _ => return invalid_value(stmt, "cursor scrollability"),
+            }
             SQL_SUCCESS
         }
         _ => SQL_SUCCESS,
     }
 }
 
+/// A string attribute value of `len` bytes, or up to its NUL with SQL_NTS.
+/// A null pointer is the empty string.
+unsafe fn read_str(value: SQLPOINTER, len: SQLINTEGER, wide: bool) -> String {
+    if value.is_null() {
+        return String::new();
+    }
+    if wide {
+        let units = if len < 0 { -1 } else { len as isize / 2 };
+        return crate::utf16::from_wide_ptr(value as *const u16, units);
+    }
+    let bytes = if len < 0 {
+        std::ffi::CStr::from_ptr(value as *const std::ffi::c_char).to_bytes()
+    } else {
+        std::slice::from_raw_parts(value as *const u8, len as usize)
+    };
+    String::from_utf8_lossy(bytes).into_owned()
+}
+
+fn invalid_value(stmt: &mut crate::handle::Statement, what: &str) -> SQLRETURN {
+    stmt.diagnostics.push(crate::handle::DiagRecord {
+        state: "HY024".to_string(),
+        native_error: 0,
+        message: format!("Invalid attribute value ({})", what),
+    });
+    SQL_ERROR
+}
+
 pub fn get_stmt_attr(
-    _stmt: &crate::handle::Statement,
-    _attribute: SQLINTEGER,
-    _value: SQLPOINTER,
-    _buffer_length: SQLINTEGER,
-    _string_length: *mut SQLINTEGER,
+    stmt: &crate::handle::Statement,
+    attribute: SQLINTEGER,
+    value: SQLPOINTER,
+    buffer_length: SQLINTEGER,
+    string_length: *mut SQLINTEGER,
+    wide: bool,
 ) -> SQLRETURN {
-    SQL_SUCCESS
+    let write_ulen = |v: SQLULEN| -> SQLRETURN {
+        if !value.is_null() {
+            unsafe {
+                *(value as *mut SQLULEN) = v;
+            }
+        }
+        if !string_length.is_null() {
+            unsafe {
+                *string_length = std::mem::size_of::<SQLULEN>() as SQLINTEGER;
+            }
+        }
+        SQL_SUCCESS
+    };
+
+    let write_ptr = |p: SQLPOINTER| -> SQLRETURN {
+        if !value.is_null() {
+            unsafe {
+                *(value as *mut SQLPOINTER) = p;
+            }
+        }
+        if !string_length.is_null() {
+            unsafe {
+                *string_length = std::mem::size_of::<SQLPOINTER>() as SQLINTEGER;
+            }
+        }
+        SQL_SUCCESS
+    };
+
+    // String values are NUL-terminated and cut to the buffer; their whole
+    // length in bytes goes to `string_length`
+    let write_str = |s: &str| -> SQLRETURN {
+        let len = if wide {
+            let cap = buffer_length.max(0) as usize / 2;
+            2 * unsafe { crate::utf16::write_wide(s, value as *mut u16, cap) }
+        } else {
+            if !value.is_null() && buffer_length > 0 {
+                let n = s.len().min(buffer_length as usize - 1);
+                unsafe {
+                    ptr::copy_nonoverlapping(s.as_ptr(), value as *mut u8, n);
+                    *(value as *mut u8).add(n) = 0;
+                }
+            }
+            s.len()
+        };
+        if !string_length.is_null() {
+            unsafe {
+                *string_length = len as SQLINTEGER;
+            }
+        }
+        SQL_SUCCESS
+    };
+
+    match attribute {
+        SQL_ATTR_PARAMSET_SIZE => write_ulen(stmt.paramset_size),
+        SQL_ATTR_QUERY_TIMEOUT => write_ulen(stmt.query_timeout),
+        SQL_ATTR_FB_PREFETCH_BYTES => write_ulen(stmt.prefetch_bytes),
+        SQL_ATTR_FB_READ_AHEAD => write_ulen(stmt.read_ahead as usize),
+        SQL_ATTR_FB_PARTITIONS => write_ulen(stmt.partitions),
+        SQL_ATTR_FB_PARTITION_KEY => write_str(&stmt.partition_key),
+        SQL_ATTR_FB_PARTITION_ORDERED => write_ulen(stmt.partition_ordered as usize),
+        SQL_ATTR_FB_STATS => crate::stats::write(&stmt.stats, value, buffer_length, string_length),
+        SQL_ATTR_ASYNC_ENABLE => write_ulen(stmt.async_enable as SQLULEN),
+        SQL_ATTR_ASYNC_STMT_EVENT => write_ptr(stmt.async_event),
+        SQL_ATTR_ASYNC_STMT_PCALLBACK => write_ptr(
+            stmt.async_callback
+                .map_or(ptr::null_mut(), |f| f as SQLPOINTER),
+        ),
+        SQL_ATTR_ASYNC_STMT_PCONTEXT => write_ptr(stmt.async_context),
+        SQL_ATTR_PARAM_BIND_TYPE => write_ulen(stmt.param_bind_type),
+        SQL_ATTR_PARAM_BIND_OFFSET_PTR => write_ptr(stmt.param_bind_offset_ptr as SQLPOINTER),
+        SQL_ATTR_PARAM_OPERATION_PTR => write_ptr(stmt.param_operation_ptr as SQLPOINTER),
+        SQL_ATTR_PARAM_STATUS_PTR => write_ptr(stmt.param_status_ptr as SQLPOINTER),
+        SQL_ATTR_PARAMS_PROCESSED_PTR => write_ptr(stmt.params_processed_ptr as SQLPOINTER),
+        SQL_ATTR_ROW_ARRAY_SIZE => write_ulen(stmt.row_array_size),
+        SQL_ATTR_ROW_BIND_TYPE => write_ulen(stmt.row_bind_type),
+        SQL_ATTR_ROW_BIND_OFFSET_PTR => write_ptr(stmt.row_bind_offset_ptr as SQLPOINTER),
+        SQL_ATTR_ROWS_FETCHED_PTR => write_ptr(stmt.rows_fetched_ptr as SQLPOINTER),
+        SQL_ATTR_ROW_STATUS_PTR => write_ptr(stmt.row_status_ptr as SQLPOINTER),
+        SQL_ATTR_CURSOR_TYPE => write_ulen(stmt.cursor_type),
+        SQL_ATTR_CONCURRENCY => write_ulen(stmt.concurrency),
+        SQL_ATTR_CURSOR_SCROLLABLE => write_ulen(if stmt.cursor_type == SQL_CURSOR_FORWARD_ONLY {
+            SQL_NONSCROLLABLE
+        } else {
+            SQL_SCROLLABLE
+        }),
+        _ => SQL_SUCCESS,
+    }
 }
 
 pub fn get_info_w(
@@ -204,20 +545,11 @@ pub fn get_info_w(
 ) -> SQLRETURN {
     // Helper to write a UTF-16 string info value
     let write_str_w = |s: &str| -> SQLRETURN {
-        let utf16: Vec<u16> = s.encode_utf16().collect();
-        let byte_len = (utf16.len() * 2) as SQLSMALLINT;
+        let cap = (buffer_length.max(0) as usize) / 2;
+        let units = unsafe { crate::utf16::write_wide(s, info_value as *mut u16, cap) };
         if !string_length.is_null() {
             unsafe {
-                *string_length = byte_len;
-            }
-        }
-        if !info_value.is_null() && buffer_length > 0 {
-            let buf_cap = (buffer_length as usize) / 2;
-            let copy_count = std::cmp::min(utf16.len(), buf_cap.saturating_sub(1));
-            let dest = info_value as *mut u16;
-            unsafe {
-                ptr::copy_nonoverlapping(utf16.as_ptr(), dest, copy_count);
-                *dest.add(copy_count) = 0;
+                *string_length = (units * 2) as SQLSMALLINT;
             }
         }
         SQL_SUCCESS
@@ -301,6 +633,8 @@ pub fn get_info_w(
         SQL_DEFAULT_TXN_ISOLATION => write_u32(2),
         SQL_SUBQUERIES => write_u32(0x1F),
         SQL_UNION => write_u32(3),
+        SQL_PARAM_ARRAY_ROW_COUNTS => write_u32(SQL_PARC_NO_BATCH),
+        SQL_PARAM_ARRAY_SELECTS => write_u32(SQL_PAS_NO_SELECT),
         _ => write_str_w(""),
     }
 }
@@ -0,0 +1,550 @@
+use crate::handle::{Cell, CellValue};
+use crate::utf16;
+
+/// Byte range of one string or binary value in the arena
+type Span = (usize, usize);
+
+/// Values of one column, one element per row (NULL rows hold a placeholder).
+/// The representation is picked by the first non-NULL value; a value of
+/// another type later on (sql_variant, or decimals of mixed scale) switches
+/// the column to owned per-row values.
+#[derive(Clone)]
+enum Values {
+    Empty,
+    Bool(Vec<bool>),
+    U8(Vec<u8>),
+    I16(Vec<i16>),
+    I32(Vec<i32>),
+    I64(Vec<i64>),
+    F32(Vec<f32>),
+    F64(Vec<f64>),
+    Date(Vec<i32>),
+    Time(Vec<i64>),
+    DateTime(Vec<i64>),
+    DateTimeOffset(Vec<(i64, i16)>),
+    Decimal {
+        values: Vec<i128>,
+        precision: u8,
+        scale: u8,
+    },
+    Guid(Vec<[u8; 16]>),
+    Str(Vec<Span>),
+    /// UTF-16LE text, for columns read as SQL_C_WCHAR
+    Wide(Vec<Span>),
+    Bytes(Vec<Span>),
+    Variant(Vec<CellValue>),
+}
+
+/// Run `$body` with `$v` bound to the value vector of whichever
+/// representation `$values` holds.
+macro_rules! with_vec {
+    ($values:expr, $v:ident => $body:expr) => {
+        match $values {
+            Values::Empty => {}
+            Values::Bool($v) => $body,
+            Values::U8($v) => $body,
+            Values::I16($v) => $body,
+            Values::I32($v) => $body,
+            Values::I64($v) => $body,
+            Values::F32($v) => $body,
+            Values::F64($v) => $body,
+            Values::Date($v) => $body,
+            Values::Time($v) => $body,
+            Values::DateTime($v) => $body,
+            Values::DateTimeOffset($v) => $body,
+            Values::Decimal { values: $v, .. } => $body,
+            Values::Guid($v) => $body,
+            Values::Str($v) => $body,
+            Values::Wide($v) => $body,
+            Values::Bytes($v) => $body,
+            Values::Variant($v) => $body,
+        }
+    };
+}
+
+impl Values {
+    /// Representation for `cell`, holding `rows` placeholders for the NULL
+    /// rows that came before it.
+    fn for_cell(cell: &Cell<'_>, rows: usize) -> Values {
+        match *cell {
+            Cell::Null => Values::Empty,
+            Cell::Bool(_) => Values::Bool(vec![false; rows]),
+            Cell::U8(_) => Values::U8(vec![0; rows]),
+            Cell::I16(_) => Values::I16(vec![0; rows]),
+            Cell::I32(_) => Values::I32(vec![0; rows]),
+            Cell::I64(_) => Values::I64(vec![0; rows]),
+            Cell::F32(_) => Values::F32(vec![0.0; rows]),
+            Cell::F64(_) => Values::F64(vec![0.0; rows]),
+            Cell::Date { .. } => Values::Date(vec![0; rows]),
+            Cell::Time { .. } => Values::Time(vec![0; rows]),
+            Cell::DateTime { .. } => Values::DateTime(vec![0; rows]),
+            Cell::DateTimeOffset { .. } => Values::DateTimeOffset(vec![(0, 0); rows]),
+            Cell::Decimal {
+                precision, scale, ..
+            } => Values::Decimal {
+                values: vec![0; rows],
+                precision,
+                scale,
+            },
+            Cell::Guid(_) => Values::Guid(vec![[0; 16]; rows]),
+            Cell::Str(_) => Values::Str(vec![(0, 0); rows]),
+            Cell::Wide(_) => Values::Wide(vec![(0, 0); rows]),
+            Cell::Bytes(_) => Values::Bytes(vec![(0, 0); rows]),
+        }
+    }
+
+    fn push_placeholder(&mut self) {
+        with_vec!(self, v => v.push(Default::default()))
+    }
+
+    /// Append `cell` if it fits this representation.
+    fn try_push(&mut self, cell: Cell<'_>, arena: &mut Vec<u8>) -> bool {
+        match (self, cell) {
+            (Values::Bool(v), Cell::Bool(x)) => v.push(x),
+            (Values::U8(v), Cell::U8(x)) => v.push(x),
+            (Values::I16(v), Cell::I16(x)) => v.push(x),
+            (Values::I32(v), Cell::I32(x)) => v.push(x),
+            (Values::I64(v), Cell::I64(x)) => v.push(x),
+            (Values::F32(v), Cell::F32(x)) => v.push(x),
+            (Values::F64(v), Cell::F64(x)) => v.push(x),
+            (Values::Date(v), Cell::Date { days }) => v.push(days),
+            (Values::Time(v), Cell::Time { nanos }) => v.push(nanos),
+            (Values::DateTime(v), Cell::DateTime { micros }) => v.push(micros),
+            (Values::DateTimeOffset(v), Cell::DateTimeOffset { micros, offset_min }) => {
+                v.push((micros, offset_min))
+            }
+            (
+                Values::Decimal {
+                    values,
+                    precision,
+                    scale,
+                },
+                Cell::Decimal {
+                    value,
+                    precision: p,
+                    scale: s,
+                },
+            ) if *precision == p && *scale == s => values.push(value),
+            (Values::Guid(v), Cell::Guid(x)) => v.push(x),
+            (Values::Str(v), Cell::Str(s)) => v.push(append(arena, s.as_bytes())),
+            (Values::Wide(v), Cell::Wide(b)) => v.push(append(arena, b)),
+            // A block read before the application's preference changed
+            (Values::Str(v), Cell::Wide(b)) => v.push(append_utf8(arena, b)),
+            (Values::Wide(v), Cell::Str(s)) => v.push(append_utf16(arena, s)),
+            (Values::Bytes(v), Cell::Bytes(b)) => v.push(append(arena, b)),
+            (Values::Variant(v), c) => v.push(c.into_value()),
+            _ => return false,
+        }
+        true
+    }
+
+    fn get<'a>(&'a self, row: usize, arena: &'a [u8]) -> Cell<'a> {
+        match self {
+            Values::Empty => Cell::Null,
+            Values::Bool(v) => Cell::Bool(v[row]),
+            Values::U8(v) => Cell::U8(v[row]),
+            Values::I16(v) => Cell::I16(v[row]),
+            Values::I32(v) => Cell::I32(v[row]),
+            Values::I64(v) => Cell::I64(v[row]),
+            Values::F32(v) => Cell::F32(v[row]),
+            Values::F64(v) => Cell::F64(v[row]),
+            Values::Date(v) => Cell::Date { days: v[row] },
+            Values::Time(v) => Cell::Time { nanos: v[row] },
+            Values::DateTime(v) => Cell::DateTime { micros: v[row] },
+            Values::DateTimeOffset(v) => Cell::DateTimeOffset {
+                micros: v[row].0,
+                offset_min: v[row].1,
+            },
+            Values::Decimal {
+                values,
+                precision,
+                scale,
+            } => Cell::Decimal {
+                value: values[row],
+                precision: *precision,
+                scale: *scale,
+            },
+            Values::Guid(v) => Cell::Guid(v[row]),
+            Values::Str(v) => {
+                let (start, end) = v[row];
+                // SAFETY: the span was copied from a &str (or encoded from
+                // UTF-16) and the arena is only ever cut at row boundaries
+                Cell::Str(unsafe { std::str::from_utf8_unchecked(&arena[start..end]) })
+            }
+            Values::Wide(v) => {
+                let (start, end) = v[row];
+                Cell::Wide(&arena[start..end])
+            }
+            Values::Bytes(v) => {
+                let (start, end) = v[row];
+                Cell::Bytes(&arena[start..end])
+            }
+            Values::Variant(v) => v[row].as_cell(),
+        }
+    }
+}
+
+fn append(arena: &mut Vec<u8>, bytes: &[u8]) -> Span {
+    let start = arena.len();
+    arena.extend_from_slice(bytes);
+    (start, arena.len())
+}
+
+/// Append UTF-16LE text transcoded to UTF-8
+fn append_utf8(arena: &mut Vec<u8>, bytes: &[u8]) -> Span {
+    let start = arena.len();
+    utf16::decode_le_into(bytes, arena);
+    (start, arena.len())
+}
+
+/// Append text as little-endian UTF-16 code units
+fn append_utf16(arena: &mut Vec<u8>, s: &str) -> Span {
+    let start = arena.len();
+    utf16::encode_le_into(s, arena);
+    (start, arena.len())
+}
+
+/// One column of a batch: its values and a null bitmap. Bits past `len` are
+/// always clear.
+#[derive(Clone)]
+struct Column {
+    values: Values,
+    nulls: Vec<u64>,
+    len: usize,
+}
+
+impl Column {
+    fn new() -> Self {
+        Self {
+            values: Values::Empty,
+            nulls: Vec::new(),
+            len: 0,
+        }
+    }
+
+    fn is_null(&self, row: usize) -> bool {
+        self.nulls[row / 64] & (1 << (row % 64)) != 0
+    }
+
+    fn next_slot(&mut self) -> usize {
+        let row = self.len;
+        if row.is_multiple_of(64) {
+            self.nulls.push(0);
+        }
+        self.len += 1;
+        row
+    }
+
+    fn push_null(&mut self) {
+        let row = self.next_slot();
+        self.nulls[row / 64] |= 1 << (row % 64);
+        self.values.push_placeholder();
+    }
+
+    fn push(&mut self, cell: Cell<'_>, arena: &mut Vec<u8>) {
+        if matches!(cell, Cell::Null) {
+            return self.push_null();
+        }
+        if matches!(self.values, Values::Empty) {
+            self.values = Values::for_cell(&cell, self.len);
+        }
+        if !self.values.try_push(cell, arena) {
+            let mut owned: Vec<CellValue> = (0..self.len)
+                .map(|r| self.get(r, arena).into_value())
+                .collect();
+            owned.push(cell.into_value());
+            self.values = Values::Variant(owned);
+        }
+        self.next_slot();
+    }
+
+    /// Append UTF-16 text straight into the arena: as it is when the column
+    /// is read as SQL_C_WCHAR (`wide`), otherwise transcoded to UTF-8.
+    fn push_utf16(&mut self, units: &[u16], arena: &mut Vec<u8>, wide: bool) {
+        if matches!(self.values, Values::Empty) {
+            let cell = if wide { Cell::Wide(&[]) } else { Cell::Str("") };
+            self.values = Values::for_cell(&cell, self.len);
+        }
+        #[cfg(target_endian = "little")]
+        // SAFETY: any initialized u16 slice is valid as bytes
+        let bytes =
+            unsafe { std::slice::from_raw_parts(units.as_ptr() as *const u8, units.len() * 2) };
+        #[cfg(target_endian = "big")]
+        let bytes = &units
+            .iter()
+            .flat_map(|u| u.to_le_bytes())
+            .collect::<Vec<u8>>()[..];
+        match &mut self.values {
+            Values::Wide(spans) => spans.push(append(arena, bytes)),
+            Values::Str(spans) => spans.push(append_utf8(arena, bytes)),
+            _ => return self.push(Cell::Wide(bytes), arena),
+        }
+        self.next_slot();
+    }
+
+    fn get<'a>(&'a self, row: usize, arena: &'a [u8]) -> Cell<'a> {
+        if self.is_null(row) {
+            Cell::Null
+        } else {
+            self.values.get(row, arena)
+        }
+    }
+
+    fn truncate(&mut self, len: usize) {
+        if len >= self.len {
+            return;
+        }
+        with_vec!(&mut self.values, v => v.truncate(len));
+        self.len = len;
+        self.clear_bits_past_len();
+    }
+
+    /// Drop the first `n` rows; `cut` is where the arena now starts.
+    fn discard_front(&mut self, n: usize, cut: usize) {
+        with_vec!(&mut self.values, v => {
+            v.drain(..n);
+        });
+        if let Values::Str(spans) | Values::Wide(spans) | Values::Bytes(spans) = &mut self.values {
+            // NULL rows hold a (0,0) placeholder that points at no bytes
+            for (row, span) in spans.iter_mut().enumerate() {
+                if self.nulls[(row + n) / 64] & (1 << ((row + n) % 64)) != 0 {
+                    continue;
+                }
+                span.0 -= cut;
+                span.1 -= cut;
+            }
+        }
+        // Shift the bitmap down; each bit is read before it is overwritten
+        let len = self.len - n;
+        for row in 0..len {
+            let word = &mut self.nulls[row / 64];
+            *word &= !(1 << (row % 64));
+            if self.nulls[(row + n) / 64] & (1 << ((row + n) % 64)) != 0 {
+                self.nulls[row / 64] |= 1 << (row % 64);
+            }
+        }
+        self.len = len;
+        self.clear_bits_past_len();
+    }
+
+    fn clear_bits_past_len(&mut self) {
+        self.nulls.truncate(self.len.div_ceil(64));
+        if !self.len.is_multiple_of(64) {
+            let last = self.nulls.len() - 1;
+            self.nulls[last] &= (1 << (self.len % 64)) - 1;
+        }
+    }
+}
+
+/// Column-oriented buffer for a block of rows: a typed array and null bitmap
+/// per column, plus one arena holding the bytes of every string and binary
+/// value. Rows are appended one cell at a time in column order, which is how
+/// tabby's RowWriter delivers them, and a buffer is reused from one block to
+/// the next without reallocating.
+#[derive(Clone, Default)]
+pub struct RowBatch {
+    columns: Vec<Column>,
+    arena: Vec<u8>,
+    /// Arena length at the start of each complete row, for dropping rows
+    /// from the front
+    row_starts: Vec<usize>,
+    /// Arena length at the start of the row being written
+    row_start: usize,
+    rows: usize,
+    /// Column the next cell of the row being written goes to
+    next_col: usize,
+    /// Columns (bit per column, first 64) whose UTF-16 text is kept as is
+    wide: u64,
+}
+
+impl RowBatch {
+    /// Number of complete rows
+    pub fn len(&self) -> usize {
+        self.rows
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.rows == 0
+    }
+
+    /// Number of columns the rows have
+    pub fn width(&self) -> usize {
+        self.columns.len()
+    }
+
+    /// Bytes held by the complete and partial rows: column arrays plus the
+    /// arena (owned sql_variant strings are not counted)
+    pub fn data_bytes(&self) -> usize {
+        let mut bytes = self.arena.len();
+        for column in &self.columns {
+            with_vec!(&column.values, v => bytes += std::mem::size_of_val(v.as_slice()));
+        }
+        bytes
+    }
+
+    /// Room allocated for the arena and column arrays, each in its own
+    /// units: it goes up only when one of them reallocates
+    pub fn capacity(&self) -> usize {
+        let mut capacity = self.arena.capacity() + self.row_starts.capacity();
+        for column in &self.columns {
+            with_vec!(&column.values, v => capacity += v.capacity());
+        }
+        capacity
+    }
+
+    /// The cell at `row`, `col` (both 0-based), or None if out of range
+    pub fn cell(&self, row: usize, col: usize) -> Option<Cell<'_>> {
+        if row >= self.rows {
+            return None;
+        }
+        self.columns.get(col).map(|c| c.get(row, &self.arena))
+    }
+
+    /// Column for the next cell of the row being written
+    fn next_column(&mut self) -> &mut Column {
+        while self.columns.len() <= self.next_col {
+            // A column first seen part way through: NULL in earlier rows
+            let mut column = Column::new();
+            for _ in 0..self.rows {
+                column.push_null();
+            }
+            self.columns.push(column);
+        }
+        self.next_col += 1;
+        &mut self.columns[self.next_col - 1]
+    }
+
+    /// Append the next cell of the row being written
+    pub fn push(&mut self, cell: Cell<'_>) {
+        let mut arena = std::mem::take(&mut self.arena);
+        self.next_column().push(cell, &mut arena);
+        self.arena = arena;
+    }
+
+    /// Append the next cell of the row being written from UTF-16 text
+    pub fn push_utf16(&mut self, units: &[u16]) {
+        let col = self.next_col;
+        let wide = col < 64 && self.wide & (1 << col) != 0;
+        let mut arena = std::mem::take(&mut self.arena);
+        self.next_column().push_utf16(units, &mut arena, wide);
+        self.arena = arena;
+    }
+
+    /// Columns (bit per column) whose UTF-16 text should be kept as is from
+    /// now on. An empty column whose text is held the other way starts over.
+    pub fn set_wide(&mut self, wide: u64) {
+        if wide == self.wide {
+            return;
+        }
+        self.wide = wide;
+        for (col, column) in self.columns.iter_mut().enumerate().take(64) {
+            let want = wide & (1 << col) != 0;
+            let empty = column.len == 0;
+            let held_wide = matches!(column.values, Values::Wide(_));
+            if empty
+                && matches!(column.values, Values::Str(_) | Values::Wide(_))
+                && held_wide != want
+            {
+                column.values = Values::Empty;
+            }
+        }
+    }
+
+    /// Append copies of all of `other`'s rows
+    pub fn append(&mut self, other: &RowBatch) {
+        for row in 0..other.rows {
+            self.append_row(other, row);
+        }
+    }
+
+    /// Append a copy of row `row` of `other`
+    pub fn append_row(&mut self, other: &RowBatch, row: usize) {
+        for column in &other.columns {
+            self.push(column.get(row, &other.arena));
+        }
+        self.finish_row();
+    }
+
+    /// Complete the row being written. Columns it did not reach are NULL.
+    pub fn finish_row(&mut self) {
+        for column in &mut self.columns[self.next_col..] {
+            column.push_null();
+        }
+        self.row_starts.push(self.row_start);
+        self.row_start = self.arena.len();
+        self.rows += 1;
+        self.next_col = 0;
+    }
+
+    /// Throw away the cells of a row that will not be completed
+    pub fn discard_partial_row(&mut self) {
+        for column in &mut self.columns {
+            column.truncate(self.rows);
+        }
+        self.arena.truncate(self.row_start);
+        self.next_col = 0;
+    }
+
+    /// Drop the rows from `len` on, keeping all allocations
+    pub fn truncate(&mut self, len: usize) {
+        if len >= self.rows {
+            return;
+        }
+        self.discard_partial_row();
+        for column in &mut self.columns {
+            column.truncate(len);
+        }
+        self.arena.truncate(self.row_starts[len]);
+        self.row_starts.truncate(len);
+        self.row_start = self.arena.len();
+        self.rows = len;
+    }
+
+    /// Drop the first `n` rows, keeping the rest (and all allocations) for
+    /// the next block.
+    pub fn discard_front(&mut self, n: usize) {
+        let n = n.min(self.rows);
+        if n == 0 {
+            return;
+        }
+        self.discard_partial_row();
+        if n == self.rows {
+            for column in &mut self.columns {
+                column.truncate(0);
+            }
+            self.arena.clear();
+            self.row_starts.clear();
+        } else {
+            let cut = self.row_starts[n];
+            for column in &mut self.columns {
+                column.discard_front(n, cut);
+            }
+            self.arena.drain(..cut);
+            self.row_starts.drain(..n);
+            for start in &mut self.row_starts {
+                *start -= cut;
+            }
+        }
+        self.row_start = self.arena.len();
+        self.rows -= n;
+    }
+
+    /// Release arena memory beyond `bytes`, or beyond what the rows still
+    /// held need
+    pub fn shrink_to(&mut self, bytes: usize) {
+        if self.arena.capacity() > bytes {
+            self.arena.shrink_to(bytes.max(self.arena.len()));
+        }
+    }
+
+    /// Empty the batch for a new result set, whose columns may have
+    /// different types.
+    pub fn clear(&mut self) {
+        self.columns.clear();
+        self.arena.clear();
+        self.row_starts.clear();
+        self.row_start = 0;
+        self.rows = 0;
+        self.next_col = 0;
+    }
+}
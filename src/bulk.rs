@@ -0,0 +1,1196 @@
+use crate::handle::*;
+use crate::stream::PACKET_SIZE;
+use crate::types::*;
+
+/// BULK_LOAD packets are framed at the session's packet size
+const PACKET_BODY: usize = PACKET_SIZE - 8;
+/// Whole packets are held back until there are this many, which then go out
+/// in one vectored write
+const SEND_PACKETS: usize = 16;
+const PACKET_BULK_LOAD: u8 = 0x07;
+
+const TOKEN_COLMETADATA: u8 = 0x81;
+const TOKEN_ROW: u8 = 0xD1;
+const TOKEN_ERROR: u8 = 0xAA;
+const TOKEN_INFO: u8 = 0xAB;
+const TOKEN_ENVCHANGE: u8 = 0xE3;
+const TOKEN_RETURNSTATUS: u8 = 0x79;
+const TOKEN_DONE: u8 = 0xFD;
+const TOKEN_DONEPROC: u8 = 0xFE;
+const TOKEN_DONEINPROC: u8 = 0xFF;
+const DONE_COUNT: u16 = 0x10;
+
+/// Length sent for a var-length column declared (max); its values go out
+/// as PLP (partially length-prefixed) chunks
+const MAX_LEN: u16 = 0xFFFF;
+/// Days from 0001-01-01 and from 1900-01-01 to the Unix epoch
+const DAYS_FROM_0001: i64 = 719_162;
+const DAYS_FROM_1900: i64 = 25_567;
+const NANOS_PER_DAY: i64 = 86_400_000_000_000;
+
+/// How a table column's values are encoded in the BULK_LOAD message
+#[derive(Clone, Copy)]
+enum WireType {
+    Bit,
+    Int(u8),
+    Float(u8),
+    Money(u8),
+    Decimal {
+        precision: u8,
+        scale: u8,
+    },
+    DateTime,
+    SmallDateTime,
+    Date,
+    Time(u8),
+    DateTime2(u8),
+    Guid,
+    Text {
+        max_len: u16,
+        wide: bool,
+        fixed: bool,
+    },
+    Binary {
+        max_len: u16,
+        fixed: bool,
+    },
+}
+
+/// A column of the target table, from sys.columns
+struct TableColumn {
+    name: String,
+    /// None for types bulk copy does not support; binding them fails
+    ty: Option<WireType>,
+    type_name: String,
+    nullable: bool,
+    computed: bool,
+    /// Type as declared in the INSERT BULK column list
+    decl: String,
+    collation: [u8; 5],
+    code_page: i64,
+}
+
+/// A table column bound with furball_bcp_bind
+struct BulkBind {
+    column: usize,
+    c_type: SQLSMALLINT,
+    value: SQLPOINTER,
+    buffer_length: SQLLEN,
+    len_ind: *mut SQLLEN,
+}
+
+/// Bulk copy into one table (furball_bcp_init). Rows are encoded straight
+/// into the BULK_LOAD message as they are sent, and whole packets go out
+/// SEND_PACKETS at a time, so a batch of any size holds only that many
+/// packets in memory.
+pub struct BulkCopy {
+    table: String,
+    columns: Vec<TableColumn>,
+    binds: Vec<BulkBind>,
+    /// Rows per batch, 0 = one batch for the whole copy
+    batch_size: u64,
+    tablock: bool,
+    check_constraints: bool,
+    /// INSERT BULK sent and its BULK_LOAD message open
+    in_batch: bool,
+    batch_rows: u64,
+    /// Rows committed by the batches finished so far
+    total_rows: u64,
+    /// Message bytes not sent yet
+    buf: Vec<u8>,
+    /// Encoding of the row being sent, appended to `buf` once complete
+    row: Vec<u8>,
+    packet_id: u8,
+}
+
+impl BulkCopy {
+    /// Whether a BULK_LOAD message is open on the connection, which then
+    /// cannot take any other request
+    pub fn in_batch(&self) -> bool {
+        self.in_batch
+    }
+}
+
+type BulkError = (&'static str, String);
+
+fn push_diag(conn: &mut Connection, (state, message): BulkError) {
+    conn.diagnostics.push(DiagRecord {
+        state: state.to_string(),
+        native_error: 0,
+        message,
+    });
+}
+
+/// Start a bulk copy into `table`: read its column definitions and reset
+/// the bindings. `options` is a mask of FB_BCP_* flags.
+pub fn init(
+    conn: &mut Connection,
+    table: &str,
+    batch_size: u64,
+    options: SQLUINTEGER,
+) -> SQLRETURN {
+    if conn.bulk.as_ref().is_some_and(|b| b.in_batch) || !conn.async_stmt.is_null() {
+        push_diag(conn, ("HY010", "Connection is busy".to_string()));
+        return SQL_ERROR;
+    }
+    if conn.attention.as_ref().is_some_and(|a| !a.can_signal()) {
+        // BULK_LOAD packets go to the socket, below tabby's TLS
+        push_diag(
+            conn,
+            (
+                "HYC00",
+                "Bulk copy is not supported on an encrypted connection".to_string(),
+            ),
+        );
+        return SQL_ERROR;
+    }
+    crate::execute::buffer_other_streams(conn, std::ptr::null());
+    let Some(client) = conn.client.as_mut() else {
+        push_diag(conn, ("08003", "Not connected".to_string()));
+        return SQL_ERROR;
+    };
+    let mut w = StringRowWriter::new();
+    if let Err(e) = client.batch_into(&columns_query(table), &mut w) {
+        push_diag(conn, ("HY000", e.to_string()));
+        return SQL_ERROR;
+    }
+    w.finalize();
+    let columns = match w.result_sets.first() {
+        Some(rs) if !rs.rows.is_empty() => table_columns(rs),
+        _ => {
+            push_diag(conn, ("42S02", format!("Invalid object name '{}'", table)));
+            return SQL_ERROR;
+        }
+    };
+    conn.bulk = Some(BulkCopy {
+        table: table.to_string(),
+        columns,
+        binds: Vec::new(),
+        batch_size,
+        tablock: options & FB_BCP_TABLOCK != 0,
+        check_constraints: options & FB_BCP_CHECK_CONSTRAINTS != 0,
+        in_batch: false,
+        batch_rows: 0,
+        total_rows: 0,
+        buf: Vec::with_capacity(PACKET_BODY * (SEND_PACKETS + 1)),
+        row: Vec::new(),
+        packet_id: 1,
+    });
+    SQL_SUCCESS
+}
+
+fn columns_query(table: &str) -> String {
+    format!(
+        "SELECT c.name, t.name, c.max_length, c.precision, c.scale, c.is_nullable, \
+         c.is_computed, c.collation_name, \
+         CAST(COLLATIONPROPERTY(c.collation_name, 'LCID') AS int), \
+         CAST(COLLATIONPROPERTY(c.collation_name, 'ComparisonStyle') AS int), \
+         CAST(COLLATIONPROPERTY(c.collation_name, 'Version') AS int), \
+         CAST(COLLATIONPROPERTY(c.collation_name, 'CodePage') AS int) \
+         FROM sys.columns c JOIN sys.types t ON t.user_type_id = c.system_type_id \
+         WHERE c.object_id = OBJECT_ID(N'{}') ORDER BY c.column_id",
+        table.replace('\'', "''")
+    )
+}
+
+fn table_columns(rs: &ResultSet) -> Vec<TableColumn> {
+    let text = |row: usize, col: usize| {
+        rs.rows
+            .cell(row, col)
+            .and_then(|c| c.to_string_repr())
+            .map(|s| s.into_owned())
+            .unwrap_or_default()
+    };
+    let int = |row: usize, col: usize| {
+        rs.rows
+            .cell(row, col)
+            .map(crate::fetch::cell_to_i64)
+            .unwrap_or(0)
+    };
+    (0..rs.rows.len())
+        .map(|r| {
+            let type_name = text(r, 1);
+            let (max_length, precision, scale) = (int(r, 2), int(r, 3) as u8, int(r, 4) as u8);
+            let collation_name = text(r, 7);
+            let ty = wire_type(&type_name, max_length, precision, scale);
+            let mut decl = match ty {
+                Some(WireType::Decimal { precision, scale }) => {
+                    format!("{}({},{})", type_name, precision, scale)
+                }
+                Some(WireType::Time(s)) | Some(WireType::DateTime2(s)) => {
+                    format!("{}({})", type_name, s)
+                }
+                Some(WireType::Text { max_len, wide, .. }) if max_len != MAX_LEN => {
+                    let chars = if wide { max_len / 2 } else { max_len };
+                    format!("{}({})", type_name, chars)
+                }
+                Some(WireType::Binary { max_len, .. }) if max_len != MAX_LEN => {
+                    format!("{}({})", type_name, max_len)
+                }
+                Some(WireType::Text { .. }) | Some(WireType::Binary { .. }) => {
+                    format!("{}(max)", type_name)
+                }
+                _ => type_name.clone(),
+            };
+            if !collation_name.is_empty() {
+                decl.push_str(" COLLATE ");
+                decl.push_str(&collation_name);
+            }
+            TableColumn {
+                name: text(r, 0),
+                ty,
+                type_name,
+                nullable: int(r, 5) != 0,
+                computed: int(r, 6) != 0,
+                decl,
+                collation: collation_bytes(&collation_name, int(r, 8), int(r, 9), int(r, 10)),
+                code_page: int(r, 11),
+            }
+        })
+        .collect()
+}
+
+fn wire_type(type_name: &str, max_length: i64, precision: u8, scale: u8) -> Option<WireType> {
+    let max_len = if max_length < 0 {
+        MAX_LEN
+    } else {
+        max_length as u16
+    };
+    Some(match type_name {
+        "bit" => WireType::Bit,
+        "tinyint" => WireType::Int(1),
+        "smallint" => WireType::Int(2),
+        "int" => WireType::Int(4),
+        "bigint" => WireType::Int(8),
+        "real" => WireType::Float(4),
+        "float" => WireType::Float(8),
+        "money" => WireType::Money(8),
+        "smallmoney" => WireType::Money(4),
+        "decimal" | "numeric" => WireType::Decimal { precision, scale },
+        "datetime" => WireType::DateTime,
+        "smalldatetime" => WireType::SmallDateTime,
+        "date" => WireType::Date,
+        "time" => WireType::Time(scale),
+        "datetime2" => WireType::DateTime2(scale),
+        "uniqueidentifier" => WireType::Guid,
+        "char" | "varchar" | "nchar" | "nvarchar" => WireType::Text {
+            max_len,
+            wide: type_name.starts_with('n'),
+            fixed: type_name.ends_with("char") && !type_name.contains("var"),
+        },
+        "binary" | "varbinary" => WireType::Binary {
+            max_len,
+            fixed: type_name == "binary",
+        },
+        _ => return None,
+    })
+}
+
+/// TDS collation of a column: LCID and comparison flags, version, and a
+/// sort id. SQL collations (SQL_*) go out as the Windows collation of their
+/// LCID, which shares their code page; the server converts to the column's
+/// collation on insert.
+fn collation_bytes(name: &str, lcid: i64, style: i64, version: i64) -> [u8; 5] {
+    if name.is_empty() {
+        return [0; 5];
+    }
+    let mut info = (lcid as u32) & 0xF_FFFF;
+    let flags = [
+        (1, 1 << 20),       // ignore case
+        (2, 1 << 21),       // ignore accent
+        (0x20000, 1 << 22), // ignore width
+        (0x10000, 1 << 23), // ignore kana type
+    ];
+    for (style_bit, flag) in flags {
+        if style & style_bit != 0 {
+            info |= flag;
+        }
+    }
+    let upper = name.to_ascii_uppercase();
+    if upper.contains("_BIN2") {
+        info |= 1 << 25;
+    } else if upper.contains("_BIN") {
+        info |= 1 << 24;
+    }
+    if upper.contains("_UTF8") {
+        info |= 1 << 26;
+    }
+    info |= ((version as u32) & 0xF) << 28;
+    let b = info.to_le_bytes();
+    [b[0], b[1], b[2], b[3], 0]
+}
+
+/// Bind application memory to table column `column` (1-based), read on
+/// every furball_bcp_sendrow. A null buffer and indicator unbinds it.
+pub fn bind(
+    conn: &mut Connection,
+    column: SQLUSMALLINT,
+    c_type: SQLSMALLINT,
+    value: SQLPOINTER,
+    buffer_length: SQLLEN,
+    len_ind: *mut SQLLEN,
+) -> SQLRETURN {
+    let Some(bulk) = conn.bulk.as_mut() else {
+        push_diag(conn, ("HY010", "No bulk copy in progress".to_string()));
+        return SQL_ERROR;
+    };
+    let error = if bulk.in_batch {
+        Some(("HY010", "Bindings cannot change within a batch".to_string()))
+    } else {
+        match bulk.columns.get((column as usize).wrapping_sub(1)) {
+            None => Some(("07009", format!("Invalid column number {}", column))),
+            Some(c) if c.computed => Some(("HY000", format!("Column {} is computed", c.name))),
+            Some(c) if c.ty.is_none() => Some((
+                "HYC00",
+                format!("Bulk copy of {} columns is not supported", c.type_name),
+            )),
+            _ => None,
+        }
+    };
+    if let Some(e) = error {
+        push_diag(conn, e);
+        return SQL_ERROR;
+    }
+    let idx = column as usize - 1;
+    bulk.binds.retain(|b| b.column != idx);
+    if value.is_null() && len_ind.is_null() {
+        return SQL_SUCCESS;
+    }
+    let c_type = if c_type == SQL_C_DEFAULT {
+        default_c_type(bulk.columns[idx].ty.unwrap())
+    } else {
+        c_type
+    };
+    let at = bulk.binds.partition_point(|b| b.column < idx);
+    bulk.binds.insert(
+        at,
+        BulkBind {
+            column: idx,
+            c_type,
+            value,
+            buffer_length,
+            len_ind,
+        },
+    );
+    SQL_SUCCESS
+}
+
+fn default_c_type(ty: WireType) -> SQLSMALLINT {
+    match ty {
+        WireType::Bit => SQL_C_BIT,
+        WireType::Int(1) => SQL_C_UTINYINT,
+        WireType::Int(2) => SQL_C_SHORT,
+        WireType::Int(4) => SQL_C_LONG,
+        WireType::Int(_) => SQL_C_SBIGINT,
+        WireType::Float(4) => SQL_C_FLOAT,
+        WireType::Float(_) => SQL_C_DOUBLE,
+        WireType::Date => SQL_C_TYPE_DATE,
+        WireType::Time(_) => SQL_C_TYPE_TIME,
+        WireType::DateTime | WireType::SmallDateTime | WireType::DateTime2(_) => {
+            SQL_C_TYPE_TIMESTAMP
+        }
+        WireType::Guid => SQL_C_GUID,
+        WireType::Text { wide: true, .. } => SQL_C_WCHAR,
+        WireType::Binary { .. } => SQL_C_BINARY,
+        _ => SQL_C_CHAR,
+    }
+}
+
+/// Add one row, read from the bound buffers, to the current batch; the
+/// first row of a batch sends its INSERT BULK. Once the batch holds
+/// `batch_size` rows it is committed.
+pub fn send_row(conn: &mut Connection) -> SQLRETURN {
+    let Some(bulk) = conn.bulk.as_mut() else {
+        push_diag(conn, ("HY010", "No bulk copy in progress".to_string()));
+        return SQL_ERROR;
+    };
+    if bulk.binds.is_empty() {
+        push_diag(conn, ("HY010", "No columns bound".to_string()));
+        return SQL_ERROR;
+    }
+    let mut row = std::mem::take(&mut bulk.row);
+    row.clear();
+    let encoded = encode_row(bulk, &mut row);
+    bulk.row = row;
+    if let Err(e) = encoded {
+        push_diag(conn, e);
+        return SQL_ERROR;
+    }
+    if !conn.bulk.as_ref().unwrap().in_batch {
+        if let Err(e) = start_batch(conn) {
+            push_diag(conn, e);
+            return SQL_ERROR;
+        }
+    }
+
+    let bulk = conn.bulk.as_mut().unwrap();
+    bulk.buf.extend_from_slice(&bulk.row);
+    bulk.batch_rows += 1;
+    let full = bulk.buf.len() / PACKET_BODY * PACKET_BODY;
+    if full >= PACKET_BODY * SEND_PACKETS {
+        let written = match conn.attention.as_ref() {
+            Some(attention) => attention.write_packets(
+                PACKET_BULK_LOAD,
+                &bulk.buf[..full],
+                false,
+                PACKET_SIZE,
+                &mut bulk.packet_id,
+            ),
+            None => Err(std::io::ErrorKind::NotConnected.into()),
+        };
+        bulk.buf.drain(..full);
+        if let Err(e) = written {
+            lose_session(conn);
+            push_diag(
+                conn,
+                ("08S01", format!("Communication link failure: {}", e)),
+            );
+            return SQL_ERROR;
+        }
+    }
+    if bulk.batch_size > 0 && bulk.batch_rows >= bulk.batch_size {
+        if let Err(e) = finish_batch(conn) {
+            push_diag(conn, e);
+            return SQL_ERROR;
+        }
+    }
+    SQL_SUCCESS
+}
+
+/// Send the INSERT BULK for the bound columns and open its BULK_LOAD
+/// message with the column metadata
+fn start_batch(conn: &mut Connection) -> Result<(), BulkError> {
+    crate::execute::buffer_other_streams(conn, std::ptr::null());
+    crate::execute::ensure_transaction(conn).map_err(|m| ("HY000", m))?;
+    let bulk = conn.bulk.as_mut().unwrap();
+    let cols: Vec<&TableColumn> = bulk.binds.iter().map(|b| &bulk.columns[b.column]).collect();
+
+    let mut sql = format!("INSERT BULK {} (", bulk.table);
+    for (i, c) in cols.iter().enumerate() {
+        if i > 0 {
+            sql.push_str(", ");
+        }
+        sql.push_str(&format!("[{}] {}", c.name.replace(']', "]]"), c.decl));
+    }
+    sql.push(')');
+    let hints: Vec<&str> = [
+        (bulk.tablock, "TABLOCK"),
+        (bulk.check_constraints, "CHECK_CONSTRAINTS"),
+    ]
+    .iter()
+    .filter(|h| h.0)
+    .map(|h| h.1)
+    .collect();
+    if !hints.is_empty() {
+        sql.push_str(&format!(" WITH ({})", hints.join(", ")));
+    }
+
+    bulk.buf.clear();
+    bulk.buf.push(TOKEN_COLMETADATA);
+    bulk.buf
+        .extend_from_slice(&(cols.len() as u16).to_le_bytes());
+    for c in &cols {
+        let flags: u16 = if c.nullable { 0x0009 } else { 0x0008 };
+        bulk.buf.extend_from_slice(&0u32.to_le_bytes()); // user type
+        bulk.buf.extend_from_slice(&flags.to_le_bytes());
+        put_type_info(&mut bulk.buf, c.ty.unwrap(), &c.collation);
+        let name: Vec<u16> = c.name.encode_utf16().collect();
+        bulk.buf.push(name.len() as u8);
+        for u in name {
+            bulk.buf.extend_from_slice(&u.to_le_bytes());
+        }
+    }
+
+    let client = conn
+        .client
+        .as_mut()
+        .ok_or(("08003", "Not connected".to_string()))?;
+    let mut w = StringRowWriter::new();
+    client
+        .batch_into(&sql, &mut w)
+        .map_err(|e| ("HY000", e.to_string()))?;
+    bulk.in_batch = true;
+    bulk.batch_rows = 0;
+    Ok(())
+}
+
+/// Close the open BULK_LOAD message, if any, and read the server's reply.
+/// Returns the rows the batch committed.
+fn finish_batch(conn: &mut Connection) -> Result<u64, BulkError> {
+    let bulk = conn.bulk.as_mut().unwrap();
+    if !bulk.in_batch {
+        return Ok(0);
+    }
+    bulk.in_batch = false;
+    bulk.buf.push(TOKEN_DONE);
+    bulk.buf.extend_from_slice(&[0; 12]);
+    let reply = match conn.attention.as_ref() {
+        Some(attention) => attention
+            .write_packets(
+                PACKET_BULK_LOAD,
+                &bulk.buf,
+                true,
+                PACKET_SIZE,
+                &mut bulk.packet_id,
+            )
+            .and_then(|_| attention.read_message()),
+        None => Err(std::io::ErrorKind::NotConnected.into()),
+    };
+    bulk.buf.clear();
+    let reply = match reply {
+        Ok(reply) => reply,
+        Err(e) => {
+            lose_session(conn);
+            return Err(("08S01", format!("Communication link failure: {}", e)));
+        }
+    };
+    let (rows, error) = parse_reply(&reply);
+    if let Some((number, message)) = error {
+        let state = match number {
+            2627 | 2601 | 547 | 515 => "23000",
+            208 => "42S02",
+            _ => "HY000",
+        };
+        conn.diagnostics.push(DiagRecord {
+            state: state.to_string(),
+            native_error: number,
+            message,
+        });
+        return Err(("HY000", "Bulk copy batch failed".to_string()));
+    }
+    let bulk = conn.bulk.as_mut().unwrap();
+    bulk.total_rows += rows;
+    Ok(rows)
+}
+
+/// The wire is out of step with the client: drop the session
+fn lose_session(conn: &mut Connection) {
+    conn.client = None;
+    conn.attention = None;
+    conn.connected = false;
+    if let Some(bulk) = conn.bulk.as_mut() {
+        bulk.in_batch = false;
+        bulk.buf.clear();
+    }
+}
+
+/// Commit the rows sent since the last batch, writing their count to `rows`
+pub fn batch(conn: &mut Connection, rows: *mut SQLLEN) -> SQLRETURN {
+    if conn.bulk.is_none() {
+        push_diag(conn, ("HY010", "No bulk copy in progress".to_string()));
+        return SQL_ERROR;
+    }
+    match finish_batch(conn) {
+        Ok(n) => {
+            if !rows.is_null() {
+                unsafe { *rows = n as SQLLEN };
+            }
+            SQL_SUCCESS
+        }
+        Err(e) => {
+            push_diag(conn, e);
+            SQL_ERROR
+        }
+    }
+}
+
+/// Commit the last batch and end the bulk copy, writing the rows copied by
+/// all its batches to `rows`
+pub fn done(conn: &mut Connection, rows: *mut SQLLEN) -> SQLRETURN {
+    if conn.bulk.is_none() {
+        push_diag(conn, ("HY010", "No bulk copy in progress".to_string()));
+        return SQL_ERROR;
+    }
+    let finished = finish_batch(conn);
+    let bulk = conn.bulk.take().unwrap();
+    if !rows.is_null() {
+        unsafe { *rows = bulk.total_rows as SQLLEN };
+    }
+    match finished {
+        Ok(_) => SQL_SUCCESS,
+        Err(e) => {
+            push_diag(conn, e);
+            SQL_ERROR
+        }
+    }
+}
+
+/// Rows reported by the reply's DONE tokens, and its first error
+fn parse_reply(reply: &[u8]) -> (u64, Option<(i32, String)>) {
+    let mut rows = 0;
+    let mut error = None;
+    let mut i = 0;
+    let u16_at = |i: usize| u16::from_le_bytes([reply[i], reply[i + 1]]) as usize;
+    while i < reply.len() {
+        match reply[i] {
+            TOKEN_ERROR | TOKEN_INFO if i + 3 <= reply.len() => {
+                let len = u16_at(i + 1);
+                let body = &reply[i + 3..(i + 3 + len).min(reply.len())];
+                if reply[i] == TOKEN_ERROR && error.is_none() && body.len() >= 8 {
+                    let number = i32::from_le_bytes([body[0], body[1], body[2], body[3]]);
+                    let chars = u16::from_le_bytes([body[6], body[7]]) as usize;
+                    let text: Vec<u16> = body[8..]
+                        .chunks_exact(2)
+                        .take(chars)
+                        .map(|c| u16::from_le_bytes([c[0], c[1]]))
+                        .collect();
+                    error = Some((number, String::from_utf16_lossy(&text)));
+                }
+                i += 3 + len;
+            }
+            TOKEN_ENVCHANGE if i + 3 <= reply.len() => i += 3 + u16_at(i + 1),
+            TOKEN_RETURNSTATUS => i += 5,
+            TOKEN_DONE | TOKEN_DONEPROC | TOKEN_DONEINPROC if i + 13 <= reply.len() => {
+                let status = u16_at(i + 1) as u16;
+                if reply[i] == TOKEN_DONE && status & DONE_COUNT != 0 {
+                    let mut count = [0u8; 8];
+                    count.copy_from_slice(&reply[i + 5..i + 13]);
+                    rows += u64::from_le_bytes(count);
+                }
+                i += 13;
+            }
+            _ => break,
+        }
+    }
+    (rows, error)
+}
+
+fn put_type_info(out: &mut Vec<u8>, ty: WireType, collation: &[u8; 5]) {
+    match ty {
+        WireType::Bit => out.extend_from_slice(&[0x68, 1]),
+        WireType::Int(n) => out.extend_from_slice(&[0x26, n]),
+        WireType::Float(n) => out.extend_from_slice(&[0x6D, n]),
+        WireType::Money(n) => out.extend_from_slice(&[0x6E, n]),
+        WireType::Decimal { precision, scale } => {
+            out.extend_from_slice(&[0x6A, decimal_len(precision), precision, scale])
+        }
+        WireType::DateTime => out.extend_from_slice(&[0x6F, 8]),
+        WireType::SmallDateTime => out.extend_from_slice(&[0x6F, 4]),
+        WireType::Date => out.push(0x28),
+        WireType::Time(s) => out.extend_from_slice(&[0x29, s]),
+        WireType::DateTime2(s) => out.extend_from_slice(&[0x2A, s]),
+        WireType::Guid => out.extend_from_slice(&[0x24, 16]),
+        WireType::Text {
+            max_len,
+            wide,
+            fixed,
+        } => {
+            out.push(match (wide, fixed) {
+                (false, false) => 0xA7,
+                (false, true) => 0xAF,
+                (true, false) => 0xE7,
+                (true, true) => 0xEF,
+            });
+            out.extend_from_slice(&max_len.to_le_bytes());
+            out.extend_from_slice(collation);
+        }
+        WireType::Binary { max_len, fixed } => {
+            out.push(if fixed { 0xAD } else { 0xA5 });
+            out.extend_from_slice(&max_len.to_le_bytes());
+        }
+    }
+}
+
+fn decimal_len(precision: u8) -> u8 {
+    match precision {
+        0..=9 => 5,
+        10..=19 => 9,
+        20..=28 => 13,
+        _ => 17,
+    }
+}
+
+/// A value read from a bound buffer
+enum Value<'a> {
+    Null,
+    Int(i64),
+    Float(f64),
+    Text(&'a [u8]),
+    WText(&'a [u16]),
+    Bytes(&'a [u8]),
+    /// Days since the Unix epoch and nanoseconds into the day
+    When(i64, i64),
+    Guid([u8; 16]),
+}
+
+/// Read the value currently in a bound buffer
+unsafe fn read_value<'a>(b: &BulkBind) -> Value<'a> {
+    let ind = (!b.len_ind.is_null()).then(|| *b.len_ind);
+    if ind == Some(SQL_NULL_DATA) || b.value.is_null() {
+        return Value::Null;
+    }
+    // Explicit length, or None for a null-terminated string
+    let len = match ind {
+        Some(n) if n >= 0 => Some(n as usize),
+        _ => None,
+    };
+    match b.c_type {
+        SQL_C_LONG | SQL_C_SLONG => Value::Int(*(b.value as *const i32) as i64),
+        SQL_C_ULONG => Value::Int(*(b.value as *const u32) as i64),
+        SQL_C_SHORT => Value::Int(*(b.value as *const i16) as i64),
+        SQL_C_USHORT => Value::Int(*(b.value as *const u16) as i64),
+        SQL_C_SBIGINT => Value::Int(*(b.value as *const i64)),
+        SQL_C_UTINYINT | SQL_C_BIT => Value::Int(*(b.value as *const u8) as i64),
+        SQL_C_STINYINT => Value::Int(*(b.value as *const i8) as i64),
+        SQL_C_DOUBLE => Value::Float(*(b.value as *const f64)),
+        SQL_C_FLOAT => Value::Float(*(b.value as *const f32) as f64),
+        SQL_C_TYPE_TIMESTAMP => {
+            let ts = &*(b.value as *const SqlTimestampStruct);
+            Value::When(
+                days_from_civil(ts.year as i64, ts.month as i64, ts.day as i64),
+                time_nanos(ts.hour, ts.minute, ts.second) + ts.fraction as i64,
+            )
+        }
+        SQL_C_TYPE_DATE => {
+            let d = &*(b.value as *const SqlDateStruct);
+            Value::When(
+                days_from_civil(d.year as i64, d.month as i64, d.day as i64),
+                0,
+            )
+        }
+        SQL_C_TYPE_TIME => {
+            let t = &*(b.value as *const SqlTimeStruct);
+            Value::When(-DAYS_FROM_1900, time_nanos(t.hour, t.minute, t.second))
+        }
+        SQL_C_GUID => {
+            // SQLGUID in memory is the wire layout on little-endian hosts
+            let g = &*(b.value as *const SqlGuid);
+            let mut bytes = [0u8; 16];
+            bytes[..4].copy_from_slice(&g.data1.to_le_bytes());
+            bytes[4..6].copy_from_slice(&g.data2.to_le_bytes());
+            bytes[6..8].copy_from_slice(&g.data3.to_le_bytes());
+            bytes[8..].copy_from_slice(&g.data4);
+            Value::Guid(bytes)
+        }
+        SQL_C_BINARY => {
+            let n = len.unwrap_or(b.buffer_length.max(0) as usize);
+            Value::Bytes(std::slice::from_raw_parts(b.value as *const u8, n))
+        }
+        SQL_C_WCHAR => {
+            let ptr = b.value as *const u16;
+            let n = len.map(|n| n / 2).unwrap_or_else(|| {
+                let mut n = 0;
+                while *ptr.add(n) != 0 {
+                    n += 1;
+                }
+                n
+            });
+            Value::WText(std::slice::from_raw_parts(ptr, n))
+        }
+        _ => {
+            let ptr = b.value as *const u8;
+            let n = len.unwrap_or_else(|| {
+                let mut n = 0;
+                while *ptr.add(n) != 0 {
+                    n += 1;
+                }
+                n
+            });
+            Value::Text(std::slice::from_raw_parts(ptr, n))
+        }
+    }
+}
+
+fn time_nanos(h: u16, m: u16, s: u16) -> i64 {
+    ((h as i64 * 60 + m as i64) * 60 + s as i64) * 1_000_000_000
+}
+
+/// Days from the Unix epoch to a proleptic Gregorian date
+fn days_from_civil(y: i64, m: i64, d: i64) -> i64 {
+    let y = if m <= 2 { y - 1 } else { y };
+    let era = if y >= 0 { y } else { y - 399 } / 400;
+    let yoe = y - era * 400;
+    let mp = (m + 9) % 12;
+    let doy = (153 * mp + 2) / 5 + d - 1;
+    let doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    era * 146097 + doe - 719468
+}
+
+/// Encode the bound values of one row as a ROW token
+fn encode_row(bulk: &BulkCopy, out: &mut Vec<u8>) -> Result<(), BulkError> {
+    out.push(TOKEN_ROW);
+    for b in &bulk.binds {
+        let col = &bulk.columns[b.column];
+        let value = unsafe { read_value(b) };
+        if matches!(value, Value::Null) && !col.nullable {
+            return Err((
+                "23000",
+                format!("Cannot insert NULL into column '{}'", col.name),
+            ));
+        }
+        encode_value(col, value, out)
+            .map_err(|(state, msg)| (state, format!("{} (column '{}')", msg, col.name)))?;
+    }
+    Ok(())
+}
+
+fn out_of_range() -> BulkError {
+    ("22003", "Numeric value out of range".to_string())
+}
+
+fn bad_cast() -> BulkError {
+    (
+        "22018",
+        "Invalid character value for cast specification".to_string(),
+    )
+}
+
+fn text_str(v: &Value<'_>) -> Option<String> {
+    match v {
+        Value::Text(t) => Some(String::from_utf8_lossy(t).trim().to_string()),
+        Value::WText(t) => Some(String::from_utf16_lossy(t).trim().to_string()),
+        _ => None,
+    }
+}
+
+fn to_i64(v: &Value<'_>) -> Result<i64, BulkError> {
+    match v {
+        Value::Int(i) => Ok(*i),
+        Value::Float(f) if f.is_finite() && f.abs() < 9.2e18 => Ok(f.trunc() as i64),
+        Value::Float(_) => Err(out_of_range()),
+        _ => text_str(v)
+            .and_then(|s| s.parse().ok())
+            .ok_or_else(bad_cast),
+    }
+}
+
+fn to_f64(v: &Value<'_>) -> Result<f64, BulkError> {
+    match v {
+        Value::Int(i) => Ok(*i as f64),
+        Value::Float(f) => Ok(*f),
+        _ => text_str(v)
+            .and_then(|s| s.parse().ok())
+            .ok_or_else(bad_cast),
+    }
+}
+
+/// Value as an integer scaled by 10^`scale`
+fn to_scaled(v: &Value<'_>, scale: u8) -> Result<i128, BulkError> {
+    let (value, from) = match v {
+        Value::Int(i) => (*i as i128, 0),
+        // Display prints the shortest digits that round-trip, never an exponent
+        Value::Float(f) if f.is_finite() => parse_decimal(&f.to_string()).ok_or_else(bad_cast)?,
+        Value::Float(_) => return Err(out_of_range()),
+        _ => text_str(v)
+            .and_then(|s| parse_decimal(&s))
+            .ok_or_else(bad_cast)?,
+    };
+    if from <= scale {
+        return 10i128
+            .checked_pow((scale - from) as u32)
+            .and_then(|p| value.checked_mul(p))
+            .ok_or_else(out_of_range);
+    }
+    // Round half away from zero
+    let div = 10i128
+        .checked_pow((from - scale) as u32)
+        .ok_or_else(out_of_range)?;
+    let (q, r) = (value / div, value % div);
+    Ok(if r.abs() * 2 >= div {
+        q + value.signum()
+    } else {
+        q
+    })
+}
+
+fn parse_decimal(s: &str) -> Option<(i128, u8)> {
+    let (negative, digits) = match s.strip_prefix('-') {
+        Some(rest) => (true, rest),
+        None => (false, s.strip_prefix('+').unwrap_or(s)),
+    };
+    let (int, frac) = digits.split_once('.').unwrap_or((digits, ""));
+    if int.is_empty() && frac.is_empty() {
+        return None;
+    }
+    let mut value: i128 = 0;
+    for c in int.bytes().chain(frac.bytes()) {
+        if !c.is_ascii_digit() {
+            return None;
+        }
+        value = value.checked_mul(10)?.checked_add((c - b'0') as i128)?;
+    }
+    let scale = u8::try_from(frac.len()).ok()?;
+    Some((if negative { -value } else { value }, scale))
+}
+
+fn to_when(v: &Value<'_>) -> Result<(i64, i64), BulkError> {
+    if let Value::When(days, nanos) = v {
+        return Ok((*days, *nanos));
+    }
+    let s = text_str(v).ok_or_else(bad_cast)?;
+    if !s.contains('-') && s.contains(':') {
+        // Time of day only
+        let ts = crate::fetch::parse_timestamp(&format!("1900-01-01 {}", s));
+        return Ok((
+            -DAYS_FROM_1900,
+            time_nanos(ts.hour, ts.minute, ts.second) + ts.fraction as i64,
+        ));
+    }
+    let ts = crate::fetch::parse_timestamp(&s);
+    if ts.month == 0 || ts.day == 0 {
+        return Err(bad_cast());
+    }
+    Ok((
+        days_from_civil(ts.year as i64, ts.month as i64, ts.day as i64),
+        time_nanos(ts.hour, ts.minute, ts.second) + ts.fraction as i64,
+    ))
+}
+
+fn time_len(scale: u8) -> usize {
+    match scale {
+        0..=2 => 3,
+        3 | 4 => 4,
+        _ => 5,
+    }
+}
+
+fn put_time(out: &mut Vec<u8>, nanos: i64, scale: u8) {
+    let units = nanos / 10i64.pow(9 - scale.min(7) as u32);
+    out.extend_from_slice(&units.to_le_bytes()[..time_len(scale)]);
+}
+
+fn put_date(out: &mut Vec<u8>, days: i64) -> Result<(), BulkError> {
+    let d = days + DAYS_FROM_0001;
+    if !(0..3_652_059).contains(&d) {
+        return Err(("22008", "Datetime field overflow".to_string()));
+    }
+    out.extend_from_slice(&(d as u32).to_le_bytes()[..3]);
+    Ok(())
+}
+
+/// Code page 1252 bytes 0x80-0x9F, as Unicode; 0 where the byte is unused
+const CP1252_HIGH: [u16; 32] = [
+    0x20AC, 0, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021, 0x02C6, 0x2030, 0x0160, 0x2039,
+    0x0152, 0, 0x017D, 0, 0, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014, 0x02DC,
+    0x2122, 0x0161, 0x203A, 0x0153, 0, 0x017E, 0x0178,
+];
+
+/// Characters for a narrow column in the column's code page: UTF-8 for
+/// UTF-8 collations, Windows-1252 (the Latin1_General collations) mapped in
+/// full, any other code page only where the text is ASCII. A character the
+/// code page cannot hold is an error rather than a '?'.
+fn narrow(text: &str, code_page: i64) -> Result<Vec<u8>, BulkError> {
+    if code_page == 65001 || text.is_ascii() {
+        return Ok(text.as_bytes().to_vec());
+    }
+    if code_page != 1252 {
+        return Err((
+            "HYC00",
+            format!(
+                "Bulk copy of non-ASCII text into a code page {} column is not supported",
+                code_page
+            ),
+        ));
+    }
+    text.chars()
+        .map(|c| match c as u32 {
+            n @ (0..=0x7F | 0xA0..=0xFF) => Ok(n as u8),
+            n => CP1252_HIGH
+                .iter()
+                .position(|&u| u as u32 == n)
+                .map(|i| 0x80 + i as u8)
+                .ok_or_else(|| {
+                    (
+                        "22018",
+                        format!(
+                            "Character U+{:04X} cannot be represented in code page 1252",
+                            n
+                        ),
+                    )
+                }),
+        })
+        .collect()
+}
+
+fn encode_value(col: &TableColumn, v: Value<'_>, out: &mut Vec<u8>) -> Result<(), BulkError> {
+    let ty = col.ty.expect("bound columns have a wire type");
+    let null = matches!(v, Value::Null);
+    match ty {
+        WireType::Text { max_len, .. } | WireType::Binary { max_len, .. } => {
+            if null {
+                if max_len == MAX_LEN {
+                    out.extend_from_slice(&u64::MAX.to_le_bytes());
+                } else {
+                    out.extend_from_slice(&0xFFFFu16.to_le_bytes());
+                }
+                return Ok(());
+            }
+            let bytes = var_bytes(ty, col.code_page, v)?;
+            if max_len == MAX_LEN {
+                out.extend_from_slice(&(bytes.len() as u64).to_le_bytes());
+                if !bytes.is_empty() {
+                    out.extend_from_slice(&(bytes.len() as u32).to_le_bytes());
+                    out.extend_from_slice(&bytes);
+                }
+                out.extend_from_slice(&0u32.to_le_bytes());
+            } else if bytes.len() > max_len as usize {
+                return Err(("22001", "String data, right truncation".to_string()));
+            } else {
+                out.extend_from_slice(&(bytes.len() as u16).to_le_bytes());
+                out.extend_from_slice(&bytes);
+            }
+            return Ok(());
+        }
+        _ if null => {
+            out.push(0);
+            return Ok(());
+        }
+        _ => {}
+    }
+    match ty {
+        WireType::Bit => {
+            let on = match text_str(&v) {
+                Some(s) if s.eq_ignore_ascii_case("true") => true,
+                Some(s) if s.eq_ignore_ascii_case("false") => false,
+                _ => to_i64(&v)? != 0,
+            };
+            out.extend_from_slice(&[1, on as u8]);
+        }
+        WireType::Int(n) => {
+            let i = to_i64(&v)?;
+            let fits = match n {
+                1 => (0..=255).contains(&i),
+                2 => i16::try_from(i).is_ok(),
+                4 => i32::try_from(i).is_ok(),
+                _ => true,
+            };
+            if !fits {
+                return Err(out_of_range());
+            }
+            out.push(n);
+            out.extend_from_slice(&i.to_le_bytes()[..n as usize]);
+        }
+        WireType::Float(4) => {
+            out.push(4);
+            out.extend_from_slice(&(to_f64(&v)? as f32).to_le_bytes());
+        }
+        WireType::Float(_) => {
+            out.push(8);
+            out.extend_from_slice(&to_f64(&v)?.to_le_bytes());
+        }
+        WireType::Money(n) => {
+            let m = i64::try_from(to_scaled(&v, 4)?).map_err(|_| out_of_range())?;
+            if n == 4 {
+                let m = i32::try_from(m).map_err(|_| out_of_range())?;
+                out.push(4);
+                out.extend_from_slice(&m.to_le_bytes());
+            } else {
+                out.push(8);
+                out.extend_from_slice(&((m >> 32) as i32).to_le_bytes());
+                out.extend_from_slice(&(m as u32).to_le_bytes());
+            }
+        }
+        WireType::Decimal { precision, scale } => {
+            let value = to_scaled(&v, scale)?;
+            let limit = 10u128.checked_pow(precision as u32).unwrap_or(u128::MAX);
+            if value.unsigned_abs() >= limit {
+                return Err(out_of_range());
+            }
+            let len = decimal_len(precision);
+            out.push(len);
+            out.push((value >= 0) as u8);
+            out.extend_from_slice(&value.unsigned_abs().to_le_bytes()[..len as usize - 1]);
+        }
+        WireType::DateTime => {
+            let (mut days, nanos) = to_when(&v)?;
+            days += DAYS_FROM_1900;
+            // 1/300 second ticks
+            let mut ticks = (nanos * 3 + 5_000_000) / 10_000_000;
+            if ticks >= 300 * 86_400 {
+                days += 1;
+                ticks -= 300 * 86_400;
+            }
+            let days = i32::try_from(days).map_err(|_| out_of_range())?;
+            out.push(8);
+            out.extend_from_slice(&days.to_le_bytes());
+            out.extend_from_slice(&(ticks as u32).to_le_bytes());
+        }
+        WireType::SmallDateTime => {
+            let (mut days, nanos) = to_when(&v)?;
+            days += DAYS_FROM_1900;
+            let mut minutes = (nanos + 30_000_000_000) / 60_000_000_000;
+            if minutes >= 1440 {
+                days += 1;
+                minutes -= 1440;
+            }
+            let days = u16::try_from(days).map_err(|_| out_of_range())?;
+            out.push(4);
+            out.extend_from_slice(&days.to_le_bytes());
+            out.extend_from_slice(&(minutes as u16).to_le_bytes());
+        }
+        WireType::Date => {
+            let (days, _) = to_when(&v)?;
+            out.push(3);
+            put_date(out, days)?;
+        }
+        WireType::Time(scale) => {
+            let (_, nanos) = to_when(&v)?;
+            out.push(time_len(scale) as u8);
+            put_time(out, nanos.rem_euclid(NANOS_PER_DAY), scale);
+        }
+        WireType::DateTime2(scale) => {
+            let (days, nanos) = to_when(&v)?;
+            out.push(time_len(scale) as u8 + 3);
+            put_time(out, nanos.rem_euclid(NANOS_PER_DAY), scale);
+            put_date(out, days + nanos.div_euclid(NANOS_PER_DAY))?;
+        }
+        WireType::Guid => {
+            let bytes = match v {
+                Value::Guid(g) => g,
+                _ => {
+                    let s = text_str(&v).ok_or_else(bad_cast)?;
+                    if s.chars().filter(|c| c.is_ascii_hexdigit()).count() != 32 {
+                        return Err(bad_cast());
+                    }
+                    let g = crate::fetch::parse_guid(&s);
+                    let mut bytes = [0u8; 16];
+                    bytes[..4].copy_from_slice(&g.data1.to_le_bytes());
+                    bytes[4..6].copy_from_slice(&g.data2.to_le_bytes());
+                    bytes[6..8].copy_from_slice(&g.data3.to_le_bytes());
+                    bytes[8..].copy_from_slice(&g.data4);
+                    bytes
+                }
+            };
+            out.push(16);
+            out.extend_from_slice(&bytes);
+        }
+        WireType::Text { .. } | WireType::Binary { .. } => unreachable!("encoded above"),
+    }
+    Ok(())
+}
+
+/// Bytes of a value for a character or binary column
+fn var_bytes(ty: WireType, code_page: i64, v: Value<'_>) -> Result<Vec<u8>, BulkError> {
+    let wide = matches!(ty, WireType::Text { wide: true, .. });
+    let text = match v {
+        Value::Bytes(b) if matches!(ty, WireType::Binary { .. }) => return Ok(b.to_vec()),
+        Value::Bytes(_) => {
+            return Err((
+                "07006",
+                "Binary data is not accepted for a character column".to_string(),
+            ));
+        }
+        Value::Text(t) if matches!(ty, WireType::Binary { .. }) => return Ok(t.to_vec()),
+        Value::WText(t) if wide => {
+            return Ok(t.iter().flat_map(|u| u.to_le_bytes()).collect());
+        }
+        Value::WText(t) => String::from_utf16_lossy(t),
+        // SQL_C_CHAR data is UTF-8, which needs no conversion as long as the
+        // column takes UTF-8 or the text is ASCII
+        Value::Text(t) if !wide && (code_page == 65001 || t.is_ascii()) => return Ok(t.to_vec()),
+        Value::Text(t) => String::from_utf8_lossy(t).into_owned(),
+        Value::Int(i) => i.to_string(),
+        Value::Float(f) => f.to_string(),
+        Value::When(..) | Value::Guid(_) | Value::Null => {
+            return Err((
+                "07006",
+                "Restricted data type attribute violation".to_string(),
+            ));
+        }
+    };
+    if wide {
+        Ok(text.encode_utf16().flat_map(|u| u.to_le_bytes()).collect())
+    } else {
+        narrow(&text, code_page)
+    }
+}
@@ -1,66 +1,318 @@
+use crate::batch::RowBatch;
 use crate::execute;
 use crate::handle::*;
 use crate::types::*;
+use std::collections::HashMap;
+use std::time::{Duration, Instant};
 
+/// Seconds a cached catalog result is served for, unless the connection
+/// string sets CatalogCacheTTL=. 0 turns the cache off.
+pub const DEFAULT_CATALOG_TTL: u64 = 60;
+
+/// Results kept per connection
+const CATALOG_CACHE_SIZE: usize = 256;
+
+/// Results larger than this are not kept
+const MAX_CACHED_BYTES: usize = 16 * 1024 * 1024;
+
+/// Results of the catalog functions, keyed by the query each call builds,
+/// which encodes the function and its arguments. An entry is served until
+/// it is `ttl` old; DDL run on the connection drops them all. Schema
+/// changes made by other sessions are seen once the entries expire.
+pub struct CatalogCache {
+    entries: HashMap<String, (Instant, ResultSet)>,
+    ttl: Duration,
+}
+
+impl CatalogCache {
+    pub fn new(ttl_secs: u64) -> Self {
+        Self {
+            entries: HashMap::new(),
+            ttl: Duration::from_secs(ttl_secs),
+        }
+    }
+
+    pub fn clear(&mut self) {
+        self.entries.clear();
+    }
+
+    fn get(&self, key: &str) -> Option<&ResultSet> {
+        self.entries
+            .get(key)
+            .filter(|(at, _)| at.elapsed() < self.ttl)
+            .map(|(_, rs)| rs)
+    }
+
+    fn insert(&mut self, key: String, rs: &ResultSet) {
+        if self.ttl.is_zero() || rs.rows.data_bytes() > MAX_CACHED_BYTES {
+            return;
+        }
+        let ttl = self.ttl;
+        self.entries.retain(|_, (at, _)| at.elapsed() < ttl);
+        if self.entries.len() >= CATALOG_CACHE_SIZE {
+            let oldest = self
+                .entries
+                .iter()
+                .min_by_key(|(_, (at, _))| *at)
+                .map(|(k, _)| k.clone());
+            if let Some(k) = oldest {
+                self.entries.remove(&k);
+            }
+        }
+        self.entries.insert(key, (Instant::now(), rs.clone()));
+    }
+}
+
+/// Drop the connection's cached catalog results if `sql` may change what
+/// they say: DDL, renames, permission changes, SELECT INTO and USE
+pub fn note_statement(conn: &mut Connection, sql: &str) {
+    if !conn.catalog_cache.entries.is_empty() && changes_catalog(sql) {
+        conn.catalog_cache.clear();
+    }
+}
+
+/// Whether `sql` has a keyword of a statement that changes the catalog.
+/// Errs on the side of yes: words in string literals count too.
+fn changes_catalog(sql: &str) -> bool {
+    let mut prev = "";
+    for word in sql
+        .split(|c: char| !(c.is_ascii_alphanumeric() || c == '_'))
+        .filter(|w| !w.is_empty())
+    {
+        let is = |k: &str| word.eq_ignore_ascii_case(k);
+        if is("create")
+            || is("alter")
+            || is("drop")
+            || is("sp_rename")
+            || is("grant")
+            || is("revoke")
+            || is("deny")
+            || is("use")
+            || (is("into") && !prev.eq_ignore_ascii_case("insert"))
+        {
+            return true;
+        }
+        prev = word;
+    }
+    false
+}
+
+/// Run catalog query `sql`, answering from the connection's cache while
+/// the result it last returned is fresh
+pub fn cached(stmt: &mut Statement, sql: String) -> SQLRETURN {
+    let conn = unsafe { &mut *stmt.conn };
+    if let Some(rs) = conn.catalog_cache.get(&sql) {
+        let rs = rs.clone();
+        return execute::set_result(stmt, rs);
+    }
+    match execute::exec_result(stmt, &sql) {
+        Ok(rs) => {
+            let conn = unsafe { &mut *stmt.conn };
+            conn.catalog_cache.insert(sql, &rs);
+            execute::set_result(stmt, rs)
+        }
+        Err(ret) => ret,
+    }
+}
+
+/// The server's built-in types as (name, max_length), in sys.types order
+const SYSTEM_TYPES: &[(&str, i32)] = &[
+    ("image", 16),
+    ("text", 16),
+    ("uniqueidentifier", 16),
+    ("date", 3),
+    ("time", 5),
+    ("datetime2", 8),
+    ("datetimeoffset", 10),
+    ("tinyint", 1),
+    ("smallint", 2),
+    ("int", 4),
+    ("smalldatetime", 4),
+    ("real", 4),
+    ("money", 8),
+    ("datetime", 8),
+    ("float", 8),
+    ("sql_variant", 8016),
+    ("ntext", 16),
+    ("bit", 1),
+    ("decimal", 17),
+    ("numeric", 17),
+    ("smallmoney", 4),
+    ("bigint", 8),
+    ("varbinary", 8000),
+    ("varchar", 8000),
+    ("binary", 8000),
+    ("char", 8000),
+    ("timestamp", 8),
+    ("nvarchar", 8000),
+    ("nchar", 8000),
+    ("xml", -1),
+];
+
+/// SQL data type reported for a built-in type
+fn odbc_type(name: &str) -> SQLSMALLINT {
+    match name {
+        "int" => SQL_INTEGER,
+        "smallint" => SQL_SMALLINT,
+        "tinyint" => SQL_TINYINT,
+        "bigint" => SQL_BIGINT,
+        "float" => SQL_FLOAT,
+        "real" => SQL_REAL,
+        "bit" => SQL_BIT,
+        "datetime" | "datetime2" => SQL_TYPE_TIMESTAMP,
+        "date" => SQL_TYPE_DATE,
+        "time" => SQL_TYPE_TIME,
+        "nvarchar" => SQL_WVARCHAR,
+        "char" => SQL_CHAR,
+        "nchar" => SQL_WCHAR,
+        "text" => SQL_LONGVARCHAR,
+        "ntext" | "xml" => SQL_WLONGVARCHAR,
+        "binary" => SQL_BINARY,
+        "varbinary" => SQL_VARBINARY,
+        "image" => SQL_LONGVARBINARY,
+        "decimal" | "money" | "smallmoney" => SQL_DECIMAL,
+        "numeric" => SQL_NUMERIC,
+        "uniqueidentifier" => SQL_GUID,
+        _ => SQL_VARCHAR,
+    }
+}
+
+/// SQLGetTypeInfo: the type catalog, built in memory. `data_type` selects
+/// one SQL type, or SQL_ALL_TYPES.
 pub fn get_type_info(stmt: &mut Statement, data_type: SQLSMALLINT) -> SQLRETURN {
-    let _filter = if data_type == SQL_ALL_TYPES {
-        String::new()
-    } else {
-        format!("WHERE DATA_TYPE = {}", data_type)
+    // ODBC 2 date and time codes
+    let data_type = match data_type {
+        SQL_DATE => SQL_TYPE_DATE,
+        SQL_TIME => SQL_TYPE_TIME,
+        SQL_TIMESTAMP => SQL_TYPE_TIMESTAMP,
+        t => t,
     };
+    let col = |name: &str, sql_type, size| ColumnDesc {
+        name: name.to_string(),
+        sql_type,
+        size,
+        decimal_digits: 0,
+        nullable: SQL_NULLABLE,
+    };
+    let columns = vec![
+        col("TYPE_NAME", SQL_WVARCHAR, 128),
+        col("DATA_TYPE", SQL_SMALLINT, 5),
+        col("COLUMN_SIZE", SQL_INTEGER, 10),
+        col("LITERAL_PREFIX", SQL_VARCHAR, 2),
+        col("LITERAL_SUFFIX", SQL_VARCHAR, 1),
+        col("CREATE_PARAMS", SQL_VARCHAR, 15),
+        col("NULLABLE", SQL_SMALLINT, 5),
+        col("CASE_SENSITIVE", SQL_SMALLINT, 5),
+        col("SEARCHABLE", SQL_SMALLINT, 5),
+        col("UNSIGNED_ATTRIBUTE", SQL_SMALLINT, 5),
+        col("FIXED_PREC_SCALE", SQL_SMALLINT, 5),
+        col("AUTO_UNIQUE_VALUE", SQL_SMALLINT, 5),
+        col("LOCAL_TYPE_NAME", SQL_WVARCHAR, 128),
+        col("MINIMUM_SCALE", SQL_SMALLINT, 5),
+        col("MAXIMUM_SCALE", SQL_SMALLINT, 5),
+        col("SQL_DATA_TYPE", SQL_SMALLINT, 5),
+        col("SQL_DATETIME_SUB", SQL_SMALLINT, 5),
+        col("NUM_PREC_RADIX", SQL_INTEGER, 10),
+        col("INTERVAL_PRECISION", SQL_SMALLINT, 5),
+    ];
 
-    // Return a standard ODBC type catalog
-    let sql = format!(
-        "SELECT \
-         TYPE_NAME = tp.name, \
-         DATA_TYPE = CASE tp.name \
-           WHEN 'int' THEN 4 WHEN 'smallint' THEN 5 WHEN 'tinyint' THEN -6 \
-           WHEN 'bigint' THEN -5 WHEN 'float' THEN 8 WHEN 'real' THEN 7 \
-           WHEN 'bit' THEN -7 WHEN 'datetime' THEN 93 WHEN 'datetime2' THEN 93 \
-           WHEN 'date' THEN 91 WHEN 'time' THEN 92 \
-           WHEN 'varchar' THEN 12 WHEN 'nvarchar' THEN -9 \
-           WHEN 'char' THEN 1 WHEN 'nchar' THEN -8 \
-           WHEN 'text' THEN -1 WHEN 'ntext' THEN -10 \
-           WHEN 'binary' THEN -2 WHEN 'varbinary' THEN -3 WHEN 'image' THEN -4 \
-           WHEN 'decimal' THEN 3 WHEN 'numeric' THEN 2 \
-           WHEN 'money' THEN 3 WHEN 'smallmoney' THEN 3 \
-           WHEN 'uniqueidentifier' THEN -11 \
-           WHEN 'xml' THEN -10 \
-           ELSE 12 END, \
-         COLUMN_SIZE = CASE \
-           WHEN tp.name IN ('int') THEN 10 \
-           WHEN tp.name IN ('smallint') THEN 5 \
-           WHEN tp.name IN ('tinyint') THEN 3 \
-           WHEN tp.name IN ('bigint') THEN 19 \
-           WHEN tp.name IN ('float') THEN 53 \
-           WHEN tp.name IN ('real') THEN 24 \
-           WHEN tp.name IN ('bit') THEN 1 \
-           WHEN tp.name IN ('datetime','datetime2') THEN 23 \
-           WHEN tp.name IN ('date') THEN 10 \
-           WHEN tp.name IN ('time') THEN 16 \
-           WHEN tp.name IN ('uniqueidentifier') THEN 36 \
-           ELSE tp.max_length END, \
-         LITERAL_PREFIX = CASE WHEN tp.name IN ('varchar','nvarchar','char','nchar','text','ntext','datetime','datetime2','date','time','uniqueidentifier') THEN '''' WHEN tp.name IN ('binary','varbinary','image') THEN '0x' ELSE NULL END, \
-         LITERAL_SUFFIX = CASE WHEN tp.name IN ('varchar','nvarchar','char','nchar','text','ntext','datetime','datetime2','date','time','uniqueidentifier') THEN '''' ELSE NULL END, \
-         CREATE_PARAMS = CASE WHEN tp.name IN ('varchar','nvarchar','char','nchar','binary','varbinary') THEN 'max length' WHEN tp.name IN ('decimal','numeric') THEN 'precision,scale' ELSE NULL END, \
-         NULLABLE = CAST(1 AS SMALLINT), \
-         CASE_SENSITIVE = CAST(0 AS SMALLINT), \
-         SEARCHABLE = CAST(3 AS SMALLINT), \
-         UNSIGNED_ATTRIBUTE = CASE WHEN tp.name IN ('tinyint') THEN CAST(1 AS SMALLINT) ELSE CAST(0 AS SMALLINT) END, \
-         FIXED_PREC_SCALE = CASE WHEN tp.name IN ('money','smallmoney') THEN CAST(1 AS SMALLINT) ELSE CAST(0 AS SMALLINT) END, \
-         AUTO_UNIQUE_VALUE = CAST(0 AS SMALLINT), \
-         LOCAL_TYPE_NAME = tp.name, \
-         MINIMUM_SCALE = CAST(0 AS SMALLINT), \
-         MAXIMUM_SCALE = CASE WHEN tp.name IN ('decimal','numeric') THEN CAST(38 AS SMALLINT) WHEN tp.name IN ('datetime2','time') THEN CAST(7 AS SMALLINT) ELSE CAST(0 AS SMALLINT) END, \
-         SQL_DATA_TYPE = CAST(0 AS SMALLINT), \
-         SQL_DATETIME_SUB = CAST(NULL AS SMALLINT), \
-         NUM_PREC_RADIX = CASE WHEN tp.name IN ('int','smallint','tinyint','bigint','decimal','numeric','money','smallmoney') THEN 10 WHEN tp.name IN ('float','real') THEN 2 ELSE NULL END, \
-         INTERVAL_PRECISION = CAST(NULL AS SMALLINT) \
-         FROM sys.types tp WHERE tp.system_type_id = tp.user_type_id \
-         ORDER BY DATA_TYPE"
-    );
+    let mut types: Vec<(&str, i32)> = SYSTEM_TYPES
+        .iter()
+        .copied()
+        .filter(|&(name, _)| data_type == SQL_ALL_TYPES || odbc_type(name) == data_type)
+        .collect();
+    types.sort_by_key(|&(name, _)| odbc_type(name));
 
-    execute::exec_direct(stmt, &sql)
+    let mut rows = RowBatch::default();
+    let text = |s: Option<&'static str>| s.map_or(Cell::Null, Cell::Str);
+    for (name, max_length) in types {
+        let quoted = matches!(
+            name,
+            "varchar"
+                | "nvarchar"
+                | "char"
+                | "nchar"
+                | "text"
+                | "ntext"
+                | "datetime"
+                | "datetime2"
+                | "date"
+                | "time"
+                | "uniqueidentifier"
+        );
+        let column_size = match name {
+            "int" => 10,
+            "smallint" => 5,
+            "tinyint" => 3,
+            "bigint" => 19,
+            "float" => 53,
+            "real" => 24,
+            "bit" => 1,
+            "datetime" | "datetime2" => 23,
+            "date" => 10,
+            "time" => 16,
+            "uniqueidentifier" => 36,
+            _ => max_length,
+        };
+        let prefix = if quoted {
+            Some("'")
+        } else if matches!(name, "binary" | "varbinary" | "image") {
+            Some("0x")
+        } else {
+            None
+        };
+        let create_params = match name {
+            "varchar" | "nvarchar" | "char" | "nchar" | "binary" | "varbinary" => {
+                Some("max length")
+            }
+            "decimal" | "numeric" => Some("precision,scale"),
+            _ => None,
+        };
+        let max_scale = match name {
+            "decimal" | "numeric" => 38,
+            "datetime2" | "time" => 7,
+            _ => 0,
+        };
+        let radix = match name {
+            "int" | "smallint" | "tinyint" | "bigint" | "decimal" | "numeric" | "money"
+            | "smallmoney" => Cell::I32(10),
+            "float" | "real" => Cell::I32(2),
+            _ => Cell::Null,
+        };
+        for cell in [
+            Cell::Str(name),
+            Cell::I16(odbc_type(name)),
+            Cell::I32(column_size),
+            text(prefix),
+            text(quoted.then_some("'")),
+            text(create_params),
+            Cell::I16(SQL_NULLABLE),
+            Cell::I16(0),
+            Cell::I16(SQL_SEARCHABLE),
+            Cell::I16((name == "tinyint") as i16),
+            Cell::I16(matches!(name, "money" | "smallmoney") as i16),
+            Cell::I16(0),
+            Cell::Str(name),
+            Cell::I16(0),
+            Cell::I16(max_scale),
+            Cell::I16(0),
+            Cell::Null,
+            radix,
+            Cell::Null,
+        ] {
+            rows.push(cell);
+        }
+        rows.finish_row();
+    }
+    execute::set_result(
+        stmt,
+        ResultSet {
+            columns: columns.into(),
+            rows,
+            spill: None,
+            done_rows: 0,
+        },
+    )
 }
 
 pub fn primary_keys(stmt: &mut Statement, _catalog: &str, schema: &str, table: &str) -> SQLRETURN {
@@ -84,7 +336,7 @@ pub fn primary_keys(stmt: &mut Statement, _catalog: &str, schema: &str, table: &
          ORDER BY TABLE_SCHEM, TABLE_NAME, KEY_SEQ",
         conditions.join(" AND ")
     );
-    execute::exec_direct(stmt, &sql)
+    cached(stmt, sql)
 }
 
 pub fn statistics(
@@ -130,7 +382,7 @@ pub fn statistics(
         conditions.join(" AND "),
         unique_filter
     );
-    execute::exec_direct(stmt, &sql)
+    cached(stmt, sql)
 }
 
 pub fn special_columns(
@@ -174,7 +426,7 @@ pub fn special_columns(
         conditions.join(" AND "),
         extra_filter
     );
-    execute::exec_direct(stmt, &sql)
+    cached(stmt, sql)
 }
 
 pub fn foreign_keys(
@@ -224,5 +476,5 @@ pub fn foreign_keys(
          ORDER BY FKTABLE_CAT, FKTABLE_SCHEM, FKTABLE_NAME, KEY_SEQ",
         conditions.join(" AND ")
     );
-    execute::exec_direct(stmt, &sql)
+    cached(stmt, sql)
 }
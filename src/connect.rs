@@ -1,83 +1,464 @@
+use crate::catalog::CatalogCache;
 use crate::handle::*;
+use crate::pool::{self, PoolConfig, PoolKey};
+use crate::stream::{Attention, TdsStream, PACKET_SIZE};
 use crate::types::*;
-use std::net::TcpStream;
+use socket2::{Domain, Protocol, Socket, Type};
+use std::net::{SocketAddr, TcpStream, ToSocketAddrs};
+use std::sync::mpsc;
+use std::sync::Arc;
+use std::time::{Duration, Instant};
 use tabby::{AuthMethod, Config, EncryptionLevel, SyncClient};
 
-pub fn parse_connection_string(conn_str: &str) -> (String, u16, String, String, String, bool) {
+/// Split a connection string into (lowercased keyword, value) pairs
+fn conn_str_pairs(conn_str: &str) -> impl Iterator<Item = (String, String)> + '_ {
+    conn_str.split(';').filter_map(|part| {
+        let part = part.trim();
+        let idx = part.find('=')?;
+        Some((
+            part[..idx].trim().to_lowercase(),
+            part[idx + 1..].trim().to_string(),
+        ))
+    })
+}
+
+fn is_true(val: &str) -> bool {
+    val.eq_ignore_ascii_case("yes") || val == "1" || val.eq_ignore_ascii_case("true")
+}
+
+/// Encrypt= keyword. `Strict` validates the server certificate even with
+/// TrustServerCertificate=yes; tabby negotiates TLS after PRELOGIN either
+/// way, as TDS 7.x does.
+#[derive(Clone, Copy, PartialEq, Eq, Hash)]
+pub enum Encrypt {
+    /// Only the login packet is encrypted (Encrypt=no / optional)
+    No,
+    Yes,
+    Strict,
+}
+
+fn parse_encrypt(val: &str) -> Encrypt {
+    if val.eq_ignore_ascii_case("strict") {
+        Encrypt::Strict
+    } else if is_true(val) || val.eq_ignore_ascii_case("mandatory") {
+        Encrypt::Yes
+    } else {
+        Encrypt::No
+    }
+}
+
+/// The session settings of a connection string, and whether it asks for
+/// MultiSubnetFailover
+pub fn parse_connection_string(conn_str: &str) -> (PoolKey, bool) {
     let mut host = "localhost".to_string();
     let mut port: u16 = 1433;
     let mut database = "master".to_string();
     let mut uid = String::new();
     let mut pwd = String::new();
     let mut trust_cert = false;
+    // Unlike msodbcsql 18 the default is no: tabby runs TLS above
+    // TdsStream, so an encrypted session cannot signal attention or write
+    // BULK_LOAD packets (no SQLCancel, query timeout or bulk copy)
+    let mut encrypt = Encrypt::No;
+    let mut multi_subnet_failover = false;
 
-    for part in conn_str.split(';') {
-        let part = part.trim();
-        if part.is_empty() {
-            continue;
-        }
-        if let Some(idx) = part.find('=') {
-            let key = part[..idx].trim().to_lowercase();
-            let val = part[idx + 1..].trim().to_string();
-            match key.as_str() {
-                "server" => {
-                    if let Some(comma) = val.find(',') {
-                        host = val[..comma].to_string();
-                        if let Ok(p) = val[comma + 1..].trim().parse() {
-                            port = p;
-                        }
-                    } else {
-                        host = val;
+    for (key, val) in conn_str_pairs(conn_str) {
+        match key.as_str() {
+            "server" => {
+                if let Some(comma) = val.find(',') {
+                    host = val[..comma].to_string();
+                    if let Ok(p) = val[comma + 1..].trim().parse() {
+                        port = p;
                     }
+                } else {
+                    host = val;
                 }
-                "database" | "initial catalog" => database = val,
-                "uid" | "user id" => uid = val,
-                "pwd" | "password" => pwd = val,
-                "trustservercertificate" => {
-                    trust_cert = val.eq_ignore_ascii_case("yes")
-                        || val == "1"
-                        || val.eq_ignore_ascii_case("true")
+            }
+            "database" | "initial catalog" => database = val,
+            "uid" | "user id" => uid = val,
+            "pwd" | "password" => pwd = val,
+            "trustservercertificate" => trust_cert = is_true(&val),
+            "encrypt" => encrypt = parse_encrypt(&val),
+            "multisubnetfailover" => multi_subnet_failover = is_true(&val),
+            _ => {}
+        }
+    }
+    let key = PoolKey {
+        host,
+        port,
+        database,
+        uid,
+        pwd,
+        trust_cert,
+        encrypt,
+    };
+    (key, multi_subnet_failover)
+}
+
+/// Pool settings from the connection string, or None unless Pooling=yes
+pub fn parse_pool_config(conn_str: &str) -> Option<PoolConfig> {
+    let mut enabled = false;
+    let mut config = PoolConfig::default();
+    let secs = |val: &str| match val.parse::<u64>() {
+        Ok(0) | Err(_) => None,
+        Ok(n) => Some(Duration::from_secs(n)),
+    };
+    for (key, val) in conn_str_pairs(conn_str) {
+        match key.as_str() {
+            "pooling" => enabled = is_true(&val),
+            "poolmaxidle" => {
+                if let Ok(n) = val.parse() {
+                    config.max_idle = n;
                 }
-                _ => {}
             }
+            "poolidletimeout" => config.idle_timeout = secs(&val),
+            "poolmaxlifetime" => config.max_lifetime = secs(&val),
+            _ => {}
         }
     }
-    (host, port, database, uid, pwd, trust_cert)
+    enabled.then_some(config)
 }
 
-pub fn driver_connect(conn: &mut Connection, conn_str: &str) -> SQLRETURN {
-    let (host, port, database, uid, pwd, trust_cert) = parse_connection_string(conn_str);
-    conn.server = format!("{}:{}", host, port);
-    conn.database = database.clone();
-    conn.uid = uid.clone();
-    conn.pwd = pwd.clone();
-
-    let result = (|| {
-        let mut config = Config::new();
-        config.host(&host);
-        config.port(port);
-        config.database(&database);
-        config.authentication(AuthMethod::sql_server(&uid, &pwd));
-        if trust_cert {
-            config.trust_cert();
+/// PrefetchBytes= keyword: default read-ahead budget for the connection's
+/// statements
+fn parse_prefetch_bytes(conn_str: &str) -> usize {
+    let mut bytes = crate::fetch::DEFAULT_PREFETCH_BYTES;
+    for (key, val) in conn_str_pairs(conn_str) {
+        if key == "prefetchbytes" {
+            match val.parse() {
+                Ok(0) | Err(_) => {}
+                Ok(n) => bytes = n,
+            }
+        }
+    }
+    bytes
+}
+
+/// BufferBytes= keyword: memory for the rows of a reply read ahead so
+/// another statement can use the connection, past which they are spilled
+fn parse_buffer_bytes(conn_str: &str) -> usize {
+    conn_str_pairs(conn_str)
+        .filter(|(key, _)| key == "bufferbytes")
+        .filter_map(|(_, val)| val.parse().ok())
+        .filter(|&n| n > 0)
+        .last()
+        .unwrap_or(crate::spill::DEFAULT_BUFFER_BYTES)
+}
+
+/// CatalogCacheTTL= keyword: seconds catalog function results are cached
+fn parse_catalog_ttl(conn_str: &str) -> u64 {
+    conn_str_pairs(conn_str)
+        .filter(|(key, _)| key == "catalogcachettl")
+        .filter_map(|(_, val)| val.parse().ok())
+        .last()
+        .unwrap_or(crate::catalog::DEFAULT_CATALOG_TTL)
+}
+
+/// Packet Size= or PacketSize= keyword: bytes per TDS packet to ask the
+/// server for, brought into the 512 to 32767 it takes
+fn parse_packet_size(conn_str: &str) -> Option<SQLULEN> {
+    conn_str_pairs(conn_str)
+        .filter(|(key, _)| key == "packet size" || key == "packetsize")
+        .filter_map(|(_, val)| val.parse::<SQLULEN>().ok())
+        .filter(|&n| n > 0)
+        .last()
+        .map(|n| n.clamp(512, 32767))
+}
+
+/// SocketBufferSize= keyword: SO_RCVBUF and SO_SNDBUF of the connection's
+/// socket, in bytes. Unset leaves them to the system, which tunes them to
+/// the connection as it goes; a fixed size suits links with a large
+/// bandwidth-delay product that the system limits would hold back.
+fn parse_socket_buffer_size(conn_str: &str) -> Option<usize> {
+    conn_str_pairs(conn_str)
+        .filter(|(key, _)| key == "socketbuffersize")
+        .filter_map(|(_, val)| val.parse().ok())
+        .filter(|&n| n > 0)
+        .last()
+}
+
+enum LoginError {
+    TimedOut,
+    Failed(String),
+}
+
+/// How a connection's session was opened, kept so the sessions of a
+/// partitioned extract can be opened the same way
+#[derive(Clone)]
+pub struct Login {
+    pub key: PoolKey,
+    multi_subnet_failover: bool,
+    socket_buffer_size: Option<usize>,
+}
+
+fn io_error(e: std::io::Error) -> LoginError {
+    if matches!(
+        e.kind(),
+        std::io::ErrorKind::TimedOut | std::io::ErrorKind::WouldBlock
+    ) {
+        LoginError::TimedOut
+    } else {
+        LoginError::Failed(e.to_string())
+    }
+}
+
+/// Connect the TCP socket to one of the addresses `addr` resolves to,
+/// within `timeout` in all if one is set. The addresses are tried in turn,
+/// or all at once with MultiSubnetFailover, as an availability group
+/// listener resolves to an address in each subnet and only one answers.
+fn open_socket(
+    addr: &str,
+    timeout: Option<Duration>,
+    multi_subnet_failover: bool,
+    buffer_size: Option<usize>,
+) -> Result<TcpStream, LoginError> {
+    let deadline = timeout.map(|t| Instant::now() + t);
+    let addrs: Vec<SocketAddr> = addr.to_socket_addrs().map_err(io_error)?.collect();
+    if multi_subnet_failover && addrs.len() > 1 {
+        return connect_any(addrs, deadline, buffer_size);
+    }
+    let mut last = LoginError::Failed(format!("Could not resolve {}", addr));
+    for sa in addrs {
+        let attempt = match deadline {
+            Some(deadline) => match remaining(deadline) {
+                Some(left) => connect_socket(sa, Some(left), buffer_size),
+                None => return Err(LoginError::TimedOut),
+            },
+            None => connect_socket(sa, None, buffer_size),
+        };
+        match attempt {
+            Ok(tcp) => return Ok(tcp),
+            Err(e) => last = io_error(e),
         }
-        config.encryption(EncryptionLevel::NotSupported);
+    }
+    Err(last)
+}
 
-        let tcp = TcpStream::connect(config.get_addr()).map_err(|e| e.to_string())?;
-        tcp.set_nodelay(true).map_err(|e| e.to_string())?;
+/// Connect a socket to `sa`, sized to `buffer_size` if set. The buffers
+/// are sized before the connect, so the TCP window scale offered in the
+/// handshake covers them.
+fn connect_socket(
+    sa: SocketAddr,
+    timeout: Option<Duration>,
+    buffer_size: Option<usize>,
+) -> std::io::Result<TcpStream> {
+    let socket = Socket::new(Domain::for_address(sa), Type::STREAM, Some(Protocol::TCP))?;
+    if let Some(size) = buffer_size {
+        socket.set_recv_buffer_size(size)?;
+        socket.set_send_buffer_size(size)?;
+    }
+    match timeout {
+        Some(t) => socket.connect_timeout(&sa.into(), t)?,
+        None => socket.connect(&sa.into())?,
+    }
+    Ok(socket.into())
+}
 
-        let client = SyncClient::connect(config, tcp).map_err(|e| e.to_string())?;
+/// Time left until `deadline`, or None once it has passed
+fn remaining(deadline: Instant) -> Option<Duration> {
+    deadline
+        .checked_duration_since(Instant::now())
+        .filter(|d| !d.is_zero())
+}
 
-        Ok::<_, String>(client)
-    })();
+/// Connect to all of `addrs` in parallel and keep the first socket that
+/// connects. The other attempts finish on their own threads, and any
+/// socket they open is closed.
+fn connect_any(
+    addrs: Vec<SocketAddr>,
+    deadline: Option<Instant>,
+    buffer_size: Option<usize>,
+) -> Result<TcpStream, LoginError> {
+    let (tx, rx) = mpsc::channel();
+    for sa in addrs {
+        let tx = tx.clone();
+        let timeout = deadline.and_then(remaining);
+        std::thread::spawn(move || {
+            let _ = tx.send(connect_socket(sa, timeout, buffer_size));
+        });
+    }
+    drop(tx);
+    let mut last = LoginError::TimedOut;
+    loop {
+        let attempt = match deadline {
+            Some(deadline) => match rx.recv_timeout(remaining(deadline).unwrap_or_default()) {
+                Ok(attempt) => attempt,
+                Err(mpsc::RecvTimeoutError::Timeout) => return Err(LoginError::TimedOut),
+                Err(mpsc::RecvTimeoutError::Disconnected) => return Err(last),
+            },
+            None => match rx.recv() {
+                Ok(attempt) => attempt,
+                Err(_) => return Err(last),
+            },
+        };
+        match attempt {
+            Ok(tcp) => return Ok(tcp),
+            Err(e) => last = io_error(e),
+        }
+    }
+}
+
+/// TCP connect and TDS login for a new session, all within `timeout` from
+/// `started` if one is set
+fn open(
+    login: &Login,
+    timeout: Option<Duration>,
+    started: Instant,
+) -> Result<(SyncClient<TdsStream>, Arc<Attention>), LoginError> {
+    let mut config = Config::new();
+    config.host(&login.key.host);
+    config.port(login.key.port);
+    config.database(&login.key.database);
+    config.authentication(AuthMethod::sql_server(&login.key.uid, &login.key.pwd));
+    if login.key.trust_cert && login.key.encrypt != Encrypt::Strict {
+        config.trust_cert();
+    }
+    config.encryption(match login.key.encrypt {
+        Encrypt::No => EncryptionLevel::NotSupported,
+        Encrypt::Yes | Encrypt::Strict => EncryptionLevel::Required,
+    });
+
+    let tcp = open_socket(
+        &config.get_addr(),
+        timeout,
+        login.multi_subnet_failover,
+        login.socket_buffer_size,
+    )?;
+    tcp.set_nodelay(true).map_err(io_error)?;
+    // The TLS and login handshakes get what is left of the same timeout
+    let left = timeout.map(|t| {
+        t.saturating_sub(started.elapsed())
+            .max(Duration::from_millis(1))
+    });
+    tcp.set_read_timeout(left).map_err(io_error)?;
+
+    let (stream, attention) = TdsStream::new(
+        tcp.try_clone().map_err(io_error)?,
+        login.key.encrypt == Encrypt::No,
+    )
+    .map_err(io_error)?;
+    let client = SyncClient::connect(config, stream).map_err(|e| {
+        if timeout.is_some_and(|t| started.elapsed() >= t) {
+            LoginError::TimedOut
+        } else {
+            LoginError::Failed(e.to_string())
+        }
+    })?;
+    tcp.set_read_timeout(None).map_err(io_error)?;
+    Ok((client, attention))
+}
+
+/// A new session for a partitioned extract, opened like the connection's
+/// own with `timeout` (SQL_ATTR_LOGIN_TIMEOUT) for the login
+pub fn open_session(
+    login: &Login,
+    timeout: Option<Duration>,
+) -> Result<(SyncClient<TdsStream>, Arc<Attention>), String> {
+    open(login, timeout, Instant::now()).map_err(|e| match e {
+        LoginError::TimedOut => "Login timeout expired".to_string(),
+        LoginError::Failed(msg) => msg,
+    })
+}
+
+/// Check out a pooled session for `key` and reset it. Sessions that fail the
+/// reset are dead and are dropped.
+fn checkout_session(conn: &mut Connection, key: &PoolKey, config: &PoolConfig) -> bool {
+    if conn.env.is_null() {
+        return false;
+    }
+    let env = unsafe { &*conn.env };
+    loop {
+        let session = env.pool.lock().unwrap().checkout(key, config);
+        let Some(mut session) = session else {
+            return false;
+        };
+        let mut w = StringRowWriter::new();
+        if session
+            .client
+            .batch_into(&pool::reset_batch(&key.database), &mut w)
+            .is_ok()
+        {
+            conn.client = Some(session.client);
+            conn.attention = Some(session.attention);
+            conn.prepared = session.prepared;
+            conn.session_created = session.created;
+            return true;
+        }
+    }
+}
+
+fn record_pool_lookup(conn: &Connection, hit: bool) {
+    if conn.env.is_null() {
+        return;
+    }
+    let mut pool = unsafe { &*conn.env }.pool.lock().unwrap();
+    if hit {
+        pool.hits += 1;
+    } else {
+        pool.misses += 1;
+    }
+}
+
+pub fn driver_connect(conn: &mut Connection, conn_str: &str) -> SQLRETURN {
+    let (key, multi_subnet_failover) = parse_connection_string(conn_str);
+    conn.server = format!("{}:{}", key.host, key.port);
+    conn.database = key.database.clone();
+    conn.uid = key.uid.clone();
+    conn.pwd = key.pwd.clone();
+    conn.in_transaction = false;
+    conn.prefetch_bytes = parse_prefetch_bytes(conn_str);
+    conn.buffer_bytes = parse_buffer_bytes(conn_str);
+    conn.read_ahead = conn_str_pairs(conn_str)
+        .filter(|(key, _)| key == "readahead")
+        .any(|(_, val)| is_true(&val));
+    conn.catalog_cache = CatalogCache::new(parse_catalog_ttl(conn_str));
+    // A trace file that cannot be opened only means no trace
+    conn.trace = conn_str_pairs(conn_str)
+        .find(|(key, _)| key == "trace")
+        .and_then(|(_, path)| crate::stats::Trace::open(&path).ok());
+    if let Some(size) = parse_packet_size(conn_str) {
+        conn.packet_size = size;
+    }
+    let started = Instant::now();
+    let login = Login {
+        key: key.clone(),
+        multi_subnet_failover,
+        socket_buffer_size: parse_socket_buffer_size(conn_str),
+    };
+    conn.login = Some(login.clone());
+
+    conn.pooling = parse_pool_config(conn_str).map(|config| (key, config));
+    if let Some((key, config)) = conn.pooling.clone() {
+        let hit = checkout_session(conn, &key, &config);
+        record_pool_lookup(conn, hit);
+        if hit {
+            conn.connected = true;
+            return connected(conn, true, started);
+        }
+    }
+
+    let login_timeout =
+        (conn.login_timeout > 0).then(|| Duration::from_secs(conn.login_timeout as u64));
+    let result = open(&login, login_timeout, started);
 
     match result {
-        Ok(client) => {
+        Ok((client, attention)) => {
+            conn.prepared.drain();
             conn.client = Some(client);
+            conn.attention = Some(attention);
+            conn.session_created = Instant::now();
             conn.connected = true;
-            SQL_SUCCESS
+            connected(conn, false, started)
         }
-        Err(msg) => {
+        Err(LoginError::TimedOut) => {
+            conn.diagnostics.push(DiagRecord {
+                state: "HYT00".to_string(),
+                native_error: 0,
+                message: "Login timeout expired".to_string(),
+            });
+            SQL_ERROR
+        }
+        Err(LoginError::Failed(msg)) => {
             conn.diagnostics.push(DiagRecord {
                 state: "08001".to_string(),
                 native_error: 0,
@@ -88,8 +469,131 @@ pub fn driver_connect(conn: &mut Connection, conn_str: &str) -> SQLRETURN {
     }
 }
 
+/// The connection has a session, new or from the pool, since `started`:
+/// count from here on, trace the connect and settle the packet size
+fn connected(conn: &mut Connection, pooled: bool, started: Instant) -> SQLRETURN {
+    crate::stats::reset_connection(conn);
+    // The session runs at PACKET_SIZE whatever was asked for
+    let asked = std::mem::replace(&mut conn.packet_size, PACKET_SIZE as SQLULEN);
+    let changed = asked != 0 && asked != conn.packet_size;
+    if changed {
+        conn.diagnostics.push(DiagRecord {
+            state: "01S02".to_string(),
+            native_error: 0,
+            message: format!("Packet size changed to {}", conn.packet_size),
+        });
+    }
+    if let Some(trace) = conn.trace.as_ref() {
+        trace.write(&format!(
+            "connect server={} database={} pooled={} us={}",
+            conn.server,
+            conn.database,
+            pooled,
+            started.elapsed().as_micros()
+        ));
+    }
+    if changed {
+        SQL_SUCCESS_WITH_INFO
+    } else {
+        SQL_SUCCESS
+    }
+}
+
 pub fn disconnect(conn: &mut Connection) -> SQLRETURN {
+    // Also takes the client back from any read-ahead thread
+    for &stmt in &conn.statements {
+        let stmt = unsafe { &mut *stmt };
+        if stmt.streaming {
+            crate::execute::close_stream(stmt);
+        }
+    }
+    // Flushes the trace file
+    conn.trace = None;
+    conn.catalog_cache.clear();
+    // A bulk copy batch left open has the wire mid-message: the session can
+    // only be closed, and its uncommitted rows roll back with it
+    if conn.bulk.take().is_some_and(|b| b.in_batch()) {
+        conn.pooling = None;
+        conn.prepared.drain();
+        conn.client = None;
+    }
+    if let Some((key, config)) = conn.pooling.take() {
+        if return_to_pool(conn, key, &config) {
+            conn.connected = false;
+            return SQL_SUCCESS;
+        }
+    }
+    // Release server-side prepared statements; best effort, since the
+    // session is about to end anyway
+    let handles = conn.prepared.drain();
+    if let Some(client) = conn.client.as_mut() {
+        if !handles.is_empty() {
+            let mut w = StringRowWriter::new();
+            let _ = client.batch_into(&crate::params::unprepare_call(&handles), &mut w);
+        }
+    }
     conn.client = None;
+    conn.attention = None;
     conn.connected = false;
     SQL_SUCCESS
 }
+
+/// An idle session from the pool of `conn`, for a partition of an extract.
+/// The caller resets it, as `checkout_session` does.
+pub fn checkout_idle(conn: &Connection) -> Option<pool::PooledSession> {
+    let (key, config) = conn.pooling.as_ref()?;
+    if conn.env.is_null() {
+        return None;
+    }
+    let session = unsafe { &*conn.env }
+        .pool
+        .lock()
+        .unwrap()
+        .checkout(key, config);
+    record_pool_lookup(conn, session.is_some());
+    session
+}
+
+/// Park a partition's session in the pool of `conn`, or close it if the
+/// connection does not pool. Its reply must be complete.
+pub fn release_session(
+    conn: &Connection,
+    client: SyncClient<TdsStream>,
+    attention: Arc<Attention>,
+    prepared: PreparedCache,
+    created: Instant,
+) {
+    let Some((key, config)) = conn.pooling.as_ref().filter(|_| !conn.env.is_null()) else {
+        return;
+    };
+    let env = unsafe { &*conn.env };
+    env.pool
+        .lock()
+        .unwrap()
+        .checkin(key.clone(), config, client, attention, prepared, created);
+}
+
+/// Hand the connection's session back to the environment's pool. The
+/// caller has closed any result stream still open on its statements, so the
+/// next user starts on a clean wire. Returns false when the session cannot
+/// be pooled; the caller then closes it.
+fn return_to_pool(conn: &mut Connection, key: PoolKey, config: &PoolConfig) -> bool {
+    if conn.env.is_null() {
+        return false;
+    }
+    // Closing a stream drops the session if it could not be resynchronised
+    let (Some(client), Some(attention)) = (conn.client.take(), conn.attention.take()) else {
+        return false;
+    };
+    let prepared = std::mem::replace(&mut conn.prepared, PreparedCache::new(PREPARED_CACHE_SIZE));
+    let env = unsafe { &*conn.env };
+    env.pool.lock().unwrap().checkin(
+        key,
+        config,
+        client,
+        attention,
+        prepared,
+        conn.session_created,
+    );
+    true
+}
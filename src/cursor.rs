@@ -0,0 +1,458 @@
+use crate::batch::RowBatch;
+use crate::execute;
+use crate::fetch;
+use crate::handle::*;
+use crate::params::{self, Parameterized};
+use crate::spill::Spill;
+use crate::types::*;
+use std::sync::Arc;
+
+/// sp_cursorfetch fetch types
+const FETCH_FIRST: u32 = 0x01;
+const FETCH_NEXT: u32 = 0x02;
+const FETCH_PREV: u32 = 0x04;
+const FETCH_LAST: u32 = 0x08;
+const FETCH_ABSOLUTE: u32 = 0x10;
+const FETCH_RELATIVE: u32 = 0x20;
+
+/// Cursor type bits of sp_cursoropen's scrollopt
+const SCROLLOPT_TYPE: u32 = 0x0F;
+/// Concurrency bits of sp_cursoropen's ccopt
+const CCOPT_CONCURRENCY: u32 = 0x0F;
+
+/// Hidden status column the server may append to the rows of a fetch
+const ROWSTAT: &str = "ROWSTAT";
+
+/// Cursor a scrollable statement's result is read through
+pub enum Cursor {
+    Server(ServerCursor),
+    Client(ClientCursor),
+}
+
+/// Server cursor a scrollable statement's result is read through. Only the
+/// current rowset is held on the client: every SQLFetchScroll is one
+/// sp_cursorfetch for SQL_ATTR_ROW_ARRAY_SIZE rows.
+pub struct ServerCursor {
+    handle: i32,
+    /// Positioned before the first row, where the server cursor cannot be
+    /// moved: the next SQL_FETCH_NEXT fetches the first rowset
+    before_start: bool,
+}
+
+/// Static read-only cursor over a result read whole onto the client: the
+/// rows kept in memory, then those spilled past BufferBytes=, which are read
+/// back a segment at a time as the cursor moves over them. Every
+/// SQLFetchScroll copies its rowset to `stmt.rows`.
+pub struct ClientCursor {
+    head: Box<RowBatch>,
+    spill: Option<Arc<Spill>>,
+    /// The spill segment last read back, and its index
+    segment: Box<RowBatch>,
+    loaded: Option<usize>,
+    /// First row of the current rowset, from 1: 0 before the first row and
+    /// past the last row after it
+    start: usize,
+    /// Rows asked for by the fetch that made the current rowset
+    rowset: usize,
+}
+
+impl ClientCursor {
+    fn new(head: RowBatch, spill: Option<Arc<Spill>>) -> Self {
+        Self {
+            head: Box::new(head),
+            spill,
+            segment: Box::default(),
+            loaded: None,
+            start: 0,
+            rowset: 0,
+        }
+    }
+
+    /// Rows in the result
+    fn len(&self) -> usize {
+        self.head.len() + self.spill.as_ref().map_or(0, |s| s.rows())
+    }
+
+    /// Replace `out` with copies of up to `n` rows from row `first` (from 0)
+    fn copy(&mut self, first: usize, n: usize, out: &mut RowBatch) -> std::io::Result<()> {
+        out.clear();
+        for row in first..(first + n).min(self.len()) {
+            if row < self.head.len() {
+                out.append_row(&self.head, row);
+                continue;
+            }
+            let spill = self.spill.as_ref().expect("row past the head is spilled");
+            let (index, from) = spill
+                .locate(row - self.head.len())
+                .expect("row within the result");
+            if self.loaded != Some(index) {
+                self.segment.clear();
+                self.loaded = None;
+                spill.load(index, &mut self.segment)?;
+                self.loaded = Some(index);
+            }
+            out.append_row(&self.segment, row - self.head.len() - from);
+        }
+        Ok(())
+    }
+}
+
+fn scrollopt(cursor_type: SQLULEN) -> u32 {
+    match cursor_type {
+        SQL_CURSOR_KEYSET_DRIVEN => 0x01,
+        SQL_CURSOR_DYNAMIC => 0x02,
+        SQL_CURSOR_STATIC => 0x08,
+        _ => 0x04,
+    }
+}
+
+fn cursor_type_of(scrollopt: u32) -> SQLULEN {
+    match scrollopt & SCROLLOPT_TYPE {
+        0x01 => SQL_CURSOR_KEYSET_DRIVEN,
+        0x02 => SQL_CURSOR_DYNAMIC,
+        0x08 => SQL_CURSOR_STATIC,
+        _ => SQL_CURSOR_FORWARD_ONLY,
+    }
+}
+
+fn ccopt(concurrency: SQLULEN) -> u32 {
+    match concurrency {
+        SQL_CONCUR_LOCK => 0x02,
+        SQL_CONCUR_ROWVER => 0x04,
+        SQL_CONCUR_VALUES => 0x08,
+        _ => 0x01,
+    }
+}
+
+fn concurrency_of(ccopt: u32) -> SQLULEN {
+    match ccopt & CCOPT_CONCURRENCY {
+        0x02 => SQL_CONCUR_LOCK,
+        0x04 => SQL_CONCUR_ROWVER,
+        0x08 => SQL_CONCUR_VALUES,
+        _ => SQL_CONCUR_READ_ONLY,
+    }
+}
+
+/// Whether executing `text` opens a cursor: the application asked for a
+/// scrollable cursor and the statement is a query. Anything else runs as a
+/// forward-only result stream.
+pub fn wanted(stmt: &Statement, text: &str) -> bool {
+    if stmt.cursor_type == SQL_CURSOR_FORWARD_ONLY {
+        return false;
+    }
+    let word = leading_keyword(text);
+    word.eq_ignore_ascii_case("select") || word.eq_ignore_ascii_case("with")
+}
+
+/// The first word of `text`, past any whitespace and opening parentheses
+pub fn leading_keyword(text: &str) -> &str {
+    let text = text.trim_start_matches(|c: char| c.is_whitespace() || c == '(');
+    let end = text
+        .find(|c: char| !c.is_ascii_alphabetic())
+        .unwrap_or(text.len());
+    &text[..end]
+}
+
+/// Open `p` as a cursor of the statement's SQL_ATTR_CURSOR_TYPE and
+/// SQL_ATTR_CONCURRENCY. A static read-only cursor is kept on the client;
+/// any other is a server cursor, and no rows are read until the first
+/// fetch. When the server settles for another type or concurrency the
+/// attributes are updated and 01S02 reported.
+pub fn open(stmt: &mut Statement, p: &Parameterized) -> SQLRETURN {
+    close(stmt);
+    if stmt.cursor_type == SQL_CURSOR_STATIC && stmt.concurrency == SQL_CONCUR_READ_ONLY {
+        return open_client(stmt, p);
+    }
+    crate::stats::start(stmt, &p.text);
+    let sql = params::cursor_open_call(p, scrollopt(stmt.cursor_type), ccopt(stmt.concurrency));
+    let mut w = match execute::run_buffered(stmt, &sql) {
+        Ok(w) => w,
+        Err(ret) => return ret,
+    };
+    let Some(out) = w.result_sets.pop() else {
+        stmt.diagnostics.push(DiagRecord {
+            state: "HY000".to_string(),
+            native_error: 0,
+            message: "sp_cursoropen returned no cursor".to_string(),
+        });
+        return SQL_ERROR;
+    };
+    let output = |col| out.rows.cell(0, col).map_or(0, fetch::cell_to_i64);
+    let (handle, so, cc, rows) = (output(0), output(1), output(2), output(3));
+
+    let mut sets = w.result_sets.into_iter();
+    if handle == 0 {
+        // The server ran the statement instead of opening a cursor over it,
+        // as it does for batches that are not a single query
+        let first = sets.next().unwrap_or(ResultSet {
+            columns: Columns::default(),
+            rows: Default::default(),
+            spill: None,
+            done_rows: 0,
+        });
+        execute::set_result(stmt, first);
+        stmt.pending_result_sets.extend(sets);
+        changed(stmt);
+        return SQL_SUCCESS_WITH_INFO;
+    }
+
+    // The cursor's metadata comes back as a result set without rows
+    let columns = sets
+        .next()
+        .map_or_else(Columns::default, |rs| visible(&rs.columns));
+    execute::set_result(
+        stmt,
+        ResultSet {
+            columns,
+            rows: Default::default(),
+            spill: None,
+            done_rows: 0,
+        },
+    );
+    stmt.row_count = if rows >= 0 { rows as SQLLEN } else { -1 };
+    stmt.cursor = Some(Cursor::Server(ServerCursor {
+        handle: handle as i32,
+        before_start: false,
+    }));
+
+    let cursor_type = cursor_type_of(so as u32);
+    let concurrency = concurrency_of(cc as u32);
+    if cursor_type != stmt.cursor_type || concurrency != stmt.concurrency {
+        stmt.cursor_type = cursor_type;
+        stmt.concurrency = concurrency;
+        changed(stmt);
+        return SQL_SUCCESS_WITH_INFO;
+    }
+    SQL_SUCCESS
+}
+
+/// Run `p` and read its result set whole onto the client, spilling what does
+/// not fit BufferBytes=, as the rows of a static cursor. Later result sets
+/// are buffered for SQLMoreResults as usual.
+fn open_client(stmt: &mut Statement, p: &Parameterized) -> SQLRETURN {
+    let ret = execute::exec_direct(stmt, &params::executesql_call(p));
+    if !stmt.streaming {
+        // Failed, or no result set to scroll
+        return ret;
+    }
+    fetch::buffer_rest(stmt);
+    if !stmt.buffered {
+        // Cancelled or timed out part way
+        if stmt.streaming {
+            execute::close_stream(stmt);
+        }
+        return SQL_ERROR;
+    }
+    stmt.streaming = false;
+    let spill = stmt
+        .spilled
+        .take()
+        .map(crate::spill::SpillReader::into_spill);
+    let head = std::mem::take(&mut stmt.rows);
+    if let Some(PrefetchTerminal::Error(message)) = stmt.prefetch_done.take() {
+        stmt.diagnostics.push(DiagRecord {
+            state: "HY000".to_string(),
+            native_error: 0,
+            message,
+        });
+        return SQL_ERROR;
+    }
+    let cursor = ClientCursor::new(head, spill);
+    stmt.row_count = cursor.len() as SQLLEN;
+    stmt.cursor = Some(Cursor::Client(cursor));
+    ret
+}
+
+fn changed(stmt: &mut Statement) {
+    stmt.diagnostics.push(DiagRecord {
+        state: "01S02".to_string(),
+        native_error: 0,
+        message: "Cursor type changed".to_string(),
+    });
+}
+
+/// Columns of a cursor result, without the fetch status column
+fn visible(columns: &Columns) -> Columns {
+    match columns.last() {
+        Some(c) if c.name.eq_ignore_ascii_case(ROWSTAT) => columns[..columns.len() - 1].into(),
+        _ => columns.clone(),
+    }
+}
+
+/// SQLFetchScroll: position the statement's server cursor and read the
+/// rowset there in one sp_cursorfetch, or move over a client-side cursor's
+/// rows. Without a cursor only SQL_FETCH_NEXT is supported.
+pub fn fetch_scroll(stmt: &mut Statement, orientation: SQLSMALLINT, offset: SQLLEN) -> SQLRETURN {
+    let cursor = match &stmt.cursor {
+        Some(Cursor::Server(cursor)) => cursor,
+        Some(Cursor::Client(_)) => return scroll_client(stmt, orientation, offset),
+        None if orientation == SQL_FETCH_NEXT => return fetch::fetch(stmt),
+        None => return fetch_type_error(stmt),
+    };
+    let handle = cursor.handle;
+    let before_start = cursor.before_start;
+
+    let (fetch_type, rownum) = match orientation {
+        SQL_FETCH_NEXT if before_start => (FETCH_FIRST, 0),
+        SQL_FETCH_NEXT => (FETCH_NEXT, 0),
+        SQL_FETCH_PRIOR if before_start => return before_first(stmt),
+        SQL_FETCH_PRIOR => (FETCH_PREV, 0),
+        SQL_FETCH_FIRST => (FETCH_FIRST, 0),
+        SQL_FETCH_LAST => (FETCH_LAST, 0),
+        SQL_FETCH_ABSOLUTE if offset == 0 => return before_first(stmt),
+        SQL_FETCH_ABSOLUTE => (FETCH_ABSOLUTE, offset),
+        SQL_FETCH_RELATIVE if before_start && offset <= 0 => return before_first(stmt),
+        SQL_FETCH_RELATIVE if before_start => (FETCH_ABSOLUTE, offset),
+        SQL_FETCH_RELATIVE => (FETCH_RELATIVE, offset),
+        SQL_FETCH_BOOKMARK => return bookmark_error(stmt),
+        _ => return fetch_type_error(stmt),
+    };
+
+    let sql = format!(
+        "EXEC sp_cursorfetch {}, {}, {}, {}",
+        handle,
+        fetch_type,
+        rownum,
+        stmt.row_array_size.max(1)
+    );
+    let rs = match execute::exec_result(stmt, &sql) {
+        Ok(rs) => rs,
+        Err(ret) => return ret,
+    };
+    if stmt.columns.is_empty() {
+        stmt.columns = visible(&rs.columns);
+    }
+    stmt.rows = rs.rows;
+    stmt.spilled = None;
+    stmt.row_index = -1;
+    stmt.rowset_len = 0;
+    // Moving back past the first row leaves the cursor before it; moving
+    // forward past the last row is tracked by the server
+    let backward = fetch_type == FETCH_PREV
+        || (fetch_type & (FETCH_ABSOLUTE | FETCH_RELATIVE) != 0 && rownum < 0);
+    if let Some(Cursor::Server(cursor)) = stmt.cursor.as_mut() {
+        cursor.before_start = stmt.rows.is_empty() && backward;
+    }
+    fetch::fetch_rowset(stmt)
+}
+
+/// Where a fetch on a client-side cursor moves it
+enum Move {
+    /// Before the first row
+    BeforeStart,
+    /// To the rowset starting at this row, from 1; past the last row moves
+    /// after the end
+    Row(i64),
+    /// To the first rowset, from a rowset that would start before the first
+    /// row but reach it: 01S06
+    First,
+}
+
+/// SQLFetchScroll on a client-side cursor, moved by the cursor positioning
+/// rules of the ODBC reference for static cursors
+fn scroll_client(stmt: &mut Statement, orientation: SQLSMALLINT, offset: SQLLEN) -> SQLRETURN {
+    let Some(Cursor::Client(cursor)) = stmt.cursor.as_mut() else {
+        return fetch_type_error(stmt);
+    };
+    let size = stmt.row_array_size.max(1) as i64;
+    let last = cursor.len() as i64;
+    let start = cursor.start as i64;
+    let offset = offset as i64;
+    let to = match orientation {
+        SQL_FETCH_NEXT if start == 0 => Move::Row(1),
+        SQL_FETCH_NEXT => Move::Row(start + cursor.rowset as i64),
+        SQL_FETCH_PRIOR if start <= 1 => Move::BeforeStart,
+        SQL_FETCH_PRIOR if start > last => Move::Row((last - size + 1).max(1)),
+        SQL_FETCH_PRIOR if start - size < 1 => Move::First,
+        SQL_FETCH_PRIOR => Move::Row(start - size),
+        SQL_FETCH_FIRST => Move::Row(1),
+        SQL_FETCH_LAST => Move::Row((last - size + 1).max(1)),
+        SQL_FETCH_ABSOLUTE if offset == 0 => Move::BeforeStart,
+        SQL_FETCH_ABSOLUTE if offset > 0 => Move::Row(offset),
+        SQL_FETCH_ABSOLUTE if -offset <= last => Move::Row(last + offset + 1),
+        SQL_FETCH_ABSOLUTE if -offset > size => Move::BeforeStart,
+        SQL_FETCH_ABSOLUTE => Move::First,
+        SQL_FETCH_RELATIVE if start == 0 && offset <= 0 => Move::BeforeStart,
+        SQL_FETCH_RELATIVE if start > last && offset >= 0 => Move::Row(start),
+        SQL_FETCH_RELATIVE if start + offset >= 1 => Move::Row(start + offset),
+        SQL_FETCH_RELATIVE if -offset > size => Move::BeforeStart,
+        SQL_FETCH_RELATIVE => Move::First,
+        SQL_FETCH_BOOKMARK => return bookmark_error(stmt),
+        _ => return fetch_type_error(stmt),
+    };
+    let row = match to {
+        Move::BeforeStart => 0,
+        Move::Row(row) => row.min(last + 1) as usize,
+        Move::First => 1,
+    };
+    cursor.start = row;
+    cursor.rowset = size as usize;
+    stmt.row_index = -1;
+    stmt.rowset_len = 0;
+    if row == 0 || row > cursor.len() {
+        stmt.rows.clear();
+        return fetch::fetch_rowset(stmt);
+    }
+    if let Err(e) = cursor.copy(row - 1, size as usize, &mut stmt.rows) {
+        stmt.rows.clear();
+        stmt.diagnostics.push(DiagRecord {
+            state: "HY000".to_string(),
+            native_error: 0,
+            message: format!("Could not read back buffered rows: {}", e),
+        });
+        return SQL_ERROR;
+    }
+    let ret = fetch::fetch_rowset(stmt);
+    if matches!(to, Move::First) && ret == SQL_SUCCESS {
+        stmt.diagnostics.push(DiagRecord {
+            state: "01S06".to_string(),
+            native_error: 0,
+            message: "Attempt to fetch before the result set returned the first rowset".to_string(),
+        });
+        return SQL_SUCCESS_WITH_INFO;
+    }
+    ret
+}
+
+/// Leave the cursor before the first row: an empty rowset and SQL_NO_DATA
+fn before_first(stmt: &mut Statement) -> SQLRETURN {
+    if let Some(Cursor::Server(cursor)) = stmt.cursor.as_mut() {
+        cursor.before_start = true;
+    }
+    stmt.rows.clear();
+    stmt.row_index = -1;
+    stmt.rowset_len = 0;
+    fetch::fetch_rowset(stmt)
+}
+
+fn bookmark_error(stmt: &mut Statement) -> SQLRETURN {
+    stmt.diagnostics.push(DiagRecord {
+        state: "HYC00".to_string(),
+        native_error: 0,
+        message: "Bookmarks are not supported".to_string(),
+    });
+    SQL_ERROR
+}
+
+fn fetch_type_error(stmt: &mut Statement) -> SQLRETURN {
+    stmt.diagnostics.push(DiagRecord {
+        state: "HY106".to_string(),
+        native_error: 0,
+        message: "Fetch type out of range".to_string(),
+    });
+    SQL_ERROR
+}
+
+/// Release the statement's cursor, if it has one
+pub fn close(stmt: &mut Statement) {
+    let Some(Cursor::Server(cursor)) = stmt.cursor.take() else {
+        return;
+    };
+    if stmt.conn.is_null() {
+        return;
+    }
+    // Best effort: the server drops its cursors with the session anyway
+    let mark = stmt.diagnostics.len();
+    let _ = execute::exec_batch(stmt, &format!("EXEC sp_cursorclose {}", cursor.handle));
+    stmt.diagnostics.truncate(mark);
+}
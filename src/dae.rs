@@ -0,0 +1,413 @@
+use crate::execute;
+use crate::handle::*;
+use crate::params;
+use crate::types::*;
+use crate::utf16;
+
+/// Bytes of a data-at-execution value held on the client. A value up to this
+/// long goes to the server as a constant in the statement; a longer one is
+/// appended to a row of the staging table a piece of this size at a time, so
+/// an upload needs the same client memory whatever its length.
+const FLUSH_BYTES: usize = 1 << 20;
+
+/// Session temp table holding the long values until the statement runs,
+/// one row per statement (`s`) and parameter number (`n`)
+const STAGING_TABLE: &str = "#fb_dae";
+
+/// Identifies `stmt`'s rows in the staging table, which all statements on
+/// the connection share: the handle's address, unique while it is allocated
+fn staging_key(stmt: &Statement) -> usize {
+    stmt as *const Statement as usize
+}
+
+/// How the bytes passed to SQLPutData are read
+#[derive(Clone, Copy, Default, PartialEq, Eq)]
+pub enum DaeKind {
+    /// UTF-16LE text (SQL_C_WCHAR)
+    Wide,
+    /// UTF-8 text
+    #[default]
+    Narrow,
+    Binary,
+}
+
+impl DaeKind {
+    /// Staging table column and its type
+    fn column(self) -> (&'static str, &'static str) {
+        match self {
+            DaeKind::Binary => ("b", "varbinary(max)"),
+            _ => ("w", "nvarchar(max)"),
+        }
+    }
+}
+
+/// Value of a data-at-execution parameter whose data has all been put
+pub enum DaeValue {
+    Null,
+    /// T-SQL constant sent with the statement
+    Literal(String),
+    /// Value held in the parameter's staging row; `len` counts UTF-16 units,
+    /// or bytes for binary data
+    Staged {
+        kind: DaeKind,
+        len: usize,
+    },
+}
+
+/// The parameter SQLPutData is currently sending
+#[derive(Default)]
+pub struct DaePut {
+    pub param: u16,
+    pub kind: DaeKind,
+    /// Data put but not sent yet
+    pub buf: Vec<u8>,
+    /// SQLPutData was called for the parameter
+    pub started: bool,
+    pub null: bool,
+    /// Units appended to the staging row, None until the row is created
+    pub staged: Option<usize>,
+}
+
+fn sequence_error(stmt: &mut Statement) -> SQLRETURN {
+    stmt.diagnostics.push(DiagRecord {
+        state: "HY010".to_string(),
+        native_error: 0,
+        message: "Function sequence error".to_string(),
+    });
+    SQL_ERROR
+}
+
+/// SQLParamData: finish the parameter being put and ask for the next one, or
+/// execute the statement once every data-at-execution parameter has its data
+pub fn param_data(stmt: &mut Statement, value_ptr_ptr: *mut SQLPOINTER) -> SQLRETURN {
+    if stmt.dae_sql.is_none() {
+        return sequence_error(stmt);
+    }
+    if stmt.dae_current_idx > 0 {
+        match finish(stmt) {
+            Ok(value) => {
+                let param = stmt.dae_current.param;
+                stmt.dae_collected.push((param, value));
+            }
+            Err(ret) => {
+                abandon(stmt);
+                return ret;
+            }
+        }
+    }
+
+    if stmt.dae_current_idx < stmt.dae_params_needed.len() {
+        let param_num = stmt.dae_params_needed[stmt.dae_current_idx];
+        stmt.dae_current_idx += 1;
+        let bound = stmt
+            .bound_params
+            .iter()
+            .find(|p| p.param_number == param_num);
+        let kind = match bound.map(crate::param_c_type) {
+            Some(SQL_C_WCHAR) => DaeKind::Wide,
+            Some(SQL_C_BINARY) => DaeKind::Binary,
+            _ => DaeKind::Narrow,
+        };
+        // The value pointer bound for the parameter tells the application
+        // which one to put
+        if let (Some(bp), false) = (bound, value_ptr_ptr.is_null()) {
+            unsafe { *value_ptr_ptr = bp.value_ptr };
+        }
+        stmt.dae_current = DaePut {
+            param: param_num,
+            kind,
+            ..DaePut::default()
+        };
+        return SQL_NEED_DATA;
+    }
+
+    let sql = stmt.dae_sql.take().unwrap();
+    let collected = std::mem::take(&mut stmt.dae_collected);
+    stmt.dae_params_needed.clear();
+    stmt.dae_current_idx = 0;
+    stmt.dae_current = DaePut::default();
+
+    // Staged values are read into variables passed to sp_executesql, and
+    // the staging rows are dropped before the statement runs
+    let mut prologue = String::new();
+    let key = staging_key(stmt);
+    let p = params::parameterize(&sql, |n| {
+        let param = stmt.bound_params.iter().find(|p| p.param_number == n)?;
+        let (literal, literal_len) = match collected.iter().find(|(c, _)| *c == n) {
+            Some((_, DaeValue::Null)) => ("NULL".to_string(), 0),
+            Some((_, DaeValue::Literal(l))) => (l.clone(), l.len()),
+            Some((_, DaeValue::Staged { kind, len })) => {
+                let (col, ty) = kind.column();
+                prologue.push_str(&format!(
+                    "DECLARE @D{n} {ty} = \
+                     (SELECT {col} FROM {STAGING_TABLE} WHERE s = {key} AND n = {n});\n"
+                ));
+                // Binary lengths are measured as hex constants
+                let len = if *kind == DaeKind::Binary {
+                    2 * len + 2
+                } else {
+                    *len
+                };
+                (format!("@D{}", n), len)
+            }
+            None => {
+                let l = crate::read_param_value(param);
+                let len = l.len();
+                (l, len)
+            }
+        };
+        let decl = params::param_type_decl(
+            param.parameter_type,
+            param.column_size,
+            param.decimal_digits,
+            literal_len,
+        );
+        Some((decl, literal))
+    });
+    if collected
+        .iter()
+        .any(|(_, v)| matches!(v, DaeValue::Staged { .. }))
+    {
+        prologue.push_str(&format!("DELETE FROM {STAGING_TABLE} WHERE s = {key};\n"));
+    }
+    stmt.bound_params.clear();
+    prologue.push_str(&params::executesql_call(&p));
+    execute::exec_direct(stmt, &prologue)
+}
+
+/// SQLPutData: add `len_or_ind` bytes at `data` to the current parameter,
+/// sending each full piece to its staging row as it fills
+pub fn put_data(stmt: &mut Statement, data: SQLPOINTER, len_or_ind: SQLLEN) -> SQLRETURN {
+    if stmt.dae_sql.is_none() || stmt.dae_current_idx == 0 {
+        return sequence_error(stmt);
+    }
+    let cur = &mut stmt.dae_current;
+    cur.started = true;
+    if data.is_null() || len_or_ind == SQL_NULL_DATA {
+        cur.null = true;
+        cur.buf.clear();
+        return SQL_SUCCESS;
+    }
+    let len = if len_or_ind == SQL_NTS as SQLLEN {
+        unsafe { nts_len(data, cur.kind) }
+    } else {
+        len_or_ind.max(0) as usize
+    };
+    let mut bytes = unsafe { std::slice::from_raw_parts(data as *const u8, len) };
+    loop {
+        let cur = &mut stmt.dae_current;
+        let room = FLUSH_BYTES.saturating_sub(cur.buf.len()).min(bytes.len());
+        cur.buf.extend_from_slice(&bytes[..room]);
+        bytes = &bytes[room..];
+        if cur.buf.len() < FLUSH_BYTES {
+            return SQL_SUCCESS;
+        }
+        if let Err(ret) = flush(stmt, false) {
+            abandon(stmt);
+            return ret;
+        }
+    }
+}
+
+/// Byte length of a null-terminated value, whose terminator is two bytes
+/// for wide text
+unsafe fn nts_len(data: SQLPOINTER, kind: DaeKind) -> usize {
+    let mut len = 0;
+    unsafe {
+        if kind == DaeKind::Wide {
+            let p = data as *const u16;
+            while p.add(len).read_unaligned() != 0 {
+                len += 1;
+            }
+            len * 2
+        } else {
+            let p = data as *const u8;
+            while *p.add(len) != 0 {
+                len += 1;
+            }
+            len
+        }
+    }
+}
+
+/// Drop a data-at-execution call in progress (SQLCancel, or an error while
+/// sending). Returns false if there was none.
+pub fn abandon(stmt: &mut Statement) -> bool {
+    if stmt.dae_sql.take().is_none() {
+        return false;
+    }
+    let staged = stmt.dae_current.staged.is_some()
+        || stmt
+            .dae_collected
+            .iter()
+            .any(|(_, v)| matches!(v, DaeValue::Staged { .. }));
+    stmt.dae_params_needed.clear();
+    stmt.dae_current_idx = 0;
+    stmt.dae_collected.clear();
+    stmt.dae_current = DaePut::default();
+    if staged {
+        // Best effort: a row left behind is replaced when its parameter is
+        // next staged
+        let mark = stmt.diagnostics.len();
+        let sql = format!(
+            "DELETE FROM {STAGING_TABLE} WHERE s = {}",
+            staging_key(stmt)
+        );
+        let _ = execute::exec_batch(stmt, &sql);
+        stmt.diagnostics.truncate(mark);
+    }
+    true
+}
+
+/// Value of the current parameter once all its data has been put
+fn finish(stmt: &mut Statement) -> Result<DaeValue, SQLRETURN> {
+    let cur = &stmt.dae_current;
+    if cur.null || !cur.started {
+        return Ok(DaeValue::Null);
+    }
+    if cur.staged.is_none() {
+        let param_type = stmt
+            .bound_params
+            .iter()
+            .find(|p| p.param_number == cur.param)
+            .map_or(SQL_WVARCHAR, |p| p.parameter_type);
+        return Ok(DaeValue::Literal(literal(param_type, cur.kind, &cur.buf)));
+    }
+    if !cur.buf.is_empty() {
+        flush(stmt, true)?;
+    }
+    let cur = &stmt.dae_current;
+    Ok(DaeValue::Staged {
+        kind: cur.kind,
+        len: cur.staged.unwrap_or(0),
+    })
+}
+
+/// Append the data put so far to the current parameter's staging row,
+/// creating the row on the first call. Unless `last`, a character split
+/// across SQLPutData calls is kept back for the next piece.
+fn flush(stmt: &mut Statement, last: bool) -> Result<(), SQLRETURN> {
+    let cur = &stmt.dae_current;
+    let take = if last {
+        cur.buf.len()
+    } else {
+        complete_len(cur.kind, &cur.buf)
+    };
+    let (constant, units) = encode(cur.kind, &cur.buf[..take]);
+    let (col, _) = cur.kind.column();
+    let n = cur.param;
+    let key = staging_key(stmt);
+    let sql = match cur.staged {
+        None => format!(
+            "IF OBJECT_ID('tempdb..{t}') IS NULL \
+             CREATE TABLE {t} (s bigint, n int, w nvarchar(max), b varbinary(max), \
+             PRIMARY KEY (s, n));\n\
+             DELETE FROM {t} WHERE s = {key} AND n = {n};\n\
+             INSERT INTO {t} (s, n, {col}) VALUES ({key}, {n}, {constant})",
+            t = STAGING_TABLE
+        ),
+        Some(_) => format!(
+            "UPDATE {} SET {col}.WRITE({constant}, NULL, 0) WHERE s = {key} AND n = {n}",
+            STAGING_TABLE
+        ),
+    };
+    drop(constant);
+    execute::exec_batch(stmt, &sql)?;
+    let cur = &mut stmt.dae_current;
+    cur.buf.drain(..take);
+    cur.staged = Some(cur.staged.unwrap_or(0) + units);
+    Ok(())
+}
+
+/// Length of the prefix of `buf` holding whole characters
+fn complete_len(kind: DaeKind, buf: &[u8]) -> usize {
+    match kind {
+        DaeKind::Binary => buf.len(),
+        DaeKind::Wide => {
+            let even = buf.len() & !1;
+            // Keep a high surrogate with the low one that follows it
+            match even
+                .checked_sub(2)
+                .map(|i| u16::from_le_bytes([buf[i], buf[i + 1]]))
+            {
+                Some(0xD800..=0xDBFF) => even - 2,
+                _ => even,
+            }
+        }
+        DaeKind::Narrow => match std::str::from_utf8(buf) {
+            Ok(_) => buf.len(),
+            Err(e) if e.error_len().is_none() => e.valid_up_to(),
+            Err(_) => buf.len(),
+        },
+    }
+}
+
+/// T-SQL constant for `data`, and its length in staging units
+fn encode(kind: DaeKind, data: &[u8]) -> (String, usize) {
+    match kind {
+        DaeKind::Binary => {
+            let mut s = String::with_capacity(2 + data.len() * 2);
+            s.push_str("0x");
+            for b in data {
+                s.push(HEX[(b >> 4) as usize] as char);
+                s.push(HEX[(b & 0xF) as usize] as char);
+            }
+            (s, data.len())
+        }
+        DaeKind::Wide => quote(utf16::decode_le(data).chars(), data.len() / 2),
+        DaeKind::Narrow => quote(String::from_utf8_lossy(data).chars(), data.len()),
+    }
+}
+
+const HEX: &[u8; 16] = b"0123456789ABCDEF";
+
+/// N'...' constant for `text`, sized for about `hint` characters
+fn quote(text: impl Iterator<Item = char>, hint: usize) -> (String, usize) {
+    let mut s = String::with_capacity(hint + 3);
+    let mut units = 0;
+    s.push_str("N'");
+    for ch in text {
+        if ch == '\'' {
+            s.push('\'');
+        }
+        s.push(ch);
+        units += ch.len_utf16();
+    }
+    s.push('\'');
+    (s, units)
+}
+
+/// T-SQL constant for a complete value short enough to go with the
+/// statement, in the form the parameter's SQL type expects
+fn literal(param_type: SQLSMALLINT, kind: DaeKind, data: &[u8]) -> String {
+    let (constant, _) = encode(kind, data);
+    if kind == DaeKind::Binary {
+        return constant;
+    }
+    let text = &constant[2..constant.len() - 1];
+    match param_type {
+        SQL_DOUBLE | SQL_FLOAT | SQL_REAL if !text.contains('\'') => {
+            match text.trim().parse::<f64>() {
+                Ok(v) => crate::format_float_literal(v),
+                Err(_) => constant,
+            }
+        }
+        SQL_INTEGER | SQL_SMALLINT | SQL_TINYINT | SQL_BIGINT | SQL_NUMERIC | SQL_DECIMAL
+        | SQL_BIT
+            if is_number(text) =>
+        {
+            text.trim().to_string()
+        }
+        _ => constant,
+    }
+}
+
+/// Whether `text` is a plain decimal number, safe to send unquoted
+fn is_number(text: &str) -> bool {
+    let t = text.trim();
+    let t = t.strip_prefix(['-', '+']).unwrap_or(t);
+    !t.is_empty()
+        && t.chars().any(|c| c.is_ascii_digit())
+        && t.chars().all(|c| c.is_ascii_digit() || c == '.')
+        && t.matches('.').count() <= 1
+}
@@ -16,14 +16,20 @@ pub fn get_diag_rec(
         return SQL_INVALID_HANDLE;
     }
 
+    let _lock;
     let diagnostics: &[DiagRecord] = match handle_type {
         SQL_HANDLE_ENV => return SQL_NO_DATA, // env has no diagnostics in our impl
         SQL_HANDLE_DBC => {
             let conn = unsafe { &*(handle as *const Connection) };
+            _lock = Some(conn.lock());
             &conn.diagnostics
         }
         SQL_HANDLE_STMT => {
             let stmt = unsafe { &*(handle as *const Statement) };
+            if crate::asyncexec::running(stmt) {
+                return SQL_NO_DATA;
+            }
+            _lock = stmt.lock();
             &stmt.diagnostics
         }
         _ => return SQL_INVALID_HANDLE,
@@ -1,60 +1,205 @@
 use crate::handle::*;
+use crate::params::{self, Parameterized};
+use crate::stream::{Attention, BusyGuard, Interrupt, TdsStream, Traffic};
 use crate::types::*;
+use std::borrow::Cow;
+use tabby::SyncClient;
+
+/// SQL Server error raised by sp_execute for an unknown prepared handle
+const ERR_PREPARED_HANDLE_NOT_FOUND: i32 = 8179;
+
+/// End the implicit transaction. The driver only knows a transaction was
+/// started, not that it is still open: the server rolls it back itself on
+/// some errors, and a batch that fails to compile never opens it.
+pub const COMMIT: &str = "IF @@TRANCOUNT > 0 COMMIT TRANSACTION";
+pub const ROLLBACK: &str = "IF @@TRANCOUNT > 0 ROLLBACK TRANSACTION";
+
+/// Common prologue for every request sent on the connection: drain any
+/// result stream still open on this statement and buffer those of the
+/// connection's other statements. The request itself goes through
+/// `in_transaction` so that, with autocommit off, it opens the transaction.
+fn begin_request(stmt: &mut Statement) -> SQLRETURN {
+    // If we were previously streaming, cancel the rest of the old result
+    if stmt.streaming {
+        close_stream(stmt);
+    }
 
-pub fn exec_direct(stmt: &mut Statement, sql: &str) -> SQLRETURN {
     let conn = unsafe { &mut *stmt.conn };
+    // An open bulk copy batch owns the wire until furball_bcp_batch/done,
+    // as does another statement's asynchronous call until it completes
+    let owner = if conn.bulk.as_ref().is_some_and(|b| b.in_batch()) {
+        Some("a bulk copy batch")
+    } else if crate::asyncexec::conn_busy(conn, stmt) {
+        Some("an asynchronous call")
+    } else {
+        None
+    };
+    if let Some(owner) = owner {
+        stmt.diagnostics.push(DiagRecord {
+            state: "HY010".to_string(),
+            native_error: 0,
+            message: format!("Connection is busy with {}", owner),
+        });
+        return SQL_ERROR;
+    }
+    // Before checking for the client, which a read-ahead thread may hold
+    buffer_other_streams(conn, stmt);
+    if conn.client.is_none() {
+        stmt.diagnostics.push(DiagRecord {
+            state: "08003".to_string(),
+            native_error: 0,
+            message: "Not connected".to_string(),
+        });
+        return SQL_ERROR;
+    }
 
-    let client = match conn.client.as_mut() {
-        Some(c) => c,
-        None => {
-            stmt.diagnostics.push(DiagRecord {
-                state: "08003".to_string(),
-                native_error: 0,
-                message: "Not connected".to_string(),
-            });
-            return SQL_ERROR;
-        }
+    SQL_SUCCESS
+}
+
+/// `sql`, preceded by the BEGIN TRANSACTION that opens the implicit
+/// transaction when autocommit is off and none is open. Sending it in the
+/// same batch saves the round trip of a request of its own. Also says
+/// whether the batch carries the BEGIN, for `settle_transaction` should it
+/// fail. A statement that must start its batch gets the BEGIN as a request
+/// of its own instead.
+fn in_transaction<'a>(conn: &mut Connection, sql: &'a str) -> Result<(Cow<'a, str>, bool), String> {
+    if conn.autocommit || conn.in_transaction {
+        return Ok((Cow::Borrowed(sql), false));
+    }
+    if must_start_batch(sql) {
+        ensure_transaction(conn)?;
+        return Ok((Cow::Borrowed(sql), false));
+    }
+    conn.in_transaction = true;
+    Ok((Cow::Owned(format!("BEGIN TRANSACTION;\n{}", sql)), true))
+}
+
+/// Whether `sql` begins with a statement the server only accepts first in
+/// its batch (Msg 111): CREATE or ALTER of a view, procedure, function or
+/// trigger, CREATE SCHEMA, DEFAULT or RULE
+fn must_start_batch(sql: &str) -> bool {
+    let mut words = sql
+        .split(|c: char| !c.is_ascii_alphabetic())
+        .filter(|w| !w.is_empty());
+    let is = |w: Option<&str>, k: &str| w.is_some_and(|w| w.eq_ignore_ascii_case(k));
+    let first = words.next();
+    let create = is(first, "create");
+    if !create && !is(first, "alter") {
+        return false;
+    }
+    let mut object = words.next();
+    if create && is(object, "or") {
+        // CREATE OR ALTER
+        words.next();
+        object = words.next();
+    }
+    let Some(object) = object else {
+        return false;
     };
+    let routine = ["view", "procedure", "proc", "function", "trigger"];
+    let create_only = ["schema", "default", "rule"];
+    routine.iter().any(|k| object.eq_ignore_ascii_case(k))
+        || (create && create_only.iter().any(|k| object.eq_ignore_ascii_case(k)))
+}
 
-    // If we were previously streaming, drain the old stream first
-    if stmt.streaming {
-        let _ = client.batch_drain();
-        stmt.streaming = false;
-    }
-
-    // If autocommit is OFF and we're not already in a transaction, start one
-    if !conn.autocommit && !conn.in_transaction {
-        let begin_result = {
-            let mut w = StringRowWriter::new();
-            client
-                .batch_into("BEGIN TRANSACTION", &mut w)
-                .map_err(|e| e.to_string())
-        };
-        if let Err(msg) = begin_result {
-            stmt.diagnostics.push(DiagRecord {
-                state: "HY000".to_string(),
-                native_error: 0,
-                message: format!("Failed to begin transaction: {}", msg),
-            });
-            return SQL_ERROR;
-        }
-        conn.in_transaction = true;
+/// A batch that carried the transaction's BEGIN failed. A compile error
+/// stops the BEGIN from running and a runtime one does not, so ask the
+/// server whether the transaction is open.
+fn settle_transaction(conn: &mut Connection) {
+    let Some(client) = conn.client.as_mut() else {
+        conn.in_transaction = false;
+        return;
+    };
+    let mut w = StringRowWriter::new();
+    let counted = client.batch_into("SELECT @@TRANCOUNT", &mut w).is_ok();
+    w.finalize();
+    let count = w.result_sets.last().and_then(|rs| rs.rows.cell(0, 0));
+    conn.in_transaction = counted && matches!(count, Some(Cell::I32(n)) if n > 0);
+}
+
+/// Report an error message from the server or client on `stmt`
+fn push_error(stmt: &mut Statement, msg: String) {
+    let (state, native) = map_sqlstate(&msg);
+    stmt.diagnostics.push(DiagRecord {
+        state,
+        native_error: native,
+        message: msg,
+    });
+}
+
+/// Move the results still streaming on the connection's statements, other
+/// than `except`, into memory so a new request can take the wire
+pub fn buffer_other_streams(conn: &Connection, except: *const Statement) {
+    let streaming: Vec<*mut Statement> = conn
+        .statements
+        .iter()
+        .copied()
+        .filter(|&s| !std::ptr::eq(s, except) && unsafe { (*s).streaming })
+        .collect();
+    for other in streaming {
+        crate::fetch::buffer_rest(unsafe { &mut *other });
     }
+}
 
-    let sql = sql.to_string();
+/// If autocommit is OFF and we're not already in a transaction, start one
+/// with a request of its own, for requests that must be alone in their
+/// batch (INSERT BULK)
+pub fn ensure_transaction(conn: &mut Connection) -> Result<(), String> {
+    if conn.autocommit || conn.in_transaction {
+        return Ok(());
+    }
+    let client = conn.client.as_mut().ok_or("Not connected")?;
+    let mut w = StringRowWriter::new();
+    client
+        .batch_into("BEGIN TRANSACTION", &mut w)
+        .map_err(|e| format!("Failed to begin transaction: {}", e))?;
+    conn.in_transaction = true;
+    Ok(())
+}
+
+pub fn exec_direct(stmt: &mut Statement, sql: &str) -> SQLRETURN {
+    let ret = begin_request(stmt);
+    if ret != SQL_SUCCESS {
+        return ret;
+    }
+    crate::stats::start(stmt, sql);
+    let conn = unsafe { &mut *stmt.conn };
+    crate::catalog::note_statement(conn, sql);
+    let (sql, begins) = match in_transaction(conn, sql) {
+        Ok((sql, begins)) => (sql.into_owned(), begins),
+        Err(msg) => {
+            push_error(stmt, msg);
+            crate::stats::finish(stmt);
+            return SQL_ERROR;
+        }
+    };
+    let client = conn.client.as_mut().expect("checked in begin_request");
 
     // Use streaming API: send query, read only until metadata
     let mut rows_affected = 0u64;
+    let busy = busy(stmt, true);
     let result = client
         .batch_start_with_rowcount(&sql, &mut rows_affected)
         .map_err(|e| e.to_string());
+    busy.end(stmt);
+    if check_interrupt(stmt) {
+        if begins {
+            settle_transaction(conn);
+        }
+        crate::stats::finish(stmt);
+        return SQL_ERROR;
+    }
+    if begins && result.is_err() {
+        settle_transaction(conn);
+    }
 
-    match result {
+    let ret = match result {
         Ok(columns) => {
             if columns.is_empty() {
                 // No result set (DML statement) — the stream is already done
-                stmt.columns = Vec::new();
-                stmt.rows = Vec::new();
+                stmt.columns = Columns::default();
+                stmt.rows.clear();
+                stmt.spilled = None;
                 stmt.row_count = if rows_affected == 0 {
                     -1
                 } else {
@@ -65,51 +210,316 @@ pub fn exec_direct(stmt: &mut Statement, sql: &str) -> SQLRETURN {
                 stmt.streaming = false;
                 stmt.read_offsets.clear();
                 stmt.pending_result_sets.clear();
-                stmt.current_row.clear();
-                stmt.prefetch_buffer.clear();
                 stmt.prefetch_done = None;
             } else {
                 // Has result set — set up columns, enable streaming
-                stmt.columns = columns
-                    .iter()
-                    .map(|c| {
-                        let (sql_type, size, decimal_digits, nullable) = sql_type_from_column(c);
-                        ColumnDesc {
-                            name: c.name().to_string(),
-                            sql_type,
-                            size,
-                            decimal_digits,
-                            nullable,
-                        }
-                    })
-                    .collect();
-                stmt.rows = Vec::new(); // no rows buffered
+                stmt.columns = conn.column_cache.get(&columns);
+                stmt.rows.clear(); // no rows buffered
+                stmt.spilled = None;
                 stmt.row_count = -1;
                 stmt.row_index = -1;
                 stmt.executed = true;
                 stmt.streaming = true;
+                crate::fetch::reset_prefetch(stmt);
                 stmt.read_offsets.clear();
                 stmt.pending_result_sets.clear();
-                stmt.current_row.clear();
-                stmt.prefetch_buffer.clear();
                 stmt.prefetch_done = None;
             }
             SQL_SUCCESS
         }
         Err(msg) => {
-            let (state, native) = map_sqlstate(&msg);
-            stmt.diagnostics.push(DiagRecord {
-                state,
-                native_error: native,
-                message: msg.clone(),
-            });
+            push_error(stmt, msg);
             SQL_ERROR
         }
+    };
+    if !stmt.streaming {
+        // No result set to fetch
+        crate::stats::finish(stmt);
+    }
+    ret
+}
+
+/// Execute a prepared statement through its server-side handle, preparing it
+/// on first use. Statements the server refuses to prepare are run through
+/// sp_executesql instead, which reports any real error in the statement.
+pub fn exec_prepared(stmt: &mut Statement, p: &Parameterized) -> SQLRETURN {
+    let handle = match prepared_handle(stmt, p) {
+        Ok(Some(h)) => h,
+        Ok(None) => return exec_direct(stmt, &params::executesql_call(p)),
+        Err(ret) => return ret,
+    };
+    let mark = stmt.diagnostics.len();
+    let ret = exec_direct(stmt, &params::execute_call(handle, p));
+    let lost = stmt.diagnostics[mark..]
+        .iter()
+        .any(|d| d.native_error == ERR_PREPARED_HANDLE_NOT_FOUND);
+    if ret != SQL_ERROR || !lost {
+        return ret;
+    }
+    // The server dropped the handle behind our back: prepare again once
+    stmt.diagnostics.truncate(mark);
+    let conn = unsafe { &mut *stmt.conn };
+    conn.prepared.remove(&p.cache_key());
+    match prepared_handle(stmt, p) {
+        Ok(Some(h)) => exec_direct(stmt, &params::execute_call(h, p)),
+        Ok(None) => exec_direct(stmt, &params::executesql_call(p)),
+        Err(ret) => ret,
+    }
+}
+
+/// Look up or create the server-side handle for `p` in the connection's
+/// prepared statement cache. Returns Ok(None), leaving no diagnostics, when
+/// the statement cannot be prepared, and Err when the request was cancelled
+/// or timed out.
+pub fn prepared_handle(stmt: &mut Statement, p: &Parameterized) -> Result<Option<i32>, SQLRETURN> {
+    let key = p.cache_key();
+    let conn = unsafe { &mut *stmt.conn };
+    if let Some(h) = conn.prepared.get(&key) {
+        return Ok(Some(h));
+    }
+
+    let mark = stmt.diagnostics.len();
+    if begin_request(stmt) != SQL_SUCCESS {
+        stmt.diagnostics.truncate(mark);
+        return Ok(None);
+    }
+    let conn = unsafe { &mut *stmt.conn };
+    conn.prepared.reserve();
+    // The queued unprepares stay queued until a batch carrying them succeeds
+    let sql = params::prepare_call(p, &conn.prepared.evicted);
+    let Ok((sql, begins)) = in_transaction(conn, &sql) else {
+        return Ok(None);
+    };
+    let Some(client) = conn.client.as_mut() else {
+        return Ok(None);
+    };
+
+    let mut w = StringRowWriter::new();
+    let busy = busy(stmt, true);
+    let result = client.batch_into(&sql, &mut w);
+    busy.end(stmt);
+    let interrupted = check_interrupt(stmt);
+    if begins && (interrupted || result.is_err()) {
+        settle_transaction(conn);
+    }
+    if interrupted {
+        return Err(SQL_ERROR);
+    }
+    w.finalize();
+    let handle = w.result_sets.last().and_then(|rs| rs.rows.cell(0, 0));
+    match (result, handle) {
+        (Ok(_), Some(Cell::I32(h))) => {
+            conn.prepared.evicted.clear();
+            conn.prepared.insert(key, h);
+            Ok(Some(h))
+        }
+        _ => Ok(None),
+    }
+}
+
+/// Run a batch that is not expected to produce a cursor (array-bound DML)
+/// and return the total row count reported by its DONE tokens. Any result
+/// sets the batch does return are discarded.
+pub fn exec_batch(stmt: &mut Statement, sql: &str) -> Result<u64, SQLRETURN> {
+    let w = run_buffered(stmt, sql)?;
+    Ok(w.done_rows + w.result_sets.iter().map(|r| r.done_rows).sum::<u64>())
+}
+
+/// Run a query and read its first result set into memory
+pub fn exec_result(stmt: &mut Statement, sql: &str) -> Result<ResultSet, SQLRETURN> {
+    let mut w = run_buffered(stmt, sql)?;
+    Ok(if w.result_sets.is_empty() {
+        ResultSet {
+            columns: Columns::default(),
+            rows: Default::default(),
+            spill: None,
+            done_rows: w.done_rows,
+        }
+    } else {
+        w.result_sets.swap_remove(0)
+    })
+}
+
+/// Run a batch, reading its whole reply into memory
+pub fn run_buffered(stmt: &mut Statement, sql: &str) -> Result<StringRowWriter, SQLRETURN> {
+    let ret = begin_request(stmt);
+    if ret != SQL_SUCCESS {
+        return Err(ret);
+    }
+    let conn = unsafe { &mut *stmt.conn };
+    crate::catalog::note_statement(conn, sql);
+    let (sql, begins) = match in_transaction(conn, sql) {
+        Ok(sql) => sql,
+        Err(msg) => {
+            push_error(stmt, msg);
+            return Err(SQL_ERROR);
+        }
+    };
+    let client = conn.client.as_mut().expect("checked in begin_request");
+
+    let mut w = StringRowWriter::new();
+    let busy = busy(stmt, true);
+    let result = client.batch_into(&sql, &mut w);
+    busy.end(stmt);
+    let interrupted = check_interrupt(stmt);
+    if begins && (interrupted || result.is_err()) {
+        settle_transaction(conn);
+    }
+    if interrupted {
+        return Err(SQL_ERROR);
     }
+    match result {
+        Ok(_) => {
+            w.finalize();
+            Ok(w)
+        }
+        Err(e) => {
+            push_error(stmt, e.to_string());
+            Err(SQL_ERROR)
+        }
+    }
+}
+
+/// Make `rs`, already in memory, the statement's result, as if a query had
+/// just returned it
+pub fn set_result(stmt: &mut Statement, rs: ResultSet) -> SQLRETURN {
+    if stmt.streaming {
+        close_stream(stmt);
+    }
+    stmt.columns = rs.columns;
+    stmt.rows = rs.rows;
+    stmt.spilled = rs.spill.map(crate::spill::SpillReader::new);
+    stmt.row_count = -1;
+    stmt.row_index = -1;
+    stmt.executed = true;
+    stmt.streaming = false;
+    stmt.buffered = false;
+    stmt.read_offsets.clear();
+    stmt.pending_result_sets.clear();
+    stmt.prefetch_done = None;
+    SQL_SUCCESS
+}
+
+/// Mark the start of a call into the client that waits on the server, so
+/// SQLCancel and SQL_ATTR_QUERY_TIMEOUT can interrupt it.
+pub fn busy(stmt: &Statement, new_request: bool) -> Busy {
+    let conn = unsafe { &*stmt.conn };
+    Busy {
+        guard: conn.attention.as_ref().map(|a| {
+            a.begin(
+                stmt as *const Statement as usize,
+                stmt.query_timeout,
+                new_request,
+            )
+        }),
+        traffic: crate::stats::traffic(stmt),
+    }
+}
+
+/// A call into the client on behalf of a statement, from `busy` until `end`
+pub struct Busy {
+    guard: Option<BusyGuard>,
+    traffic: Traffic,
+}
+
+impl Busy {
+    /// The call has returned: clear the busy state and charge the traffic
+    /// to the statement
+    pub fn end(self, stmt: &mut Statement) {
+        drop(self.guard);
+        crate::stats::add_traffic(stmt, self.traffic);
+    }
+}
+
+/// Called after a call into the client returns. If the request was cancelled
+/// or timed out, read the rest of the reply up to the attention
+/// acknowledgement, close the statement's result and report HY008 / HYT00.
+pub fn check_interrupt(stmt: &mut Statement) -> bool {
+    let conn = unsafe { &mut *stmt.conn };
+    let Some(attention) = conn.attention.clone() else {
+        return false;
+    };
+    if !attention.pending() {
+        return false;
+    }
+    if let Some(client) = conn.client.as_mut() {
+        let _ = client.batch_drain();
+    }
+    let synced = attention.wait_ack().is_ok();
+    let (state, message) = match attention.finish() {
+        Some(Interrupt::TimedOut) => ("HYT00", "Query timeout expired"),
+        _ => ("HY008", "Operation canceled"),
+    };
+    if !synced {
+        // Lost track of the reply: the session is unusable
+        conn.client = None;
+        conn.attention = None;
+        conn.connected = false;
+    }
+    stmt.streaming = false;
+    stmt.rows.clear();
+    stmt.spilled = None;
+    stmt.prefetch_done = None;
+    stmt.diagnostics.push(DiagRecord {
+        state: state.to_string(),
+        native_error: 0,
+        message: message.to_string(),
+    });
+    true
+}
+
+/// Abandon the result stream still open on a statement. The server is told
+/// to stop with an attention signal, so closing a cursor early costs one
+/// round trip instead of reading the rest of the result. An encrypted
+/// session reads the rest.
+pub fn close_stream(stmt: &mut Statement) {
+    stmt.streaming = false;
+    let partitioned = crate::partition::close(stmt);
+    let stopped = crate::fetch::stop_read_ahead(stmt);
+    let reply_complete = matches!(
+        stmt.prefetch_done.as_ref().or(stopped.as_ref()),
+        Some(PrefetchTerminal::Done)
+    );
+    stmt.rows.clear();
+    stmt.spilled = None;
+    stmt.prefetch_done = None;
+    // A partitioned extract reads on sessions of its own
+    if reply_complete || stmt.buffered || partitioned {
+        return;
+    }
+    let conn = unsafe { &mut *stmt.conn };
+    let Some(client) = conn.client.as_mut() else {
+        return;
+    };
+    let Some(attention) = conn.attention.clone() else {
+        let _ = client.batch_drain();
+        return;
+    };
+    if !abandon_reply(client, &attention) {
+        conn.client = None;
+        conn.attention = None;
+        conn.connected = false;
+    }
+}
+
+/// Stop the reply still coming in on `client` with an attention signal and
+/// read up to its acknowledgement, or on an encrypted session, which cannot
+/// signal, read the rest of the reply. Returns false if the session lost
+/// track of the reply and is unusable.
+pub fn abandon_reply(client: &mut SyncClient<TdsStream>, attention: &Attention) -> bool {
+    if !attention.can_signal() {
+        return client.batch_drain().is_ok();
+    }
+    let synced = attention.send().is_ok() && {
+        let _ = client.batch_drain();
+        attention.wait_ack().is_ok()
+    };
+    attention.finish();
+    synced
 }
 
 /// Parse SQL Server error number from error message and map to SQLSTATE
-fn map_sqlstate(msg: &str) -> (String, i32) {
+pub fn map_sqlstate(msg: &str) -> (String, i32) {
     let native = extract_error_number(msg);
     let state = match native {
         2627 | 2601 | 547 => "23000",
@@ -1,197 +1,805 @@
+use crate::batch::RowBatch;
 use crate::handle::*;
+use crate::readahead::{Message, ReadAhead};
+use crate::spill::{Spill, SpillReader, SEGMENT_BYTES};
+use crate::stream::TdsStream;
 use crate::types::*;
+use crate::utf16;
 use std::ptr;
-use tabby::BatchFetchResult;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+use std::time::Instant;
+use tabby::{BatchFetchResult, SyncClient};
 
-/// Single-row writer that appends values to a Vec<CellValue>
-struct SingleRowWriter<'a> {
-    row: &'a mut Vec<CellValue>,
-    info_messages: Vec<(u32, String)>,
+/// Writer that appends each row tabby decodes to a row batch
+pub struct SingleRowWriter<'a> {
+    pub rows: &'a mut RowBatch,
+    pub info_messages: Vec<(u32, String)>,
 }
 
 impl<'a> tabby::RowWriter for SingleRowWriter<'a> {
     fn write_null(&mut self, _col: usize) {
-        self.row.push(CellValue::Null);
+        self.rows.push(Cell::Null);
     }
     fn write_bool(&mut self, _col: usize, val: bool) {
-        self.row.push(CellValue::Bool(val));
+        self.rows.push(Cell::Bool(val));
     }
     fn write_u8(&mut self, _col: usize, val: u8) {
-        self.row.push(CellValue::U8(val));
+        self.rows.push(Cell::U8(val));
     }
     fn write_i16(&mut self, _col: usize, val: i16) {
-        self.row.push(CellValue::I16(val));
+        self.rows.push(Cell::I16(val));
     }
     fn write_i32(&mut self, _col: usize, val: i32) {
-        self.row.push(CellValue::I32(val));
+        self.rows.push(Cell::I32(val));
     }
     fn write_i64(&mut self, _col: usize, val: i64) {
-        self.row.push(CellValue::I64(val));
+        self.rows.push(Cell::I64(val));
     }
     fn write_f32(&mut self, _col: usize, val: f32) {
-        self.row.push(CellValue::F32(val));
+        self.rows.push(Cell::F32(val));
     }
     fn write_f64(&mut self, _col: usize, val: f64) {
-        self.row.push(CellValue::F64(val));
+        self.rows.push(Cell::F64(val));
     }
     fn write_str(&mut self, _col: usize, val: &str) {
-        self.row.push(CellValue::String(val.to_string()));
+        self.rows.push(Cell::Str(val));
     }
     fn write_utf16(&mut self, _col: usize, val: &[u16]) {
-        self.row
-            .push(CellValue::String(String::from_utf16_lossy(val)));
+        self.rows.push_utf16(val);
     }
     fn write_bytes(&mut self, _col: usize, val: &[u8]) {
-        self.row.push(CellValue::Bytes(val.to_vec()));
+        self.rows.push(Cell::Bytes(val));
     }
     fn write_date(&mut self, _col: usize, days: i32) {
-        self.row.push(CellValue::Date { days });
+        self.rows.push(Cell::Date { days });
     }
     fn write_time(&mut self, _col: usize, nanos: i64) {
-        self.row.push(CellValue::Time { nanos });
+        self.rows.push(Cell::Time { nanos });
     }
     fn write_datetime(&mut self, _col: usize, micros: i64) {
-        self.row.push(CellValue::DateTime { micros });
+        self.rows.push(Cell::DateTime { micros });
     }
     fn write_datetimeoffset(&mut self, _col: usize, micros: i64, offset_minutes: i16) {
-        self.row.push(CellValue::DateTimeOffset {
+        self.rows.push(Cell::DateTimeOffset {
             micros,
             offset_min: offset_minutes,
         });
     }
     fn write_decimal(&mut self, _col: usize, value: i128, precision: u8, scale: u8) {
-        self.row.push(CellValue::Decimal {
+        self.rows.push(Cell::Decimal {
             value,
             precision,
             scale,
         });
     }
     fn write_guid(&mut self, _col: usize, bytes: &[u8; 16]) {
-        self.row.push(CellValue::Guid(*bytes));
+        self.rows.push(Cell::Guid(*bytes));
     }
     fn on_info(&mut self, number: u32, message: &str) {
         self.info_messages.push((number, message.to_string()));
     }
 }
 
+/// Read-ahead budget when neither SQL_ATTR_FB_PREFETCH_BYTES nor the
+/// PrefetchBytes keyword sets one
+pub const DEFAULT_PREFETCH_BYTES: usize = 4 << 20;
+/// Initial rows per refill of a new result set, and the bounds the adaptive
+/// target stays within. The byte budget still cuts a refill short, but a
+/// refill always completes the rowset being fetched.
+pub const PREFETCH_ROWS: usize = 256;
+const PREFETCH_MIN_ROWS: usize = 16;
+const PREFETCH_MAX_ROWS: usize = 65536;
+
 pub fn fetch(stmt: &mut Statement) -> SQLRETURN {
     if !stmt.executed {
         return SQL_ERROR;
     }
+    if stmt.cursor.is_some() {
+        return crate::cursor::fetch_scroll(stmt, SQL_FETCH_NEXT, 0);
+    }
+    fetch_rowset(stmt)
+}
 
+/// Move to the next rowset of the rows in `stmt.rows` or on the wire and
+/// write it to the bound columns
+pub fn fetch_rowset(stmt: &mut Statement) -> SQLRETURN {
     // Reset read offsets on each new row
     stmt.read_offsets.clear();
 
+    let mut ret = next_rowset(stmt, stmt.row_array_size.max(1));
+    if stmt.rowset_len == 0 {
+        set_rows_fetched(stmt, 0);
+        crate::stats::finish(stmt);
+        return ret;
+    }
+    crate::stats::rows(stmt, stmt.rowset_len);
+    if write_rowset(stmt) && ret == SQL_SUCCESS {
+        ret = SQL_SUCCESS_WITH_INFO;
+    }
+    ret
+}
+
+/// Move to the next rowset of up to `array_size` rows, refilling from the
+/// wire while streaming, and leave it in `stmt.rows` at `row_index` for
+/// `rowset_len` rows. Returns SQL_NO_DATA (with an empty rowset) past the
+/// end of the result set.
+pub fn next_rowset(stmt: &mut Statement, array_size: usize) -> SQLRETURN {
+    let mut ret = SQL_SUCCESS;
+
     if stmt.streaming {
-        // If prefetch buffer is empty and no terminal state, fill it
-        if stmt.prefetch_buffer.is_empty() && stmt.prefetch_done.is_none() {
-            let conn = unsafe { &mut *stmt.conn };
-            let client = match conn.client.as_mut() {
-                Some(c) => c,
-                None => return SQL_ERROR,
+        // stmt.rows holds the current rowset followed by the rows read ahead
+        let mut start = if stmt.row_index < 0 {
+            0
+        } else {
+            stmt.row_index as usize + stmt.rowset_len
+        };
+        if stmt.rows.len() - start < array_size && stmt.spilled.is_some() {
+            if !unspill(stmt, start, array_size) {
+                return SQL_ERROR;
+            }
+            start = 0;
+        }
+        if stmt.rows.len() - start < array_size && stmt.prefetch_done.is_none() {
+            // Drop the rows already returned and refill behind the rest
+            stmt.rows.discard_front(start);
+            start = 0;
+            if stmt.lob_rows {
+                release_lob_buffers(stmt);
+            }
+            let refilled = if stmt.partitioned.is_some() {
+                crate::partition::receive(stmt, array_size)
+            } else if stmt.reader.is_some() {
+                receive(stmt, array_size)
+            } else {
+                prefetch(stmt, array_size)
             };
-
-            let mut row_buf = Vec::new();
-            let mut info_msgs = Vec::new();
-            let string_buf = &mut stmt.stream_string_buf;
-            let bytes_buf = &mut stmt.stream_bytes_buf;
-            let prefetch_buffer = &mut stmt.prefetch_buffer;
-
-            let terminal = {
-                let mut result = None;
-                for _ in 0..256 {
-                    row_buf.clear();
-                    let mut writer = SingleRowWriter {
-                        row: &mut row_buf,
-                        info_messages: Vec::new(),
-                    };
-                    match client.batch_fetch_row(&mut writer, string_buf, bytes_buf) {
-                        Ok(BatchFetchResult::Row) => {
-                            info_msgs.extend(writer.info_messages);
-                            prefetch_buffer.push_back(std::mem::take(&mut row_buf));
-                        }
-                        Ok(BatchFetchResult::Done(_)) => {
-                            info_msgs.extend(writer.info_messages);
-                            result = Some(PrefetchTerminal::Done);
-                            break;
-                        }
-                        Ok(BatchFetchResult::MoreResults) => {
-                            info_msgs.extend(writer.info_messages);
-                            result = Some(PrefetchTerminal::MoreResults);
-                            break;
-                        }
-                        Err(e) => {
-                            info_msgs.extend(writer.info_messages);
-                            result = Some(PrefetchTerminal::Error(e.to_string()));
-                            break;
-                        }
-                    }
-                }
-                result
+            if !refilled {
+                stmt.row_index = -1;
+                stmt.rowset_len = 0;
+                return SQL_ERROR;
+            }
+        }
+        let n = std::cmp::min(array_size, stmt.rows.len() - start);
+        // Result set exhausted within this rowset. After MoreResults the
+        // reply stays open for SQLMoreResults.
+        if n < array_size && !matches!(stmt.prefetch_done, Some(PrefetchTerminal::MoreResults)) {
+            stmt.streaming = false;
+            if let Some(PrefetchTerminal::Error(msg)) = stmt.prefetch_done.take() {
+                stmt.diagnostics.push(DiagRecord {
+                    state: "HY000".to_string(),
+                    native_error: 0,
+                    message: msg,
+                });
+                ret = SQL_ERROR;
+            }
+        }
+        if n == 0 {
+            stmt.rows.discard_front(start);
+            stmt.row_index = -1;
+            stmt.rowset_len = 0;
+            return if ret == SQL_ERROR {
+                SQL_ERROR
+            } else {
+                SQL_NO_DATA
             };
+        }
+        if ret == SQL_ERROR {
+            // Partial rowset: rows before the error are still valid
+            ret = SQL_SUCCESS_WITH_INFO;
+        }
+        stmt.row_index = start as isize;
+        stmt.rowset_len = n;
+    } else {
+        // Non-streaming mode (buffered rows from pending_result_sets, or legacy)
+        let mut start = if stmt.row_index < 0 {
+            0
+        } else {
+            stmt.row_index as usize + stmt.rowset_len.max(1)
+        };
+        if stmt.rows.len().saturating_sub(start) < array_size && stmt.spilled.is_some() {
+            if !unspill(stmt, start, array_size) {
+                return SQL_ERROR;
+            }
+            start = 0;
+        }
+        if start >= stmt.rows.len() {
+            stmt.row_index = stmt.rows.len() as isize;
+            stmt.rowset_len = 0;
+            return SQL_NO_DATA;
+        }
+        stmt.row_index = start as isize;
+        stmt.rowset_len = std::cmp::min(array_size, stmt.rows.len() - start);
+    }
+    ret
+}
 
-            // Transfer info messages
-            for (number, message) in info_msgs {
+/// Drop the rows of `stmt.rows` before `start` and read the spilled ones
+/// after them back in, until it holds `rowset` rows or the spill is used up.
+/// Returns false, with the rowset emptied, if the spill file could not be
+/// read.
+fn unspill(stmt: &mut Statement, start: usize, rowset: usize) -> bool {
+    stmt.rows.discard_front(start);
+    while stmt.rows.len() < rowset {
+        let Some(reader) = stmt.spilled.as_mut() else {
+            break;
+        };
+        match reader.load_next(&mut stmt.rows) {
+            Ok(true) => {}
+            Ok(false) => stmt.spilled = None,
+            Err(e) => {
+                stmt.spilled = None;
+                stmt.rows.clear();
+                stmt.row_index = -1;
+                stmt.rowset_len = 0;
                 stmt.diagnostics.push(DiagRecord {
-                    state: "01000".to_string(),
-                    native_error: number as i32,
-                    message,
+                    state: "HY000".to_string(),
+                    native_error: 0,
+                    message: format!("Could not read back buffered rows: {}", e),
                 });
+                return false;
             }
+        }
+    }
+    true
+}
 
-            stmt.prefetch_done = terminal;
+/// Forget what prefetch learned about the previous result set, and start
+/// the read-ahead thread for the new one if the statement asks for it. A
+/// result set with LOB columns is read one rowset at a time instead: each
+/// row may be as large as its values, so reading ahead only holds memory.
+pub fn reset_prefetch(stmt: &mut Statement) {
+    stmt.buffered = false;
+    stmt.prefetch_rows = PREFETCH_ROWS;
+    stmt.prefetch_refilled = None;
+    stmt.lob_rows = stmt.columns.iter().any(ColumnDesc::is_lob);
+    if !stmt.read_ahead || stmt.lob_rows || stmt.reader.is_some() || stmt.partitioned.is_some() {
+        return;
+    }
+    let conn = unsafe { &mut *stmt.conn };
+    let Some(client) = conn.client.take() else {
+        return;
+    };
+    stmt.reader_traffic = crate::stats::traffic(stmt);
+    stmt.reader = Some(ReadAhead::start(
+        client,
+        conn.attention.clone(),
+        stmt as *const Statement as usize,
+        stmt.query_timeout,
+        stmt.prefetch_rows,
+        stmt.prefetch_bytes,
+        stmt.wide_cols.clone(),
+    ));
+}
+
+/// Decode rows from `client` onto the end of `writer`'s batch until it
+/// holds `min_rows`, then on until `target` rows or `budget` bytes. Returns
+/// how the result set ended, or None if it continues.
+pub fn read_rows(
+    client: &mut SyncClient<TdsStream>,
+    writer: &mut SingleRowWriter<'_>,
+    string_buf: &mut String,
+    bytes_buf: &mut Vec<u8>,
+    min_rows: usize,
+    target: usize,
+    budget: usize,
+) -> Option<PrefetchTerminal> {
+    while writer.rows.len() < min_rows
+        || (writer.rows.len() < target && writer.rows.data_bytes() < budget)
+    {
+        match client.batch_fetch_row(writer, string_buf, bytes_buf) {
+            Ok(BatchFetchResult::Row) => writer.rows.finish_row(),
+            Ok(BatchFetchResult::Done(_)) => return Some(PrefetchTerminal::Done),
+            Ok(BatchFetchResult::MoreResults) => return Some(PrefetchTerminal::MoreResults),
+            Err(e) => {
+                writer.rows.discard_partial_row();
+                return Some(PrefetchTerminal::Error(e.to_string()));
+            }
         }
+    }
+    None
+}
 
-        // Pop from buffer
-        match stmt.prefetch_buffer.pop_front() {
-            Some(row) => {
-                stmt.rows.clear();
-                stmt.rows.push(row);
-                stmt.row_index = 0;
-                SQL_SUCCESS
+/// Read rows from the wire onto the end of `stmt.rows`, recording how the
+/// result set ended (if it did) in `prefetch_done`. A refill stops at the
+/// adaptive row target or the byte budget, whichever comes first, but not
+/// before the batch holds `rowset` rows. Returns false if the request was
+/// cancelled or timed out.
+fn prefetch(stmt: &mut Statement, rowset: usize) -> bool {
+    let conn = unsafe { &mut *stmt.conn };
+    let Some(client) = conn.client.as_mut() else {
+        stmt.prefetch_done = Some(PrefetchTerminal::Error("Not connected".to_string()));
+        return true;
+    };
+
+    let started = Instant::now();
+    let target = if stmt.lob_rows {
+        rowset
+    } else {
+        stmt.prefetch_rows.max(rowset)
+    };
+    let budget = stmt.prefetch_bytes;
+    let busy = crate::execute::busy(stmt, false);
+    stmt.rows.set_wide(stmt.wide_cols.load(Ordering::Relaxed));
+    let capacity = stmt.rows.capacity();
+    let mut writer = SingleRowWriter {
+        rows: &mut stmt.rows,
+        info_messages: Vec::new(),
+    };
+    let terminal = read_rows(
+        client,
+        &mut writer,
+        &mut stmt.stream_string_buf,
+        &mut stmt.stream_bytes_buf,
+        rowset,
+        target,
+        budget,
+    );
+    let info_msgs = writer.info_messages;
+    busy.end(stmt);
+    let grew = stmt.rows.capacity() > capacity;
+    crate::stats::count(stmt, |s| {
+        s.prefetch_refills += 1;
+        s.prefetch_stalls += 1;
+        s.buffer_grows += grew as u64;
+    });
+    if crate::execute::check_interrupt(stmt) {
+        return false;
+    }
+    push_info(stmt, info_msgs);
+
+    if terminal.is_none() && !stmt.rows.is_empty() {
+        // A consumer that drained the last block faster than the wire
+        // refilled it gets bigger blocks (fewer trips through the row loop);
+        // one that is much slower gets smaller ones, as reading further
+        // ahead only holds memory.
+        let fill = started.elapsed();
+        let grow = stmt.prefetch_refilled.and_then(|refilled| {
+            let drain = started.duration_since(refilled);
+            if drain < fill {
+                Some(true)
+            } else if drain > fill * 4 {
+                Some(false)
+            } else {
+                None
             }
-            None => {
-                // Buffer empty — handle terminal state
-                match stmt.prefetch_done.take() {
-                    Some(PrefetchTerminal::Done) => {
-                        stmt.streaming = false;
-                        SQL_NO_DATA
-                    }
-                    Some(PrefetchTerminal::MoreResults) => {
-                        stmt.streaming = false;
-                        SQL_NO_DATA
-                    }
-                    Some(PrefetchTerminal::Error(msg)) => {
-                        stmt.streaming = false;
-                        stmt.diagnostics.push(DiagRecord {
-                            state: "HY000".to_string(),
-                            native_error: 0,
-                            message: msg,
-                        });
-                        SQL_ERROR
-                    }
-                    None => SQL_NO_DATA,
+        });
+        let row_bytes = stmt.rows.data_bytes() / stmt.rows.len();
+        stmt.prefetch_rows = resize_target(stmt.prefetch_rows, grow, row_bytes, budget);
+    }
+    stmt.prefetch_done = terminal;
+    stmt.prefetch_refilled = Some(Instant::now());
+    true
+}
+
+/// Give back what the row batch and decode buffers grew to beyond the
+/// prefetch budget for values already returned, so a statement reading
+/// LOBs holds about one rowset of them at a time
+fn release_lob_buffers(stmt: &mut Statement) {
+    let keep = stmt.prefetch_bytes;
+    stmt.rows.shrink_to(keep);
+    if stmt.stream_string_buf.capacity() > keep {
+        stmt.stream_string_buf = String::with_capacity(4096);
+    }
+    if stmt.stream_bytes_buf.capacity() > keep {
+        stmt.stream_bytes_buf = Vec::with_capacity(4096);
+    }
+}
+
+/// Next refill size: doubled or halved as `grow` says, and never more than
+/// the byte budget fits at the observed row size.
+pub fn resize_target(target: usize, grow: Option<bool>, row_bytes: usize, budget: usize) -> usize {
+    let target = match grow {
+        Some(true) => target.saturating_mul(2),
+        Some(false) => target / 2,
+        None => target,
+    };
+    target
+        .min(budget / row_bytes.max(1))
+        .clamp(PREFETCH_MIN_ROWS, PREFETCH_MAX_ROWS)
+}
+
+/// Take blocks from the read-ahead thread onto the end of `stmt.rows` until
+/// it holds `rowset` rows or the result set ends; at the end the client goes
+/// back to the connection. Returns false if the request was cancelled or
+/// timed out.
+fn receive(stmt: &mut Statement, rowset: usize) -> bool {
+    while stmt.rows.len() < rowset {
+        let Some(reader) = stmt.reader.as_ref() else {
+            break;
+        };
+        let (msg, stalled) = reader.recv();
+        let grows = reader.buffer_grows();
+        match msg {
+            Message::Rows(block, info) => {
+                crate::stats::count(stmt, |s| {
+                    s.prefetch_refills += 1;
+                    s.prefetch_stalls += stalled as u64;
+                    s.buffer_grows += grows;
+                });
+                let reader = stmt.reader.as_ref().unwrap();
+                if stmt.rows.is_empty() {
+                    // Usual case: the whole rowset comes from one block
+                    let spent = std::mem::replace(&mut stmt.rows, block);
+                    reader.recycle(spent);
+                } else {
+                    stmt.rows.append(&block);
+                    reader.recycle(block);
+                }
+                push_info(stmt, info);
+            }
+            Message::End(terminal, info) => {
+                let reader = stmt.reader.take().unwrap();
+                let conn = unsafe { &mut *stmt.conn };
+                conn.client = reader.finish();
+                crate::stats::add_traffic(stmt, stmt.reader_traffic);
+                if crate::execute::check_interrupt(stmt) {
+                    return false;
                 }
+                push_info(stmt, info);
+                stmt.prefetch_done = Some(terminal);
             }
         }
+    }
+    true
+}
+
+/// Stop the read-ahead thread, if one is running, and give its client back
+/// to the connection. Returns where the result set ended if the thread got
+/// there.
+pub fn stop_read_ahead(stmt: &mut Statement) -> Option<PrefetchTerminal> {
+    let reader = stmt.reader.take()?;
+    let conn = unsafe { &mut *stmt.conn };
+    let stopped = reader.stop(conn.attention.as_deref());
+    conn.client = stopped.client;
+    crate::stats::add_traffic(stmt, stmt.reader_traffic);
+    if conn.client.is_none() {
+        // The reader died with the session's client
+        conn.attention = None;
+        conn.connected = false;
+    }
+    stopped.terminal
+}
+
+/// Let the read-ahead thread, if one is running, read to the end of the
+/// result set, discarding the rows, and give its client back to the
+/// connection. Returns where the result set ended.
+pub fn drain_read_ahead(stmt: &mut Statement) -> Option<PrefetchTerminal> {
+    let reader = stmt.reader.take()?;
+    loop {
+        match reader.recv().0 {
+            Message::Rows(block, _) => reader.recycle(block),
+            Message::End(terminal, info) => {
+                let conn = unsafe { &mut *stmt.conn };
+                conn.client = reader.finish();
+                crate::stats::add_traffic(stmt, stmt.reader_traffic);
+                push_info(stmt, info);
+                return Some(terminal);
+            }
+        }
+    }
+}
+
+/// Read the rest of a statement's reply into memory so another statement
+/// can use the wire: the current result set onto `stmt.rows` and any later
+/// ones into `pending_result_sets`. The statement then fetches and moves
+/// through its results as before, without touching the connection. This
+/// stands in for MARS, which tabby's single session cannot multiplex.
+/// Rows past the connection's BufferBytes= go to a spill file.
+pub fn buffer_rest(stmt: &mut Statement) {
+    // A partitioned extract does not read on the connection's session
+    if !stmt.streaming || stmt.partitioned.is_some() {
+        return;
+    }
+    let budget = unsafe { &*stmt.conn }.buffer_bytes;
+    if stmt.reader.is_some() {
+        if !receive_all(stmt, budget) {
+            return;
+        }
+    } else if stmt.prefetch_done.is_none() && !prefetch_all(stmt, budget) {
+        return;
+    }
+    stmt.buffered = true;
+    let conn = unsafe { &mut *stmt.conn };
+    if matches!(stmt.prefetch_done, Some(PrefetchTerminal::Error(_))) {
+        // Keep the error for the application; leave the wire clean
+        if let Some(client) = conn.client.as_mut() {
+            let _ = client.batch_drain();
+        }
+        return;
+    }
+    if !matches!(stmt.prefetch_done, Some(PrefetchTerminal::MoreResults)) {
+        return;
+    }
+    // The current result set now ends the reply as far as the stream goes
+    stmt.prefetch_done = Some(PrefetchTerminal::Done);
+    let Some(client) = conn.client.as_mut() else {
+        return;
+    };
+    let busy = crate::execute::busy(stmt, false);
+    let mut info = Vec::new();
+    let mut left = budget.saturating_sub(stmt.rows.data_bytes());
+    let mut spilled = 0;
+    loop {
+        let columns = match client.batch_fetch_metadata() {
+            Ok(columns) if !columns.is_empty() => columns,
+            _ => break,
+        };
+        let mut rows = RowBatch::default();
+        let mut writer = SingleRowWriter {
+            rows: &mut rows,
+            info_messages: Vec::new(),
+        };
+        let (terminal, spill) = read_spilling(
+            client,
+            &mut writer,
+            &mut stmt.stream_string_buf,
+            &mut stmt.stream_bytes_buf,
+            left,
+        );
+        info.append(&mut writer.info_messages);
+        left = left.saturating_sub(rows.data_bytes());
+        spilled += spill.as_ref().map_or(0, |s| s.written());
+        stmt.pending_result_sets.push_back(ResultSet {
+            columns: conn.column_cache.get(&columns),
+            rows,
+            spill: spill.map(Arc::new),
+            done_rows: 0,
+        });
+        if !matches!(terminal, Some(PrefetchTerminal::MoreResults)) {
+            break;
+        }
+    }
+    busy.end(stmt);
+    crate::stats::count(stmt, |s| s.spill_bytes += spilled as u64);
+    if !crate::execute::check_interrupt(stmt) {
+        push_info(stmt, info);
+    }
+}
+
+/// Decode the rest of the result set onto `writer`'s batch, keeping rows in
+/// memory up to `budget` bytes and spilling the ones after them. Returns how
+/// the result set ended and the spilled rows, if any.
+fn read_spilling(
+    client: &mut SyncClient<TdsStream>,
+    writer: &mut SingleRowWriter<'_>,
+    string_buf: &mut String,
+    bytes_buf: &mut Vec<u8>,
+    budget: usize,
+) -> (Option<PrefetchTerminal>, Option<Spill>) {
+    let mut terminal = read_rows(client, writer, string_buf, bytes_buf, 0, usize::MAX, budget);
+    let mut spill = None;
+    while terminal.is_none() {
+        // A segment at a time behind the rows kept, which stay as they are
+        let keep = writer.rows.len();
+        let limit = writer.rows.data_bytes() + SEGMENT_BYTES;
+        terminal = read_rows(
+            client,
+            writer,
+            string_buf,
+            bytes_buf,
+            keep + 1,
+            usize::MAX,
+            limit,
+        );
+        spill.get_or_insert_with(Spill::new).push(writer.rows, keep);
+        writer.rows.truncate(keep);
+    }
+    (terminal, spill.map(Spill::finish))
+}
+
+/// Read the rest of the current result set onto `stmt.rows`, spilling what
+/// does not fit `budget`. Returns false if the request was cancelled or
+/// timed out.
+fn prefetch_all(stmt: &mut Statement, budget: usize) -> bool {
+    let conn = unsafe { &mut *stmt.conn };
+    let Some(client) = conn.client.as_mut() else {
+        stmt.prefetch_done = Some(PrefetchTerminal::Error("Not connected".to_string()));
+        return true;
+    };
+    let busy = crate::execute::busy(stmt, false);
+    stmt.rows.set_wide(stmt.wide_cols.load(Ordering::Relaxed));
+    let mut writer = SingleRowWriter {
+        rows: &mut stmt.rows,
+        info_messages: Vec::new(),
+    };
+    let (terminal, spill) = read_spilling(
+        client,
+        &mut writer,
+        &mut stmt.stream_string_buf,
+        &mut stmt.stream_bytes_buf,
+        budget,
+    );
+    let info = writer.info_messages;
+    busy.end(stmt);
+    if crate::execute::check_interrupt(stmt) {
+        return false;
+    }
+    push_info(stmt, info);
+    stmt.prefetch_done = terminal;
+    set_spill(stmt, spill);
+    true
+}
+
+/// Take the rest of the current result set from the read-ahead thread onto
+/// `stmt.rows`, spilling the blocks after the one that goes past `budget`.
+/// Returns false if the request was cancelled or timed out.
+fn receive_all(stmt: &mut Statement, budget: usize) -> bool {
+    let mut spill: Option<(Spill, usize)> = None;
+    while stmt.reader.is_some() {
+        if !receive(stmt, stmt.rows.len() + 1) {
+            return false;
+        }
+        if let Some((spill, keep)) = spill.as_mut() {
+            spill.push(&stmt.rows, *keep);
+            stmt.rows.truncate(*keep);
+        } else if stmt.rows.data_bytes() > budget {
+            spill = Some((Spill::new(), stmt.rows.len()));
+        }
+    }
+    set_spill(stmt, spill.map(|(spill, _)| spill.finish()));
+    true
+}
+
+/// Make `spill` the rest of the statement's current result set
+fn set_spill(stmt: &mut Statement, spill: Option<Spill>) {
+    let written = spill.as_ref().map_or(0, |s| s.written());
+    crate::stats::count(stmt, |s| s.spill_bytes += written as u64);
+    stmt.spilled = spill.map(|spill| SpillReader::new(Arc::new(spill)));
+}
+
+pub fn push_info(stmt: &mut Statement, info: Vec<(u32, String)>) {
+    for (number, message) in info {
+        stmt.diagnostics.push(DiagRecord {
+            state: "01000".to_string(),
+            native_error: number as i32,
+            message,
+        });
+    }
+}
+
+fn set_rows_fetched(stmt: &Statement, n: usize) {
+    if !stmt.rows_fetched_ptr.is_null() {
+        unsafe {
+            *stmt.rows_fetched_ptr = n as SQLULEN;
+        }
+    }
+}
+
+/// Size of one element of a fixed-length C type, or None for variable-length targets
+pub fn c_type_size(c_type: SQLSMALLINT) -> Option<usize> {
+    match c_type {
+        SQL_C_LONG | SQL_C_SLONG | SQL_C_ULONG | SQL_C_FLOAT => Some(4),
+        SQL_C_SHORT | SQL_C_USHORT => Some(2),
+        SQL_C_SBIGINT | SQL_C_DOUBLE => Some(8),
+        SQL_C_BIT | SQL_C_UTINYINT | SQL_C_STINYINT => Some(1),
+        SQL_C_TYPE_TIMESTAMP => Some(std::mem::size_of::<SqlTimestampStruct>()),
+        SQL_C_TYPE_DATE => Some(std::mem::size_of::<SqlDateStruct>()),
+        SQL_C_TYPE_TIME => Some(std::mem::size_of::<SqlTimeStruct>()),
+        SQL_C_GUID => Some(std::mem::size_of::<SqlGuid>()),
+        _ => None,
+    }
+}
+
+/// Write the current rowset into the bound column buffers and fill the
+/// rows-fetched / row-status arrays. Returns true if any value was truncated.
+fn write_rowset(stmt: &mut Statement) -> bool {
+    let base = stmt.row_index as usize;
+    let n = stmt.rowset_len;
+    let bind_offset = if stmt.row_bind_offset_ptr.is_null() {
+        0
     } else {
-        // Non-streaming mode (buffered rows from pending_result_sets, or legacy)
-        stmt.row_index += 1;
-        if stmt.row_index as usize >= stmt.rows.len() {
-            SQL_NO_DATA
-        } else {
-            SQL_SUCCESS
+        unsafe { *stmt.row_bind_offset_ptr }
+    };
+    let row_wise = stmt.row_bind_type != SQL_BIND_BY_COLUMN;
+    let mut truncated = false;
+
+    // Resolve each bound column's conversion once for the whole rowset
+    for (j, b) in stmt.bound_cols.iter().enumerate() {
+        let col_sql_type = stmt
+            .columns
+            .get(b.col_number as usize - 1)
+            .map(|c| c.sql_type)
+            .unwrap_or(SQL_VARCHAR);
+        let plan = plan_for(&mut stmt.bound_plans, j, col_sql_type, b.target_type);
+        note_target(&stmt.wide_cols, b.col_number as usize - 1, plan.eff_type);
+    }
+    let text_columns = stmt
+        .bound_plans
+        .iter()
+        .take(stmt.bound_cols.len())
+        .flatten()
+        .filter(|p| p.via_text)
+        .count();
+    if text_columns > 0 {
+        crate::stats::count(stmt, |s| s.text_conversions += (text_columns * n) as u64);
+    }
+
+    for i in 0..n {
+        let mut row_status = SQL_ROW_SUCCESS;
+        for (b, plan) in stmt.bound_cols.iter().zip(&stmt.bound_plans) {
+            let Some(plan) = plan else {
+                continue;
+            };
+            let col_idx = b.col_number as usize - 1;
+            // Columns bound past the end of this result set are left untouched
+            let Some(cell) = stmt.rows.cell(base + i, col_idx) else {
+                continue;
+            };
+
+            // Column-wise: arrays of elements; row-wise: structs of row_bind_type bytes
+            let (value_off, ind_off) = if row_wise {
+                let off = bind_offset + i * stmt.row_bind_type;
+                (off, off)
+            } else {
+                let elem = c_type_size(plan.eff_type).unwrap_or(b.buffer_length.max(0) as usize);
+                (
+                    bind_offset + i * elem,
+                    bind_offset + i * std::mem::size_of::<SQLLEN>(),
+                )
+            };
+            let target_value = if b.target_value.is_null() {
+                ptr::null_mut()
+            } else {
+                unsafe { (b.target_value as *mut u8).add(value_off) as SQLPOINTER }
+            };
+            let str_len_or_ind = if b.str_len_or_ind.is_null() {
+                ptr::null_mut()
+            } else {
+                unsafe { (b.str_len_or_ind as *mut u8).add(ind_off) as *mut SQLLEN }
+            };
+
+            let mut offset = 0;
+            match convert_cell(
+                cell,
+                plan,
+                target_value,
+                b.buffer_length,
+                str_len_or_ind,
+                &mut offset,
+            ) {
+                SQL_SUCCESS_WITH_INFO => {
+                    truncated = true;
+                    if row_status == SQL_ROW_SUCCESS {
+                        row_status = SQL_ROW_SUCCESS_WITH_INFO;
+                    }
+                }
+                SQL_ERROR => row_status = SQL_ROW_ERROR,
+                _ => {}
+            }
+        }
+        if !stmt.row_status_ptr.is_null() {
+            unsafe {
+                *stmt.row_status_ptr.add(i) = row_status;
+            }
+        }
+    }
+
+    if !stmt.row_status_ptr.is_null() {
+        for i in n..stmt.row_array_size {
+            unsafe {
+                *stmt.row_status_ptr.add(i) = SQL_ROW_NOROW;
+            }
         }
     }
+    set_rows_fetched(stmt, n);
+
+    if truncated {
+        stmt.diagnostics.push(DiagRecord {
+            state: "01004".to_string(),
+            native_error: 0,
+            message: "String data, right truncated".to_string(),
+        });
+    }
+    truncated
 }
 
-/// Helper: write a fixed-size numeric value to the target buffer
+/// Helper: write a fixed-size value to the target buffer
 unsafe fn write_fixed<T: Copy>(
     target_value: SQLPOINTER,
     str_len_or_ind: *mut SQLLEN,
     val: T,
-    read_offsets: &mut [usize],
-    col_idx: usize,
+    offset: &mut usize,
 ) -> SQLRETURN {
     if !target_value.is_null() {
         *(target_value as *mut T) = val;
@@ -199,42 +807,50 @@ unsafe fn write_fixed<T: Copy>(
     if !str_len_or_ind.is_null() {
         *str_len_or_ind = std::mem::size_of::<T>() as SQLLEN;
     }
-    read_offsets[col_idx] = 0;
+    *offset = 0;
     SQL_SUCCESS
 }
 
-/// Helper: convert CellValue to i64 for numeric cross-type conversions
-fn cell_to_i64(cell: &CellValue) -> i64 {
+/// Helper: convert Cell to i64 for numeric cross-type conversions
+pub fn cell_to_i64(cell: Cell<'_>) -> i64 {
     match cell {
-        CellValue::Bool(v) => *v as i64,
-        CellValue::U8(v) => *v as i64,
-        CellValue::I16(v) => *v as i64,
-        CellValue::I32(v) => *v as i64,
-        CellValue::I64(v) => *v,
-        CellValue::F32(v) => *v as i64,
-        CellValue::F64(v) => *v as i64,
-        CellValue::String(s) => s.parse().unwrap_or(0),
+        Cell::Bool(v) => v as i64,
+        Cell::U8(v) => v as i64,
+        Cell::I16(v) => v as i64,
+        Cell::I32(v) => v as i64,
+        Cell::I64(v) => v,
+        Cell::F32(v) => v as i64,
+        Cell::F64(v) => v as i64,
+        Cell::Str(s) => s.parse().unwrap_or(0),
+        Cell::Wide(_) => cell
+            .text(&mut TextBuf::new())
+            .and_then(|s| s.parse().ok())
+            .unwrap_or(0),
         _ => 0,
     }
 }
 
-fn cell_to_f64(cell: &CellValue) -> f64 {
+pub fn cell_to_f64(cell: Cell<'_>) -> f64 {
     match cell {
-        CellValue::Bool(v) => {
-            if *v {
+        Cell::Bool(v) => {
+            if v {
                 1.0
             } else {
                 0.0
             }
         }
-        CellValue::U8(v) => *v as f64,
-        CellValue::I16(v) => *v as f64,
-        CellValue::I32(v) => *v as f64,
-        CellValue::I64(v) => *v as f64,
-        CellValue::F32(v) => *v as f64,
-        CellValue::F64(v) => *v,
-        CellValue::String(s) => s.parse().unwrap_or(0.0),
-        CellValue::Decimal { value, scale, .. } => *value as f64 / 10f64.powi(*scale as i32),
+        Cell::U8(v) => v as f64,
+        Cell::I16(v) => v as f64,
+        Cell::I32(v) => v as f64,
+        Cell::I64(v) => v as f64,
+        Cell::F32(v) => v as f64,
+        Cell::F64(v) => v,
+        Cell::Str(s) => s.parse().unwrap_or(0.0),
+        Cell::Wide(_) => cell
+            .text(&mut TextBuf::new())
+            .and_then(|s| s.parse().ok())
+            .unwrap_or(0.0),
+        Cell::Decimal { value, scale, .. } => value as f64 / 10f64.powi(scale as i32),
         _ => 0.0,
     }
 }
@@ -250,502 +866,605 @@ pub fn get_data(
     if stmt.row_index < 0 || stmt.row_index as usize >= stmt.rows.len() {
         return SQL_ERROR;
     }
-    let row = &stmt.rows[stmt.row_index as usize];
     let col_idx = (col as usize).wrapping_sub(1); // 1-based to 0-based
-    if col_idx >= row.len() {
+    let Some(cell) = stmt.rows.cell(stmt.row_index as usize, col_idx) else {
         return SQL_ERROR;
-    }
+    };
 
     // Ensure read_offsets is large enough
     while stmt.read_offsets.len() <= col_idx {
         stmt.read_offsets.push(0);
     }
 
-    let cell = &row[col_idx];
+    let col_sql_type = stmt
+        .columns
+        .get(col_idx)
+        .map(|c| c.sql_type)
+        .unwrap_or(SQL_VARCHAR);
+    let plan = plan_for(&mut stmt.get_plans, col_idx, col_sql_type, target_type);
+    note_target(&stmt.wide_cols, col_idx, plan.eff_type);
+    let ret = convert_cell(
+        cell,
+        &plan,
+        target_value,
+        buffer_length,
+        str_len_or_ind,
+        &mut stmt.read_offsets[col_idx],
+    );
+    crate::stats::count(stmt, |s| {
+        s.get_data_calls += 1;
+        s.text_conversions += plan.via_text as u64;
+    });
+    ret
+}
+
+/// Remember whether the application reads a column as SQL_C_WCHAR or
+/// SQL_C_CHAR, so the rows read next keep that column's NVARCHAR text in
+/// the form it is read in
+pub fn note_target(wide_cols: &AtomicU64, col_idx: usize, c_type: SQLSMALLINT) {
+    if col_idx >= 64 {
+        return;
+    }
+    let bit = 1u64 << col_idx;
+    let wide = match c_type {
+        SQL_C_WCHAR => true,
+        SQL_C_CHAR => false,
+        _ => return,
+    };
+    let held = wide_cols.load(Ordering::Relaxed) & bit != 0;
+    if held != wide {
+        if wide {
+            wide_cols.fetch_or(bit, Ordering::Relaxed);
+        } else {
+            wide_cols.fetch_and(!bit, Ordering::Relaxed);
+        }
+    }
+}
+
+/// Default C type for a column when the application asks for SQL_C_DEFAULT
+pub fn default_c_type(sql_type: SQLSMALLINT) -> SQLSMALLINT {
+    match sql_type {
+        SQL_INTEGER => SQL_C_LONG,
+        SQL_SMALLINT => SQL_C_SHORT,
+        SQL_BIGINT => SQL_C_SBIGINT,
+        SQL_DOUBLE | SQL_FLOAT => SQL_C_DOUBLE,
+        SQL_REAL => SQL_C_FLOAT,
+        SQL_BIT => SQL_C_BIT,
+        SQL_TYPE_TIMESTAMP => SQL_C_TYPE_TIMESTAMP,
+        SQL_TYPE_DATE => SQL_C_TYPE_DATE,
+        SQL_TYPE_TIME => SQL_C_TYPE_TIME,
+        SQL_BINARY | SQL_VARBINARY | SQL_LONGVARBINARY => SQL_C_BINARY,
+        SQL_GUID => SQL_C_GUID,
+        SQL_TINYINT => SQL_C_UTINYINT,
+        _ => SQL_C_CHAR,
+    }
+}
+
+/// Converts one non-NULL cell into an application buffer. `offset` is the
+/// chunked-read position for the cell; bound columns pass a fresh zero.
+type Convert = fn(Cell<'_>, SQLPOINTER, SQLLEN, *mut SQLLEN, &mut usize) -> SQLRETURN;
+
+/// How cells of one column type are converted to one C type, worked out
+/// once and reused for every cell while neither changes
+#[derive(Clone, Copy)]
+pub struct ConvPlan {
+    sql_type: SQLSMALLINT,
+    target_type: SQLSMALLINT,
+    /// The C type written, with SQL_C_DEFAULT resolved
+    pub eff_type: SQLSMALLINT,
+    convert: Convert,
+    /// Goes through the value's text form (SQL_ATTR_FB_STATS counts these)
+    pub via_text: bool,
+}
+
+impl ConvPlan {
+    pub fn new(sql_type: SQLSMALLINT, target_type: SQLSMALLINT) -> Self {
+        let eff_type = if target_type == SQL_C_DEFAULT {
+            default_c_type(sql_type)
+        } else {
+            target_type
+        };
+        let convert: Convert = match eff_type {
+            SQL_C_LONG | SQL_C_SLONG => convert_fixed::<i32>,
+            SQL_C_ULONG => convert_fixed::<u32>,
+            SQL_C_SHORT => convert_fixed::<i16>,
+            SQL_C_USHORT => convert_fixed::<u16>,
+            SQL_C_SBIGINT => convert_fixed::<i64>,
+            SQL_C_DOUBLE => convert_fixed::<f64>,
+            SQL_C_FLOAT => convert_fixed::<f32>,
+            SQL_C_BIT => convert_fixed::<Bit>,
+            SQL_C_UTINYINT | SQL_C_STINYINT => convert_fixed::<u8>,
+            SQL_C_TYPE_TIMESTAMP => convert_fixed::<SqlTimestampStruct>,
+            SQL_C_TYPE_DATE => convert_fixed::<SqlDateStruct>,
+            SQL_C_TYPE_TIME => convert_fixed::<SqlTimeStruct>,
+            SQL_C_GUID => convert_fixed::<SqlGuid>,
+            SQL_C_WCHAR => convert_wchar,
+            SQL_C_BINARY => convert_binary,
+            // SQL_C_CHAR or unknown
+            _ => convert_char,
+        };
+        let text_sql = matches!(
+            sql_type,
+            SQL_CHAR | SQL_VARCHAR | SQL_LONGVARCHAR | SQL_WCHAR | SQL_WVARCHAR | SQL_WLONGVARCHAR
+        );
+        let text_c = matches!(eff_type, SQL_C_CHAR | SQL_C_WCHAR);
+        ConvPlan {
+            sql_type,
+            target_type,
+            eff_type,
+            convert,
+            via_text: text_sql != text_c && eff_type != SQL_C_BINARY,
+        }
+    }
+}
+
+/// The plan cached in `plans[idx]`, rebuilt if the column type or the C
+/// type it was made for has changed
+pub fn plan_for(
+    plans: &mut Vec<Option<ConvPlan>>,
+    idx: usize,
+    sql_type: SQLSMALLINT,
+    target_type: SQLSMALLINT,
+) -> ConvPlan {
+    if plans.len() <= idx {
+        plans.resize(idx + 1, None);
+    }
+    match plans[idx] {
+        Some(plan) if plan.sql_type == sql_type && plan.target_type == target_type => plan,
+        _ => *plans[idx].insert(ConvPlan::new(sql_type, target_type)),
+    }
+}
 
+/// Convert one cell into an application buffer.
+///
+/// Shared by SQLGetData and bound columns. `offset` is the chunked-read
+/// position for this cell; bound columns pass a fresh zero each row.
+fn convert_cell(
+    cell: Cell<'_>,
+    plan: &ConvPlan,
+    target_value: SQLPOINTER,
+    buffer_length: SQLLEN,
+    str_len_or_ind: *mut SQLLEN,
+    offset: &mut usize,
+) -> SQLRETURN {
     // Handle NULL
-    if matches!(cell, CellValue::Null) {
+    if matches!(cell, Cell::Null) {
         if !str_len_or_ind.is_null() {
             unsafe {
                 *str_len_or_ind = SQL_NULL_DATA;
             }
         }
-        stmt.read_offsets[col_idx] = 0;
+        *offset = 0;
         return SQL_SUCCESS;
     }
+    (plan.convert)(cell, target_value, buffer_length, str_len_or_ind, offset)
+}
 
-    // Determine effective target type
-    let eff_type = if target_type == SQL_C_DEFAULT {
-        if col_idx < stmt.columns.len() {
-            match stmt.columns[col_idx].sql_type {
-                SQL_INTEGER => SQL_C_LONG,
-                SQL_SMALLINT => SQL_C_SHORT,
-                SQL_BIGINT => SQL_C_SBIGINT,
-                SQL_DOUBLE | SQL_FLOAT => SQL_C_DOUBLE,
-                SQL_REAL => SQL_C_FLOAT,
-                SQL_BIT => SQL_C_BIT,
-                SQL_TYPE_TIMESTAMP => SQL_C_TYPE_TIMESTAMP,
-                SQL_TYPE_DATE => SQL_C_TYPE_DATE,
-                SQL_TYPE_TIME => SQL_C_TYPE_TIME,
-                SQL_BINARY | SQL_VARBINARY | SQL_LONGVARBINARY => SQL_C_BINARY,
-                SQL_GUID => SQL_C_GUID,
-                SQL_TINYINT => SQL_C_UTINYINT,
-                _ => SQL_C_CHAR,
-            }
-        } else {
-            SQL_C_CHAR
+/// A fixed-size C type and how a cell becomes one
+trait FromCell: Copy {
+    fn from_cell(cell: Cell<'_>) -> Self;
+}
+
+fn convert_fixed<T: FromCell>(
+    cell: Cell<'_>,
+    target_value: SQLPOINTER,
+    _buffer_length: SQLLEN,
+    str_len_or_ind: *mut SQLLEN,
+    offset: &mut usize,
+) -> SQLRETURN {
+    unsafe { write_fixed(target_value, str_len_or_ind, T::from_cell(cell), offset) }
+}
+
+impl FromCell for i32 {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::I32(v) => v,
+            Cell::Bool(v) => v as i32,
+            Cell::U8(v) => v as i32,
+            Cell::I16(v) => v as i32,
+            _ => cell_to_i64(cell) as i32,
         }
-    } else {
-        target_type
-    };
+    }
+}
 
-    match eff_type {
-        SQL_C_LONG | SQL_C_SLONG => {
-            let v: i32 = match cell {
-                CellValue::I32(v) => *v,
-                CellValue::Bool(v) => *v as i32,
-                CellValue::U8(v) => *v as i32,
-                CellValue::I16(v) => *v as i32,
-                _ => cell_to_i64(cell) as i32,
-            };
-            unsafe {
-                write_fixed(
-                    target_value,
-                    str_len_or_ind,
-                    v,
-                    &mut stmt.read_offsets,
-                    col_idx,
-                )
-            }
+impl FromCell for u32 {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::Bool(v) => v as u32,
+            Cell::U8(v) => v as u32,
+            _ => cell_to_i64(cell) as u32,
         }
-        SQL_C_SHORT => {
-            let v: i16 = match cell {
-                CellValue::I16(v) => *v,
-                _ => cell_to_i64(cell) as i16,
-            };
-            unsafe {
-                write_fixed(
-                    target_value,
-                    str_len_or_ind,
-                    v,
-                    &mut stmt.read_offsets,
-                    col_idx,
-                )
-            }
+    }
+}
+
+impl FromCell for i16 {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::I16(v) => v,
+            _ => cell_to_i64(cell) as i16,
         }
-        SQL_C_SBIGINT => {
-            let v: i64 = match cell {
-                CellValue::I64(v) => *v,
-                _ => cell_to_i64(cell),
-            };
-            unsafe {
-                write_fixed(
-                    target_value,
-                    str_len_or_ind,
-                    v,
-                    &mut stmt.read_offsets,
-                    col_idx,
-                )
-            }
+    }
+}
+
+impl FromCell for u16 {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::U8(v) => v as u16,
+            _ => cell_to_i64(cell) as u16,
         }
-        SQL_C_DOUBLE => {
-            let v: f64 = match cell {
-                CellValue::F64(v) => *v,
-                _ => cell_to_f64(cell),
-            };
-            unsafe {
-                write_fixed(
-                    target_value,
-                    str_len_or_ind,
-                    v,
-                    &mut stmt.read_offsets,
-                    col_idx,
-                )
-            }
+    }
+}
+
+impl FromCell for i64 {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::I64(v) => v,
+            _ => cell_to_i64(cell),
         }
-        SQL_C_FLOAT => {
-            let v: f32 = match cell {
-                CellValue::F32(v) => *v,
-                _ => cell_to_f64(cell) as f32,
-            };
-            unsafe {
-                write_fixed(
-                    target_value,
-                    str_len_or_ind,
-                    v,
-                    &mut stmt.read_offsets,
-                    col_idx,
-                )
-            }
+    }
+}
+
+impl FromCell for f64 {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::F64(v) => v,
+            _ => cell_to_f64(cell),
         }
-        SQL_C_BIT => {
-            let v: u8 = match cell {
-                CellValue::Bool(b) => {
-                    if *b {
-                        1
-                    } else {
-                        0
-                    }
-                }
-                CellValue::U8(v) => {
-                    if *v != 0 {
-                        1
-                    } else {
-                        0
-                    }
-                }
-                CellValue::String(s) => {
-                    if s == "0" || s.is_empty() {
-                        0
-                    } else {
-                        1
-                    }
-                }
-                _ => {
-                    if cell_to_i64(cell) != 0 {
-                        1
-                    } else {
-                        0
-                    }
-                }
-            };
-            unsafe {
-                write_fixed(
-                    target_value,
-                    str_len_or_ind,
-                    v,
-                    &mut stmt.read_offsets,
-                    col_idx,
-                )
-            }
+    }
+}
+
+impl FromCell for f32 {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::F32(v) => v,
+            _ => cell_to_f64(cell) as f32,
         }
-        SQL_C_UTINYINT | SQL_C_STINYINT => {
-            let v: u8 = match cell {
-                CellValue::U8(v) => *v,
-                _ => cell_to_i64(cell) as u8,
-            };
-            unsafe {
-                write_fixed(
-                    target_value,
-                    str_len_or_ind,
-                    v,
-                    &mut stmt.read_offsets,
-                    col_idx,
-                )
-            }
+    }
+}
+
+impl FromCell for u8 {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::U8(v) => v,
+            _ => cell_to_i64(cell) as u8,
         }
-        SQL_C_WCHAR => {
-            // Fast path: if we already have UTF-16, skip encoding entirely
-            let utf16: std::borrow::Cow<[u16]> = match cell {
-                CellValue::Utf16(u) => std::borrow::Cow::Borrowed(u.as_slice()),
-                _ => {
-                    let val = cell.to_string_repr().unwrap_or_default();
-                    std::borrow::Cow::Owned(val.encode_utf16().collect())
-                }
-            };
-            let total_bytes = (utf16.len() * 2) as SQLLEN;
-            let offset = stmt.read_offsets[col_idx]; // offset in u16 units
-            let remaining_u16 = if offset < utf16.len() {
-                &utf16[offset..]
-            } else {
-                if !str_len_or_ind.is_null() {
-                    unsafe {
-                        *str_len_or_ind = 0;
-                    }
-                }
-                stmt.read_offsets[col_idx] = 0;
-                return SQL_NO_DATA;
-            };
+    }
+}
 
-            if offset == 0 {
-                if !str_len_or_ind.is_null() {
-                    unsafe {
-                        *str_len_or_ind = total_bytes;
-                    }
-                }
-            } else if !str_len_or_ind.is_null() {
-                unsafe {
-                    *str_len_or_ind = (remaining_u16.len() * 2) as SQLLEN;
-                }
+/// SQL_C_BIT: one byte, 0 or 1
+#[derive(Clone, Copy)]
+#[repr(transparent)]
+struct Bit(u8);
+
+impl FromCell for Bit {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        let set = match cell {
+            Cell::Bool(b) => b,
+            Cell::U8(v) => v != 0,
+            Cell::Str(_) | Cell::Wide(_) => {
+                let mut text = TextBuf::new();
+                let s = cell.text(&mut text).unwrap_or_default();
+                !(s == "0" || s.is_empty())
             }
+            _ => cell_to_i64(cell) != 0,
+        };
+        Bit(set as u8)
+    }
+}
 
-            if !target_value.is_null() && buffer_length > 0 {
-                let buf_u16_cap = (buffer_length as usize) / 2;
-                let copy_count = std::cmp::min(remaining_u16.len(), buf_u16_cap.saturating_sub(1));
-                let dest = target_value as *mut u16;
-                unsafe {
-                    ptr::copy_nonoverlapping(remaining_u16.as_ptr(), dest, copy_count);
-                    *dest.add(copy_count) = 0;
-                }
-                stmt.read_offsets[col_idx] = offset + copy_count;
-                if remaining_u16.len() > copy_count {
-                    return SQL_SUCCESS_WITH_INFO;
+impl FromCell for SqlTimestampStruct {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::DateTime { micros } | Cell::DateTimeOffset { micros, .. } => {
+                let (year, month, day, h, mi, sec, millis) = micros_to_timestamp_parts(micros);
+                SqlTimestampStruct {
+                    year: year as i16,
+                    month: month as u16,
+                    day: day as u16,
+                    hour: h as u16,
+                    minute: mi as u16,
+                    second: sec as u16,
+                    fraction: millis * 1_000_000, // millis -> nanoseconds
                 }
             }
-            stmt.read_offsets[col_idx] = 0;
-            SQL_SUCCESS
-        }
-        SQL_C_TYPE_TIMESTAMP => {
-            let ts = match cell {
-                CellValue::DateTime { micros } => {
-                    let (year, month, day, h, mi, sec, millis) = micros_to_timestamp_parts(*micros);
-                    SqlTimestampStruct {
-                        year: year as i16,
-                        month: month as u16,
-                        day: day as u16,
-                        hour: h as u16,
-                        minute: mi as u16,
-                        second: sec as u16,
-                        fraction: millis * 1_000_000, // millis -> nanoseconds
-                    }
-                }
-                CellValue::DateTimeOffset { micros, .. } => {
-                    let (year, month, day, h, mi, sec, millis) = micros_to_timestamp_parts(*micros);
-                    SqlTimestampStruct {
-                        year: year as i16,
-                        month: month as u16,
-                        day: day as u16,
-                        hour: h as u16,
-                        minute: mi as u16,
-                        second: sec as u16,
-                        fraction: millis * 1_000_000,
-                    }
-                }
-                CellValue::Date { .. } => {
-                    let s = cell.to_string_repr().unwrap_or_default();
-                    parse_timestamp(&s)
-                }
-                _ => {
-                    let s = cell.to_string_repr().unwrap_or_default();
-                    parse_timestamp(&s)
-                }
-            };
-            if !target_value.is_null() {
-                unsafe {
-                    *(target_value as *mut SqlTimestampStruct) = ts;
+            _ => parse_timestamp(cell.text(&mut TextBuf::new()).unwrap_or_default()),
+        }
+    }
+}
+
+impl FromCell for SqlDateStruct {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::DateTime { micros } | Cell::DateTimeOffset { micros, .. } => {
+                let (year, month, day, ..) = micros_to_timestamp_parts(micros);
+                SqlDateStruct {
+                    year: year as i16,
+                    month: month as u16,
+                    day: day as u16,
                 }
             }
-            if !str_len_or_ind.is_null() {
-                unsafe {
-                    *str_len_or_ind = std::mem::size_of::<SqlTimestampStruct>() as SQLLEN;
+            _ => {
+                let ts = parse_timestamp(cell.text(&mut TextBuf::new()).unwrap_or_default());
+                SqlDateStruct {
+                    year: ts.year,
+                    month: ts.month,
+                    day: ts.day,
                 }
             }
-            stmt.read_offsets[col_idx] = 0;
-            SQL_SUCCESS
-        }
-        SQL_C_TYPE_DATE => {
-            let ts = match cell {
-                CellValue::DateTime { micros } | CellValue::DateTimeOffset { micros, .. } => {
-                    let (year, month, day, ..) = micros_to_timestamp_parts(*micros);
-                    SqlDateStruct {
-                        year: year as i16,
-                        month: month as u16,
-                        day: day as u16,
-                    }
-                }
-                CellValue::Date { .. } => {
-                    let s = cell.to_string_repr().unwrap_or_default();
-                    let ts = parse_timestamp(&s);
-                    SqlDateStruct {
-                        year: ts.year,
-                        month: ts.month,
-                        day: ts.day,
-                    }
-                }
-                _ => {
-                    let s = cell.to_string_repr().unwrap_or_default();
-                    let ts = parse_timestamp(&s);
-                    SqlDateStruct {
-                        year: ts.year,
-                        month: ts.month,
-                        day: ts.day,
-                    }
-                }
-            };
-            if !target_value.is_null() {
-                unsafe {
-                    *(target_value as *mut SqlDateStruct) = ts;
+        }
+    }
+}
+
+impl FromCell for SqlTimeStruct {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::Time { nanos } => {
+                let total_secs = (nanos / 1_000_000_000) as u32;
+                SqlTimeStruct {
+                    hour: (total_secs / 3600) as u16,
+                    minute: ((total_secs % 3600) / 60) as u16,
+                    second: (total_secs % 60) as u16,
                 }
             }
-            if !str_len_or_ind.is_null() {
-                unsafe {
-                    *str_len_or_ind = std::mem::size_of::<SqlDateStruct>() as SQLLEN;
+            Cell::DateTime { micros } | Cell::DateTimeOffset { micros, .. } => {
+                let (_, _, _, h, mi, sec, _) = micros_to_timestamp_parts(micros);
+                SqlTimeStruct {
+                    hour: h as u16,
+                    minute: mi as u16,
+                    second: sec as u16,
                 }
             }
-            stmt.read_offsets[col_idx] = 0;
-            SQL_SUCCESS
-        }
-        SQL_C_TYPE_TIME => {
-            let ts = match cell {
-                CellValue::Time { nanos } => {
-                    let total_secs = (*nanos / 1_000_000_000) as u32;
-                    SqlTimeStruct {
-                        hour: (total_secs / 3600) as u16,
-                        minute: ((total_secs % 3600) / 60) as u16,
-                        second: (total_secs % 60) as u16,
-                    }
-                }
-                CellValue::DateTime { micros } | CellValue::DateTimeOffset { micros, .. } => {
-                    let (_, _, _, h, mi, sec, _) = micros_to_timestamp_parts(*micros);
-                    SqlTimeStruct {
-                        hour: h as u16,
-                        minute: mi as u16,
-                        second: sec as u16,
-                    }
-                }
-                _ => {
-                    let s = cell.to_string_repr().unwrap_or_default();
-                    let ts = parse_timestamp(&s);
-                    SqlTimeStruct {
-                        hour: ts.hour,
-                        minute: ts.minute,
-                        second: ts.second,
-                    }
-                }
-            };
-            if !target_value.is_null() {
-                unsafe {
-                    *(target_value as *mut SqlTimeStruct) = ts;
+            _ => {
+                let ts = parse_timestamp(cell.text(&mut TextBuf::new()).unwrap_or_default());
+                SqlTimeStruct {
+                    hour: ts.hour,
+                    minute: ts.minute,
+                    second: ts.second,
                 }
             }
-            if !str_len_or_ind.is_null() {
-                unsafe {
-                    *str_len_or_ind = std::mem::size_of::<SqlTimeStruct>() as SQLLEN;
-                }
+        }
+    }
+}
+
+impl FromCell for SqlGuid {
+    fn from_cell(cell: Cell<'_>) -> Self {
+        match cell {
+            Cell::Guid(bytes) => SqlGuid {
+                data1: u32::from_be_bytes([bytes[0], bytes[1], bytes[2], bytes[3]]),
+                data2: u16::from_be_bytes([bytes[4], bytes[5]]),
+                data3: u16::from_be_bytes([bytes[6], bytes[7]]),
+                data4: [
+                    bytes[8], bytes[9], bytes[10], bytes[11], bytes[12], bytes[13], bytes[14],
+                    bytes[15],
+                ],
+            },
+            _ => parse_guid(cell.text(&mut TextBuf::new()).unwrap_or_default()),
+        }
+    }
+}
+
+/// Chunked-read position after the last part of a value. A value that
+/// took several calls reports SQL_NO_DATA next; one read whole in a single
+/// call can be read again.
+fn read_complete(start: usize) -> usize {
+    if start > 0 {
+        usize::MAX
+    } else {
+        0
+    }
+}
+
+/// Where SQL_C_WCHAR text comes from
+#[derive(Clone, Copy)]
+enum WideSource<'a> {
+    /// UTF-16LE code units, as stored
+    Utf16(&'a [u8]),
+    Text(&'a str),
+}
+
+/// UTF-16 text, readable in chunks
+fn convert_wchar(
+    cell: Cell<'_>,
+    target_value: SQLPOINTER,
+    buffer_length: SQLLEN,
+    str_len_or_ind: *mut SQLLEN,
+    offset: &mut usize,
+) -> SQLRETURN {
+    let mut text = TextBuf::new();
+    let source = match cell {
+        Cell::Wide(units) => WideSource::Utf16(units),
+        _ => WideSource::Text(cell.text(&mut text).unwrap_or_default()),
+    };
+    let total = match source {
+        WideSource::Utf16(units) => units.len() / 2,
+        WideSource::Text(s) => utf16::utf16_len(s),
+    };
+    let start = *offset; // offset in u16 units
+
+    // An empty value is one read of zero units; only a later call is past
+    // the end
+    if start >= total && start > 0 {
+        if !str_len_or_ind.is_null() {
+            unsafe {
+                *str_len_or_ind = 0;
             }
-            stmt.read_offsets[col_idx] = 0;
-            SQL_SUCCESS
-        }
-        SQL_C_BINARY => {
-            let bytes: Vec<u8> = match cell {
-                CellValue::Bytes(b) => b.clone(),
-                CellValue::Guid(g) => g.to_vec(),
-                _ => {
-                    let s = cell.to_string_repr().unwrap_or_default();
-                    if s.chars().all(|c| c.is_ascii_hexdigit()) && s.len().is_multiple_of(2) {
-                        hex_decode(&s)
-                    } else {
-                        s.into_bytes()
-                    }
-                }
-            };
-            let offset = stmt.read_offsets[col_idx];
-            let remaining = if offset < bytes.len() {
-                &bytes[offset..]
+        }
+        *offset = 0;
+        return SQL_NO_DATA;
+    }
+    let remaining = total - start;
+
+    if !str_len_or_ind.is_null() {
+        unsafe {
+            *str_len_or_ind = (remaining * 2) as SQLLEN;
+        }
+    }
+
+    if !target_value.is_null() && buffer_length > 0 {
+        let buf_u16_cap = (buffer_length as usize) / 2;
+        let copy_count = std::cmp::min(remaining, buf_u16_cap.saturating_sub(1));
+        let dest = target_value as *mut u16;
+        if buf_u16_cap == 0 {
+            // No room for even the terminator
+            return if remaining > 0 {
+                SQL_SUCCESS_WITH_INFO
             } else {
-                if !str_len_or_ind.is_null() {
-                    unsafe {
-                        *str_len_or_ind = 0;
-                    }
-                }
-                stmt.read_offsets[col_idx] = 0;
-                return SQL_NO_DATA;
+                *offset = read_complete(start);
+                SQL_SUCCESS
             };
-
-            let remaining_len = remaining.len() as SQLLEN;
-            if offset == 0 {
-                if !str_len_or_ind.is_null() {
-                    unsafe {
-                        *str_len_or_ind = bytes.len() as SQLLEN;
+        }
+        unsafe {
+            match source {
+                // Stored as it came off the wire: one copy into the target
+                #[cfg(target_endian = "little")]
+                WideSource::Utf16(units) => ptr::copy_nonoverlapping(
+                    units[start * 2..].as_ptr(),
+                    dest as *mut u8,
+                    copy_count * 2,
+                ),
+                #[cfg(target_endian = "big")]
+                WideSource::Utf16(units) => {
+                    for (i, unit) in units[start * 2..]
+                        .chunks_exact(2)
+                        .take(copy_count)
+                        .enumerate()
+                    {
+                        *dest.add(i) = u16::from_le_bytes([unit[0], unit[1]]);
                     }
                 }
-            } else if !str_len_or_ind.is_null() {
-                unsafe {
-                    *str_len_or_ind = remaining_len;
+                WideSource::Text(s) => {
+                    utf16::encode_into(s, start, std::slice::from_raw_parts_mut(dest, copy_count));
                 }
             }
+            *dest.add(copy_count) = 0;
+        }
+        *offset = start + copy_count;
+        if remaining > copy_count {
+            return SQL_SUCCESS_WITH_INFO;
+        }
+    }
+    *offset = read_complete(start);
+    SQL_SUCCESS
+}
 
-            if !target_value.is_null() && buffer_length > 0 {
-                let copy_len = std::cmp::min(remaining_len, buffer_length) as usize;
-                unsafe {
-                    ptr::copy_nonoverlapping(remaining.as_ptr(), target_value as *mut u8, copy_len);
-                }
-                stmt.read_offsets[col_idx] = offset + copy_len;
-                if remaining.len() > copy_len {
-                    return SQL_SUCCESS_WITH_INFO;
-                }
+/// Raw bytes, readable in chunks; text holding hex digits is decoded
+fn convert_binary(
+    cell: Cell<'_>,
+    target_value: SQLPOINTER,
+    buffer_length: SQLLEN,
+    str_len_or_ind: *mut SQLLEN,
+    offset: &mut usize,
+) -> SQLRETURN {
+    let guid;
+    let mut text = TextBuf::new();
+    let bytes: std::borrow::Cow<[u8]> = match cell {
+        Cell::Bytes(b) => std::borrow::Cow::Borrowed(b),
+        Cell::Guid(g) => {
+            guid = g;
+            std::borrow::Cow::Borrowed(&guid[..])
+        }
+        _ => {
+            let s = cell.text(&mut text).unwrap_or_default();
+            if s.chars().all(|c| c.is_ascii_hexdigit()) && s.len().is_multiple_of(2) {
+                std::borrow::Cow::Owned(hex_decode(s))
+            } else {
+                std::borrow::Cow::Borrowed(s.as_bytes())
             }
-            stmt.read_offsets[col_idx] = 0;
-            SQL_SUCCESS
-        }
-        SQL_C_GUID => {
-            let guid = match cell {
-                CellValue::Guid(bytes) => SqlGuid {
-                    data1: u32::from_be_bytes([bytes[0], bytes[1], bytes[2], bytes[3]]),
-                    data2: u16::from_be_bytes([bytes[4], bytes[5]]),
-                    data3: u16::from_be_bytes([bytes[6], bytes[7]]),
-                    data4: [
-                        bytes[8], bytes[9], bytes[10], bytes[11], bytes[12], bytes[13], bytes[14],
-                        bytes[15],
-                    ],
-                },
-                _ => {
-                    let s = cell.to_string_repr().unwrap_or_default();
-                    parse_guid(&s)
-                }
-            };
-            if !target_value.is_null() {
-                unsafe {
-                    *(target_value as *mut SqlGuid) = guid;
-                }
+        }
+    };
+    let start = *offset;
+    let remaining = if start < bytes.len() || start == 0 {
+        &bytes[start..]
+    } else {
+        if !str_len_or_ind.is_null() {
+            unsafe {
+                *str_len_or_ind = 0;
             }
-            if !str_len_or_ind.is_null() {
-                unsafe {
-                    *str_len_or_ind = 16;
-                }
+        }
+        *offset = 0;
+        return SQL_NO_DATA;
+    };
+
+    let remaining_len = remaining.len() as SQLLEN;
+    if start == 0 {
+        if !str_len_or_ind.is_null() {
+            unsafe {
+                *str_len_or_ind = bytes.len() as SQLLEN;
             }
-            stmt.read_offsets[col_idx] = 0;
-            SQL_SUCCESS
         }
-        _ => {
-            // SQL_C_CHAR or unknown: return as ANSI string with chunked read support
-            let val = cell.to_string_repr().unwrap_or_default();
-            let bytes = val.as_bytes();
-            let offset = stmt.read_offsets[col_idx];
-
-            let remaining = if offset < bytes.len() {
-                &bytes[offset..]
-            } else if offset > 0 {
-                if !str_len_or_ind.is_null() {
-                    unsafe {
-                        *str_len_or_ind = 0;
-                    }
-                }
-                stmt.read_offsets[col_idx] = 0;
-                return SQL_NO_DATA;
-            } else {
-                bytes
-            };
+    } else if !str_len_or_ind.is_null() {
+        unsafe {
+            *str_len_or_ind = remaining_len;
+        }
+    }
 
-            let remaining_len = remaining.len() as SQLLEN;
+    if !target_value.is_null() && buffer_length > 0 {
+        let copy_len = std::cmp::min(remaining_len, buffer_length) as usize;
+        unsafe {
+            ptr::copy_nonoverlapping(remaining.as_ptr(), target_value as *mut u8, copy_len);
+        }
+        *offset = start + copy_len;
+        if remaining.len() > copy_len {
+            return SQL_SUCCESS_WITH_INFO;
+        }
+    }
+    *offset = read_complete(start);
+    SQL_SUCCESS
+}
 
-            if offset == 0 {
-                if !str_len_or_ind.is_null() {
-                    unsafe {
-                        *str_len_or_ind = bytes.len() as SQLLEN;
-                    }
-                }
-            } else if !str_len_or_ind.is_null() {
-                unsafe {
-                    *str_len_or_ind = remaining_len;
-                }
+/// ANSI text, readable in chunks
+fn convert_char(
+    cell: Cell<'_>,
+    target_value: SQLPOINTER,
+    buffer_length: SQLLEN,
+    str_len_or_ind: *mut SQLLEN,
+    offset: &mut usize,
+) -> SQLRETURN {
+    let mut text = TextBuf::new();
+    let bytes = cell.text(&mut text).unwrap_or_default().as_bytes();
+    let start = *offset;
+
+    let remaining = if start < bytes.len() {
+        &bytes[start..]
+    } else if start > 0 {
+        if !str_len_or_ind.is_null() {
+            unsafe {
+                *str_len_or_ind = 0;
             }
+        }
+        *offset = 0;
+        return SQL_NO_DATA;
+    } else {
+        bytes
+    };
 
-            if !target_value.is_null() && buffer_length > 0 {
-                let copy_len = std::cmp::min(remaining_len, buffer_length - 1) as usize;
-                unsafe {
-                    ptr::copy_nonoverlapping(remaining.as_ptr(), target_value as *mut u8, copy_len);
-                    *((target_value as *mut u8).add(copy_len)) = 0;
-                }
-                stmt.read_offsets[col_idx] = offset + copy_len;
-                if remaining.len() > copy_len {
-                    return SQL_SUCCESS_WITH_INFO;
-                }
+    let remaining_len = remaining.len() as SQLLEN;
+
+    if start == 0 {
+        if !str_len_or_ind.is_null() {
+            unsafe {
+                *str_len_or_ind = bytes.len() as SQLLEN;
             }
-            stmt.read_offsets[col_idx] = 0;
-            SQL_SUCCESS
+        }
+    } else if !str_len_or_ind.is_null() {
+        unsafe {
+            *str_len_or_ind = remaining_len;
         }
     }
+
+    if !target_value.is_null() && buffer_length > 0 {
+        let copy_len = std::cmp::min(remaining_len, buffer_length - 1) as usize;
+        unsafe {
+            ptr::copy_nonoverlapping(remaining.as_ptr(), target_value as *mut u8, copy_len);
+            *((target_value as *mut u8).add(copy_len)) = 0;
+        }
+        *offset = start + copy_len;
+        if remaining.len() > copy_len {
+            return SQL_SUCCESS_WITH_INFO;
+        }
+    }
+    *offset = read_complete(start);
+    SQL_SUCCESS
 }
 
 pub fn num_result_cols(stmt: &Statement) -> SQLSMALLINT {
@@ -806,7 +1525,7 @@ pub fn describe_col(
     SQL_SUCCESS
 }
 
-fn parse_timestamp(s: &str) -> SqlTimestampStruct {
+pub fn parse_timestamp(s: &str) -> SqlTimestampStruct {
     let mut ts = SqlTimestampStruct::default();
     // "YYYY-MM-DD HH:MM:SS.fff"
     let parts: Vec<&str> = s.splitn(2, [' ', 'T']).collect();
@@ -849,7 +1568,7 @@ fn hex_decode(s: &str) -> Vec<u8> {
     bytes
 }
 
-fn parse_guid(s: &str) -> SqlGuid {
+pub fn parse_guid(s: &str) -> SqlGuid {
     let hex: String = s.chars().filter(|c| c.is_ascii_hexdigit()).collect();
     let bytes = hex_decode(&hex);
     if bytes.len() >= 16 {
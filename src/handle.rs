@@ -1,12 +1,54 @@
-use std::collections::VecDeque;
+use std::borrow::Cow;
+use std::fmt::Write;
 
+use crate::batch::RowBatch;
 use crate::types::*;
+use crate::utf16;
 use tabby::RowWriter;
 
-/// Typed cell value — avoids string round-tripping for native types
-#[derive(Clone, Debug)]
-#[allow(dead_code)]
+/// Borrowed view of one cell of a result set — avoids string round-tripping
+/// for native types and copying for strings and binaries
+#[derive(Clone, Copy, Debug)]
+pub enum Cell<'a> {
+    Null,
+    Bool(bool),
+    U8(u8),
+    I16(i16),
+    I32(i32),
+    I64(i64),
+    F32(f32),
+    F64(f64),
+    Str(&'a str),
+    /// NVARCHAR text kept as the UTF-16LE code units it arrived in, for a
+    /// column the application reads as SQL_C_WCHAR
+    Wide(&'a [u8]),
+    Bytes(&'a [u8]),
+    Date {
+        days: i32,
+    },
+    Time {
+        nanos: i64,
+    },
+    DateTime {
+        micros: i64,
+    },
+    DateTimeOffset {
+        micros: i64,
+        offset_min: i16,
+    },
+    Decimal {
+        value: i128,
+        precision: u8,
+        scale: u8,
+    },
+    Guid([u8; 16]),
+}
+
+/// Owned cell value, for columns whose values do not share one type
+/// (sql_variant)
+#[derive(Clone, Debug, Default)]
 pub enum CellValue {
+    #[default]
     Null,
     Bool(bool),
     U8(u8),
@@ -36,42 +78,277 @@ pub enum CellValue {
         scale: u8,
     },
     Guid([u8; 16]),
-    /// Raw UTF-16 data — avoids UTF-16→UTF-8→UTF-16 round-trip for SQL_C_WCHAR
-    Utf16(Vec<u16>),
 }
 
 impl CellValue {
-    /// Convert any CellValue to its string representation (for SQL_C_CHAR / SQL_C_WCHAR cross-type)
-    pub fn to_string_repr(&self) -> Option<String> {
+    pub fn as_cell(&self) -> Cell<'_> {
+        match self {
+            CellValue::Null => Cell::Null,
+            CellValue::Bool(v) => Cell::Bool(*v),
+            CellValue::U8(v) => Cell::U8(*v),
+            CellValue::I16(v) => Cell::I16(*v),
+            CellValue::I32(v) => Cell::I32(*v),
+            CellValue::I64(v) => Cell::I64(*v),
+            CellValue::F32(v) => Cell::F32(*v),
+            CellValue::F64(v) => Cell::F64(*v),
+            CellValue::String(s) => Cell::Str(s),
+            CellValue::Bytes(b) => Cell::Bytes(b),
+            CellValue::Date { days } => Cell::Date { days: *days },
+            CellValue::Time { nanos } => Cell::Time { nanos: *nanos },
+            CellValue::DateTime { micros } => Cell::DateTime { micros: *micros },
+            CellValue::DateTimeOffset { micros, offset_min } => Cell::DateTimeOffset {
+                micros: *micros,
+                offset_min: *offset_min,
+            },
+            CellValue::Decimal {
+                value,
+                precision,
+                scale,
+            } => Cell::Decimal {
+                value: *value,
+                precision: *precision,
+                scale: *scale,
+            },
+            CellValue::Guid(g) => Cell::Guid(*g),
+        }
+    }
+}
+
+impl<'a> Cell<'a> {
+    pub fn into_value(self) -> CellValue {
+        match self {
+            Cell::Null => CellValue::Null,
+            Cell::Bool(v) => CellValue::Bool(v),
+            Cell::U8(v) => CellValue::U8(v),
+            Cell::I16(v) => CellValue::I16(v),
+            Cell::I32(v) => CellValue::I32(v),
+            Cell::I64(v) => CellValue::I64(v),
+            Cell::F32(v) => CellValue::F32(v),
+            Cell::F64(v) => CellValue::F64(v),
+            Cell::Str(s) => CellValue::String(s.to_string()),
+            Cell::Wide(b) => CellValue::String(utf16::decode_le(b)),
+            Cell::Bytes(b) => CellValue::Bytes(b.to_vec()),
+            Cell::Date { days } => CellValue::Date { days },
+            Cell::Time { nanos } => CellValue::Time { nanos },
+            Cell::DateTime { micros } => CellValue::DateTime { micros },
+            Cell::DateTimeOffset { micros, offset_min } => {
+                CellValue::DateTimeOffset { micros, offset_min }
+            }
+            Cell::Decimal {
+                value,
+                precision,
+                scale,
+            } => CellValue::Decimal {
+                value,
+                precision,
+                scale,
+            },
+            Cell::Guid(g) => CellValue::Guid(g),
+        }
+    }
+
+    /// String representation of the cell (for SQL_C_CHAR / SQL_C_WCHAR
+    /// cross-type); strings are borrowed rather than copied
+    pub fn to_string_repr(self) -> Option<Cow<'a, str>> {
+        if let Cell::Str(s) = self {
+            return Some(Cow::Borrowed(s));
+        }
+        let mut buf = TextBuf::new();
+        self.text(&mut buf).map(|s| Cow::Owned(s.to_string()))
+    }
+
+    /// Like `to_string_repr`, formatting into `buf` instead of a new String.
+    /// Strings are borrowed; everything else is written without allocating
+    /// unless it outgrows the buffer (hex of long binaries, huge floats).
+    pub fn text<'b>(self, buf: &'b mut TextBuf) -> Option<&'b str>
+    where
+        'a: 'b,
+    {
+        buf.clear();
         match self {
-            CellValue::Null => None,
-            CellValue::Bool(v) => Some(if *v { "1".to_string() } else { "0".to_string() }),
-            CellValue::U8(v) => Some(v.to_string()),
-            CellValue::I16(v) => Some(v.to_string()),
-            CellValue::I32(v) => Some(v.to_string()),
-            CellValue::I64(v) => Some(v.to_string()),
-            CellValue::F32(v) => Some(v.to_string()),
-            CellValue::F64(v) => Some(v.to_string()),
-            CellValue::String(s) => Some(s.clone()),
-            CellValue::Bytes(b) => Some(hex::encode(b)),
-            CellValue::Date { days } => Some(format_date(*days)),
-            CellValue::Time { nanos } => Some(format_time(*nanos)),
-            CellValue::DateTime { micros } => Some(format_datetime(*micros)),
-            CellValue::DateTimeOffset { micros, offset_min } => {
-                let mut s = format_datetime(*micros);
-                let sign = if *offset_min >= 0 { "+" } else { "-" };
-                let abs = offset_min.unsigned_abs();
-                s.push_str(&format!(" {}{:02}:{:02}", sign, abs / 60, abs % 60));
-                Some(s)
+            Cell::Null => return None,
+            Cell::Str(s) => return Some(s),
+            Cell::Wide(b) => buf.push_utf16(b),
+            Cell::Bool(v) => buf.push(if v { b"1" } else { b"0" }),
+            Cell::U8(v) => write_int(buf, v as i64),
+            Cell::I16(v) => write_int(buf, v as i64),
+            Cell::I32(v) => write_int(buf, v as i64),
+            Cell::I64(v) => write_int(buf, v),
+            Cell::F32(v) => {
+                let _ = write!(buf, "{}", v);
+            }
+            Cell::F64(v) => {
+                let _ = write!(buf, "{}", v);
+            }
+            Cell::Bytes(b) => {
+                for &byte in b {
+                    buf.push(&[
+                        HEX_LOWER[(byte >> 4) as usize],
+                        HEX_LOWER[(byte & 15) as usize],
+                    ]);
+                }
+            }
+            Cell::Date { days } => write_date(buf, days),
+            Cell::Time { nanos } => write_time(buf, nanos),
+            Cell::DateTime { micros } => write_datetime(buf, micros),
+            Cell::DateTimeOffset { micros, offset_min } => {
+                write_datetime(buf, micros);
+                let abs = offset_min.unsigned_abs() as u32;
+                buf.push(if offset_min >= 0 { b" +" } else { b" -" });
+                write2(buf, abs / 60);
+                buf.push(b":");
+                write2(buf, abs % 60);
             }
-            CellValue::Decimal { value, scale, .. } => Some(format_decimal(*value, *scale)),
-            CellValue::Guid(bytes) => Some(format_guid_str(bytes)),
-            CellValue::Utf16(u) => Some(String::from_utf16_lossy(u)),
+            Cell::Decimal { value, scale, .. } => write_decimal(buf, value, scale),
+            Cell::Guid(bytes) => write_guid(buf, &bytes),
+        }
+        Some(buf.as_str())
+    }
+}
+
+/// Stack buffer for the text of one cell. Formatted values of every fixed
+/// type fit; what does not moves to `spill`.
+pub struct TextBuf {
+    inline: [u8; 64],
+    len: usize,
+    spill: String,
+}
+
+impl Default for TextBuf {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl TextBuf {
+    pub fn new() -> Self {
+        TextBuf {
+            inline: [0; 64],
+            len: 0,
+            spill: String::new(),
+        }
+    }
+
+    pub fn clear(&mut self) {
+        self.len = 0;
+        self.spill.clear();
+    }
+
+    /// Append ASCII bytes
+    fn push(&mut self, bytes: &[u8]) {
+        let _ = self.write_str(std::str::from_utf8(bytes).unwrap_or_default());
+    }
+
+    /// Append UTF-16LE text held as bytes, transcoded straight into `spill`
+    fn push_utf16(&mut self, bytes: &[u8]) {
+        if self.spill.is_empty() {
+            let inline = std::str::from_utf8(&self.inline[..self.len]).unwrap_or_default();
+            self.spill.push_str(inline);
+        }
+        // SAFETY: decode_le_into appends valid UTF-8 only
+        utf16::decode_le_into(bytes, unsafe { self.spill.as_mut_vec() });
+    }
+
+    pub fn as_str(&self) -> &str {
+        if self.spill.is_empty() {
+            // Only ASCII and whole str slices are ever written
+            std::str::from_utf8(&self.inline[..self.len]).unwrap_or_default()
+        } else {
+            &self.spill
         }
     }
 }
 
-fn days_to_ymd(days: i32) -> (i32, u32, u32) {
+impl std::fmt::Write for TextBuf {
+    fn write_str(&mut self, s: &str) -> std::fmt::Result {
+        let end = self.len + s.len();
+        if self.spill.is_empty() && end <= self.inline.len() {
+            self.inline[self.len..end].copy_from_slice(s.as_bytes());
+            self.len = end;
+            return Ok(());
+        }
+        if self.spill.is_empty() {
+            let inline = std::str::from_utf8(&self.inline[..self.len]).unwrap_or_default();
+            self.spill.push_str(inline);
+        }
+        self.spill.push_str(s);
+        Ok(())
+    }
+}
+
+/// "00" through "99", two bytes per entry
+const DIGIT_PAIRS: &[u8; 200] = b"\
+    0001020304050607080910111213141516171819\
+    2021222324252627282930313233343536373839\
+    4041424344454647484950515253545556575859\
+    6061626364656667686970717273747576777879\
+    8081828384858687888990919293949596979899";
+
+const HEX_LOWER: &[u8; 16] = b"0123456789abcdef";
+const HEX_UPPER: &[u8; 16] = b"0123456789ABCDEF";
+
+/// Two digits, zero-padded; `v` < 100
+fn write2(buf: &mut TextBuf, v: u32) {
+    let i = v as usize * 2;
+    buf.push(&DIGIT_PAIRS[i..i + 2]);
+}
+
+fn write3(buf: &mut TextBuf, v: u32) {
+    buf.push(&[b'0' + (v / 100) as u8]);
+    write2(buf, v % 100);
+}
+
+fn write_year(buf: &mut TextBuf, y: i32) {
+    if (0..10000).contains(&y) {
+        write2(buf, y as u32 / 100);
+        write2(buf, y as u32 % 100);
+    } else {
+        let _ = write!(buf, "{:04}", y);
+    }
+}
+
+/// Digits of `v` at the end of `out`; returns where they start
+fn u128_digits(mut v: u128, out: &mut [u8; 40]) -> usize {
+    const CHUNK: u128 = 10_000_000_000_000_000_000; // 10^19
+    let mut pos = out.len();
+    // Peel 19-digit chunks so the bulk of the work is u64 arithmetic
+    while v >= CHUNK {
+        let mut chunk = (v % CHUNK) as u64;
+        v /= CHUNK;
+        for _ in 0..19 {
+            pos -= 1;
+            out[pos] = b'0' + (chunk % 10) as u8;
+            chunk /= 10;
+        }
+    }
+    let mut rest = v as u64;
+    while rest >= 100 {
+        let i = (rest % 100) as usize * 2;
+        rest /= 100;
+        pos -= 2;
+        out[pos..pos + 2].copy_from_slice(&DIGIT_PAIRS[i..i + 2]);
+    }
+    if rest >= 10 {
+        let i = rest as usize * 2;
+        pos -= 2;
+        out[pos..pos + 2].copy_from_slice(&DIGIT_PAIRS[i..i + 2]);
+    } else {
+        pos -= 1;
+        out[pos] = b'0' + rest as u8;
+    }
+    pos
+}
+
+fn write_int(buf: &mut TextBuf, v: i64) {
+    if v < 0 {
+        buf.push(b"-");
+    }
+    let mut digits = [0u8; 40];
+    let start = u128_digits(v.unsigned_abs() as u128, &mut digits);
+    buf.push(&digits[start..]);
+}
+
+pub fn days_to_ymd(days: i32) -> (i32, u32, u32) {
     let d = days + 719468i32;
     let era = if d >= 0 { d } else { d - 146096 } / 146097;
     let doe = (d - era * 146097) as u32;
@@ -85,18 +362,41 @@ fn days_to_ymd(days: i32) -> (i32, u32, u32) {
     (year, m, day)
 }
 
-fn format_date(days: i32) -> String {
+/// YYYY-MM-DD
+fn write_ymd(buf: &mut TextBuf, y: i32, m: u32, d: u32) {
+    write_year(buf, y);
+    buf.push(b"-");
+    write2(buf, m);
+    buf.push(b"-");
+    write2(buf, d);
+}
+
+/// HH:MM:SS.fff
+fn write_hms(buf: &mut TextBuf, h: u32, m: u32, s: u32, millis: u32) {
+    write2(buf, h);
+    buf.push(b":");
+    write2(buf, m);
+    buf.push(b":");
+    write2(buf, s);
+    buf.push(b".");
+    write3(buf, millis);
+}
+
+fn write_date(buf: &mut TextBuf, days: i32) {
     let (y, m, d) = days_to_ymd(days);
-    format!("{:04}-{:02}-{:02}", y, m, d)
+    write_ymd(buf, y, m, d);
 }
 
-fn format_time(nanos: i64) -> String {
+fn write_time(buf: &mut TextBuf, nanos: i64) {
     let total_secs = (nanos / 1_000_000_000) as u32;
-    let h = total_secs / 3600;
-    let m = (total_secs % 3600) / 60;
-    let s = total_secs % 60;
     let frac = (nanos % 1_000_000_000) / 1_000_000;
-    format!("{:02}:{:02}:{:02}.{:03}", h, m, s, frac)
+    write_hms(
+        buf,
+        total_secs / 3600,
+        (total_secs % 3600) / 60,
+        total_secs % 60,
+        frac as u32,
+    );
 }
 
 pub fn micros_to_timestamp_parts(micros: i64) -> (i32, u32, u32, u32, u32, u32, u32) {
@@ -112,49 +412,48 @@ pub fn micros_to_timestamp_parts(micros: i64) -> (i32, u32, u32, u32, u32, u32,
     (year, month, day, h, mi, sec, millis)
 }
 
-fn format_datetime(micros: i64) -> String {
+fn write_datetime(buf: &mut TextBuf, micros: i64) {
     let (year, m, d, h, mi, sec, millis) = micros_to_timestamp_parts(micros);
-    format!(
-        "{:04}-{:02}-{:02} {:02}:{:02}:{:02}.{:03}",
-        year, m, d, h, mi, sec, millis
-    )
+    write_ymd(buf, year, m, d);
+    buf.push(b" ");
+    write_hms(buf, h, mi, sec, millis);
 }
 
-fn format_decimal(value: i128, scale: u8) -> String {
-    let negative = value < 0;
-    let abs = value.unsigned_abs();
-    let s = abs.to_string();
+fn write_decimal(buf: &mut TextBuf, value: i128, scale: u8) {
+    if value < 0 {
+        buf.push(b"-");
+    }
+    let mut digits = [0u8; 40];
+    let start = u128_digits(value.unsigned_abs(), &mut digits);
+    let digits = &digits[start..];
     let scale = scale as usize;
-    let result = if scale == 0 {
-        s
-    } else if s.len() <= scale {
-        format!("0.{}{}", "0".repeat(scale - s.len()), s)
-    } else {
-        let (int_part, frac_part) = s.split_at(s.len() - scale);
-        format!("{}.{}", int_part, frac_part)
-    };
-    if negative {
-        format!("-{}", result)
+    if scale == 0 {
+        buf.push(digits);
+    } else if digits.len() <= scale {
+        buf.push(b"0.");
+        for _ in digits.len()..scale {
+            buf.push(b"0");
+        }
+        buf.push(digits);
     } else {
-        result
+        let (int_part, frac_part) = digits.split_at(digits.len() - scale);
+        buf.push(int_part);
+        buf.push(b".");
+        buf.push(frac_part);
     }
 }
 
-fn format_guid_str(bytes: &[u8; 16]) -> String {
-    format!(
-        "{:08X}-{:04X}-{:04X}-{:02X}{:02X}-{:02X}{:02X}{:02X}{:02X}{:02X}{:02X}",
-        u32::from_be_bytes([bytes[0], bytes[1], bytes[2], bytes[3]]),
-        u16::from_be_bytes([bytes[4], bytes[5]]),
-        u16::from_be_bytes([bytes[6], bytes[7]]),
-        bytes[8],
-        bytes[9],
-        bytes[10],
-        bytes[11],
-        bytes[12],
-        bytes[13],
-        bytes[14],
-        bytes[15]
-    )
+/// Uppercase 8-4-4-4-12 form; the first three groups are stored big-endian
+fn write_guid(buf: &mut TextBuf, bytes: &[u8; 16]) {
+    for (i, &byte) in bytes.iter().enumerate() {
+        if matches!(i, 4 | 6 | 8 | 10) {
+            buf.push(b"-");
+        }
+        buf.push(&[
+            HEX_UPPER[(byte >> 4) as usize],
+            HEX_UPPER[(byte & 15) as usize],
+        ]);
+    }
 }
 
 /// Diagnostic record
@@ -165,6 +464,7 @@ pub struct DiagRecord {
 }
 
 /// Column descriptor
+#[derive(Clone)]
 pub struct ColumnDesc {
     pub name: String,
     pub sql_type: SQLSMALLINT,
@@ -173,16 +473,58 @@ pub struct ColumnDesc {
     pub nullable: SQLSMALLINT,
 }
 
+impl ColumnDesc {
+    /// Whether values can be arbitrarily large: the MAX types, which are
+    /// sent as PLP, and the legacy text types
+    pub fn is_lob(&self) -> bool {
+        match self.sql_type {
+            SQL_LONGVARCHAR | SQL_WLONGVARCHAR | SQL_LONGVARBINARY => true,
+            SQL_VARCHAR | SQL_WVARCHAR | SQL_VARBINARY => self.size == 0,
+            _ => false,
+        }
+    }
+}
+
+/// Lock serializing the calls on a connection and on its statements.
+///
+/// Every entry point that reads or changes a connection or statement holds
+/// the connection's lock for the whole call, so statements sharing a
+/// connection (and its single TDS session) run one call at a time, while
+/// calls on different connections never wait on each other. The lock is
+/// reentrant because entry points call one another (the W functions,
+/// SQLCloseCursor, SQLFreeStmt(SQL_DROP)). An asynchronous call takes it on
+/// the worker that runs it, not on the thread that started it.
+///
+/// SQLCancel never waits for the lock, which the call it interrupts may be
+/// holding: it only signals the statement's asynchronous call and its
+/// request in flight. The environment's connection list has its own lock,
+/// held only while a handle is added or removed.
+pub type ConnLock = std::sync::Arc<parking_lot::ReentrantMutex<()>>;
+pub type ConnGuard =
+    parking_lot::ArcReentrantMutexGuard<parking_lot::RawMutex, parking_lot::RawThreadId, ()>;
+
 /// Environment handle
 pub struct Environment {
     pub odbc_version: SQLINTEGER,
-    pub connections: Vec<*mut Connection>,
+    pub connections: parking_lot::Mutex<Vec<*mut Connection>>,
+    pub pool: std::sync::Mutex<crate::pool::Pool>,
+    /// Workers running the asynchronous calls of all its connections
+    pub engine: std::sync::Arc<crate::asyncexec::Engine>,
 }
 
 /// Connection handle
 pub struct Connection {
     pub env: *mut Environment,
-    pub client: Option<tabby::SyncClient<std::net::TcpStream>>,
+    /// Set when the handle is allocated and never replaced
+    pub serial: ConnLock,
+    pub client: Option<tabby::SyncClient<crate::stream::TdsStream>>,
+    /// Cancels the request in flight on `client` (SQLCancel, query timeout)
+    pub attention: Option<std::sync::Arc<crate::stream::Attention>>,
+    pub login_timeout: SQLULEN, // SQL_ATTR_LOGIN_TIMEOUT in seconds, 0 = none
+    pub packet_size: SQLULEN,   // SQL_ATTR_PACKET_SIZE, the session's once connected
+    pub prefetch_bytes: usize,  // PrefetchBytes= keyword, inherited by new statements
+    pub buffer_bytes: usize,    // BufferBytes= keyword, memory for rows buffered for MARS
+    pub read_ahead: bool,       // ReadAhead= keyword, inherited by new statements
     pub server: String,
     pub database: String,
     pub uid: String,
@@ -192,13 +534,112 @@ pub struct Connection {
     pub connected: bool,
     pub autocommit: bool,
     pub in_transaction: bool,
+    pub prepared: PreparedCache,
+    /// Descriptors of the result sets returned on the connection
+    pub column_cache: ColumnCache,
+    /// Results of catalog functions (SQLTables, SQLColumns, ...)
+    pub catalog_cache: crate::catalog::CatalogCache,
+    /// Pool this connection's session returns to on disconnect (Pooling=yes)
+    pub pooling: Option<(crate::pool::PoolKey, crate::pool::PoolConfig)>,
+    pub session_created: std::time::Instant,
+    /// Bulk copy started by furball_bcp_init
+    pub bulk: Option<crate::bulk::BulkCopy>,
+    /// SQL_ATTR_ASYNC_ENABLE, inherited by new statements
+    pub async_enable: bool,
+    /// Statement whose asynchronous call owns the wire, or null
+    pub async_stmt: *mut Statement,
+    /// SQL_ATTR_FB_STATS, less the session traffic, which is counted from
+    /// `traffic_base` on
+    pub stats: crate::stats::Stats,
+    pub traffic_base: crate::stream::Traffic,
+    /// Trace= keyword
+    pub trace: Option<crate::stats::Trace>,
+    /// How the session was opened, for the sessions of a partitioned extract
+    pub login: Option<crate::connect::Login>,
+}
+
+impl Connection {
+    /// Wait for the other calls on the connection and its statements
+    pub fn lock(&self) -> ConnGuard {
+        self.serial.lock_arc()
+    }
+}
+
+/// Number of server-side prepared statements kept per connection
+pub const PREPARED_CACHE_SIZE: usize = 128;
+
+/// Server-side prepared statement handles (sp_prepare) shared by all
+/// statements on a connection, keyed by parameter list and statement text.
+/// Least recently used handles are evicted once `capacity` is reached; their
+/// sp_unprepare calls are queued in `evicted` and sent with the next request.
+pub struct PreparedCache {
+    entries: std::collections::HashMap<String, (i32, u64)>,
+    pub evicted: Vec<i32>,
+    capacity: usize,
+    tick: u64,
+}
+
+impl PreparedCache {
+    pub fn new(capacity: usize) -> Self {
+        Self {
+            entries: std::collections::HashMap::new(),
+            evicted: Vec::new(),
+            capacity,
+            tick: 0,
+        }
+    }
+
+    pub fn get(&mut self, key: &str) -> Option<i32> {
+        self.tick += 1;
+        let tick = self.tick;
+        self.entries.get_mut(key).map(|e| {
+            e.1 = tick;
+            e.0
+        })
+    }
+
+    /// Make room for one more entry, queueing the evicted handle for unprepare.
+    pub fn reserve(&mut self) {
+        if self.entries.len() < self.capacity {
+            return;
+        }
+        let oldest = self
+            .entries
+            .iter()
+            .min_by_key(|(_, e)| e.1)
+            .map(|(k, _)| k.clone());
+        if let Some(k) = oldest {
+            if let Some((handle, _)) = self.entries.remove(&k) {
+                self.evicted.push(handle);
+            }
+        }
+    }
+
+    pub fn insert(&mut self, key: String, handle: i32) {
+        self.tick += 1;
+        self.entries.insert(key, (handle, self.tick));
+    }
+
+    /// Forget a handle the server no longer knows about.
+    pub fn remove(&mut self, key: &str) {
+        self.entries.remove(key);
+    }
+
+    /// Remove every entry, returning all handles still prepared on the server.
+    pub fn drain(&mut self) -> Vec<i32> {
+        let mut handles = std::mem::take(&mut self.evicted);
+        handles.extend(self.entries.drain().map(|(_, e)| e.0));
+        handles
+    }
 }
 
 /// Statement handle  
 pub struct Statement {
     pub conn: *mut Connection,
-    pub columns: Vec<ColumnDesc>,
-    pub rows: Vec<Vec<CellValue>>,
+    pub columns: Columns,
+    /// Buffered rows: the whole result set, or while streaming the rows
+    /// read ahead of the application (current rowset first)
+    pub rows: RowBatch,
     pub row_index: isize, // -1 = before first row
     pub diagnostics: Vec<DiagRecord>,
     pub executed: bool,
@@ -206,22 +647,85 @@ pub struct Statement {
     pub row_count: SQLLEN,
     pub bound_params: Vec<BoundParam>,
     pub read_offsets: Vec<usize>, // tracks how much of each column has been read (for chunked SQLGetData)
+    pub get_plans: Vec<Option<crate::fetch::ConvPlan>>, // SQLGetData conversion per column
+    pub wide_cols: std::sync::Arc<std::sync::atomic::AtomicU64>, // columns read as SQL_C_WCHAR (bit per column, first 64)
     pub paramset_size: usize,     // SQL_ATTR_PARAMSET_SIZE, default 1
+    pub query_timeout: SQLULEN,   // SQL_ATTR_QUERY_TIMEOUT in seconds, 0 = none
+    pub param_bind_type: SQLULEN, // SQL_ATTR_PARAM_BIND_TYPE, 0 = column-wise
+    pub param_bind_offset_ptr: *mut SQLULEN, // SQL_ATTR_PARAM_BIND_OFFSET_PTR
+    pub param_operation_ptr: *mut SQLUSMALLINT, // SQL_ATTR_PARAM_OPERATION_PTR
+    pub param_status_ptr: *mut SQLUSMALLINT, // SQL_ATTR_PARAM_STATUS_PTR
+    pub params_processed_ptr: *mut SQLULEN, // SQL_ATTR_PARAMS_PROCESSED_PTR
     // DAE (data-at-execution) state
     pub dae_sql: Option<String>, // SQL to execute once all DAE params are collected
     pub dae_params_needed: Vec<u16>, // param numbers that need DAE data (in order)
     pub dae_current_idx: usize,  // which dae_params_needed entry we're on
-    pub dae_collected: Vec<(u16, String)>, // (param_number, collected_data)
-    pub dae_current_buf: Vec<u8>, // buffer for current param being collected via SQLPutData
+    pub dae_collected: Vec<(u16, crate::dae::DaeValue)>, // values of the params done so far
+    pub dae_current: crate::dae::DaePut, // param being sent via SQLPutData
     // Multiple result sets
-    pub pending_result_sets: Vec<ResultSet>, // remaining result sets after the current one
+    pub pending_result_sets: std::collections::VecDeque<ResultSet>, // remaining result sets after the current one
+    pub spilled: Option<crate::spill::SpillReader>, // rest of the current result set, after `rows`
     // Streaming state
     pub streaming: bool, // true if we're in streaming mode (batch_start was called)
     pub stream_string_buf: String, // reusable buffer for streaming decode
     pub stream_bytes_buf: Vec<u8>, // reusable buffer for streaming decode
-    pub current_row: Vec<CellValue>, // single-row buffer for streaming fetch
-    pub prefetch_buffer: VecDeque<Vec<CellValue>>, // pre-fetched rows for streaming mode
     pub prefetch_done: Option<PrefetchTerminal>, // terminal state from prefetch
+    pub prefetch_bytes: usize, // SQL_ATTR_FB_PREFETCH_BYTES, read-ahead memory budget
+    pub prefetch_rows: usize, // adaptive read-ahead target, in rows
+    pub prefetch_refilled: Option<std::time::Instant>, // end of the last refill
+    pub read_ahead: bool, // SQL_ATTR_FB_READ_AHEAD
+    pub reader: Option<crate::readahead::ReadAhead>, // read-ahead thread of the open result set
+    pub reader_traffic: crate::stream::Traffic, // session traffic when `reader` started
+    pub buffered: bool,  // rest of the reply read into memory for another statement
+    pub lob_rows: bool,  // the open result set has LOB columns: read a rowset at a time
+    // Partitioned extract
+    pub partitions: usize, // SQL_ATTR_FB_PARTITIONS, 0 or 1 = not partitioned
+    pub partition_key: String, // SQL_ATTR_FB_PARTITION_KEY
+    pub partition_ordered: bool, // SQL_ATTR_FB_PARTITION_ORDERED
+    pub partitioned: Option<crate::partition::Partitioned>, // sessions of the open result set
+    pub partition_attention: crate::partition::Attentions, // theirs, for SQLCancel
+    // Bound columns and block cursor state
+    pub bound_cols: Vec<BoundCol>,
+    pub bound_plans: Vec<Option<crate::fetch::ConvPlan>>, // conversion per entry of bound_cols
+    pub row_array_size: usize,                            // SQL_ATTR_ROW_ARRAY_SIZE, default 1
+    pub row_bind_type: SQLULEN,                           // SQL_ATTR_ROW_BIND_TYPE, 0 = column-wise
+    pub row_bind_offset_ptr: *mut SQLULEN,                // SQL_ATTR_ROW_BIND_OFFSET_PTR
+    pub rows_fetched_ptr: *mut SQLULEN,                   // SQL_ATTR_ROWS_FETCHED_PTR
+    pub row_status_ptr: *mut SQLUSMALLINT,                // SQL_ATTR_ROW_STATUS_PTR
+    pub rowset_len: usize,                                // rows in the current rowset
+    // Scrollable cursors
+    pub cursor_type: SQLULEN,                  // SQL_ATTR_CURSOR_TYPE
+    pub concurrency: SQLULEN,                  // SQL_ATTR_CONCURRENCY
+    pub cursor: Option<crate::cursor::Cursor>, // scrollable cursor of the open result
+    // Asynchronous execution
+    pub async_enable: bool,      // SQL_ATTR_ASYNC_ENABLE
+    pub async_event: SQLPOINTER, // SQL_ATTR_ASYNC_STMT_EVENT
+    pub async_callback: Option<crate::asyncexec::NotifyCallback>, // SQL_ATTR_ASYNC_STMT_PCALLBACK
+    pub async_context: SQLPOINTER, // SQL_ATTR_ASYNC_STMT_PCONTEXT
+    pub async_op: Option<crate::asyncexec::AsyncOp>, // call running on a worker
+    // Performance counters
+    pub stats: crate::stats::Stats, // SQL_ATTR_FB_STATS
+    pub execution: Option<crate::stats::Execution>, // execution being timed
+}
+
+impl Statement {
+    /// Lock of the statement's connection, see ConnLock
+    pub fn lock(&self) -> Option<ConnGuard> {
+        (!self.conn.is_null()).then(|| unsafe { &*self.conn }.lock())
+    }
+
+    /// Lock of the statement's connection if no other thread holds it, or
+    /// Err while another call on the connection is running
+    pub fn try_lock(&self) -> Result<Option<ConnGuard>, ()> {
+        if self.conn.is_null() {
+            return Ok(None);
+        }
+        unsafe { &*self.conn }
+            .serial
+            .try_lock_arc()
+            .map(Some)
+            .ok_or(())
+    }
 }
 
 /// Terminal state saved when prefetch batch hits end-of-stream
@@ -244,19 +748,30 @@ pub struct BoundParam {
     pub len_ind_ptr: *mut SQLLEN,
 }
 
+/// A column bound with SQLBindCol
+pub struct BoundCol {
+    pub col_number: u16,
+    pub target_type: SQLSMALLINT,
+    pub target_value: SQLPOINTER,
+    pub buffer_length: SQLLEN,
+    pub str_len_or_ind: *mut SQLLEN,
+}
+
 /// A single result set (columns + rows)
+#[derive(Clone)]
 pub struct ResultSet {
-    pub columns: Vec<ColumnDesc>,
-    pub rows: Vec<Vec<CellValue>>,
+    pub columns: Columns,
+    pub rows: RowBatch,
+    /// Rows after `rows` that did not fit the memory budget
+    pub spill: Option<std::sync::Arc<crate::spill::Spill>>,
     pub done_rows: u64,
 }
 
 // RowWriter implementation that stores typed values directly
 pub struct StringRowWriter {
     pub result_sets: Vec<ResultSet>,
-    current_columns: Vec<ColumnDesc>,
-    current_rows: Vec<Vec<CellValue>>,
-    current_row: Vec<CellValue>,
+    current_columns: Columns,
+    current_rows: RowBatch,
     got_metadata: bool,
     pub done_rows: u64,
     pub info_messages: Vec<(u32, String)>,
@@ -266,9 +781,8 @@ impl StringRowWriter {
     pub fn new() -> Self {
         Self {
             result_sets: Vec::new(),
-            current_columns: Vec::new(),
-            current_rows: Vec::new(),
-            current_row: Vec::new(),
+            current_columns: Columns::default(),
+            current_rows: RowBatch::default(),
             got_metadata: false,
             done_rows: 0,
             info_messages: Vec::new(),
@@ -282,6 +796,7 @@ impl StringRowWriter {
             self.result_sets.push(ResultSet {
                 columns: std::mem::take(&mut self.current_columns),
                 rows: std::mem::take(&mut self.current_rows),
+                spill: None,
                 done_rows: self.done_rows,
             });
             self.got_metadata = false;
@@ -290,30 +805,108 @@ impl StringRowWriter {
     }
 }
 
+/// Column descriptors of a result set, shared by the statements and
+/// executions that return the same columns
+pub type Columns = std::sync::Arc<[ColumnDesc]>;
+
+/// Describe a result column for SQLDescribeCol and friends
+pub fn column_desc(c: &tabby::Column) -> ColumnDesc {
+    let (sql_type, size, decimal_digits, nullable) = sql_type_from_column(c);
+    ColumnDesc {
+        name: c.name().to_string(),
+        sql_type,
+        size,
+        decimal_digits,
+        nullable,
+    }
+}
+
+/// Number of result set shapes whose descriptors a connection keeps
+pub const COLUMN_CACHE_SIZE: usize = 64;
+
+/// Descriptors of the result sets seen on a connection, keyed by a hash of
+/// their column metadata (names, types, lengths, nullability). A statement
+/// executed again gets the descriptors of its last execution back instead
+/// of allocating new ones. Least recently used shapes are evicted.
+pub struct ColumnCache {
+    entries: std::collections::HashMap<u64, (Columns, u64)>,
+    tick: u64,
+}
+
+impl ColumnCache {
+    pub fn new() -> Self {
+        Self {
+            entries: std::collections::HashMap::new(),
+            tick: 0,
+        }
+    }
+
+    /// Descriptors for `columns`
+    pub fn get(&mut self, columns: &[tabby::Column]) -> Columns {
+        use std::hash::{Hash, Hasher};
+        if columns.is_empty() {
+            return Columns::default();
+        }
+        let mut hasher = std::hash::DefaultHasher::new();
+        for c in columns {
+            c.name().hash(&mut hasher);
+            sql_type_from_column(c).hash(&mut hasher);
+        }
+        let key = hasher.finish();
+        self.tick += 1;
+        if let Some((cached, used)) = self.entries.get_mut(&key) {
+            let same = cached.len() == columns.len()
+                && cached.iter().zip(columns).all(|(d, c)| {
+                    d.name == c.name()
+                        && (d.sql_type, d.size, d.decimal_digits, d.nullable)
+                            == sql_type_from_column(c)
+                });
+            if same {
+                *used = self.tick;
+                return cached.clone();
+            }
+        }
+        if self.entries.len() >= COLUMN_CACHE_SIZE && !self.entries.contains_key(&key) {
+            let oldest = self
+                .entries
+                .iter()
+                .min_by_key(|(_, e)| e.1)
+                .map(|(k, _)| *k);
+            if let Some(k) = oldest {
+                self.entries.remove(&k);
+            }
+        }
+        let descs: Columns = columns.iter().map(column_desc).collect();
+        self.entries.insert(key, (descs.clone(), self.tick));
+        descs
+    }
+}
+
 pub fn sql_type_from_column(c: &tabby::Column) -> (SQLSMALLINT, SQLULEN, SQLSMALLINT, SQLSMALLINT) {
-    let type_name = format!("{:?}", c.column_type());
-    let sql_type = match type_name.as_str() {
-        "Int4" => SQL_INTEGER,
-        "Int2" => SQL_SMALLINT,
-        "Int1" => SQL_TINYINT,
-        "Int8" | "Intn" => SQL_BIGINT,
-        "Float8" | "Floatn" => SQL_DOUBLE,
-        "Float4" => SQL_REAL,
-        "Bit" | "Bitn" => SQL_BIT,
-        "BigVarChar" => SQL_VARCHAR,
-        "NVarchar" => SQL_WVARCHAR,
-        "BigChar" => SQL_CHAR,
-        "NChar" => SQL_WCHAR,
-        "Text" => SQL_LONGVARCHAR,
-        "NText" => SQL_WLONGVARCHAR,
-        "BigBinary" => SQL_BINARY,
-        "BigVarBin" => SQL_VARBINARY,
-        "Image" => SQL_LONGVARBINARY,
-        "Decimaln" | "Numericn" | "Money" | "Money4" => SQL_DECIMAL,
-        "Datetime" | "Datetimen" | "Datetime4" | "Datetime2" => SQL_TYPE_TIMESTAMP,
-        "Daten" => SQL_TYPE_DATE,
-        "Timen" => SQL_TYPE_TIME,
-        "Guid" => SQL_GUID,
+    use tabby::ColumnType as T;
+    let ty = c.column_type();
+    let sql_type = match ty {
+        T::Int4 => SQL_INTEGER,
+        T::Int2 => SQL_SMALLINT,
+        T::Int1 => SQL_TINYINT,
+        T::Int8 | T::Intn => SQL_BIGINT,
+        T::Float8 | T::Floatn => SQL_DOUBLE,
+        T::Float4 => SQL_REAL,
+        T::Bit | T::Bitn => SQL_BIT,
+        T::BigVarChar => SQL_VARCHAR,
+        T::NVarchar => SQL_WVARCHAR,
+        T::BigChar => SQL_CHAR,
+        T::NChar => SQL_WCHAR,
+        T::Text => SQL_LONGVARCHAR,
+        T::NText => SQL_WLONGVARCHAR,
+        T::BigBinary => SQL_BINARY,
+        T::BigVarBin => SQL_VARBINARY,
+        T::Image => SQL_LONGVARBINARY,
+        T::Decimaln | T::Numericn | T::Money | T::Money4 => SQL_DECIMAL,
+        T::Datetime | T::Datetimen | T::Datetime4 | T::Datetime2 => SQL_TYPE_TIMESTAMP,
+        T::Daten => SQL_TYPE_DATE,
+        T::Timen => SQL_TYPE_TIME,
+        T::Guid => SQL_GUID,
         _ => SQL_VARCHAR,
     };
     let nullable = if c.nullable().unwrap_or(true) {
@@ -343,6 +936,12 @@ pub fn sql_type_from_column(c: &tabby::Column) -> (SQLSMALLINT, SQLULEN, SQLSMAL
             {
                 decimal_digits = *scale as SQLSMALLINT;
                 *precision as SQLULEN
+            } else if ty == T::Money {
+                decimal_digits = 4;
+                19
+            } else if ty == T::Money4 {
+                decimal_digits = 4;
+                10
             } else {
                 38
             }
@@ -396,33 +995,18 @@ impl RowWriter for StringRowWriter {
             self.result_sets.push(ResultSet {
                 columns: std::mem::take(&mut self.current_columns),
                 rows: std::mem::take(&mut self.current_rows),
+                spill: None,
                 done_rows: self.done_rows,
             });
             self.done_rows = 0;
         }
         self.got_metadata = true;
-        self.current_columns = columns
-            .iter()
-            .map(|c| {
-                let (sql_type, size, decimal_digits, nullable) = sql_type_from_column(c);
-                ColumnDesc {
-                    name: c.name().to_string(),
-                    sql_type,
-                    size,
-                    decimal_digits,
-                    nullable,
-                }
-            })
-            .collect();
+        self.current_columns = columns.iter().map(column_desc).collect();
     }
 
     fn on_row_done(&mut self) {
         if self.got_metadata {
-            let row = std::mem::replace(
-                &mut self.current_row,
-                Vec::with_capacity(self.current_columns.len()),
-            );
-            self.current_rows.push(row);
+            self.current_rows.finish_row();
         }
     }
 
@@ -435,74 +1019,63 @@ impl RowWriter for StringRowWriter {
     }
 
     fn write_null(&mut self, _col: usize) {
-        self.current_row.push(CellValue::Null);
+        self.current_rows.push(Cell::Null);
     }
     fn write_bool(&mut self, _col: usize, val: bool) {
-        self.current_row.push(CellValue::Bool(val));
+        self.current_rows.push(Cell::Bool(val));
     }
     fn write_u8(&mut self, _col: usize, val: u8) {
-        self.current_row.push(CellValue::U8(val));
+        self.current_rows.push(Cell::U8(val));
     }
     fn write_i16(&mut self, _col: usize, val: i16) {
-        self.current_row.push(CellValue::I16(val));
+        self.current_rows.push(Cell::I16(val));
     }
     fn write_i32(&mut self, _col: usize, val: i32) {
-        self.current_row.push(CellValue::I32(val));
+        self.current_rows.push(Cell::I32(val));
     }
     fn write_i64(&mut self, _col: usize, val: i64) {
-        self.current_row.push(CellValue::I64(val));
+        self.current_rows.push(Cell::I64(val));
     }
     fn write_f32(&mut self, _col: usize, val: f32) {
-        self.current_row.push(CellValue::F32(val));
+        self.current_rows.push(Cell::F32(val));
     }
     fn write_f64(&mut self, _col: usize, val: f64) {
-        self.current_row.push(CellValue::F64(val));
+        self.current_rows.push(Cell::F64(val));
     }
     fn write_str(&mut self, _col: usize, val: &str) {
-        self.current_row.push(CellValue::String(val.to_string()));
+        self.current_rows.push(Cell::Str(val));
     }
     fn write_utf16(&mut self, _col: usize, val: &[u16]) {
-        // On Linux, pyodbc requests SQL_C_CHAR (UTF-8), so store as String
-        // to avoid a redundant UTF-16→String conversion in get_data.
-        // On Windows (SQL_C_WCHAR), storing as Utf16 would be faster,
-        // but String works correctly for both paths.
-        self.current_row
-            .push(CellValue::String(String::from_utf16_lossy(val)));
+        // No column of this batch asks for UTF-16, so this stores UTF-8
+        self.current_rows.push_utf16(val);
     }
     fn write_bytes(&mut self, _col: usize, val: &[u8]) {
-        self.current_row.push(CellValue::Bytes(val.to_vec()));
+        self.current_rows.push(Cell::Bytes(val));
     }
     fn write_date(&mut self, _col: usize, days: i32) {
-        self.current_row.push(CellValue::Date { days });
+        self.current_rows.push(Cell::Date { days });
     }
     fn write_time(&mut self, _col: usize, nanos: i64) {
-        self.current_row.push(CellValue::Time { nanos });
+        self.current_rows.push(Cell::Time { nanos });
     }
     fn write_datetime(&mut self, _col: usize, micros: i64) {
-        self.current_row.push(CellValue::DateTime { micros });
+        self.current_rows.push(Cell::DateTime { micros });
     }
     fn write_datetimeoffset(&mut self, _col: usize, micros: i64, offset_minutes: i16) {
-        self.current_row.push(CellValue::DateTimeOffset {
+        self.current_rows.push(Cell::DateTimeOffset {
             micros,
             offset_min: offset_minutes,
         });
     }
     fn write_decimal(&mut self, _col: usize, value: i128, precision: u8, scale: u8) {
-        self.current_row.push(CellValue::Decimal {
+        self.current_rows.push(Cell::Decimal {
             value,
             precision,
             scale,
         });
     }
     fn write_guid(&mut self, _col: usize, bytes: &[u8; 16]) {
-        self.current_row.push(CellValue::Guid(*bytes));
-    }
-}
-
-// hex encode helper (avoid depending on hex crate)
-pub(crate) mod hex {
-    pub fn encode(data: &[u8]) -> String {
-        data.iter().map(|b| format!("{:02x}", b)).collect()
+        self.current_rows.push(Cell::Guid(*bytes));
     }
 }
 
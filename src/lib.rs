@@ -7,15 +7,30 @@
 #![allow(clippy::redundant_pattern_matching)]
 #![allow(clippy::useless_format)]
 
+mod arrow;
+mod asyncexec;
 mod attr;
+mod batch;
+mod bulk;
 mod catalog;
 mod connect;
+mod cursor;
+mod dae;
 mod diagnostics;
 mod execute;
 mod fetch;
 mod handle;
+mod params;
+mod partition;
+mod pool;
+mod readahead;
+mod spill;
+mod stats;
+mod stream;
 mod types;
+mod utf16;
 
+use asyncexec::AsyncFn;
 use handle::*;
 use std::ffi::CStr;
 use std::ptr;
@@ -24,22 +39,7 @@ use types::*;
 // ── Helper: extract string from SQLCHAR* + length ───────────────────
 
 fn wchar_to_string(ptr: *const SQLWCHAR, len: SQLSMALLINT) -> String {
-    if ptr.is_null() {
-        return String::new();
-    }
-    let count = if len < 0 {
-        let mut n = 0;
-        unsafe {
-            while *ptr.add(n) != 0 {
-                n += 1;
-            }
-        }
-        n
-    } else {
-        len as usize
-    };
-    let slice = unsafe { std::slice::from_raw_parts(ptr, count) };
-    String::from_utf16_lossy(slice)
+    unsafe { utf16::from_wide_ptr(ptr, len as isize) }
 }
 
 unsafe fn sql_str(ptr: *const SQLCHAR, len: SQLSMALLINT) -> String {
@@ -90,7 +90,9 @@ fn alloc_handle_impl(
         SQL_HANDLE_ENV => {
             let env = Box::new(Environment {
                 odbc_version: SQL_OV_ODBC3,
-                connections: Vec::new(),
+                connections: Default::default(),
+                pool: std::sync::Mutex::new(pool::Pool::default()),
+                engine: Default::default(),
             });
             unsafe {
                 *output_handle = Box::into_raw(env) as SQLHANDLE;
@@ -104,7 +106,14 @@ fn alloc_handle_impl(
                 } else {
                     input_handle as *mut Environment
                 },
+                serial: Default::default(),
                 client: None,
+                attention: None,
+                login_timeout: 0,
+                packet_size: 0,
+                prefetch_bytes: fetch::DEFAULT_PREFETCH_BYTES,
+                buffer_bytes: spill::DEFAULT_BUFFER_BYTES,
+                read_ahead: false,
                 server: String::new(),
                 database: String::new(),
                 uid: String::new(),
@@ -114,11 +123,23 @@ fn alloc_handle_impl(
                 connected: false,
                 autocommit: true,
                 in_transaction: false,
+                prepared: PreparedCache::new(PREPARED_CACHE_SIZE),
+                column_cache: ColumnCache::new(),
+                catalog_cache: catalog::CatalogCache::new(catalog::DEFAULT_CATALOG_TTL),
+                pooling: None,
+                session_created: std::time::Instant::now(),
+                bulk: None,
+                async_enable: false,
+                async_stmt: ptr::null_mut(),
+                stats: Default::default(),
+                traffic_base: Default::default(),
+                trace: None,
+                login: None,
             });
             let conn_ptr = Box::into_raw(conn);
             if !input_handle.is_null() {
-                let env = unsafe { &mut *(input_handle as *mut Environment) };
-                env.connections.push(conn_ptr);
+                let env = unsafe { &*(input_handle as *const Environment) };
+                env.connections.lock().push(conn_ptr);
             }
             unsafe {
                 *output_handle = conn_ptr as SQLHANDLE;
@@ -126,14 +147,22 @@ fn alloc_handle_impl(
             SQL_SUCCESS
         }
         SQL_HANDLE_STMT => {
+            let _lock = (!input_handle.is_null())
+                .then(|| unsafe { &*(input_handle as *const Connection) }.lock());
+            let (prefetch_bytes, read_ahead, async_enable) = if input_handle.is_null() {
+                (fetch::DEFAULT_PREFETCH_BYTES, false, false)
+            } else {
+                let conn = unsafe { &*(input_handle as *mut Connection) };
+                (conn.prefetch_bytes, conn.read_ahead, conn.async_enable)
+            };
             let stmt = Box::new(Statement {
                 conn: if input_handle.is_null() {
                     std::ptr::null_mut()
                 } else {
                     input_handle as *mut Connection
                 },
-                columns: Vec::new(),
-                rows: Vec::new(),
+                columns: Columns::default(),
+                rows: batch::RowBatch::default(),
                 row_index: -1,
                 diagnostics: Vec::new(),
                 executed: false,
@@ -141,19 +170,57 @@ fn alloc_handle_impl(
                 row_count: -1,
                 bound_params: Vec::new(),
                 read_offsets: Vec::new(),
+                get_plans: Vec::new(),
+                wide_cols: Default::default(),
                 paramset_size: 1,
+                query_timeout: 0,
+                param_bind_type: SQL_PARAM_BIND_BY_COLUMN,
+                param_bind_offset_ptr: ptr::null_mut(),
+                param_operation_ptr: ptr::null_mut(),
+                param_status_ptr: ptr::null_mut(),
+                params_processed_ptr: ptr::null_mut(),
                 dae_sql: None,
                 dae_params_needed: Vec::new(),
                 dae_current_idx: 0,
                 dae_collected: Vec::new(),
-                dae_current_buf: Vec::new(),
-                pending_result_sets: Vec::new(),
+                dae_current: dae::DaePut::default(),
+                pending_result_sets: std::collections::VecDeque::new(),
+                spilled: None,
                 streaming: false,
                 stream_string_buf: String::with_capacity(4096),
                 stream_bytes_buf: Vec::with_capacity(4096),
-                current_row: Vec::new(),
-                prefetch_buffer: std::collections::VecDeque::new(),
                 prefetch_done: None,
+                prefetch_bytes,
+                prefetch_rows: fetch::PREFETCH_ROWS,
+                prefetch_refilled: None,
+                read_ahead,
+                reader: None,
+                reader_traffic: Default::default(),
+                buffered: false,
+                lob_rows: false,
+                partitions: 0,
+                partition_key: String::new(),
+                partition_ordered: false,
+                partitioned: None,
+                partition_attention: Default::default(),
+                bound_cols: Vec::new(),
+                bound_plans: Vec::new(),
+                row_array_size: 1,
+                row_bind_type: SQL_BIND_BY_COLUMN,
+                row_bind_offset_ptr: ptr::null_mut(),
+                rows_fetched_ptr: ptr::null_mut(),
+                row_status_ptr: ptr::null_mut(),
+                rowset_len: 0,
+                cursor_type: SQL_CURSOR_FORWARD_ONLY,
+                concurrency: SQL_CONCUR_READ_ONLY,
+                cursor: None,
+                async_enable,
+                async_event: ptr::null_mut(),
+                async_callback: None,
+                async_context: ptr::null_mut(),
+                async_op: None,
+                stats: Default::default(),
+                execution: None,
             });
             let stmt_ptr = Box::into_raw(stmt);
             if !input_handle.is_null() {
@@ -189,17 +256,33 @@ fn free_handle_impl(handle_type: SQLSMALLINT, handle: SQLHANDLE) -> SQLRETURN {
             SQL_SUCCESS
         }
         SQL_HANDLE_DBC => {
+            if !unsafe { &*(handle as *const Connection) }
+                .async_stmt
+                .is_null()
+            {
+                return SQL_ERROR;
+            }
             let conn = unsafe { Box::from_raw(handle as *mut Connection) };
             // Remove from env's connection list
             if !conn.env.is_null() {
-                let env = unsafe { &mut *conn.env };
-                env.connections.retain(|&p| p != handle as *mut Connection);
+                let env = unsafe { &*conn.env };
+                env.connections
+                    .lock()
+                    .retain(|&p| p != handle as *mut Connection);
             }
             drop(conn);
             SQL_SUCCESS
         }
         SQL_HANDLE_STMT => {
-            let stmt = unsafe { Box::from_raw(handle as *mut Statement) };
+            if asyncexec::busy(unsafe { &mut *(handle as *mut Statement) }) {
+                return SQL_ERROR;
+            }
+            let mut stmt = unsafe { Box::from_raw(handle as *mut Statement) };
+            let _lock = stmt.lock();
+            if stmt.streaming {
+                execute::close_stream(&mut stmt);
+            }
+            cursor::close(&mut stmt);
             // Remove from connection's statement list
             if !stmt.conn.is_null() {
                 let conn = unsafe { &mut *stmt.conn };
@@ -223,32 +306,35 @@ pub extern "C" fn SQLFreeStmt(hstmt: SQLHSTMT, option: SQLUSMALLINT) -> SQLRETUR
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    // The statement belongs to its asynchronous call until that is collected
+    if asyncexec::busy(stmt) {
+        return SQL_ERROR;
+    }
+    let _lock = stmt.lock();
     match option {
         SQL_CLOSE => {
-            // If we're in streaming mode, drain the remaining tokens
+            // If we're in streaming mode, cancel the rest of the result
             if stmt.streaming {
-                let conn = unsafe { &mut *stmt.conn };
-                if let Some(client) = conn.client.as_mut() {
-                    let _ = client.batch_drain();
-                }
-                stmt.streaming = false;
+                execute::close_stream(stmt);
             }
-            stmt.columns.clear();
+            cursor::close(stmt);
+            stmt.columns = Columns::default();
             stmt.rows.clear();
+            stmt.spilled = None;
             stmt.row_index = -1;
             stmt.executed = false;
             stmt.row_count = -1;
             stmt.read_offsets.clear();
             stmt.pending_result_sets.clear();
-            stmt.current_row.clear();
-            stmt.prefetch_buffer.clear();
             stmt.prefetch_done = None;
             SQL_SUCCESS
         }
-        SQL_UNBIND | SQL_RESET_PARAMS => {
-            if option == SQL_RESET_PARAMS {
-                stmt.bound_params.clear();
-            }
+        SQL_UNBIND => {
+            stmt.bound_cols.clear();
+            SQL_SUCCESS
+        }
+        SQL_RESET_PARAMS => {
+            stmt.bound_params.clear();
             SQL_SUCCESS
         }
         SQL_DROP => free_handle_impl(SQL_HANDLE_STMT, hstmt),
@@ -273,6 +359,7 @@ pub extern "C" fn SQLDriverConnect(
         return SQL_INVALID_HANDLE;
     }
     let conn = unsafe { &mut *(hdbc as *mut Connection) };
+    let _lock = conn.lock();
     conn.diagnostics.clear();
 
     let conn_str = unsafe { sql_str(conn_str_in, conn_str_in_len) };
@@ -301,9 +388,102 @@ pub extern "C" fn SQLDisconnect(hdbc: SQLHDBC) -> SQLRETURN {
         return SQL_INVALID_HANDLE;
     }
     let conn = unsafe { &mut *(hdbc as *mut Connection) };
+    if asyncexec::conn_busy_any(conn) {
+        conn.diagnostics.push(DiagRecord {
+            state: "HY010".to_string(),
+            native_error: 0,
+            message: "Asynchronous call in progress".to_string(),
+        });
+        return SQL_ERROR;
+    }
+    let _lock = conn.lock();
     connect::disconnect(conn)
 }
 
+// ── Bulk copy ───────────────────────────────────────────────────────
+//
+// Driver extensions in the style of the bcp_* API, on the driver's own
+// connection handle (SQLGetInfo SQL_DRIVER_HDBC under a driver manager).
+
+/// Start a bulk copy into `table`. Every `batch_size` rows are committed as
+/// one batch (0 = only at furball_bcp_batch/done); `options` is a mask of
+/// FB_BCP_TABLOCK and FB_BCP_CHECK_CONSTRAINTS.
+#[unsafe(no_mangle)]
+pub extern "C" fn furball_bcp_init(
+    hdbc: SQLHDBC,
+    table: *const SQLCHAR,
+    table_len: SQLSMALLINT,
+    batch_size: SQLULEN,
+    options: SQLUINTEGER,
+) -> SQLRETURN {
+    if hdbc.is_null() {
+        return SQL_INVALID_HANDLE;
+    }
+    let conn = unsafe { &mut *(hdbc as *mut Connection) };
+    let _lock = conn.lock();
+    conn.diagnostics.clear();
+    let table = unsafe { sql_str(table, table_len) };
+    bulk::init(conn, &table, batch_size as u64, options)
+}
+
+/// Bind a buffer to table column `column` (1-based), read at each
+/// furball_bcp_sendrow, with the same indicator conventions as
+/// SQLBindParameter
+#[unsafe(no_mangle)]
+pub extern "C" fn furball_bcp_bind(
+    hdbc: SQLHDBC,
+    column: SQLUSMALLINT,
+    c_type: SQLSMALLINT,
+    value: SQLPOINTER,
+    buffer_length: SQLLEN,
+    len_ind: *mut SQLLEN,
+) -> SQLRETURN {
+    if hdbc.is_null() {
+        return SQL_INVALID_HANDLE;
+    }
+    let conn = unsafe { &mut *(hdbc as *mut Connection) };
+    let _lock = conn.lock();
+    conn.diagnostics.clear();
+    bulk::bind(conn, column, c_type, value, buffer_length, len_ind)
+}
+
+/// Copy one row from the bound buffers
+#[unsafe(no_mangle)]
+pub extern "C" fn furball_bcp_sendrow(hdbc: SQLHDBC) -> SQLRETURN {
+    if hdbc.is_null() {
+        return SQL_INVALID_HANDLE;
+    }
+    let conn = unsafe { &mut *(hdbc as *mut Connection) };
+    let _lock = conn.lock();
+    conn.diagnostics.clear();
+    bulk::send_row(conn)
+}
+
+/// Commit the rows sent since the last batch; `rows` receives their count
+#[unsafe(no_mangle)]
+pub extern "C" fn furball_bcp_batch(hdbc: SQLHDBC, rows: *mut SQLLEN) -> SQLRETURN {
+    if hdbc.is_null() {
+        return SQL_INVALID_HANDLE;
+    }
+    let conn = unsafe { &mut *(hdbc as *mut Connection) };
+    let _lock = conn.lock();
+    conn.diagnostics.clear();
+    bulk::batch(conn, rows)
+}
+
+/// Commit the last batch and end the bulk copy; `rows` receives the rows
+/// committed by all its batches
+#[unsafe(no_mangle)]
+pub extern "C" fn furball_bcp_done(hdbc: SQLHDBC, rows: *mut SQLLEN) -> SQLRETURN {
+    if hdbc.is_null() {
+        return SQL_INVALID_HANDLE;
+    }
+    let conn = unsafe { &mut *(hdbc as *mut Connection) };
+    let _lock = conn.lock();
+    conn.diagnostics.clear();
+    bulk::done(conn, rows)
+}
+
 // ── Execution ───────────────────────────────────────────────────────
 
 #[unsafe(no_mangle)]
@@ -316,14 +496,16 @@ pub extern "C" fn SQLExecDirect(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    if let Some(ret) = asyncexec::poll(stmt, AsyncFn::ExecDirect) {
+        return ret;
+    }
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
 
     let sql = unsafe { sql_str(statement_text, text_length as SQLSMALLINT) };
-    let final_sql = handle_exec_params(stmt, sql);
-    match final_sql {
-        Ok(s) => execute::exec_direct(stmt, &s),
-        Err(ret) => ret,
-    }
+    asyncexec::run(stmt, AsyncFn::ExecDirect, move |stmt| {
+        exec_direct_impl(stmt, sql)
+    })
 }
 
 #[unsafe(no_mangle)]
@@ -336,30 +518,26 @@ pub extern "C" fn SQLExecDirectW(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    if let Some(ret) = asyncexec::poll(stmt, AsyncFn::ExecDirect) {
+        return ret;
+    }
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
 
     // Convert UTF-16 to UTF-8
-    let sql = if statement_text.is_null() {
-        String::new()
-    } else {
-        let len = if text_length == SQL_NTS as SQLINTEGER {
-            let mut l = 0usize;
-            unsafe {
-                while *statement_text.add(l) != 0 {
-                    l += 1;
-                }
-            }
-            l
-        } else {
-            text_length as usize
-        };
-        let slice = unsafe { std::slice::from_raw_parts(statement_text, len) };
-        String::from_utf16_lossy(slice)
-    };
+    let sql = unsafe { utf16::from_wide_ptr(statement_text, text_length as isize) };
+
+    asyncexec::run(stmt, AsyncFn::ExecDirect, move |stmt| {
+        exec_direct_impl(stmt, sql)
+    })
+}
 
-    let final_sql = handle_exec_params(stmt, sql);
-    match final_sql {
-        Ok(s) => execute::exec_direct(stmt, &s),
+fn exec_direct_impl(stmt: &mut Statement, sql: String) -> SQLRETURN {
+    cursor::close(stmt);
+    match handle_exec_params(stmt, sql) {
+        Ok(p) if cursor::wanted(stmt, &p.text) => cursor::open(stmt, &p),
+        Ok(p) if partition::wanted(stmt, &p.text) => partition::open(stmt, &p),
+        Ok(p) => execute::exec_direct(stmt, &params::executesql_call(&p)),
         Err(ret) => ret,
     }
 }
@@ -372,6 +550,7 @@ pub extern "C" fn SQLNumResultCols(hstmt: SQLHSTMT, column_count: *mut SQLSMALLI
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &*(hstmt as *const Statement) };
+    let _lock = stmt.lock();
     if !column_count.is_null() {
         unsafe {
             *column_count = fetch::num_result_cols(stmt);
@@ -396,6 +575,7 @@ pub extern "C" fn SQLDescribeCol(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &*(hstmt as *const Statement) };
+    let _lock = stmt.lock();
     fetch::describe_col(
         stmt,
         col_number,
@@ -415,7 +595,31 @@ pub extern "C" fn SQLFetch(hstmt: SQLHSTMT) -> SQLRETURN {
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
-    fetch::fetch(stmt)
+    if let Some(ret) = asyncexec::poll(stmt, AsyncFn::Fetch) {
+        return ret;
+    }
+    let _lock = stmt.lock();
+    asyncexec::run(stmt, AsyncFn::Fetch, fetch::fetch)
+}
+
+/// Driver extension: fetch the next rowset as an Arrow C Data Interface
+/// record batch instead of through bound columns or SQLGetData. Takes the
+/// driver's own statement handle (SQLGetInfo SQL_DRIVER_HSTMT under a driver
+/// manager) and returns SQL_NO_DATA past the last row.
+#[unsafe(no_mangle)]
+pub extern "C" fn furball_fetch_arrow(
+    hstmt: SQLHSTMT,
+    max_rows: SQLULEN,
+    array: *mut arrow::ArrowArray,
+    schema: *mut arrow::ArrowSchema,
+) -> SQLRETURN {
+    if hstmt.is_null() {
+        return SQL_INVALID_HANDLE;
+    }
+    let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
+    stmt.diagnostics.clear();
+    arrow::fetch_arrow(stmt, max_rows, array, schema)
 }
 
 #[unsafe(no_mangle)]
@@ -431,6 +635,7 @@ pub extern "C" fn SQLGetData(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     fetch::get_data(
         stmt,
         col,
@@ -454,6 +659,7 @@ pub extern "C" fn SQLGetDataW(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
 
     // For W variant, default to SQL_C_WCHAR for character data
     let eff_type = if target_type == SQL_C_DEFAULT || target_type == SQL_C_CHAR {
@@ -601,6 +807,7 @@ fn set_connect_attr_impl(
         return SQL_INVALID_HANDLE;
     }
     let conn = unsafe { &mut *(hdbc as *mut Connection) };
+    let _lock = conn.lock();
     attr::set_connect_attr(conn, attribute, value, string_length)
 }
 
@@ -626,30 +833,24 @@ pub extern "C" fn SQLGetConnectAttr(
         return SQL_INVALID_HANDLE;
     }
     let conn = unsafe { &*(hdbc as *mut Connection) };
-    let _ = (buffer_length, string_length);
-    match attribute {
-        SQL_ATTR_AUTOCOMMIT => {
-            if !value.is_null() {
-                unsafe {
-                    *(value as *mut SQLULEN) = if conn.autocommit { 1 } else { 0 };
-                }
-            }
-            SQL_SUCCESS
-        }
-        _ => SQL_SUCCESS,
-    }
+    let _lock = conn.lock();
+    attr::get_connect_attr(conn, attribute, value, buffer_length, string_length)
 }
 
 #[unsafe(no_mangle)]
 pub extern "C" fn SQLGetConnectAttrW(
-    _hdbc: SQLHDBC,
+    hdbc: SQLHDBC,
     attribute: SQLINTEGER,
     value: SQLPOINTER,
     buffer_length: SQLINTEGER,
     string_length: *mut SQLINTEGER,
 ) -> SQLRETURN {
-    let _ = (attribute, value, buffer_length, string_length);
-    SQL_SUCCESS
+    if hdbc.is_null() {
+        return SQL_INVALID_HANDLE;
+    }
+    let conn = unsafe { &*(hdbc as *mut Connection) };
+    let _lock = conn.lock();
+    attr::get_connect_attr(conn, attribute, value, buffer_length, string_length)
 }
 
 #[unsafe(no_mangle)]
@@ -664,6 +865,7 @@ pub extern "C" fn SQLGetInfo(
         return SQL_INVALID_HANDLE;
     }
     let conn = unsafe { &*(hdbc as *const Connection) };
+    let _lock = conn.lock();
     attr::get_info(conn, info_type, info_value, buffer_length, string_length)
 }
 
@@ -679,6 +881,7 @@ pub extern "C" fn SQLGetInfoW(
         return SQL_INVALID_HANDLE;
     }
     let conn = unsafe { &*(hdbc as *const Connection) };
+    let _lock = conn.lock();
     attr::get_info_w(conn, info_type, info_value, buffer_length, string_length)
 }
 
@@ -693,7 +896,8 @@ pub extern "C" fn SQLSetStmtAttr(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
-    attr::set_stmt_attr(stmt, attribute, value, string_length)
+    let _lock = stmt.lock();
+    attr::set_stmt_attr(stmt, attribute, value, string_length, false)
 }
 
 #[unsafe(no_mangle)]
@@ -707,7 +911,8 @@ pub extern "C" fn SQLSetStmtAttrW(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
-    attr::set_stmt_attr(stmt, attribute, value, string_length)
+    let _lock = stmt.lock();
+    attr::set_stmt_attr(stmt, attribute, value, string_length, true)
 }
 
 #[unsafe(no_mangle)]
@@ -722,7 +927,8 @@ pub extern "C" fn SQLGetStmtAttr(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &*(hstmt as *const Statement) };
-    attr::get_stmt_attr(stmt, attribute, value, buffer_length, string_length)
+    let _lock = stmt.lock();
+    attr::get_stmt_attr(stmt, attribute, value, buffer_length, string_length, false)
 }
 
 #[unsafe(no_mangle)]
@@ -737,7 +943,8 @@ pub extern "C" fn SQLGetStmtAttrW(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &*(hstmt as *const Statement) };
-    attr::get_stmt_attr(stmt, attribute, value, buffer_length, string_length)
+    let _lock = stmt.lock();
+    attr::get_stmt_attr(stmt, attribute, value, buffer_length, string_length, true)
 }
 
 // ── Column Attributes (needed by isql) ──────────────────────────────
@@ -756,6 +963,7 @@ pub extern "C" fn SQLColAttribute(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &*(hstmt as *const Statement) };
+    let _lock = stmt.lock();
     let idx = (col_number as usize).wrapping_sub(1);
 
     // For SQL_DESC_COUNT, col_number is 0
@@ -877,6 +1085,7 @@ pub extern "C" fn SQLColAttributeW(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &*(hstmt as *const Statement) };
+    let _lock = stmt.lock();
     let idx = (col_number as usize).wrapping_sub(1);
 
     if field_identifier == SQL_DESC_COUNT {
@@ -894,23 +1103,11 @@ pub extern "C" fn SQLColAttributeW(
     let col = &stmt.columns[idx];
 
     let write_str_w = |s: &str| -> SQLRETURN {
-        let utf16: Vec<u16> = s.encode_utf16().collect();
+        let cap = (buffer_length.max(0) as usize) / 2;
+        let units = unsafe { utf16::write_wide(s, char_attr as *mut u16, cap) };
         if !string_length.is_null() {
             unsafe {
-                *string_length = (utf16.len() * 2) as SQLSMALLINT;
-            }
-        }
-        if !char_attr.is_null() && buffer_length > 0 {
-            let buf_cap = (buffer_length as usize) / 2;
-            let copy_count = std::cmp::min(utf16.len(), buf_cap.saturating_sub(1));
-            let dest = char_attr as *mut u16;
-            for i in 0..copy_count {
-                unsafe {
-                    *dest.add(i) = utf16[i];
-                }
-            }
-            unsafe {
-                *dest.add(copy_count) = 0;
+                *string_length = (units * 2) as SQLSMALLINT;
             }
         }
         SQL_SUCCESS
@@ -988,7 +1185,7 @@ pub extern "C" fn SQLColAttributeW(
     }
 }
 
-// ── Catalog functions (stubs) ───────────────────────────────────────
+// ── Catalog functions ───────────────────────────────────────────────
 
 fn catalog_tables(
     hstmt: SQLHSTMT,
@@ -1001,6 +1198,7 @@ fn catalog_tables(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
 
     // Build SQL query for sys catalog
@@ -1052,7 +1250,7 @@ fn catalog_tables(
         where_clause
     );
     let _ = (catalog,); // catalog is always current DB for SQL Server
-    execute::exec_direct(stmt, &sql)
+    catalog::cached(stmt, sql)
 }
 
 #[unsafe(no_mangle)]
@@ -1104,6 +1302,7 @@ fn catalog_columns(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
 
     let mut conditions = vec!["1=1".to_string()];
@@ -1136,7 +1335,7 @@ fn catalog_columns(
          WHERE {} ORDER BY TABLE_SCHEM, TABLE_NAME, ORDINAL_POSITION",
         conditions.join(" AND ")
     );
-    execute::exec_direct(stmt, &sql)
+    catalog::cached(stmt, sql)
 }
 
 #[unsafe(no_mangle)]
@@ -1185,6 +1384,7 @@ pub extern "C" fn SQLRowCount(hstmt: SQLHSTMT, row_count: *mut SQLLEN) -> SQLRET
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &*(hstmt as *const Statement) };
+    let _lock = stmt.lock();
     if !row_count.is_null() {
         unsafe {
             *row_count = stmt.row_count;
@@ -1205,6 +1405,7 @@ pub extern "C" fn SQLPrepare(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
     let sql = read_c_str_i32(statement_text, text_length);
     stmt.prepared_sql = Some(sql);
@@ -1239,20 +1440,9 @@ pub extern "C" fn SQLPrepareW(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
-    let count = if text_length < 0 {
-        let mut n = 0;
-        unsafe {
-            while *statement_text.add(n) != 0 {
-                n += 1;
-            }
-        }
-        n
-    } else {
-        text_length as usize
-    };
-    let slice = unsafe { std::slice::from_raw_parts(statement_text, count) };
-    stmt.prepared_sql = Some(String::from_utf16_lossy(slice));
+    stmt.prepared_sql = Some(unsafe { utf16::from_wide_ptr(statement_text, text_length as isize) });
     SQL_SUCCESS
 }
 
@@ -1262,7 +1452,16 @@ pub extern "C" fn SQLExecute(hstmt: SQLHSTMT) -> SQLRETURN {
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    if let Some(ret) = asyncexec::poll(stmt, AsyncFn::Execute) {
+        return ret;
+    }
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
+    asyncexec::run(stmt, AsyncFn::Execute, execute_impl)
+}
+
+fn execute_impl(stmt: &mut Statement) -> SQLRETURN {
+    cursor::close(stmt);
     let sql = match &stmt.prepared_sql {
         Some(s) => s.clone(),
         None => {
@@ -1277,22 +1476,14 @@ pub extern "C" fn SQLExecute(hstmt: SQLHSTMT) -> SQLRETURN {
 
     // Check for data-at-execution params — we don't support DAE
     // Also check for array parameter binding (paramset_size > 1)
-    let final_sql = if stmt.bound_params.is_empty() {
-        sql
+    let parameterized = if stmt.bound_params.is_empty() {
+        parameterize(&sql, &[])
     } else {
         if stmt.paramset_size > 1 {
-            // Array binding (fast_executemany) — not supported, execute one row at a time
-            let mut last_ret = SQL_SUCCESS;
-            for row_idx in 0..stmt.paramset_size {
-                let row_sql = substitute_params_row(&sql, &stmt.bound_params, row_idx);
-                last_ret = execute::exec_direct(stmt, &row_sql);
-                if last_ret == SQL_ERROR {
-                    break;
-                }
-            }
+            let ret = execute_param_array(stmt, &sql, true);
             stmt.bound_params.clear();
             stmt.paramset_size = 1;
-            return last_ret;
+            return ret;
         }
         // Check if any param uses DAE
         let has_dae = stmt.bound_params.iter().any(|p| {
@@ -1318,21 +1509,40 @@ pub extern "C" fn SQLExecute(hstmt: SQLHSTMT) -> SQLRETURN {
             stmt.dae_params_needed = dae_params;
             stmt.dae_current_idx = 0;
             stmt.dae_collected.clear();
-            stmt.dae_current_buf.clear();
+            stmt.dae_current = dae::DaePut::default();
             return SQL_NEED_DATA;
         }
-        substitute_params(&sql, &stmt.bound_params)
+        parameterize(&sql, &stmt.bound_params)
     };
 
-    let ret = execute::exec_direct(stmt, &final_sql);
+    let ret = if cursor::wanted(stmt, &parameterized.text) {
+        cursor::open(stmt, &parameterized)
+    } else if partition::wanted(stmt, &parameterized.text) {
+        partition::open(stmt, &parameterized)
+    } else {
+        execute::exec_prepared(stmt, &parameterized)
+    };
     // Reset params after execute
     stmt.bound_params.clear();
     ret
 }
 
-fn handle_exec_params(stmt: &mut Statement, sql: String) -> Result<String, SQLRETURN> {
+fn handle_exec_params(
+    stmt: &mut Statement,
+    sql: String,
+) -> Result<params::Parameterized, SQLRETURN> {
     if stmt.bound_params.is_empty() {
-        return Ok(sql);
+        return Ok(params::Parameterized {
+            text: sql,
+            decls: String::new(),
+            values: Vec::new(),
+        });
+    }
+    if stmt.paramset_size > 1 {
+        let ret = execute_param_array(stmt, &sql, false);
+        stmt.bound_params.clear();
+        stmt.paramset_size = 1;
+        return Err(ret);
     }
     // Check for DAE params
     let has_dae = stmt.bound_params.iter().any(|p| {
@@ -1358,56 +1568,242 @@ fn handle_exec_params(stmt: &mut Statement, sql: String) -> Result<String, SQLRE
         stmt.dae_params_needed = dae_params;
         stmt.dae_current_idx = 0;
         stmt.dae_collected.clear();
-        stmt.dae_current_buf.clear();
+        stmt.dae_current = dae::DaePut::default();
         return Err(SQL_NEED_DATA);
     }
-    let s = substitute_params(&sql, &stmt.bound_params);
+    let p = parameterize(&sql, &stmt.bound_params);
     stmt.bound_params.clear();
-    Ok(s)
+    Ok(p)
 }
 
-fn substitute_params(sql: &str, params: &[BoundParam]) -> String {
-    substitute_params_row(sql, params, 0)
-}
+/// Upper bounds for one batch of array-bound parameter sets. Each set is
+/// inlined as its own statement, so the byte cap keeps a batch within a
+/// reasonable number of TDS packets and the row cap bounds server parse time.
+const PARAM_BATCH_MAX_ROWS: usize = 1000;
+const PARAM_BATCH_MAX_BYTES: usize = 4 * 1024 * 1024;
 
-fn substitute_params_row(sql: &str, params: &[BoundParam], _row_idx: usize) -> String {
-    let mut result = String::with_capacity(sql.len() + 64);
-    let mut param_idx = 0u16;
-    for ch in sql.chars() {
-        if ch == '?' {
-            param_idx += 1;
-            if let Some(param) = params.iter().find(|p| p.param_number == param_idx) {
-                let val = read_param_value(param);
-                result.push_str(&val);
-            } else {
-                result.push_str("NULL");
+/// Execute the statement once per parameter set (SQL_ATTR_PARAMSET_SIZE > 1).
+/// The sets are packed into multi-statement batches so the whole array costs
+/// a handful of round trips instead of one per row. With `prepared` each set
+/// is an sp_execute of the cached server-side handle.
+fn execute_param_array(stmt: &mut Statement, sql: &str, prepared: bool) -> SQLRETURN {
+    let has_dae = stmt.bound_params.iter().any(|p| {
+        if p.len_ind_ptr.is_null() {
+            false
+        } else {
+            let ind = unsafe { *p.len_ind_ptr };
+            ind == SQL_DATA_AT_EXEC || ind <= SQL_LEN_DATA_AT_EXEC_OFFSET
+        }
+    });
+    if has_dae {
+        stmt.diagnostics.push(DiagRecord {
+            state: "HYC00".to_string(),
+            native_error: 0,
+            message: "Data-at-execution parameters not supported with parameter arrays".to_string(),
+        });
+        return SQL_ERROR;
+    }
+
+    let set_count = stmt.paramset_size;
+    set_params_processed(stmt, 0);
+    let mut batch = String::with_capacity(sql.len() * set_count.min(PARAM_BATCH_MAX_ROWS));
+    let mut batch_rows: Vec<usize> = Vec::new();
+    let mut processed = set_count;
+    let mut total_rows = 0u64;
+    let mut failed = false;
+
+    for row in 0..set_count {
+        if param_row_ignored(stmt, row) {
+            set_param_status(stmt, row, SQL_PARAM_UNUSED);
+            continue;
+        }
+        let p = parameterize_row(sql, stmt, row);
+        let handle = if prepared {
+            match execute::prepared_handle(stmt, &p) {
+                Ok(h) => h,
+                Err(_) => {
+                    // Cancelled while preparing: the sets still queued were
+                    // never sent
+                    processed = batch_rows.first().copied().unwrap_or(row);
+                    failed = true;
+                    break;
+                }
             }
         } else {
-            result.push(ch);
+            None
+        };
+        match handle {
+            Some(h) => batch.push_str(&params::execute_call(h, &p)),
+            None => batch.push_str(&params::executesql_call(&p)),
         }
+        batch.push_str(";\n");
+        batch_rows.push(row);
+        if (batch_rows.len() >= PARAM_BATCH_MAX_ROWS || batch.len() >= PARAM_BATCH_MAX_BYTES)
+            && !flush_param_batch(stmt, &mut batch, &mut batch_rows, &mut total_rows)
+        {
+            processed = row + 1;
+            failed = true;
+            break;
+        }
+    }
+    if !failed && !batch_rows.is_empty() {
+        failed = !flush_param_batch(stmt, &mut batch, &mut batch_rows, &mut total_rows);
+    }
+    for row in processed..set_count {
+        set_param_status(stmt, row, SQL_PARAM_UNUSED);
+    }
+    set_params_processed(stmt, processed);
+
+    stmt.row_count = if total_rows == 0 {
+        -1
+    } else {
+        total_rows as SQLLEN
+    };
+    if failed {
+        SQL_ERROR
+    } else {
+        SQL_SUCCESS
     }
-    result
 }
 
-fn read_param_value(param: &BoundParam) -> String {
-    // Check for NULL
-    if !param.len_ind_ptr.is_null() {
-        let len_ind = unsafe { *param.len_ind_ptr };
-        if len_ind == SQL_NULL_DATA {
-            return "NULL".to_string();
-        }
-        // Check for data-at-execution
-        if len_ind == SQL_DATA_AT_EXEC || len_ind <= SQL_LEN_DATA_AT_EXEC_OFFSET {
-            return "NULL".to_string();
+/// Send one accumulated parameter batch and record the per-row outcome. An
+/// error in one set does not stop a T-SQL batch, so the batch runs as a unit:
+/// in a transaction of its own under autocommit, else to a savepoint, and
+/// rolled back if any set fails. The server only says that the batch failed,
+/// so when it does every row in it is marked SQL_PARAM_DIAG_UNAVAILABLE,
+/// none of them applied.
+fn flush_param_batch(
+    stmt: &mut Statement,
+    batch: &mut String,
+    batch_rows: &mut Vec<usize>,
+    total_rows: &mut u64,
+) -> bool {
+    let conn = unsafe { &*stmt.conn };
+    let (begin, commit, rollback) = if conn.autocommit && !conn.in_transaction {
+        (
+            "BEGIN TRANSACTION;",
+            "COMMIT TRANSACTION;",
+            "IF @@TRANCOUNT > 0 ROLLBACK TRANSACTION;",
+        )
+    } else {
+        // A doomed transaction cannot go back to the savepoint; the caller
+        // has to roll it back
+        (
+            "SAVE TRANSACTION fb_params;",
+            "",
+            "IF XACT_STATE() = 1 ROLLBACK TRANSACTION fb_params;",
+        )
+    };
+    let atomic = format!(
+        "BEGIN TRY\n{begin}\n{batch}{commit}\nEND TRY\n\
+         BEGIN CATCH\n{rollback}\nTHROW;\nEND CATCH"
+    );
+    let result = execute::exec_batch(stmt, &atomic);
+    let status = match result {
+        Ok(rows) => {
+            *total_rows += rows;
+            SQL_PARAM_SUCCESS
         }
+        Err(_) => SQL_PARAM_DIAG_UNAVAILABLE,
+    };
+    for &row in batch_rows.iter() {
+        set_param_status(stmt, row, status);
     }
+    batch.clear();
+    batch_rows.clear();
+    result.is_ok()
+}
 
-    if param.value_ptr.is_null() {
-        return "NULL".to_string();
+fn param_row_ignored(stmt: &Statement, row: usize) -> bool {
+    !stmt.param_operation_ptr.is_null()
+        && unsafe { *stmt.param_operation_ptr.add(row) } == SQL_PARAM_IGNORE
+}
+
+fn set_param_status(stmt: &Statement, row: usize, status: SQLUSMALLINT) {
+    if !stmt.param_status_ptr.is_null() {
+        unsafe { *stmt.param_status_ptr.add(row) = status };
+    }
+}
+
+fn set_params_processed(stmt: &Statement, n: usize) {
+    if !stmt.params_processed_ptr.is_null() {
+        unsafe { *stmt.params_processed_ptr = n as SQLULEN };
     }
+}
+
+/// Replace the `?` markers in a statement with typed named parameters taken
+/// from its bound parameters (see params::parameterize).
+fn parameterize(sql: &str, params: &[BoundParam]) -> params::Parameterized {
+    parameterize_with(sql, params, read_param_value)
+}
+
+/// Like parameterize, for parameter set `row` of an array binding, honoring
+/// SQL_ATTR_PARAM_BIND_TYPE and SQL_ATTR_PARAM_BIND_OFFSET_PTR.
+fn parameterize_row(sql: &str, stmt: &Statement, row: usize) -> params::Parameterized {
+    parameterize_with(sql, &stmt.bound_params, |p| {
+        read_param_value(&param_for_row(stmt, p, row))
+    })
+}
+
+fn parameterize_with(
+    sql: &str,
+    params: &[BoundParam],
+    read: impl Fn(&BoundParam) -> String,
+) -> params::Parameterized {
+    params::parameterize(sql, |n| {
+        let param = params.iter().find(|p| p.param_number == n)?;
+        let literal = read(param);
+        let decl = params::param_type_decl(
+            param.parameter_type,
+            param.column_size,
+            param.decimal_digits,
+            literal.len(),
+        );
+        Some((decl, literal))
+    })
+}
 
-    // Resolve effective C type: SQL_C_DEFAULT means infer from parameter_type
-    let c_type = if param.value_type == SQL_C_DEFAULT {
+/// Return a copy of `param` whose value and indicator pointers address
+/// element `row` of the bound arrays.
+fn param_for_row(stmt: &Statement, param: &BoundParam, row: usize) -> BoundParam {
+    let offset = if stmt.param_bind_offset_ptr.is_null() {
+        0
+    } else {
+        unsafe { *stmt.param_bind_offset_ptr }
+    };
+    let (value_stride, ind_stride) = if stmt.param_bind_type == SQL_PARAM_BIND_BY_COLUMN {
+        let elem =
+            fetch::c_type_size(param_c_type(param)).unwrap_or(param.buffer_length.max(0) as usize);
+        (elem, std::mem::size_of::<SQLLEN>())
+    } else {
+        (stmt.param_bind_type, stmt.param_bind_type)
+    };
+    let value_ptr = if param.value_ptr.is_null() {
+        param.value_ptr
+    } else {
+        unsafe { (param.value_ptr as *mut u8).add(offset + row * value_stride) as SQLPOINTER }
+    };
+    let len_ind_ptr = if param.len_ind_ptr.is_null() {
+        param.len_ind_ptr
+    } else {
+        unsafe { (param.len_ind_ptr as *mut u8).add(offset + row * ind_stride) as *mut SQLLEN }
+    };
+    BoundParam {
+        param_number: param.param_number,
+        value_type: param.value_type,
+        parameter_type: param.parameter_type,
+        column_size: param.column_size,
+        decimal_digits: param.decimal_digits,
+        value_ptr,
+        buffer_length: param.buffer_length,
+        len_ind_ptr,
+    }
+}
+
+/// Effective C type of a bound parameter: SQL_C_DEFAULT is inferred from the
+/// parameter's SQL type.
+fn param_c_type(param: &BoundParam) -> SQLSMALLINT {
+    if param.value_type == SQL_C_DEFAULT {
         match param.parameter_type {
             SQL_INTEGER => SQL_C_LONG,
             SQL_SMALLINT => SQL_C_SHORT,
@@ -1426,7 +1822,27 @@ fn read_param_value(param: &BoundParam) -> String {
         }
     } else {
         param.value_type
-    };
+    }
+}
+
+fn read_param_value(param: &BoundParam) -> String {
+    // Check for NULL
+    if !param.len_ind_ptr.is_null() {
+        let len_ind = unsafe { *param.len_ind_ptr };
+        if len_ind == SQL_NULL_DATA {
+            return "NULL".to_string();
+        }
+        // Check for data-at-execution
+        if len_ind == SQL_DATA_AT_EXEC || len_ind <= SQL_LEN_DATA_AT_EXEC_OFFSET {
+            return "NULL".to_string();
+        }
+    }
+
+    if param.value_ptr.is_null() {
+        return "NULL".to_string();
+    }
+
+    let c_type = param_c_type(param);
 
     unsafe {
         match c_type {
@@ -1438,21 +1854,25 @@ fn read_param_value(param: &BoundParam) -> String {
                 let v = *(param.value_ptr as *const u32);
                 v.to_string()
             }
-            SQL_C_SHORT | SQL_C_USHORT => {
+            SQL_C_SHORT => {
                 let v = *(param.value_ptr as *const i16);
                 v.to_string()
             }
+            SQL_C_USHORT => {
+                let v = *(param.value_ptr as *const u16);
+                v.to_string()
+            }
             SQL_C_SBIGINT => {
                 let v = *(param.value_ptr as *const i64);
                 v.to_string()
             }
             SQL_C_DOUBLE => {
                 let v = *(param.value_ptr as *const f64);
-                format!("CAST({} AS float)", format_float_f64(v))
+                format_float_literal(v)
             }
             SQL_C_FLOAT => {
                 let v = *(param.value_ptr as *const f32);
-                format!("CAST({} AS real)", format_float_f64(v as f64))
+                format_float_literal(v as f64)
             }
             SQL_C_BIT => {
                 let v = *(param.value_ptr as *const u8);
@@ -1543,18 +1963,9 @@ fn read_param_value(param: &BoundParam) -> String {
                 } else {
                     SQL_NTS
                 };
-                let ptr = param.value_ptr as *const u16;
-                let count = if len_ind == SQL_NTS || len_ind < 0 {
-                    let mut n = 0;
-                    while *ptr.add(n) != 0 {
-                        n += 1;
-                    }
-                    n
-                } else {
-                    (len_ind as usize) / 2
-                };
-                let slice = std::slice::from_raw_parts(ptr, count);
-                let s = String::from_utf16_lossy(slice);
+                // Bytes, or SQL_NTS
+                let len = if len_ind < 0 { -1 } else { len_ind / 2 };
+                let s = utf16::from_wide_ptr(param.value_ptr as *const u16, len);
                 // SQL-escape single quotes
                 format!("N'{}'", s.replace('\'', "''"))
             }
@@ -1600,26 +2011,65 @@ fn read_param_value(param: &BoundParam) -> String {
     }
 }
 
-fn format_float_f64(v: f64) -> String {
-    if v.fract() == 0.0 && v.abs() < 1e15 {
-        format!("{:.1}", v)
-    } else {
-        v.to_string()
-    }
+/// Format a float as a T-SQL float constant. Exponent notation makes the
+/// server parse it as float rather than decimal, and Rust prints the shortest
+/// digits that round-trip, so the value arrives unchanged.
+fn format_float_literal(v: f64) -> String {
+    format!("{:e}", v)
 }
 
 #[unsafe(no_mangle)]
 pub extern "C" fn SQLBindCol(
     hstmt: SQLHSTMT,
-    _col_number: SQLUSMALLINT,
-    _target_type: SQLSMALLINT,
-    _target_value: SQLPOINTER,
-    _buffer_length: SQLLEN,
-    _str_len_or_ind: *mut SQLLEN,
+    col_number: SQLUSMALLINT,
+    target_type: SQLSMALLINT,
+    target_value: SQLPOINTER,
+    buffer_length: SQLLEN,
+    str_len_or_ind: *mut SQLLEN,
 ) -> SQLRETURN {
     if hstmt.is_null() {
         return SQL_INVALID_HANDLE;
     }
+    let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
+
+    if col_number == 0 {
+        // Bookmark columns are not supported
+        stmt.diagnostics.push(DiagRecord {
+            state: "07009".to_string(),
+            native_error: 0,
+            message: "Invalid descriptor index (bookmarks not supported)".to_string(),
+        });
+        return SQL_ERROR;
+    }
+
+    // A null target and indicator unbinds the column
+    if target_value.is_null() && str_len_or_ind.is_null() {
+        stmt.bound_cols.retain(|b| b.col_number != col_number);
+        return SQL_SUCCESS;
+    }
+
+    let col = BoundCol {
+        col_number,
+        target_type,
+        target_value,
+        buffer_length,
+        str_len_or_ind,
+    };
+    // Rows read from here on keep the column in the form it is bound as
+    fetch::note_target(&stmt.wide_cols, col_number as usize - 1, target_type);
+
+    // Replace if already bound at this position
+    if let Some(existing) = stmt
+        .bound_cols
+        .iter_mut()
+        .find(|b| b.col_number == col_number)
+    {
+        *existing = col;
+    } else {
+        stmt.bound_cols.push(col);
+    }
+
     SQL_SUCCESS
 }
 
@@ -1629,25 +2079,52 @@ pub extern "C" fn SQLMoreResults(hstmt: SQLHSTMT) -> SQLRETURN {
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    if let Some(ret) = asyncexec::poll(stmt, AsyncFn::MoreResults) {
+        return ret;
+    }
+    let _lock = stmt.lock();
+    asyncexec::run(stmt, AsyncFn::MoreResults, more_results)
+}
 
+fn more_results(stmt: &mut Statement) -> SQLRETURN {
+    // A client-side cursor holds only the result set it was opened over
+    if matches!(stmt.cursor, Some(cursor::Cursor::Client(_))) {
+        stmt.cursor = None;
+    }
+    // A partitioned extract is a single result set
+    if stmt.partitioned.is_some() {
+        execute::close_stream(stmt);
+        return SQL_NO_DATA;
+    }
     if stmt.streaming {
-        // Drain remaining rows in current result set
+        // Drain remaining rows in current result set, unless prefetch or the
+        // read-ahead thread already reached its end
+        let terminal = match stmt.prefetch_done.take() {
+            Some(terminal) => Some(terminal),
+            None => fetch::drain_read_ahead(stmt),
+        };
         let conn = unsafe { &mut *stmt.conn };
         let client = match conn.client.as_mut() {
             Some(c) => c,
             None => return SQL_NO_DATA,
         };
 
-        let result: Result<bool, tabby::error::Error> = {
-            let mut dummy_writer = handle::SingleRowDrainWriter;
-            let mut s = String::new();
-            let mut b = Vec::new();
-            loop {
-                match client.batch_fetch_row(&mut dummy_writer, &mut s, &mut b) {
-                    Ok(tabby::BatchFetchResult::Row) => continue,
-                    Ok(tabby::BatchFetchResult::Done(_)) => break Ok(false),
-                    Ok(tabby::BatchFetchResult::MoreResults) => break Ok(true),
-                    Err(e) => break Err(e),
+        let busy = execute::busy(stmt, false);
+        let result: Result<bool, ()> = match terminal {
+            Some(handle::PrefetchTerminal::Done) => Ok(false),
+            Some(handle::PrefetchTerminal::MoreResults) => Ok(true),
+            Some(handle::PrefetchTerminal::Error(_)) => Err(()),
+            None => {
+                let mut dummy_writer = handle::SingleRowDrainWriter;
+                let mut s = String::new();
+                let mut b = Vec::new();
+                loop {
+                    match client.batch_fetch_row(&mut dummy_writer, &mut s, &mut b) {
+                        Ok(tabby::BatchFetchResult::Row) => continue,
+                        Ok(tabby::BatchFetchResult::Done(_)) => break Ok(false),
+                        Ok(tabby::BatchFetchResult::MoreResults) => break Ok(true),
+                        Err(_) => break Err(()),
+                    }
                 }
             }
         };
@@ -1656,28 +2133,20 @@ pub extern "C" fn SQLMoreResults(hstmt: SQLHSTMT) -> SQLRETURN {
             Ok(true) => {
                 // Read next result set metadata
                 let meta_result = client.batch_fetch_metadata();
+                busy.end(stmt);
+                if execute::check_interrupt(stmt) {
+                    return SQL_ERROR;
+                }
                 match meta_result {
                     Ok(columns) if !columns.is_empty() => {
-                        stmt.columns = columns
-                            .iter()
-                            .map(|c| {
-                                let (sql_type, size, decimal_digits, nullable) =
-                                    handle::sql_type_from_column(c);
-                                handle::ColumnDesc {
-                                    name: c.name().to_string(),
-                                    sql_type,
-                                    size,
-                                    decimal_digits,
-                                    nullable,
-                                }
-                            })
-                            .collect();
+                        stmt.columns = conn.column_cache.get(&columns);
                         stmt.rows.clear();
+                        stmt.spilled = None;
                         stmt.row_index = -1;
                         stmt.read_offsets.clear();
                         stmt.row_count = -1;
                         stmt.streaming = true;
-                        stmt.prefetch_buffer.clear();
+                        fetch::reset_prefetch(stmt);
                         stmt.prefetch_done = None;
                         SQL_SUCCESS
                     }
@@ -1691,19 +2160,28 @@ pub extern "C" fn SQLMoreResults(hstmt: SQLHSTMT) -> SQLRETURN {
                     }
                 }
             }
+            _ if execute::check_interrupt(stmt) => SQL_ERROR,
             Ok(false) => {
+                // Later result sets may have been buffered for MARS
                 stmt.streaming = false;
-                SQL_NO_DATA
+                next_pending_result(stmt)
             }
             Err(_) => {
                 stmt.streaming = false;
                 SQL_NO_DATA
             }
         }
-    } else if !stmt.pending_result_sets.is_empty() {
-        let rs = stmt.pending_result_sets.remove(0);
+    } else {
+        next_pending_result(stmt)
+    }
+}
+
+/// Move to the next buffered result set
+fn next_pending_result(stmt: &mut Statement) -> SQLRETURN {
+    if let Some(rs) = stmt.pending_result_sets.pop_front() {
         stmt.columns = rs.columns;
         stmt.rows = rs.rows;
+        stmt.spilled = rs.spill.map(spill::SpillReader::new);
         stmt.row_index = -1;
         stmt.read_offsets.clear();
         stmt.row_count = if stmt.columns.is_empty() {
@@ -1727,6 +2205,7 @@ pub extern "C" fn SQLGetTypeInfo(hstmt: SQLHSTMT, data_type: SQLSMALLINT) -> SQL
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
     catalog::get_type_info(stmt, data_type)
 }
@@ -1754,23 +2233,7 @@ pub extern "C" fn SQLDriverConnectW(
     }
 
     // Convert UTF-16 input to UTF-8
-    let utf8_str = if conn_str_in.is_null() {
-        String::new()
-    } else {
-        let len = if conn_str_in_len == SQL_NTS as SQLSMALLINT {
-            let mut l = 0usize;
-            unsafe {
-                while *conn_str_in.add(l) != 0 {
-                    l += 1;
-                }
-            }
-            l
-        } else {
-            conn_str_in_len as usize
-        };
-        let slice = unsafe { std::slice::from_raw_parts(conn_str_in, len) };
-        String::from_utf16_lossy(slice)
-    };
+    let utf8_str = wchar_to_string(conn_str_in, conn_str_in_len);
 
     // Use the ANSI version with a temp buffer
     let utf8_bytes = utf8_str.as_bytes();
@@ -1789,21 +2252,12 @@ pub extern "C" fn SQLDriverConnectW(
     );
 
     // Convert output to UTF-16
-    if !conn_str_out.is_null() && conn_str_out_max > 0 {
-        let out_str = &out_buf[..out_len as usize];
-        let copy_len = std::cmp::min(out_str.len(), (conn_str_out_max as usize).saturating_sub(1));
-        for i in 0..copy_len {
-            unsafe {
-                *conn_str_out.add(i) = out_str[i] as u16;
-            }
-        }
+    let out_str = String::from_utf8_lossy(&out_buf[..(out_len.max(0) as usize).min(out_buf.len())]);
+    let units =
+        unsafe { utf16::write_wide(&out_str, conn_str_out, conn_str_out_max.max(0) as usize) };
+    if !conn_str_out_len.is_null() {
         unsafe {
-            *conn_str_out.add(copy_len) = 0;
-        }
-        if !conn_str_out_len.is_null() {
-            unsafe {
-                *conn_str_out_len = out_len;
-            }
+            *conn_str_out_len = units as SQLSMALLINT;
         }
     }
 
@@ -1826,6 +2280,7 @@ pub extern "C" fn SQLDescribeColW(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &*(hstmt as *const Statement) };
+    let _lock = stmt.lock();
     let idx = (col_number as usize).wrapping_sub(1);
     if idx >= stmt.columns.len() {
         return SQL_ERROR;
@@ -1833,21 +2288,10 @@ pub extern "C" fn SQLDescribeColW(
     let col = &stmt.columns[idx];
 
     // Write column name as UTF-16
-    if !col_name.is_null() && buffer_length > 0 {
-        let name_utf16: Vec<u16> = col.name.encode_utf16().collect();
-        let copy_len = std::cmp::min(name_utf16.len(), (buffer_length as usize).saturating_sub(1));
-        for i in 0..copy_len {
-            unsafe {
-                *col_name.add(i) = name_utf16[i];
-            }
-        }
-        unsafe {
-            *col_name.add(copy_len) = 0;
-        }
-    }
+    let units = unsafe { utf16::write_wide(&col.name, col_name, buffer_length.max(0) as usize) };
     if !name_length.is_null() {
         unsafe {
-            *name_length = col.name.encode_utf16().count() as SQLSMALLINT;
+            *name_length = units as SQLSMALLINT;
         }
     }
     if !data_type.is_null() {
@@ -1930,14 +2374,23 @@ pub extern "C" fn SQLEndTran(
         _ => return SQL_INVALID_HANDLE,
     };
 
+    if asyncexec::conn_busy_any(conn) {
+        conn.diagnostics.push(DiagRecord {
+            state: "HY010".to_string(),
+            native_error: 0,
+            message: "Asynchronous call in progress".to_string(),
+        });
+        return SQL_ERROR;
+    }
+    let _lock = conn.lock();
     if !conn.in_transaction {
         return SQL_SUCCESS;
     }
 
     let sql = if completion_type == SQL_COMMIT {
-        "COMMIT"
+        execute::COMMIT
     } else {
-        "ROLLBACK"
+        execute::ROLLBACK
     };
 
     let client = match conn.client.as_mut() {
@@ -2050,6 +2503,7 @@ pub extern "C" fn SQLNumParams(hstmt: SQLHSTMT, param_count: *mut SQLSMALLINT) -
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &*(hstmt as *const Statement) };
+    let _lock = stmt.lock();
     if !param_count.is_null() {
         let count = stmt
             .prepared_sql
@@ -2084,6 +2538,8 @@ pub extern "C" fn SQLGetFunctions(
             }
             // Set bits for supported functions (ODBC API function IDs from sql.h/sqlext.h)
             let supported_funcs: &[u16] = &[
+                4,    // SQL_API_SQLBINDCOL
+                5,    // SQL_API_SQLCANCEL
                 6,    // SQL_API_SQLCOLATTRIBUTE
                 7,    // SQL_API_SQLCONNECT
                 8,    // SQL_API_SQLDESCRIBECOL
@@ -2117,6 +2573,7 @@ pub extern "C" fn SQLGetFunctions(
                 1016, // SQL_API_SQLSETCONNECTATTR
                 1019, // SQL_API_SQLSETENVATTR
                 1020, // SQL_API_SQLSETSTMTATTR
+                1021, // SQL_API_SQLFETCHSCROLL
             ];
             for &f in supported_funcs {
                 let word = (f >> 4) as usize;
@@ -2154,6 +2611,7 @@ pub extern "C" fn SQLSpecialColumns(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
     let cat = unsafe { sql_str(catalog, catalog_len) };
     let sch = unsafe { sql_str(schema, schema_len) };
@@ -2178,6 +2636,7 @@ pub extern "C" fn SQLSpecialColumnsW(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
     let cat = wchar_to_string(catalog, catalog_len);
     let sch = wchar_to_string(schema, schema_len);
@@ -2202,6 +2661,7 @@ pub extern "C" fn SQLStatistics(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
     let cat = unsafe { sql_str(catalog, catalog_len) };
     let sch = unsafe { sql_str(schema, schema_len) };
@@ -2225,6 +2685,7 @@ pub extern "C" fn SQLStatisticsW(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
     let cat = wchar_to_string(catalog, catalog_len);
     let sch = wchar_to_string(schema, schema_len);
@@ -2247,6 +2708,7 @@ pub extern "C" fn SQLPrimaryKeys(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
     let cat = unsafe { sql_str(catalog, catalog_len) };
     let sch = unsafe { sql_str(schema, schema_len) };
@@ -2268,6 +2730,7 @@ pub extern "C" fn SQLPrimaryKeysW(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
     let cat = wchar_to_string(catalog, catalog_len);
     let sch = wchar_to_string(schema, schema_len);
@@ -2297,6 +2760,7 @@ pub extern "C" fn SQLForeignKeys(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
     let pkc = unsafe { sql_str(pk_cat, pk_cat_len) };
     let pks = unsafe { sql_str(pk_sch, pk_sch_len) };
@@ -2327,6 +2791,7 @@ pub extern "C" fn SQLForeignKeysW(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
     stmt.diagnostics.clear();
     let pkc = wchar_to_string(pk_cat, pk_cat_len);
     let pks = wchar_to_string(pk_sch, pk_sch_len);
@@ -2351,7 +2816,8 @@ pub extern "C" fn SQLProcedures(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
-    stmt.columns.clear();
+    let _lock = stmt.lock();
+    stmt.columns = Columns::default();
     stmt.rows.clear();
     stmt.row_index = -1;
     stmt.executed = true;
@@ -2390,6 +2856,7 @@ pub extern "C" fn SQLBindParameter(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    let _lock = stmt.lock();
 
     let param = BoundParam {
         param_number,
@@ -2423,6 +2890,42 @@ pub extern "C" fn SQLCancel(hstmt: SQLHSTMT) -> SQLRETURN {
     if hstmt.is_null() {
         return SQL_INVALID_HANDLE;
     }
+    let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    // Waiting for data-at-execution parameters: abandon the execution. That
+    // state is only left by calls on the statement, so it can only be seen
+    // when no call is running on the connection.
+    if let Ok(_lock) = stmt.try_lock() {
+        if dae::abandon(stmt) {
+            return SQL_SUCCESS;
+        }
+    }
+    // An encrypted session cannot signal attention. The record is only
+    // added when no call is running, since a running call owns the
+    // statement's diagnostics.
+    if !stmt.conn.is_null() {
+        let conn = unsafe { &*stmt.conn };
+        if conn.attention.as_ref().is_some_and(|a| !a.can_signal()) {
+            if let Ok(_lock) = stmt.try_lock() {
+                stmt.diagnostics.push(DiagRecord {
+                    state: "HYC00".to_string(),
+                    native_error: 0,
+                    message: "SQLCancel is not supported on an encrypted connection".to_string(),
+                });
+            }
+            return SQL_ERROR;
+        }
+    }
+    asyncexec::cancel(stmt);
+    // May be called from another thread while this statement waits on the
+    // server; the waiting call then fails with HY008. A request of another
+    // statement on the connection is left alone.
+    if !stmt.conn.is_null() {
+        let conn = unsafe { &*stmt.conn };
+        if let Some(attention) = conn.attention.as_ref() {
+            attention.cancel(stmt as *const Statement as usize);
+        }
+    }
+    partition::cancel(stmt);
     SQL_SUCCESS
 }
 
@@ -2434,127 +2937,8 @@ pub extern "C" fn SQLParamData(hstmt: SQLHSTMT, value_ptr_ptr: *mut SQLPOINTER)
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
-
-    // If we have a current buffer from SQLPutData, finalize it
-    if !stmt.dae_current_buf.is_empty() && stmt.dae_current_idx > 0 {
-        let param_num = stmt.dae_params_needed[stmt.dae_current_idx - 1];
-        // Check if the param was bound as WCHAR (UTF-16) — decode accordingly
-        let is_wchar = stmt
-            .bound_params
-            .iter()
-            .find(|p| p.param_number == param_num)
-            .map(|p| {
-                p.value_type == SQL_C_WCHAR
-                    || (p.value_type == SQL_C_DEFAULT
-                        && matches!(
-                            p.parameter_type,
-                            SQL_WVARCHAR | SQL_WCHAR | SQL_WLONGVARCHAR
-                        ))
-            })
-            .unwrap_or(false);
-        let data = if is_wchar && stmt.dae_current_buf.len() >= 2 {
-            // Interpret as UTF-16LE
-            let u16_slice: Vec<u16> = stmt
-                .dae_current_buf
-                .chunks_exact(2)
-                .map(|c| u16::from_le_bytes([c[0], c[1]]))
-                .collect();
-            String::from_utf16_lossy(&u16_slice)
-        } else {
-            String::from_utf8_lossy(&stmt.dae_current_buf).to_string()
-        };
-        stmt.dae_collected.push((param_num, data));
-        stmt.dae_current_buf.clear();
-    }
-
-    // Check if there are more params needing data
-    if stmt.dae_current_idx < stmt.dae_params_needed.len() {
-        let param_num = stmt.dae_params_needed[stmt.dae_current_idx];
-        stmt.dae_current_idx += 1;
-
-        // Return the value_ptr that was passed in SQLBindParameter for this param
-        // pyodbc uses this to identify which parameter
-        if !value_ptr_ptr.is_null() {
-            if let Some(bp) = stmt
-                .bound_params
-                .iter()
-                .find(|p| p.param_number == param_num)
-            {
-                unsafe {
-                    *value_ptr_ptr = bp.value_ptr;
-                }
-            }
-        }
-        return SQL_NEED_DATA;
-    }
-
-    // All params collected — build the SQL and execute
-    if let Some(sql) = stmt.dae_sql.take() {
-        // Build substitution: for DAE params use collected data, for non-DAE use read_param_value
-        let mut result = String::with_capacity(sql.len() + 256);
-        let mut param_idx = 0u16;
-        for ch in sql.chars() {
-            if ch == '?' {
-                param_idx += 1;
-                // Check if this param was DAE-collected
-                if let Some((_num, data)) = stmt.dae_collected.iter().find(|(n, _)| *n == param_idx)
-                {
-                    // Check the parameter type to decide quoting
-                    let param_type = stmt
-                        .bound_params
-                        .iter()
-                        .find(|p| p.param_number == param_idx)
-                        .map(|p| p.parameter_type)
-                        .unwrap_or(SQL_VARCHAR);
-                    let is_numeric = matches!(
-                        param_type,
-                        SQL_INTEGER
-                            | SQL_SMALLINT
-                            | SQL_TINYINT
-                            | SQL_BIGINT
-                            | SQL_DOUBLE
-                            | SQL_FLOAT
-                            | SQL_REAL
-                            | SQL_NUMERIC
-                            | SQL_DECIMAL
-                            | SQL_BIT
-                    );
-                    if matches!(param_type, SQL_DOUBLE | SQL_FLOAT) {
-                        result.push_str(&format!("CAST({} AS float)", data));
-                    } else if param_type == SQL_REAL {
-                        result.push_str(&format!("CAST({} AS real)", data));
-                    } else if is_numeric {
-                        result.push_str(data);
-                    } else {
-                        let escaped = data.replace('\'', "''");
-                        result.push_str(&format!("N'{}'", escaped));
-                    }
-                } else if let Some(param) = stmt
-                    .bound_params
-                    .iter()
-                    .find(|p| p.param_number == param_idx)
-                {
-                    let val = read_param_value(param);
-                    result.push_str(&val);
-                } else {
-                    result.push_str("NULL");
-                }
-            } else {
-                result.push(ch);
-            }
-        }
-
-        // Clear DAE state
-        stmt.dae_params_needed.clear();
-        stmt.dae_current_idx = 0;
-        stmt.dae_collected.clear();
-        stmt.dae_current_buf.clear();
-        stmt.bound_params.clear();
-
-        return execute::exec_direct(stmt, &result);
-    }
-
-    SQL_ERROR
+    let _lock = stmt.lock();
+    dae::param_data(stmt, value_ptr_ptr)
 }
 
 #[unsafe(no_mangle)]
@@ -2567,35 +2951,8 @@ pub extern "C" fn SQLPutData(
         return SQL_INVALID_HANDLE;
     }
     let stmt = unsafe { &mut *(hstmt as *mut Statement) };
-
-    if data_ptr.is_null() || str_len_or_ind == SQL_NULL_DATA {
-        // NULL data for this param
-        return SQL_SUCCESS;
-    }
-
-    let len = if str_len_or_ind == SQL_NTS as SQLLEN {
-        // Null-terminated string — find length
-        let ptr = data_ptr as *const u8;
-        let mut l = 0usize;
-        unsafe {
-            while *ptr.add(l) != 0 {
-                l += 1;
-            }
-        }
-        l
-    } else if str_len_or_ind >= 0 {
-        str_len_or_ind as usize
-    } else {
-        0
-    };
-
-    if len > 0 {
-        let ptr = data_ptr as *const u8;
-        let slice = unsafe { std::slice::from_raw_parts(ptr, len) };
-        stmt.dae_current_buf.extend_from_slice(slice);
-    }
-
-    SQL_SUCCESS
+    let _lock = stmt.lock();
+    dae::put_data(stmt, data_ptr, str_len_or_ind)
 }
 
 // ── SQLFetchScroll ──────────────────────────────────────────────────
@@ -2604,15 +2961,19 @@ pub extern "C" fn SQLPutData(
 pub extern "C" fn SQLFetchScroll(
     hstmt: SQLHSTMT,
     fetch_orientation: SQLSMALLINT,
-    _fetch_offset: SQLLEN,
+    fetch_offset: SQLLEN,
 ) -> SQLRETURN {
-    if fetch_orientation == SQL_FETCH_NEXT {
-        SQLFetch(hstmt)
-    } else if hstmt.is_null() {
-        SQL_INVALID_HANDLE
-    } else {
-        SQL_ERROR
+    if hstmt.is_null() {
+        return SQL_INVALID_HANDLE;
     }
+    let stmt = unsafe { &mut *(hstmt as *mut Statement) };
+    if let Some(ret) = asyncexec::poll(stmt, AsyncFn::Fetch) {
+        return ret;
+    }
+    let _lock = stmt.lock();
+    asyncexec::run(stmt, AsyncFn::Fetch, move |stmt| {
+        cursor::fetch_scroll(stmt, fetch_orientation, fetch_offset)
+    })
 }
 
 // ── SQLAllocConnect / SQLAllocEnv / SQLAllocStmt (ODBC 2.x compat) ──
@@ -2764,6 +3125,7 @@ pub extern "C" fn SQLConnect(
         return SQL_INVALID_HANDLE;
     }
     let conn = unsafe { &mut *(hdbc as *mut Connection) };
+    let _lock = conn.lock();
     conn.diagnostics.clear();
 
     let dsn_name = read_c_str(dsn, dsn_len);
@@ -2794,29 +3156,11 @@ pub extern "C" fn SQLConnectW(
     pwd_len: SQLSMALLINT,
 ) -> SQLRETURN {
     // Convert UTF-16 to UTF-8 and delegate
-    fn wchar_to_string(ptr: *const u16, len: SQLSMALLINT) -> String {
-        if ptr.is_null() {
-            return String::new();
-        }
-        let count = if len < 0 {
-            let mut n = 0;
-            unsafe {
-                while *ptr.add(n) != 0 {
-                    n += 1;
-                }
-            }
-            n
-        } else {
-            len as usize
-        };
-        let slice = unsafe { std::slice::from_raw_parts(ptr, count) };
-        String::from_utf16_lossy(slice)
-    }
-
     if hdbc.is_null() {
         return SQL_INVALID_HANDLE;
     }
     let conn = unsafe { &mut *(hdbc as *mut Connection) };
+    let _lock = conn.lock();
     conn.diagnostics.clear();
 
     let dsn_name = wchar_to_string(dsn, dsn_len);
@@ -0,0 +1,212 @@
+use crate::types::*;
+
+/// Largest nvarchar / varchar / varbinary length before a parameter has to be
+/// declared as (max).
+const MAX_NVARCHAR_LEN: usize = 4000;
+const MAX_VARCHAR_LEN: usize = 8000;
+
+/// T-SQL type used to declare a parameter in the sp_executesql parameter list.
+///
+/// Variable-length types are rounded up to a fixed declared length (or (max))
+/// instead of using the exact bound length: sp_executesql keys its plan on the
+/// parameter list text, so rounding keeps every execution of a statement on
+/// one cached plan. `literal_len` is the length of the value literal and only
+/// decides whether (max) is needed.
+pub fn param_type_decl(
+    parameter_type: SQLSMALLINT,
+    column_size: SQLULEN,
+    decimal_digits: SQLSMALLINT,
+    literal_len: usize,
+) -> String {
+    let size = column_size.max(literal_len);
+    match parameter_type {
+        SQL_BIT => "bit".to_string(),
+        SQL_TINYINT => "tinyint".to_string(),
+        SQL_SMALLINT => "smallint".to_string(),
+        SQL_INTEGER => "int".to_string(),
+        SQL_BIGINT => "bigint".to_string(),
+        SQL_REAL => "real".to_string(),
+        SQL_FLOAT | SQL_DOUBLE => "float".to_string(),
+        SQL_DECIMAL | SQL_NUMERIC => {
+            let precision = if column_size == 0 {
+                38
+            } else {
+                column_size.min(38)
+            };
+            let scale = (decimal_digits.max(0) as SQLULEN).min(precision);
+            format!("decimal({},{})", precision, scale)
+        }
+        SQL_TYPE_TIMESTAMP => "datetime2(7)".to_string(),
+        SQL_TYPE_DATE => "date".to_string(),
+        SQL_TYPE_TIME => "time(7)".to_string(),
+        SQL_GUID => "uniqueidentifier".to_string(),
+        SQL_CHAR | SQL_VARCHAR if size <= MAX_VARCHAR_LEN => {
+            format!("varchar({})", MAX_VARCHAR_LEN)
+        }
+        SQL_CHAR | SQL_VARCHAR | SQL_LONGVARCHAR => "varchar(max)".to_string(),
+        // A hex literal is "0x" plus two digits per byte
+        SQL_BINARY | SQL_VARBINARY if column_size.max(literal_len / 2) <= MAX_VARCHAR_LEN => {
+            format!("varbinary({})", MAX_VARCHAR_LEN)
+        }
+        SQL_BINARY | SQL_VARBINARY | SQL_LONGVARBINARY => "varbinary(max)".to_string(),
+        SQL_WCHAR | SQL_WVARCHAR if size <= MAX_NVARCHAR_LEN => {
+            format!("nvarchar({})", MAX_NVARCHAR_LEN)
+        }
+        _ => "nvarchar(max)".to_string(),
+    }
+}
+
+/// A statement with its `?` markers replaced by named parameters.
+pub struct Parameterized {
+    /// Statement text with @P1..@Pn in place of the markers
+    pub text: String,
+    /// sp_executesql / sp_prepare parameter list, e.g. "@P1 int, @P2 float"
+    pub decls: String,
+    /// T-SQL constant for each parameter, in marker order
+    pub values: Vec<String>,
+}
+
+impl Parameterized {
+    /// Key of the statement in the connection's prepared statement cache
+    pub fn cache_key(&self) -> String {
+        format!("{}\n{}", self.decls, self.text)
+    }
+}
+
+/// Replace the `?` markers in `sql` with named parameters.
+///
+/// `value` is called with each 1-based marker number and returns the
+/// parameter's declared type and a T-SQL constant for its value, or None for
+/// a marker with no bound parameter (sent as NULL). A `?` inside a quoted
+/// string literal is not a marker.
+pub fn parameterize(
+    sql: &str,
+    mut value: impl FnMut(u16) -> Option<(String, String)>,
+) -> Parameterized {
+    let mut text = String::with_capacity(sql.len() + 16);
+    let mut count = 0u16;
+    let mut in_string = false;
+    for ch in sql.chars() {
+        match ch {
+            '?' if !in_string => {
+                count += 1;
+                text.push_str("@P");
+                text.push_str(&count.to_string());
+            }
+            '\'' => {
+                // A doubled quote toggles twice and leaves the state unchanged
+                in_string = !in_string;
+                text.push(ch);
+            }
+            _ => text.push(ch),
+        }
+    }
+
+    let mut decls = String::new();
+    let mut values = Vec::with_capacity(count as usize);
+    for n in 1..=count {
+        let (decl, literal) =
+            value(n).unwrap_or_else(|| ("nvarchar(1)".to_string(), "NULL".to_string()));
+        if n > 1 {
+            decls.push_str(", ");
+        }
+        decls.push_str(&format!("@P{} {}", n, decl));
+        values.push(literal);
+    }
+    Parameterized {
+        text,
+        decls,
+        values,
+    }
+}
+
+/// Quote `s` as an N'...' literal
+fn quote_n(s: &str) -> String {
+    format!("N'{}'", s.replace('\'', "''"))
+}
+
+/// sp_executesql call for a parameterized statement. The statement text and
+/// parameter list stay identical across executions, so the server compiles
+/// the statement once and reuses the plan whatever the values are. Statements
+/// without markers are sent as they are.
+pub fn executesql_call(p: &Parameterized) -> String {
+    if p.values.is_empty() {
+        return p.text.clone();
+    }
+    let mut call = format!(
+        "EXEC sp_executesql {}, {}",
+        quote_n(&p.text),
+        quote_n(&p.decls)
+    );
+    for (i, v) in p.values.iter().enumerate() {
+        call.push_str(&format!(", @P{} = {}", i + 1, v));
+    }
+    call
+}
+
+/// Batch that prepares `p` with sp_prepare and returns the new handle as a
+/// one-row result set. Handles in `unprepare` are released first, which
+/// saves a separate round trip for cache evictions.
+pub fn prepare_call(p: &Parameterized, unprepare: &[i32]) -> String {
+    let decls = if p.decls.is_empty() {
+        "NULL".to_string()
+    } else {
+        quote_n(&p.decls)
+    };
+    format!(
+        "{}DECLARE @h int;\nEXEC sp_prepare @h OUTPUT, {}, {};\nSELECT @h",
+        unprepare_call(unprepare),
+        decls,
+        quote_n(&p.text)
+    )
+}
+
+/// sp_execute call that runs prepared `handle` with the values from `p`.
+pub fn execute_call(handle: i32, p: &Parameterized) -> String {
+    let mut call = format!("EXEC sp_execute {}", handle);
+    for v in &p.values {
+        call.push_str(", ");
+        call.push_str(v);
+    }
+    call
+}
+
+/// sp_unprepare calls for `handles`, each terminated by a newline.
+pub fn unprepare_call(handles: &[i32]) -> String {
+    handles
+        .iter()
+        .map(|h| format!("EXEC sp_unprepare {};\n", h))
+        .collect()
+}
+
+/// sp_cursoropen scrollopt flag: the statement is followed by its parameter
+/// list and values
+const CURSOR_PARAMETERIZED_STMT: u32 = 0x1000;
+
+/// Batch that opens `p` as a server cursor with sp_cursoropen. The server
+/// may fall back to another cursor type or concurrency, so the batch ends
+/// with a one-row result set of the handle, the options actually used and
+/// the row count.
+pub fn cursor_open_call(p: &Parameterized, scrollopt: u32, ccopt: u32) -> String {
+    let mut call = format!(
+        "DECLARE @c int, @so int = {}, @cc int = {}, @r int;\n\
+         EXEC sp_cursoropen @c OUTPUT, {}, @so OUTPUT, @cc OUTPUT, @r OUTPUT",
+        if p.values.is_empty() {
+            scrollopt
+        } else {
+            scrollopt | CURSOR_PARAMETERIZED_STMT
+        },
+        ccopt,
+        quote_n(&p.text)
+    );
+    if !p.values.is_empty() {
+        call.push_str(", ");
+        call.push_str(&quote_n(&p.decls));
+        for v in &p.values {
+            call.push_str(", ");
+            call.push_str(v);
+        }
+    }
+    call.push_str(";\nSELECT @c, @so, @cc, @r");
+    call
+}
@@ -0,0 +1,819 @@
+use crate::batch::RowBatch;
+use crate::connect;
+use crate::execute;
+use crate::fetch::{self, PREFETCH_ROWS};
+use crate::handle::*;
+use crate::params::{self, Parameterized};
+use crate::pool;
+use crate::readahead::{Message, ReadAhead};
+use crate::stream::{Attention, Interrupt, TdsStream, Traffic};
+use crate::types::*;
+use std::cmp::Ordering;
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
+use tabby::SyncClient;
+
+/// Most sessions one statement may split a query over
+pub const MAX_PARTITIONS: usize = 64;
+
+/// Attention state of the sessions a statement's partitions run on, shared
+/// with SQLCancel
+pub type Attentions = Arc<Mutex<Vec<Arc<Attention>>>>;
+
+/// A session taken for one partition, from the pool or newly opened
+struct Session {
+    client: SyncClient<TdsStream>,
+    attention: Arc<Attention>,
+    prepared: PreparedCache,
+    created: Instant,
+    /// The session's traffic before the partition's query
+    traffic: Traffic,
+}
+
+/// One partition of an open extract
+struct Part {
+    reader: Option<ReadAhead>,
+    attention: Arc<Attention>,
+    prepared: PreparedCache,
+    created: Instant,
+    traffic: Traffic,
+    /// The session once its result set has ended
+    client: Option<SyncClient<TdsStream>>,
+    /// Block an ordered merge is taking rows from, and the next of them
+    head: Option<(RowBatch, usize)>,
+}
+
+/// Partitioned extract (SQL_ATTR_FB_PARTITIONS): the statement's query run
+/// as one query per key range or hash bucket, each on a session of its own
+/// with its rows read ahead on a thread, and the rows merged into the
+/// statement's single forward-only result set. The connection's own session
+/// is left free for its other statements.
+pub struct Partitioned {
+    parts: Vec<Part>,
+    /// Result column the merge keeps in order, if ordered
+    order_by: Option<usize>,
+    /// Partition an unordered merge looks at first
+    turn: usize,
+}
+
+/// Counters of one refill, charged to the statement at the end
+#[derive(Default)]
+struct Refill {
+    refills: u64,
+    stalls: u64,
+    grows: u64,
+    info: Vec<(u32, String)>,
+}
+
+/// What opening a partition came to
+enum Opened {
+    Rows(Session, Vec<tabby::Column>),
+    /// The session, if still usable, with its reply complete
+    Failed(Option<Session>, DiagRecord),
+}
+
+/// How a partition's result set ended, as far as the merge cares
+enum Ended {
+    Done,
+    Failed(DiagRecord),
+}
+
+/// Whether executing `text` runs as a partitioned extract: the statement
+/// asks for partitions and names a key, the statement is a SELECT that can
+/// stand as a derived table, and no transaction would have to span the
+/// sessions. A leading WITH (a CTE) or a top-level ORDER BY cannot go
+/// inside the derived table (Msg 156, Msg 1033), so those run unpartitioned.
+pub fn wanted(stmt: &Statement, text: &str) -> bool {
+    if stmt.partitions < 2 || stmt.partition_key.is_empty() {
+        return false;
+    }
+    let conn = unsafe { &*stmt.conn };
+    conn.autocommit
+        && !conn.in_transaction
+        && conn.login.is_some()
+        && crate::cursor::leading_keyword(text).eq_ignore_ascii_case("select")
+        && !top_level_order_by(text)
+}
+
+/// Whether `text` has an ORDER BY outside any parentheses, string literal,
+/// quoted identifier or comment
+fn top_level_order_by(text: &str) -> bool {
+    let b = text.as_bytes();
+    let mut depth = 0usize;
+    let mut prev_order = false;
+    let mut i = 0;
+    while i < b.len() {
+        let c = b[i];
+        let close = match c {
+            b'\'' => Some(b'\''),
+            b'"' => Some(b'"'),
+            b'[' => Some(b']'),
+            _ => None,
+        };
+        if let Some(close) = close {
+            // A doubled closing character is an escape; the scan resumes
+            // right after it either way, which is all a word search needs
+            i += 1;
+            while i < b.len() && b[i] != close {
+                i += 1;
+            }
+            i += 1;
+            prev_order = false;
+            continue;
+        }
+        if b[i..].starts_with(b"--") {
+            while i < b.len() && b[i] != b'\n' {
+                i += 1;
+            }
+            continue;
+        }
+        if b[i..].starts_with(b"/*") {
+            i = text[i + 2..].find("*/").map_or(b.len(), |end| i + end + 4);
+            continue;
+        }
+        match c {
+            b'(' => {
+                depth += 1;
+                prev_order = false;
+            }
+            b')' => {
+                depth = depth.saturating_sub(1);
+                prev_order = false;
+            }
+            c if c.is_ascii_alphanumeric() || c == b'_' || c == b'@' || c == b'#' => {
+                let start = i;
+                while i < b.len()
+                    && (b[i].is_ascii_alphanumeric() || matches!(b[i], b'_' | b'@' | b'#' | b'$'))
+                {
+                    i += 1;
+                }
+                let word = &text[start..i];
+                if depth == 0 {
+                    if prev_order && word.eq_ignore_ascii_case("by") {
+                        return true;
+                    }
+                    prev_order = word.eq_ignore_ascii_case("order");
+                }
+                continue;
+            }
+            c if c.is_ascii_whitespace() => {}
+            _ => prev_order = false,
+        }
+        i += 1;
+    }
+    false
+}
+
+/// Open `p` as a partitioned extract. One round trip on the connection
+/// reads the key's bounds; each partition then opens or checks out a
+/// session and starts its query. No rows are read until the first fetch.
+pub fn open(stmt: &mut Statement, p: &Parameterized) -> SQLRETURN {
+    let ret = start(stmt, p);
+    if !stmt.streaming {
+        crate::stats::finish(stmt);
+    }
+    ret
+}
+
+fn start(stmt: &mut Statement, p: &Parameterized) -> SQLRETURN {
+    let inner = p.text.trim_end().trim_end_matches(';');
+    let key = stmt.partition_key.clone();
+    let n = stmt.partitions;
+    let with_text = |text: String| Parameterized {
+        text,
+        decls: p.decls.clone(),
+        values: p.values.clone(),
+    };
+
+    let bounds = with_text(format!(
+        "SELECT MIN({k}), MAX({k}) FROM ({q}) AS fb_bounds",
+        k = key,
+        q = inner
+    ));
+    crate::stats::start(stmt, &p.text);
+    let bounds = match execute::exec_result(stmt, &params::executesql_call(&bounds)) {
+        Ok(rs) => rs,
+        Err(ret) => return ret,
+    };
+    let text_key = bounds.columns.first().is_some_and(|c| {
+        matches!(
+            c.sql_type,
+            SQL_CHAR | SQL_VARCHAR | SQL_LONGVARCHAR | SQL_WCHAR | SQL_WVARCHAR | SQL_WLONGVARCHAR
+        )
+    });
+    let range = match (bounds.rows.cell(0, 0), bounds.rows.cell(0, 1)) {
+        (Some(lo), Some(hi)) => integer(lo).zip(integer(hi)),
+        _ => None,
+    };
+    let order_by = if !stmt.partition_ordered {
+        String::new()
+    } else if text_key {
+        // The merge compares text by code unit, as a binary collation does
+        format!(" ORDER BY ({}) COLLATE Latin1_General_BIN2", key)
+    } else {
+        format!(" ORDER BY ({})", key)
+    };
+    let queries: Vec<String> = predicates(&key, n, range)
+        .into_iter()
+        .map(|pred| {
+            params::executesql_call(&with_text(format!(
+                "SELECT * FROM ({}) AS fb_partition WHERE {}{}",
+                inner, pred, order_by
+            )))
+        })
+        .collect();
+
+    let conn = unsafe { &mut *stmt.conn };
+    let Some(mut login) = conn.login.clone() else {
+        return fail(stmt, "08003", "Not connected".to_string());
+    };
+    // Partitions see the database the connection is in now
+    login.key.database = conn.database.clone();
+    let login_timeout =
+        (conn.login_timeout > 0).then(|| Duration::from_secs(conn.login_timeout as u64));
+    let owner = stmt as *const Statement as usize;
+    let query_timeout = stmt.query_timeout;
+    stmt.partition_attention.lock().unwrap().clear();
+
+    let openers: Vec<_> = queries
+        .into_iter()
+        .map(|sql| {
+            let idle = connect::checkout_idle(conn);
+            let login = login.clone();
+            let cancels = stmt.partition_attention.clone();
+            std::thread::spawn(move || {
+                open_partition(
+                    idle,
+                    &login,
+                    login_timeout,
+                    &cancels,
+                    owner,
+                    query_timeout,
+                    &sql,
+                )
+            })
+        })
+        .collect();
+    let opened: Vec<_> = openers
+        .into_iter()
+        .map(|t| {
+            t.join().unwrap_or_else(|_| {
+                Opened::Failed(None, diag("HY000", "Partition thread failed".to_string()))
+            })
+        })
+        .collect();
+
+    let mut sessions = Vec::with_capacity(n);
+    let mut columns = None;
+    let mut failure = None;
+    for result in opened {
+        match result {
+            Opened::Rows(session, cols) => {
+                columns.get_or_insert(cols);
+                sessions.push(session);
+            }
+            Opened::Failed(session, d) => {
+                if let Some(s) = session {
+                    crate::stats::add_session_traffic(stmt, s.attention.traffic().since(s.traffic));
+                    connect::release_session(conn, s.client, s.attention, s.prepared, s.created);
+                }
+                failure.get_or_insert(d);
+            }
+        }
+    }
+    let columns = conn.column_cache.get(&columns.unwrap_or_default());
+    let key_col = if stmt.partition_ordered {
+        let name = bare_name(&key);
+        let found = columns
+            .iter()
+            .position(|c| c.name.eq_ignore_ascii_case(name));
+        if found.is_none() && failure.is_none() {
+            failure = Some(diag(
+                "42S22",
+                format!("Partition key {} is not a result column", key),
+            ));
+        }
+        found
+    } else {
+        None
+    };
+    if let Some(d) = failure {
+        for mut s in sessions {
+            let synced = execute::abandon_reply(&mut s.client, &s.attention);
+            crate::stats::add_session_traffic(stmt, s.attention.traffic().since(s.traffic));
+            if synced {
+                connect::release_session(conn, s.client, s.attention, s.prepared, s.created);
+            }
+        }
+        stmt.partition_attention.lock().unwrap().clear();
+        stmt.diagnostics.push(d);
+        return SQL_ERROR;
+    }
+
+    // Each partition reads ahead within its share of the prefetch budget
+    let budget = (stmt.prefetch_bytes / n).max(1);
+    let parts = sessions
+        .into_iter()
+        .map(|s| Part {
+            reader: Some(ReadAhead::start(
+                s.client,
+                Some(s.attention.clone()),
+                owner,
+                query_timeout,
+                PREFETCH_ROWS,
+                budget,
+                stmt.wide_cols.clone(),
+            )),
+            attention: s.attention,
+            prepared: s.prepared,
+            created: s.created,
+            traffic: s.traffic,
+            client: None,
+            head: None,
+        })
+        .collect();
+    stmt.partitioned = Some(Partitioned {
+        parts,
+        order_by: key_col,
+        turn: 0,
+    });
+    stmt.columns = columns;
+    stmt.rows.clear();
+    stmt.spilled = None;
+    stmt.row_count = -1;
+    stmt.row_index = -1;
+    stmt.executed = true;
+    stmt.streaming = true;
+    fetch::reset_prefetch(stmt);
+    stmt.read_offsets.clear();
+    stmt.pending_result_sets.clear();
+    stmt.prefetch_done = None;
+    SQL_SUCCESS
+}
+
+/// A pooled or new session for one partition, with `sql` started on it
+fn open_partition(
+    idle: Option<pool::PooledSession>,
+    login: &connect::Login,
+    login_timeout: Option<Duration>,
+    cancels: &Attentions,
+    owner: usize,
+    query_timeout: SQLULEN,
+    sql: &str,
+) -> Opened {
+    // A pooled session that fails the reset is dead and is dropped
+    let reset = idle.and_then(|mut s| {
+        let mut w = StringRowWriter::new();
+        let reset = pool::reset_batch(&login.key.database);
+        s.client.batch_into(&reset, &mut w).is_ok().then_some(s)
+    });
+    let (client, attention, prepared, created) = match reset {
+        Some(s) => (s.client, s.attention, s.prepared, s.created),
+        None => match connect::open_session(login, login_timeout) {
+            Ok((client, attention)) => (
+                client,
+                attention,
+                PreparedCache::new(PREPARED_CACHE_SIZE),
+                Instant::now(),
+            ),
+            Err(msg) => return Opened::Failed(None, diag("08001", msg)),
+        },
+    };
+    cancels.lock().unwrap().push(attention.clone());
+    let mut s = Session {
+        client,
+        traffic: attention.traffic(),
+        attention,
+        prepared,
+        created,
+    };
+
+    let mut rows_affected = 0;
+    let busy = s.attention.begin(owner, query_timeout, true);
+    let result = s.client.batch_start_with_rowcount(sql, &mut rows_affected);
+    drop(busy);
+    if s.attention.pending() {
+        let _ = s.client.batch_drain();
+        let synced = s.attention.wait_ack().is_ok();
+        let d = interrupted(s.attention.finish());
+        return Opened::Failed(synced.then_some(s), d);
+    }
+    match result {
+        Ok(columns) if !columns.is_empty() => Opened::Rows(s, columns),
+        Ok(_) => {
+            let d = diag(
+                "HY000",
+                "Partition query returned no result set".to_string(),
+            );
+            Opened::Failed(Some(s), d)
+        }
+        Err(e) => {
+            let msg = e.to_string();
+            let (state, native) = execute::map_sqlstate(&msg);
+            let d = DiagRecord {
+                state,
+                native_error: native,
+                message: msg,
+            };
+            Opened::Failed(Some(s), d)
+        }
+    }
+}
+
+/// WHERE clauses splitting the rows over `n` partitions by `key`: even
+/// ranges between the bounds of an integer key, else buckets of its
+/// CHECKSUM. NULL keys go to the first partition, keys outside the bounds
+/// (rows added since they were read) to the first or the last.
+fn predicates(key: &str, n: usize, range: Option<(i128, i128)>) -> Vec<String> {
+    let span = range.and_then(|(lo, hi)| hi.checked_sub(lo).map(|span| (lo, span)));
+    let Some((lo, span)) = span else {
+        return (0..n)
+            .map(|i| {
+                if i == 0 {
+                    format!(
+                        "(({k}) IS NULL OR ABS(CHECKSUM({k}) % {n}) = 0)",
+                        k = key,
+                        n = n
+                    )
+                } else {
+                    format!(
+                        "({k}) IS NOT NULL AND ABS(CHECKSUM({k}) % {n}) = {i}",
+                        k = key,
+                        n = n,
+                        i = i
+                    )
+                }
+            })
+            .collect();
+    };
+    let n128 = n as i128;
+    let bound = |i: usize| {
+        let i = i as i128;
+        lo + span / n128 * i + span % n128 * i / n128
+    };
+    (0..n)
+        .map(|i| match i {
+            0 => format!("(({k}) < {b} OR ({k}) IS NULL)", k = key, b = bound(1)),
+            _ if i == n - 1 => format!("({}) >= {}", key, bound(i)),
+            _ => format!(
+                "({k}) >= {lo} AND ({k}) < {hi}",
+                k = key,
+                lo = bound(i),
+                hi = bound(i + 1)
+            ),
+        })
+        .collect()
+}
+
+/// The value of an integer cell, including DECIMAL(p, 0)
+fn integer(cell: Cell<'_>) -> Option<i128> {
+    match cell {
+        Cell::U8(v) => Some(v as i128),
+        Cell::I16(v) => Some(v as i128),
+        Cell::I32(v) => Some(v as i128),
+        Cell::I64(v) => Some(v as i128),
+        Cell::Decimal {
+            value, scale: 0, ..
+        } => Some(value),
+        _ => None,
+    }
+}
+
+/// Column name of a key expression: the last part of a qualified name,
+/// without brackets or quotes
+fn bare_name(key: &str) -> &str {
+    let key = key.trim();
+    let last = match key.rfind(['.', '[']) {
+        Some(i) if key[i..].starts_with('[') => &key[i..],
+        Some(i) => &key[i + 1..],
+        None => key,
+    };
+    last.trim_matches(|c| c == '[' || c == ']' || c == '"')
+}
+
+fn diag(state: &str, message: String) -> DiagRecord {
+    DiagRecord {
+        state: state.to_string(),
+        native_error: 0,
+        message,
+    }
+}
+
+fn interrupted(interrupt: Option<Interrupt>) -> DiagRecord {
+    match interrupt {
+        Some(Interrupt::TimedOut) => diag("HYT00", "Query timeout expired".to_string()),
+        _ => diag("HY008", "Operation canceled".to_string()),
+    }
+}
+
+fn fail(stmt: &mut Statement, state: &str, message: String) -> SQLRETURN {
+    stmt.diagnostics.push(diag(state, message));
+    SQL_ERROR
+}
+
+/// Take merged rows onto the end of `stmt.rows` until it holds `rowset`
+/// rows or every partition has ended, when their sessions go back to the
+/// pool. Returns false if a partition's query was cancelled or timed out.
+pub fn receive(stmt: &mut Statement, rowset: usize) -> bool {
+    let Some(partitioned) = stmt.partitioned.as_mut() else {
+        return true;
+    };
+    let mut refill = Refill::default();
+    let wide = stmt.wide_cols.load(std::sync::atomic::Ordering::Relaxed);
+    let ended = match partitioned.order_by {
+        Some(col) => partitioned.merge_ordered(&mut stmt.rows, rowset, col, wide, &mut refill),
+        None => partitioned.merge(&mut stmt.rows, rowset, &mut refill),
+    };
+    crate::stats::count(stmt, |s| {
+        s.prefetch_refills += refill.refills;
+        s.prefetch_stalls += refill.stalls;
+        s.buffer_grows += refill.grows;
+    });
+    fetch::push_info(stmt, refill.info);
+    match ended {
+        None => true,
+        Some(Ended::Done) => {
+            release(stmt);
+            stmt.prefetch_done = Some(PrefetchTerminal::Done);
+            true
+        }
+        Some(Ended::Failed(d)) if matches!(d.state.as_str(), "HY008" | "HYT00") => {
+            release(stmt);
+            stmt.streaming = false;
+            stmt.rows.clear();
+            stmt.spilled = None;
+            stmt.prefetch_done = None;
+            stmt.diagnostics.push(d);
+            false
+        }
+        Some(Ended::Failed(d)) => {
+            // Rows merged before the error are still returned
+            release(stmt);
+            stmt.prefetch_done = Some(PrefetchTerminal::Error(d.message));
+            true
+        }
+    }
+}
+
+impl Partitioned {
+    /// Unordered: whole blocks, from whichever partition has one ready
+    /// first. Returns how the extract ended, if it did.
+    fn merge(&mut self, rows: &mut RowBatch, rowset: usize, refill: &mut Refill) -> Option<Ended> {
+        let n = self.parts.len();
+        while rows.len() < rowset {
+            let live = (0..n)
+                .map(|k| (self.turn + k) % n)
+                .filter(|&i| self.parts[i].reader.is_some());
+            let mut ready = None;
+            let mut first = None;
+            for i in live {
+                first.get_or_insert(i);
+                if let Some(msg) = self.parts[i].reader.as_ref().unwrap().try_recv() {
+                    ready = Some((i, msg, false));
+                    break;
+                }
+            }
+            let (i, msg, stalled) = match (ready, first) {
+                (Some(ready), _) => ready,
+                (None, Some(i)) => {
+                    let (msg, _) = self.parts[i].reader.as_ref().unwrap().recv();
+                    (i, msg, true)
+                }
+                (None, None) => return Some(Ended::Done),
+            };
+            self.turn = (i + 1) % n;
+            match msg {
+                Message::Rows(block, info) => {
+                    let reader = self.parts[i].reader.as_ref().unwrap();
+                    refill.refills += 1;
+                    refill.stalls += stalled as u64;
+                    refill.grows += reader.buffer_grows();
+                    refill.info.extend(info);
+                    if rows.is_empty() {
+                        let spent = std::mem::replace(rows, block);
+                        reader.recycle(spent);
+                    } else {
+                        rows.append(&block);
+                        reader.recycle(block);
+                    }
+                }
+                Message::End(terminal, info) => {
+                    refill.info.extend(info);
+                    if let Some(d) = self.end(i, terminal) {
+                        return Some(Ended::Failed(d));
+                    }
+                }
+            }
+        }
+        None
+    }
+
+    /// Ordered: row by row, the least key of the partitions' next rows.
+    /// Every partition with rows to come must have a block to compare.
+    fn merge_ordered(
+        &mut self,
+        rows: &mut RowBatch,
+        rowset: usize,
+        col: usize,
+        wide: u64,
+        refill: &mut Refill,
+    ) -> Option<Ended> {
+        rows.set_wide(wide);
+        while rows.len() < rowset {
+            for i in 0..self.parts.len() {
+                while self.parts[i].head.is_none() {
+                    let Some(reader) = self.parts[i].reader.as_ref() else {
+                        break;
+                    };
+                    let (msg, stalled) = reader.recv();
+                    match msg {
+                        Message::Rows(block, info) => {
+                            refill.refills += 1;
+                            refill.stalls += stalled as u64;
+                            refill.grows += reader.buffer_grows();
+                            refill.info.extend(info);
+                            if !block.is_empty() {
+                                self.parts[i].head = Some((block, 0));
+                            }
+                        }
+                        Message::End(terminal, info) => {
+                            refill.info.extend(info);
+                            if let Some(d) = self.end(i, terminal) {
+                                return Some(Ended::Failed(d));
+                            }
+                        }
+                    }
+                }
+            }
+            let least = self
+                .parts
+                .iter()
+                .enumerate()
+                .filter_map(|(i, p)| p.head.as_ref().map(|(block, row)| (i, block, *row)))
+                .min_by(|(_, a, ra), (_, b, rb)| {
+                    let a = a.cell(*ra, col).unwrap_or(Cell::Null);
+                    let b = b.cell(*rb, col).unwrap_or(Cell::Null);
+                    compare(a, b)
+                })
+                .map(|(i, _, _)| i);
+            let Some(i) = least else {
+                return Some(Ended::Done);
+            };
+            let part = &mut self.parts[i];
+            let (block, row) = part.head.as_mut().unwrap();
+            rows.append_row(block, *row);
+            *row += 1;
+            if *row == block.len() {
+                let (block, _) = part.head.take().unwrap();
+                if let Some(reader) = part.reader.as_ref() {
+                    reader.recycle(block);
+                }
+            }
+        }
+        None
+    }
+
+    /// Partition `i` reached the end of its result set: take its session
+    /// back. Returns the error it ended with, if any.
+    fn end(&mut self, i: usize, terminal: PrefetchTerminal) -> Option<DiagRecord> {
+        let part = &mut self.parts[i];
+        let mut client = part.reader.take().and_then(ReadAhead::finish);
+        if part.attention.pending() {
+            let synced = client.as_mut().is_some_and(|c| {
+                let _ = c.batch_drain();
+                part.attention.wait_ack().is_ok()
+            });
+            let d = interrupted(part.attention.finish());
+            part.client = client.filter(|_| synced);
+            return Some(d);
+        }
+        let Some(mut client) = client else {
+            return Some(diag("08S01", "Partition session lost".to_string()));
+        };
+        let failed = match terminal {
+            PrefetchTerminal::Done => None,
+            PrefetchTerminal::MoreResults => {
+                let _ = client.batch_drain();
+                None
+            }
+            PrefetchTerminal::Error(msg) => Some(diag("HY000", msg)),
+        };
+        part.client = Some(client);
+        failed
+    }
+}
+
+/// Stop the partitions still reading and give every session that is in a
+/// known state back to the pool
+fn release(stmt: &mut Statement) {
+    let Some(partitioned) = stmt.partitioned.take() else {
+        return;
+    };
+    let conn = unsafe { &*stmt.conn };
+    let mut traffic = Traffic::default();
+    for part in partitioned.parts {
+        let client = match part.reader {
+            Some(reader) => {
+                let stopped = reader.stop(Some(&part.attention));
+                match (stopped.client, stopped.terminal) {
+                    (Some(c), Some(PrefetchTerminal::Done)) => Some(c),
+                    (Some(mut c), _) => {
+                        execute::abandon_reply(&mut c, &part.attention).then_some(c)
+                    }
+                    (None, _) => None,
+                }
+            }
+            None => part.client,
+        };
+        let t = part.attention.traffic().since(part.traffic);
+        traffic.requests += t.requests;
+        traffic.bytes_sent += t.bytes_sent;
+        traffic.bytes_received += t.bytes_received;
+        if let Some(client) = client {
+            connect::release_session(conn, client, part.attention, part.prepared, part.created);
+        }
+    }
+    crate::stats::add_session_traffic(stmt, traffic);
+    stmt.partition_attention.lock().unwrap().clear();
+}
+
+/// Close the statement's partitioned extract, if one is open, for
+/// `close_stream`. Returns whether there was one.
+pub fn close(stmt: &mut Statement) -> bool {
+    if stmt.partitioned.is_none() {
+        return false;
+    }
+    release(stmt);
+    true
+}
+
+/// SQLCancel: interrupt the partitions' requests. Safe to call from any
+/// thread.
+pub fn cancel(stmt: &Statement) {
+    let owner = stmt as *const Statement as usize;
+    for attention in stmt.partition_attention.lock().unwrap().iter() {
+        attention.cancel(owner);
+    }
+}
+
+/// Order of two key values, as the server sorts them. NULL comes first.
+fn compare(a: Cell<'_>, b: Cell<'_>) -> Ordering {
+    use Cell::*;
+    match (a, b) {
+        (Null, Null) => Ordering::Equal,
+        (Null, _) => Ordering::Less,
+        (_, Null) => Ordering::Greater,
+        (Str(a), Str(b)) => a.encode_utf16().cmp(b.encode_utf16()),
+        (Wide(a), Wide(b)) => units(a).cmp(units(b)),
+        (Str(a), Wide(b)) => a.encode_utf16().cmp(units(b)),
+        (Wide(a), Str(b)) => units(a).cmp(b.encode_utf16()),
+        (Bytes(a), Bytes(b)) => a.cmp(b),
+        (Bool(a), Bool(b)) => a.cmp(&b),
+        (Date { days: a }, Date { days: b }) => a.cmp(&b),
+        (Time { nanos: a }, Time { nanos: b }) => a.cmp(&b),
+        (DateTime { micros: a }, DateTime { micros: b }) => a.cmp(&b),
+        (
+            DateTimeOffset {
+                micros: a,
+                offset_min: oa,
+            },
+            DateTimeOffset {
+                micros: b,
+                offset_min: ob,
+            },
+        ) => (a - oa as i64 * 60_000_000).cmp(&(b - ob as i64 * 60_000_000)),
+        (Guid(a), Guid(b)) => guid_order(&a).cmp(&guid_order(&b)),
+        (
+            Decimal {
+                value: a,
+                scale: sa,
+                ..
+            },
+            Decimal {
+                value: b,
+                scale: sb,
+                ..
+            },
+        ) if sa == sb => a.cmp(&b),
+        (a, b) => match (integer(a), integer(b)) {
+            (Some(a), Some(b)) => a.cmp(&b),
+            _ => fetch::cell_to_f64(a)
+                .partial_cmp(&fetch::cell_to_f64(b))
+                .unwrap_or(Ordering::Equal),
+        },
+    }
+}
+
+/// Code units of UTF-16LE text
+fn units(bytes: &[u8]) -> impl Iterator<Item = u16> + '_ {
+    bytes
+        .chunks_exact(2)
+        .map(|u| u16::from_le_bytes([u[0], u[1]]))
+}
+
+/// Bytes of a uniqueidentifier in the order the server compares them: the
+/// last six first, then the groups before them from the end
+fn guid_order(g: &[u8; 16]) -> [u8; 16] {
+    const ORDER: [usize; 16] = [10, 11, 12, 13, 14, 15, 8, 9, 6, 7, 4, 5, 0, 1, 2, 3];
+    ORDER.map(|i| g[i])
+}
@@ -0,0 +1,125 @@
+use crate::handle::*;
+use crate::stream::{Attention, TdsStream};
+use std::collections::HashMap;
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+use tabby::SyncClient;
+
+/// Parsed connection settings that make two sessions interchangeable.
+#[derive(Clone, PartialEq, Eq, Hash)]
+pub struct PoolKey {
+    pub host: String,
+    pub port: u16,
+    pub database: String,
+    pub uid: String,
+    pub pwd: String,
+    pub trust_cert: bool,
+    pub encrypt: crate::connect::Encrypt,
+}
+
+/// Pool settings, from the connection string keywords Pooling, PoolMaxIdle,
+/// PoolIdleTimeout and PoolMaxLifetime (both in seconds, 0 = no limit).
+#[derive(Clone, Copy)]
+pub struct PoolConfig {
+    pub max_idle: usize,
+    pub idle_timeout: Option<Duration>,
+    pub max_lifetime: Option<Duration>,
+}
+
+impl Default for PoolConfig {
+    fn default() -> Self {
+        Self {
+            max_idle: 16,
+            idle_timeout: Some(Duration::from_secs(60)),
+            max_lifetime: None,
+        }
+    }
+}
+
+/// A session parked in the pool. Its prepared statement cache travels with
+/// it, since the reset on checkout leaves server-side handles intact.
+pub struct PooledSession {
+    pub client: SyncClient<TdsStream>,
+    pub attention: Arc<Attention>,
+    pub prepared: PreparedCache,
+    pub created: Instant,
+    idle_since: Instant,
+}
+
+/// Idle sessions of one environment, grouped by connection settings.
+#[derive(Default)]
+pub struct Pool {
+    idle: HashMap<PoolKey, Vec<PooledSession>>,
+    pub hits: u64,
+    pub misses: u64,
+}
+
+impl PooledSession {
+    fn expired(&self, config: &PoolConfig, now: Instant) -> bool {
+        config
+            .idle_timeout
+            .is_some_and(|t| now.duration_since(self.idle_since) >= t)
+            || config
+                .max_lifetime
+                .is_some_and(|t| now.duration_since(self.created) >= t)
+    }
+}
+
+impl Pool {
+    /// Take the most recently returned live session for `key`, dropping any
+    /// that have outlived their idle timeout or lifetime.
+    pub fn checkout(&mut self, key: &PoolKey, config: &PoolConfig) -> Option<PooledSession> {
+        let sessions = self.idle.get_mut(key)?;
+        let now = Instant::now();
+        sessions.retain(|s| !s.expired(config, now));
+        sessions.pop()
+    }
+
+    /// Park a session for reuse. Returns false (and drops the session) when
+    /// it is past its lifetime or the pool for `key` is already full.
+    pub fn checkin(
+        &mut self,
+        key: PoolKey,
+        config: &PoolConfig,
+        client: SyncClient<TdsStream>,
+        attention: Arc<Attention>,
+        prepared: PreparedCache,
+        created: Instant,
+    ) -> bool {
+        let now = Instant::now();
+        let session = PooledSession {
+            client,
+            attention,
+            prepared,
+            created,
+            idle_since: now,
+        };
+        if session.expired(config, now) {
+            return false;
+        }
+        let sessions = self.idle.entry(key).or_default();
+        sessions.retain(|s| !s.expired(config, now));
+        if sessions.len() >= config.max_idle {
+            return false;
+        }
+        sessions.push(session);
+        true
+    }
+}
+
+/// Batch run on every checkout. sp_reset_connection is only callable as an
+/// RPC flag, so this resets the session state that matters to callers by
+/// hand, and doubles as a liveness check.
+pub fn reset_batch(database: &str) -> String {
+    format!(
+        "IF @@TRANCOUNT > 0 ROLLBACK TRANSACTION;\n\
+         SET IMPLICIT_TRANSACTIONS OFF;\n\
+         SET TRANSACTION ISOLATION LEVEL READ COMMITTED;\n\
+         SET NOCOUNT OFF;\n\
+         SET XACT_ABORT OFF;\n\
+         SET LOCK_TIMEOUT -1;\n\
+         SET ROWCOUNT 0;\n\
+         USE [{}]",
+        database.replace(']', "]]")
+    )
+}
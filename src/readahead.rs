@@ -0,0 +1,199 @@
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::mpsc::{self, Receiver, Sender, TryRecvError, TrySendError};
+use std::sync::Arc;
+use std::thread::JoinHandle;
+
+use tabby::SyncClient;
+
+use crate::batch::RowBatch;
+use crate::fetch::{self, SingleRowWriter};
+use crate::handle::PrefetchTerminal;
+use crate::stream::{Attention, TdsStream};
+use crate::types::SQLULEN;
+
+/// Decoded blocks waiting for the application, besides the one being filled
+/// and the one being consumed
+const QUEUE_DEPTH: usize = 2;
+
+pub enum Message {
+    Rows(RowBatch, Vec<(u32, String)>),
+    End(PrefetchTerminal, Vec<(u32, String)>),
+}
+
+/// Reader thread for one streamed result set (SQL_ATTR_FB_READ_AHEAD). It
+/// owns the connection's client while the result set is open, decodes rows
+/// into blocks ahead of the application, and hands the client back once it
+/// reaches the end of the result set or is stopped.
+pub struct ReadAhead {
+    blocks: Option<Receiver<Message>>,
+    recycle: Sender<RowBatch>,
+    stop: Arc<AtomicBool>,
+    /// Blocks whose buffer had to grow, not yet taken by `buffer_grows`
+    grows: Arc<AtomicU64>,
+    thread: JoinHandle<SyncClient<TdsStream>>,
+}
+
+/// How a stopped reader left the reply
+pub struct Stopped {
+    pub client: Option<SyncClient<TdsStream>>,
+    /// Where the result set ended, if the reader got that far
+    pub terminal: Option<PrefetchTerminal>,
+}
+
+impl ReadAhead {
+    /// Start reading the current result set. Each block holds up to
+    /// `target` rows and a share of `budget` bytes, so everything queued
+    /// stays within the statement's prefetch budget. `wide` is the
+    /// statement's SQL_C_WCHAR column mask, read again for every block, and
+    /// `owner` the statement, which SQLCancel names.
+    pub fn start(
+        mut client: SyncClient<TdsStream>,
+        attention: Option<Arc<Attention>>,
+        owner: usize,
+        query_timeout: SQLULEN,
+        mut target: usize,
+        budget: usize,
+        wide: Arc<AtomicU64>,
+    ) -> Self {
+        let (block_tx, blocks) = mpsc::sync_channel(QUEUE_DEPTH);
+        let (recycle, recycled) = mpsc::channel();
+        let stop = Arc::new(AtomicBool::new(false));
+        let stopped = stop.clone();
+        let grows = Arc::new(AtomicU64::new(0));
+        let grown = grows.clone();
+        let block_budget = (budget / (QUEUE_DEPTH + 2)).max(1);
+        let thread = std::thread::spawn(move || {
+            // Busy for as long as the reader owns the reply, so SQLCancel and
+            // the query timeout reach it between blocks too
+            let _busy = attention
+                .as_ref()
+                .map(|a| a.begin(owner, query_timeout, false));
+            let mut string_buf = String::with_capacity(4096);
+            let mut bytes_buf = Vec::with_capacity(4096);
+            while !stopped.load(Ordering::SeqCst) {
+                let mut rows: RowBatch = recycled.try_recv().unwrap_or_default();
+                rows.discard_front(rows.len());
+                rows.set_wide(wide.load(Ordering::Relaxed));
+                let capacity = rows.capacity();
+                let mut writer = SingleRowWriter {
+                    rows: &mut rows,
+                    info_messages: Vec::new(),
+                };
+                let terminal = fetch::read_rows(
+                    &mut client,
+                    &mut writer,
+                    &mut string_buf,
+                    &mut bytes_buf,
+                    1,
+                    target,
+                    block_budget,
+                );
+                let info = writer.info_messages;
+                if rows.capacity() > capacity {
+                    grown.fetch_add(1, Ordering::Relaxed);
+                }
+                let Some(terminal) = terminal else {
+                    // A full queue means the application is the bottleneck
+                    // and smaller blocks do; otherwise read further ahead
+                    let row_bytes = rows.data_bytes() / rows.len().max(1);
+                    let grow = match block_tx.try_send(Message::Rows(rows, info)) {
+                        Ok(()) => true,
+                        Err(TrySendError::Full(msg)) => {
+                            if block_tx.send(msg).is_err() {
+                                break;
+                            }
+                            false
+                        }
+                        Err(TrySendError::Disconnected(_)) => break,
+                    };
+                    target = fetch::resize_target(target, Some(grow), row_bytes, block_budget);
+                    continue;
+                };
+                if !rows.is_empty() && block_tx.send(Message::Rows(rows, Vec::new())).is_err() {
+                    break;
+                }
+                let _ = block_tx.send(Message::End(terminal, info));
+                break;
+            }
+            client
+        });
+        Self {
+            blocks: Some(blocks),
+            recycle,
+            stop,
+            grows,
+            thread,
+        }
+    }
+
+    /// Wait for the next block, or the end of the result set. Also says
+    /// whether the block was not ready yet, the reader being behind.
+    pub fn recv(&self) -> (Message, bool) {
+        let stopped = || {
+            Message::End(
+                PrefetchTerminal::Error("Read-ahead thread stopped".to_string()),
+                Vec::new(),
+            )
+        };
+        let Some(blocks) = self.blocks.as_ref() else {
+            return (stopped(), false);
+        };
+        match blocks.try_recv() {
+            Ok(msg) => (msg, false),
+            Err(TryRecvError::Empty) => (blocks.recv().unwrap_or_else(|_| stopped()), true),
+            Err(TryRecvError::Disconnected) => (stopped(), false),
+        }
+    }
+
+    /// The next block or the end of the result set if one is ready
+    pub fn try_recv(&self) -> Option<Message> {
+        match self.blocks.as_ref()?.try_recv() {
+            Ok(msg) => Some(msg),
+            Err(TryRecvError::Empty) => None,
+            Err(TryRecvError::Disconnected) => Some(Message::End(
+                PrefetchTerminal::Error("Read-ahead thread stopped".to_string()),
+                Vec::new(),
+            )),
+        }
+    }
+
+    /// Blocks decoded since the last call whose buffer had to grow
+    pub fn buffer_grows(&self) -> u64 {
+        self.grows.swap(0, Ordering::Relaxed)
+    }
+
+    /// Give a consumed block back for the reader to refill
+    pub fn recycle(&self, rows: RowBatch) {
+        let _ = self.recycle.send(rows);
+    }
+
+    /// Take the client back after `recv` returned the end of the result set
+    pub fn finish(self) -> Option<SyncClient<TdsStream>> {
+        self.thread.join().ok()
+    }
+
+    /// Stop reading before the end of the result set. Blocks already queued
+    /// are dropped; unless one of them ends the result set, `attention` (if
+    /// any) is signalled so a reader waiting on the server returns promptly.
+    pub fn stop(mut self, attention: Option<&Attention>) -> Stopped {
+        self.stop.store(true, Ordering::SeqCst);
+        let blocks = self.blocks.take().expect("reader already stopped");
+        let mut terminal = None;
+        while let Ok(msg) = blocks.try_recv() {
+            if let Message::End(t, _) = msg {
+                terminal = Some(t);
+            }
+        }
+        if terminal.is_none() {
+            if let Some(attention) = attention {
+                let _ = attention.send();
+            }
+        }
+        // Unblocks a reader waiting for queue space
+        drop(blocks);
+        Stopped {
+            client: self.thread.join().ok(),
+            terminal,
+        }
+    }
+}
@@ -0,0 +1,389 @@
+use crate::batch::RowBatch;
+use crate::handle::Cell;
+use std::fs::{File, OpenOptions};
+use std::io::{self, Read, Seek, SeekFrom, Write};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+
+/// Default BufferBytes=: memory for the rows of a reply read ahead for
+/// another statement, past which they go to a spill file
+pub const DEFAULT_BUFFER_BYTES: usize = 64 << 20;
+
+/// Spilled rows are written, and read back, in segments of about this size
+pub const SEGMENT_BYTES: usize = 1 << 20;
+
+// Cell tags of the row format
+const TAG_NULL: u8 = 0;
+const TAG_BOOL: u8 = 1;
+const TAG_U8: u8 = 2;
+const TAG_I16: u8 = 3;
+const TAG_I32: u8 = 4;
+const TAG_I64: u8 = 5;
+const TAG_F32: u8 = 6;
+const TAG_F64: u8 = 7;
+const TAG_STR: u8 = 8;
+const TAG_WIDE: u8 = 9;
+const TAG_BYTES: u8 = 10;
+const TAG_DATE: u8 = 11;
+const TAG_TIME: u8 = 12;
+const TAG_DATETIME: u8 = 13;
+const TAG_DATETIMEOFFSET: u8 = 14;
+const TAG_DECIMAL: u8 = 15;
+const TAG_GUID: u8 = 16;
+const TAG_END_OF_ROW: u8 = 0xFF;
+
+fn encode(cell: Cell<'_>, out: &mut Vec<u8>) {
+    let mut put = |tag: u8, bytes: &[u8]| {
+        out.push(tag);
+        out.extend_from_slice(bytes);
+    };
+    match cell {
+        Cell::Null => put(TAG_NULL, &[]),
+        Cell::Bool(v) => put(TAG_BOOL, &[v as u8]),
+        Cell::U8(v) => put(TAG_U8, &[v]),
+        Cell::I16(v) => put(TAG_I16, &v.to_le_bytes()),
+        Cell::I32(v) => put(TAG_I32, &v.to_le_bytes()),
+        Cell::I64(v) => put(TAG_I64, &v.to_le_bytes()),
+        Cell::F32(v) => put(TAG_F32, &v.to_le_bytes()),
+        Cell::F64(v) => put(TAG_F64, &v.to_le_bytes()),
+        Cell::Str(s) => encode_var(TAG_STR, s.as_bytes(), out),
+        Cell::Wide(b) => encode_var(TAG_WIDE, b, out),
+        Cell::Bytes(b) => encode_var(TAG_BYTES, b, out),
+        Cell::Date { days } => put(TAG_DATE, &days.to_le_bytes()),
+        Cell::Time { nanos } => put(TAG_TIME, &nanos.to_le_bytes()),
+        Cell::DateTime { micros } => put(TAG_DATETIME, &micros.to_le_bytes()),
+        Cell::DateTimeOffset { micros, offset_min } => {
+            put(TAG_DATETIMEOFFSET, &micros.to_le_bytes());
+            out.extend_from_slice(&offset_min.to_le_bytes());
+        }
+        Cell::Decimal {
+            value,
+            precision,
+            scale,
+        } => {
+            put(TAG_DECIMAL, &value.to_le_bytes());
+            out.extend_from_slice(&[precision, scale]);
+        }
+        Cell::Guid(g) => put(TAG_GUID, &g),
+    }
+}
+
+fn encode_var(tag: u8, bytes: &[u8], out: &mut Vec<u8>) {
+    out.push(tag);
+    out.extend_from_slice(&(bytes.len() as u32).to_le_bytes());
+    out.extend_from_slice(bytes);
+}
+
+/// Reads cells back from encoded rows
+struct Decoder<'a> {
+    bytes: &'a [u8],
+}
+
+impl<'a> Decoder<'a> {
+    fn take(&mut self, n: usize) -> &'a [u8] {
+        let (head, rest) = self.bytes.split_at(n);
+        self.bytes = rest;
+        head
+    }
+
+    fn array<const N: usize>(&mut self) -> [u8; N] {
+        self.take(N).try_into().unwrap()
+    }
+
+    fn var(&mut self) -> &'a [u8] {
+        let len = u32::from_le_bytes(self.array()) as usize;
+        self.take(len)
+    }
+
+    /// The next cell, or None at the end of a row
+    fn cell(&mut self) -> Option<Cell<'a>> {
+        Some(match self.take(1)[0] {
+            TAG_NULL => Cell::Null,
+            TAG_BOOL => Cell::Bool(self.take(1)[0] != 0),
+            TAG_U8 => Cell::U8(self.take(1)[0]),
+            TAG_I16 => Cell::I16(i16::from_le_bytes(self.array())),
+            TAG_I32 => Cell::I32(i32::from_le_bytes(self.array())),
+            TAG_I64 => Cell::I64(i64::from_le_bytes(self.array())),
+            TAG_F32 => Cell::F32(f32::from_le_bytes(self.array())),
+            TAG_F64 => Cell::F64(f64::from_le_bytes(self.array())),
+            // SAFETY: encoded from a &str, in a file only this process sees
+            TAG_STR => Cell::Str(unsafe { std::str::from_utf8_unchecked(self.var()) }),
+            TAG_WIDE => Cell::Wide(self.var()),
+            TAG_BYTES => Cell::Bytes(self.var()),
+            TAG_DATE => Cell::Date {
+                days: i32::from_le_bytes(self.array()),
+            },
+            TAG_TIME => Cell::Time {
+                nanos: i64::from_le_bytes(self.array()),
+            },
+            TAG_DATETIME => Cell::DateTime {
+                micros: i64::from_le_bytes(self.array()),
+            },
+            TAG_DATETIMEOFFSET => Cell::DateTimeOffset {
+                micros: i64::from_le_bytes(self.array()),
+                offset_min: i16::from_le_bytes(self.array()),
+            },
+            TAG_DECIMAL => Cell::Decimal {
+                value: i128::from_le_bytes(self.array()),
+                precision: self.take(1)[0],
+                scale: self.take(1)[0],
+            },
+            TAG_GUID => Cell::Guid(self.array()),
+            _ => return None,
+        })
+    }
+}
+
+/// Append the rows encoded in `bytes` to `rows`
+fn decode(bytes: &[u8], rows: &mut RowBatch) {
+    let mut decoder = Decoder { bytes };
+    while !decoder.bytes.is_empty() {
+        while let Some(cell) = decoder.cell() {
+            rows.push(cell);
+        }
+        rows.finish_row();
+    }
+}
+
+enum Segment {
+    File {
+        offset: usize,
+        len: usize,
+    },
+    /// Kept in memory as the file could not take it
+    Memory(Vec<u8>),
+}
+
+/// Rows of a buffered result set past the memory budget, in a compact row
+/// format: per cell a tag byte and the value in little-endian order,
+/// strings and binaries prefixed with their length, and an end-of-row tag.
+/// They are written in segments to an unlinked temp file, which is read
+/// back through a memory map once complete, one segment at a time: in order
+/// for a forward-only fetch, or by row number for a static cursor. Without
+/// a usable file the segments stay in memory, still encoded.
+pub struct Spill {
+    file: Option<File>,
+    map: Option<Map>,
+    segments: Vec<Segment>,
+    /// Row number, from 0, of the first row of each segment
+    starts: Vec<usize>,
+    /// Rows encoded
+    rows: usize,
+    /// Rows encoded before the segment being filled
+    segment_start: usize,
+    /// Encoded rows of the segment being filled
+    pending: Vec<u8>,
+    /// Bytes written to the file
+    written: usize,
+    /// No write to the file has failed
+    writable: bool,
+}
+
+impl Spill {
+    pub fn new() -> Self {
+        Self {
+            file: None,
+            map: None,
+            segments: Vec::new(),
+            starts: Vec::new(),
+            rows: 0,
+            segment_start: 0,
+            pending: Vec::with_capacity(SEGMENT_BYTES + SEGMENT_BYTES / 8),
+            written: 0,
+            writable: false,
+        }
+    }
+
+    /// Bytes written to the spill file
+    pub fn written(&self) -> usize {
+        self.written
+    }
+
+    /// Number of rows encoded
+    pub fn rows(&self) -> usize {
+        self.rows
+    }
+
+    /// The segment holding row `row` (from 0) of a finished spill, and the
+    /// row number its first row has. None past the last row.
+    pub fn locate(&self, row: usize) -> Option<(usize, usize)> {
+        if row >= self.rows {
+            return None;
+        }
+        let index = self.starts.partition_point(|&start| start <= row) - 1;
+        Some((index, self.starts[index]))
+    }
+
+    /// Encode the rows of `rows` from `from` on
+    pub fn push(&mut self, rows: &RowBatch, from: usize) {
+        for row in from..rows.len() {
+            for col in 0..rows.width() {
+                encode(rows.cell(row, col).unwrap_or(Cell::Null), &mut self.pending);
+            }
+            self.pending.push(TAG_END_OF_ROW);
+            self.rows += 1;
+            if self.pending.len() >= SEGMENT_BYTES {
+                self.end_segment();
+            }
+        }
+    }
+
+    fn end_segment(&mut self) {
+        self.starts.push(self.segment_start);
+        self.segment_start = self.rows;
+        if self.segments.is_empty() {
+            self.file = create_file().ok();
+            self.writable = self.file.is_some();
+        }
+        if self.writable {
+            // Writes stop at the first failure, which leaves the segments
+            // already written where they are
+            self.writable = self
+                .file
+                .as_mut()
+                .is_some_and(|f| f.write_all(&self.pending).is_ok());
+        }
+        if self.writable {
+            self.segments.push(Segment::File {
+                offset: self.written,
+                len: self.pending.len(),
+            });
+            self.written += self.pending.len();
+            self.pending.clear();
+        } else {
+            self.segments
+                .push(Segment::Memory(std::mem::take(&mut self.pending)));
+        }
+    }
+
+    /// Write out the last segment and map the file for reading
+    pub fn finish(mut self) -> Self {
+        if !self.pending.is_empty() {
+            self.end_segment();
+        }
+        self.pending = Vec::new();
+        if let Some(file) = self.file.as_ref().filter(|_| self.written > 0) {
+            self.map = Map::new(file, self.written);
+        }
+        self
+    }
+
+    /// Append the rows of segment `index` to `rows`. Returns false past the
+    /// last segment.
+    pub fn load(&self, index: usize, rows: &mut RowBatch) -> io::Result<bool> {
+        let Some(segment) = self.segments.get(index) else {
+            return Ok(false);
+        };
+        match segment {
+            Segment::Memory(bytes) => decode(bytes, rows),
+            Segment::File { offset, len } => match (self.map.as_ref(), self.file.as_ref()) {
+                (Some(map), _) => decode(&map.bytes()[*offset..offset + len], rows),
+                (None, Some(mut file)) => {
+                    let mut bytes = vec![0; *len];
+                    file.seek(SeekFrom::Start(*offset as u64))?;
+                    file.read_exact(&mut bytes)?;
+                    decode(&bytes, rows);
+                }
+                (None, None) => return Err(io::ErrorKind::NotFound.into()),
+            },
+        }
+        Ok(true)
+    }
+}
+
+/// Where a statement is in the spilled rows of its current result set
+pub struct SpillReader {
+    spill: Arc<Spill>,
+    next: usize,
+}
+
+impl SpillReader {
+    pub fn new(spill: Arc<Spill>) -> Self {
+        Self { spill, next: 0 }
+    }
+
+    /// The spilled rows, for reading in any order
+    pub fn into_spill(self) -> Arc<Spill> {
+        self.spill
+    }
+
+    /// Append the next segment's rows to `rows`. Returns false once all
+    /// have been read.
+    pub fn load_next(&mut self, rows: &mut RowBatch) -> io::Result<bool> {
+        let loaded = self.spill.load(self.next, rows)?;
+        self.next += loaded as usize;
+        Ok(loaded)
+    }
+}
+
+/// A new spill file, removed from the directory at once so its space goes
+/// back when it is closed, however the process ends
+fn create_file() -> io::Result<File> {
+    static NEXT: AtomicU64 = AtomicU64::new(0);
+    let path = std::env::temp_dir().join(format!(
+        "furball-spill-{}-{}",
+        std::process::id(),
+        NEXT.fetch_add(1, Ordering::Relaxed)
+    ));
+    let file = OpenOptions::new()
+        .read(true)
+        .write(true)
+        .create_new(true)
+        .open(&path)?;
+    let _ = std::fs::remove_file(&path);
+    Ok(file)
+}
+
+/// Read-only mapping of a complete spill file
+struct Map {
+    ptr: *const u8,
+    len: usize,
+}
+
+// SAFETY: the mapping is read-only and lives as long as the Map
+unsafe impl Send for Map {}
+unsafe impl Sync for Map {}
+
+#[cfg(unix)]
+impl Map {
+    fn new(file: &File, len: usize) -> Option<Map> {
+        use std::os::fd::AsRawFd;
+        let ptr = unsafe {
+            libc::mmap(
+                std::ptr::null_mut(),
+                len,
+                libc::PROT_READ,
+                libc::MAP_PRIVATE,
+                file.as_raw_fd(),
+                0,
+            )
+        };
+        (ptr != libc::MAP_FAILED).then(|| Map {
+            ptr: ptr as *const u8,
+            len,
+        })
+    }
+
+    fn bytes(&self) -> &[u8] {
+        unsafe { std::slice::from_raw_parts(self.ptr, self.len) }
+    }
+}
+
+#[cfg(unix)]
+impl Drop for Map {
+    fn drop(&mut self) {
+        unsafe { libc::munmap(self.ptr as *mut libc::c_void, self.len) };
+    }
+}
+
+/// Segments are read with plain reads where there is no mmap
+#[cfg(not(unix))]
+impl Map {
+    fn new(_file: &File, _len: usize) -> Option<Map> {
+        None
+    }
+
+    fn bytes(&self) -> &[u8] {
+        &[]
+    }
+}
@@ -0,0 +1,289 @@
+use crate::handle::*;
+use crate::stream::Traffic;
+use crate::types::*;
+use std::fs::{self, File, OpenOptions};
+use std::io::{BufWriter, Write};
+use std::sync::Mutex;
+use std::time::{Instant, SystemTime, UNIX_EPOCH};
+
+/// A trace file is rotated to `<path>.1` once it grows past this, so
+/// tracing holds at most twice as much on disk
+const TRACE_MAX_BYTES: u64 = 16 << 20;
+
+/// Statement text kept for a trace line
+const TRACE_SQL_CHARS: usize = 200;
+
+/// Performance counters of a statement or connection, read as a whole with
+/// SQL_ATTR_FB_STATS into a C struct of unsigned 64-bit integers in this
+/// order, and reset by setting the attribute to NULL. They are plain
+/// increments made under the connection lock, so they are always on.
+#[repr(C)]
+#[derive(Clone, Copy, Default)]
+pub struct Stats {
+    /// Requests sent and bytes exchanged with the server. A connection
+    /// counts everything on its session since the connect, transactions
+    /// included; a statement only what its own calls waited for.
+    pub round_trips: u64,
+    pub bytes_sent: u64,
+    pub bytes_received: u64,
+    /// Microseconds from sending the request to the first and to the last
+    /// row of the result. A statement holds those of its last execution,
+    /// a connection the sum over its statements.
+    pub first_row_us: u64,
+    pub last_row_us: u64,
+    pub executions: u64,
+    pub rows_fetched: u64,
+    /// Blocks of rows read from the wire, and those of them the
+    /// application had to wait for: every refill without read-ahead, and
+    /// the blocks the read-ahead thread had not finished yet
+    pub prefetch_refills: u64,
+    pub prefetch_stalls: u64,
+    pub get_data_calls: u64,
+    /// Cells converted to or from their text form, e.g. an INT column read
+    /// as SQL_C_CHAR or a VARCHAR one as SQL_C_LONG
+    pub text_conversions: u64,
+    /// Refills that had to grow the row buffer
+    pub buffer_grows: u64,
+    /// Bytes of rows buffered for another statement (BufferBytes=) that
+    /// went to a spill file
+    pub spill_bytes: u64,
+}
+
+impl Stats {
+    fn add_traffic(&mut self, t: Traffic) {
+        self.round_trips += t.requests;
+        self.bytes_sent += t.bytes_sent;
+        self.bytes_received += t.bytes_received;
+    }
+}
+
+/// SQL_ATTR_FB_STATS: copy `stats` into the application's buffer of
+/// `buffer_length` bytes, as much of it as fits, and give its whole size in
+/// `string_length`
+pub fn write(
+    stats: &Stats,
+    value: SQLPOINTER,
+    buffer_length: SQLINTEGER,
+    string_length: *mut SQLINTEGER,
+) -> SQLRETURN {
+    let size = std::mem::size_of::<Stats>();
+    if !value.is_null() {
+        let n = size.min(buffer_length.max(0) as usize);
+        unsafe {
+            std::ptr::copy_nonoverlapping(stats as *const Stats as *const u8, value as *mut u8, n);
+        }
+    }
+    if !string_length.is_null() {
+        unsafe { *string_length = size as SQLINTEGER };
+    }
+    SQL_SUCCESS
+}
+
+/// The execution a statement's latencies are being measured for
+pub struct Execution {
+    started: Instant,
+    first_row: bool,
+    /// Only kept with a trace sink
+    sql: String,
+    /// The statement's counters when it started, for the trace line
+    base: Stats,
+}
+
+/// Count something for `stmt` and its connection
+pub fn count(stmt: &mut Statement, f: impl Fn(&mut Stats)) {
+    f(&mut stmt.stats);
+    if let Some(conn) = unsafe { stmt.conn.as_mut() } {
+        f(&mut conn.stats);
+    }
+}
+
+/// Traffic of the statement's session so far, as a mark for `add_traffic`
+pub fn traffic(stmt: &Statement) -> Traffic {
+    unsafe { stmt.conn.as_ref() }
+        .and_then(|c| c.attention.as_ref())
+        .map_or_else(Traffic::default, |a| a.traffic())
+}
+
+/// Charge the session's traffic since `mark` to `stmt`. The connection
+/// reads its own from the session.
+pub fn add_traffic(stmt: &mut Statement, mark: Traffic) {
+    let now = traffic(stmt);
+    stmt.stats.add_traffic(now.since(mark));
+}
+
+/// Charge `t`, exchanged on a session other than the connection's own (a
+/// partition of an extract), to `stmt` and its connection
+pub fn add_session_traffic(stmt: &mut Statement, t: Traffic) {
+    count(stmt, |s| s.add_traffic(t));
+}
+
+/// The counters SQL_ATTR_FB_STATS reports for a connection
+pub fn connection_stats(conn: &Connection) -> Stats {
+    let mut stats = conn.stats;
+    if let Some(attention) = conn.attention.as_ref() {
+        stats.add_traffic(attention.traffic().since(conn.traffic_base));
+    }
+    stats
+}
+
+/// Forget a connection's counters, from a new connect or the application
+pub fn reset_connection(conn: &mut Connection) {
+    conn.stats = Stats::default();
+    conn.traffic_base = conn
+        .attention
+        .as_ref()
+        .map_or_else(Traffic::default, |a| a.traffic());
+}
+
+/// A request for `sql` is about to be sent on behalf of the application:
+/// start timing it
+pub fn start(stmt: &mut Statement, sql: &str) {
+    let traced = unsafe { stmt.conn.as_ref() }.is_some_and(|c| c.trace.is_some());
+    stmt.execution = Some(Execution {
+        started: Instant::now(),
+        first_row: false,
+        sql: if traced {
+            sql.chars().take(TRACE_SQL_CHARS).collect()
+        } else {
+            String::new()
+        },
+        base: stmt.stats,
+    });
+    count(stmt, |s| s.executions += 1);
+}
+
+/// `n` rows of the result were returned to the application
+pub fn rows(stmt: &mut Statement, n: usize) {
+    count(stmt, |s| s.rows_fetched += n as u64);
+    let Some(exec) = stmt.execution.as_mut() else {
+        return;
+    };
+    if exec.first_row {
+        return;
+    }
+    exec.first_row = true;
+    let us = exec.started.elapsed().as_micros() as u64;
+    stmt.stats.first_row_us = us;
+    if let Some(conn) = unsafe { stmt.conn.as_mut() } {
+        conn.stats.first_row_us += us;
+    }
+}
+
+/// The result is done, or there was none: record the time to the last row
+/// and write the execution's trace line
+pub fn finish(stmt: &mut Statement) {
+    let Some(exec) = stmt.execution.take() else {
+        return;
+    };
+    let us = exec.started.elapsed().as_micros() as u64;
+    if !exec.first_row {
+        stmt.stats.first_row_us = us;
+    }
+    stmt.stats.last_row_us = us;
+    let Some(conn) = (unsafe { stmt.conn.as_mut() }) else {
+        return;
+    };
+    if !exec.first_row {
+        conn.stats.first_row_us += us;
+    }
+    conn.stats.last_row_us += us;
+    if let Some(trace) = conn.trace.as_ref() {
+        let d = since(&stmt.stats, &exec.base);
+        trace.write(&format!(
+            "stmt={:p} first_row_us={} last_row_us={} rows={} round_trips={} \
+             bytes_sent={} bytes_received={} refills={} stalls={} get_data={} \
+             text_conversions={} buffer_grows={} sql={:?}",
+            stmt as *const Statement,
+            stmt.stats.first_row_us,
+            us,
+            d.rows_fetched,
+            d.round_trips,
+            d.bytes_sent,
+            d.bytes_received,
+            d.prefetch_refills,
+            d.prefetch_stalls,
+            d.get_data_calls,
+            d.text_conversions,
+            d.buffer_grows,
+            exec.sql
+        ));
+    }
+}
+
+/// Counts of `a` less those of `b`, without the latencies. Saturating, as
+/// the application may have reset the counters in between.
+fn since(a: &Stats, b: &Stats) -> Stats {
+    Stats {
+        round_trips: a.round_trips.saturating_sub(b.round_trips),
+        bytes_sent: a.bytes_sent.saturating_sub(b.bytes_sent),
+        bytes_received: a.bytes_received.saturating_sub(b.bytes_received),
+        first_row_us: 0,
+        last_row_us: 0,
+        executions: a.executions.saturating_sub(b.executions),
+        rows_fetched: a.rows_fetched.saturating_sub(b.rows_fetched),
+        prefetch_refills: a.prefetch_refills.saturating_sub(b.prefetch_refills),
+        prefetch_stalls: a.prefetch_stalls.saturating_sub(b.prefetch_stalls),
+        get_data_calls: a.get_data_calls.saturating_sub(b.get_data_calls),
+        text_conversions: a.text_conversions.saturating_sub(b.text_conversions),
+        buffer_grows: a.buffer_grows.saturating_sub(b.buffer_grows),
+        spill_bytes: a.spill_bytes.saturating_sub(b.spill_bytes),
+    }
+}
+
+/// Trace sink of a connection (Trace=<path>): one line per execution and
+/// per connect, buffered and written out as the buffer fills and when the
+/// connection closes. Nothing is formatted without one.
+pub struct Trace {
+    out: Mutex<TraceFile>,
+}
+
+struct TraceFile {
+    path: String,
+    file: BufWriter<File>,
+    written: u64,
+}
+
+impl Trace {
+    /// Append to the file at `path`
+    pub fn open(path: &str) -> std::io::Result<Self> {
+        let file = OpenOptions::new().create(true).append(true).open(path)?;
+        let written = file.metadata()?.len();
+        Ok(Self {
+            out: Mutex::new(TraceFile {
+                path: path.to_string(),
+                file: BufWriter::new(file),
+                written,
+            }),
+        })
+    }
+
+    /// Write one line, prefixed with the time in microseconds since the
+    /// epoch. Trace I/O errors are ignored: tracing never fails a call.
+    pub fn write(&self, line: &str) {
+        let mut out = self.out.lock().unwrap();
+        if out.written >= TRACE_MAX_BYTES {
+            let _ = out.rotate();
+        }
+        let now = SystemTime::now()
+            .duration_since(UNIX_EPOCH)
+            .map_or(0, |d| d.as_micros());
+        let line = format!("{} {}\n", now, line);
+        if out.file.write_all(line.as_bytes()).is_ok() {
+            out.written += line.len() as u64;
+        }
+    }
+}
+
+impl TraceFile {
+    fn rotate(&mut self) -> std::io::Result<()> {
+        self.file.flush()?;
+        fs::rename(&self.path, format!("{}.1", self.path))?;
+        let file = OpenOptions::new()
+            .create(true)
+            .append(true)
+            .open(&self.path)?;
+        self.file = BufWriter::new(file);
+        self.written = 0;
+        Ok(())
+    }
+}
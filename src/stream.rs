@@ -0,0 +1,480 @@
+use std::io::{self, IoSlice, Read, Write};
+use std::net::TcpStream;
+use std::sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+use std::time::{Duration, Instant};
+
+use crate::types::SQLULEN;
+
+/// Packet size of every session: tabby's login asks for 4096 bytes and has
+/// no way to ask for another, and the server can only shrink it
+pub const PACKET_SIZE: usize = 4096;
+const PACKET_HEADER_LEN: usize = 8;
+const PACKET_ATTENTION: u8 = 0x06;
+const STATUS_EOM: u8 = 0x01;
+const TOKEN_DONE: u8 = 0xFD;
+const DONE_ATTN: u16 = 0x0020;
+/// DONE token: type, status (2), curcmd (2), row count (8)
+const DONE_TOKEN_LEN: usize = 13;
+
+/// Why the request in flight was interrupted
+#[derive(Clone, Copy, PartialEq, Eq)]
+pub enum Interrupt {
+    Cancelled,
+    TimedOut,
+}
+
+/// Tracks TDS packet boundaries in the server's byte stream, so the reply to
+/// an attention signal can be recognised: it is a message whose final token
+/// is a DONE with the ATTN status bit set.
+#[derive(Default)]
+struct PacketScanner {
+    header: [u8; PACKET_HEADER_LEN],
+    header_len: usize,
+    body_left: usize,
+    eom: bool,
+    tail: [u8; DONE_TOKEN_LEN],
+    tail_len: usize,
+}
+
+impl PacketScanner {
+    /// Feed bytes read from the server; returns true if an attention
+    /// acknowledgement ended inside them.
+    fn feed(&mut self, mut data: &[u8]) -> bool {
+        let mut acked = false;
+        while !data.is_empty() {
+            if self.header_len < PACKET_HEADER_LEN {
+                let n = (PACKET_HEADER_LEN - self.header_len).min(data.len());
+                self.header[self.header_len..self.header_len + n].copy_from_slice(&data[..n]);
+                self.header_len += n;
+                data = &data[n..];
+                if self.header_len == PACKET_HEADER_LEN {
+                    let len = u16::from_be_bytes([self.header[2], self.header[3]]) as usize;
+                    self.body_left = len.saturating_sub(PACKET_HEADER_LEN);
+                    self.eom = self.header[1] & STATUS_EOM != 0;
+                    acked |= self.end_of_packet();
+                }
+                continue;
+            }
+            let n = self.body_left.min(data.len());
+            self.push_tail(&data[..n]);
+            self.body_left -= n;
+            data = &data[n..];
+            acked |= self.end_of_packet();
+        }
+        acked
+    }
+
+    fn push_tail(&mut self, bytes: &[u8]) {
+        if bytes.len() >= DONE_TOKEN_LEN {
+            self.tail
+                .copy_from_slice(&bytes[bytes.len() - DONE_TOKEN_LEN..]);
+            self.tail_len = DONE_TOKEN_LEN;
+            return;
+        }
+        let keep = (DONE_TOKEN_LEN - bytes.len()).min(self.tail_len);
+        self.tail
+            .copy_within(self.tail_len - keep..self.tail_len, 0);
+        self.tail[keep..keep + bytes.len()].copy_from_slice(bytes);
+        self.tail_len = keep + bytes.len();
+    }
+
+    fn end_of_packet(&mut self) -> bool {
+        if self.header_len < PACKET_HEADER_LEN || self.body_left > 0 {
+            return false;
+        }
+        self.header_len = 0;
+        if !self.eom {
+            // A token may straddle packets, so the tail carries over until
+            // the end of the message
+            return false;
+        }
+        let acked = self.tail_len == DONE_TOKEN_LEN
+            && self.tail[0] == TOKEN_DONE
+            && u16::from_le_bytes([self.tail[1], self.tail[2]]) & DONE_ATTN != 0;
+        self.tail_len = 0;
+        acked
+    }
+}
+
+/// Attention (cancel) state of one connection, shared by the stream the
+/// client reads through and any thread calling SQLCancel.
+pub struct Attention {
+    /// Second handle on the socket, for writing the attention packet and for
+    /// reading the acknowledgement once the client is done with a reply
+    socket: Mutex<TcpStream>,
+    /// The session runs without TLS. tabby encrypts above this stream, so on
+    /// an encrypted session nothing can be written to or read from `socket`
+    /// directly.
+    plain: bool,
+    scanner: Mutex<PacketScanner>,
+    /// A driver call is waiting on the server
+    busy: AtomicBool,
+    /// Address of the statement whose reply the busy call is reading
+    owner: AtomicUsize,
+    /// The current request has been sent completely and the reply is being read
+    receiving: AtomicBool,
+    requested: AtomicBool,
+    sent: AtomicBool,
+    acked: AtomicBool,
+    /// When SQL_ATTR_QUERY_TIMEOUT runs out for the busy call
+    deadline: Mutex<Option<Instant>>,
+    timed_out: AtomicBool,
+    /// Running totals for `traffic`
+    requests: AtomicU64,
+    bytes_sent: AtomicU64,
+    bytes_received: AtomicU64,
+}
+
+/// What the session has exchanged with the server since it was opened
+#[derive(Clone, Copy, Default)]
+pub struct Traffic {
+    /// Requests the server started replying to
+    pub requests: u64,
+    pub bytes_sent: u64,
+    pub bytes_received: u64,
+}
+
+impl Traffic {
+    /// What was exchanged between `earlier` and this reading. Saturating,
+    /// in case `earlier` was taken on another session.
+    pub fn since(self, earlier: Traffic) -> Traffic {
+        Traffic {
+            requests: self.requests.saturating_sub(earlier.requests),
+            bytes_sent: self.bytes_sent.saturating_sub(earlier.bytes_sent),
+            bytes_received: self.bytes_received.saturating_sub(earlier.bytes_received),
+        }
+    }
+}
+
+impl Attention {
+    pub fn traffic(&self) -> Traffic {
+        Traffic {
+            requests: self.requests.load(Ordering::Relaxed),
+            bytes_sent: self.bytes_sent.load(Ordering::Relaxed),
+            bytes_received: self.bytes_received.load(Ordering::Relaxed),
+        }
+    }
+
+    /// Whether the driver can signal attention and write BULK_LOAD packets
+    /// on this session: only when it is not encrypted
+    pub fn can_signal(&self) -> bool {
+        self.plain
+    }
+
+    /// Ask the server to stop the request in flight for statement `owner`.
+    /// Safe to call from any thread; does nothing unless a driver call is
+    /// waiting on the server for that statement and the session can signal.
+    pub fn cancel(&self, owner: usize) -> bool {
+        if !self.plain
+            || !self.busy.load(Ordering::SeqCst)
+            || self.owner.load(Ordering::SeqCst) != owner
+        {
+            return false;
+        }
+        self.requested.store(true, Ordering::SeqCst);
+        // Packets must not interleave with a request still being written, so
+        // an incomplete request leaves the send to the next read
+        let socket = self.socket.lock().unwrap();
+        if self.receiving.load(Ordering::SeqCst) {
+            let _ = self.send_locked(&socket);
+        }
+        true
+    }
+
+    fn send_locked(&self, mut socket: &TcpStream) -> io::Result<()> {
+        if !self.plain {
+            return Err(io::ErrorKind::Unsupported.into());
+        }
+        if self.sent.swap(true, Ordering::SeqCst) {
+            return Ok(());
+        }
+        self.acked.store(false, Ordering::SeqCst);
+        socket.write_all(&[PACKET_ATTENTION, STATUS_EOM, 0, 8, 0, 0, 1, 0])
+    }
+
+    /// Send an attention signal from the thread that owns the connection.
+    pub fn send(&self) -> io::Result<()> {
+        let socket = self.socket.lock().unwrap();
+        self.send_locked(&socket)
+    }
+
+    /// Mark the start of a driver call that waits on the server, arming
+    /// SQL_ATTR_QUERY_TIMEOUT (0 = none) from now for all of its reads
+    /// unless the session cannot signal the timeout. `new_request` is set
+    /// when the call sends a request rather than reading the current reply;
+    /// `owner` identifies the statement for SQLCancel.
+    pub fn begin(
+        self: &Arc<Self>,
+        owner: usize,
+        timeout_secs: SQLULEN,
+        new_request: bool,
+    ) -> BusyGuard {
+        if new_request {
+            self.receiving.store(false, Ordering::SeqCst);
+        }
+        *self.deadline.lock().unwrap() = (timeout_secs > 0 && self.plain)
+            .then(|| Instant::now() + Duration::from_secs(timeout_secs as u64));
+        self.owner.store(owner, Ordering::SeqCst);
+        self.busy.store(true, Ordering::SeqCst);
+        BusyGuard {
+            attention: self.clone(),
+        }
+    }
+
+    /// Whether an attention has been sent for the current request
+    pub fn pending(&self) -> bool {
+        self.sent.load(Ordering::SeqCst)
+    }
+
+    /// Read and discard the server's reply up to the attention
+    /// acknowledgement. Call after the client has consumed what it considers
+    /// the end of the reply; anything after that is only the acknowledgement.
+    pub fn wait_ack(&self) -> io::Result<()> {
+        if !self.plain {
+            return Err(io::ErrorKind::Unsupported.into());
+        }
+        let mut socket = self.socket.lock().unwrap();
+        socket.set_read_timeout(None)?;
+        let mut buf = [0u8; 512];
+        while !self.acked.load(Ordering::SeqCst) {
+            let n = socket.read(&mut buf)?;
+            if n == 0 {
+                return Err(io::ErrorKind::UnexpectedEof.into());
+            }
+            if self.scanner.lock().unwrap().feed(&buf[..n]) {
+                self.acked.store(true, Ordering::SeqCst);
+            }
+        }
+        Ok(())
+    }
+
+    /// Write part of a request message tabby cannot build (BULK_LOAD), as
+    /// packets of `packet_type` carrying up to `packet_size` bytes each.
+    /// Every packet but the last of a message must be full, so a part that
+    /// is not `last` must be a whole number of packet bodies long.
+    pub fn write_packets(
+        &self,
+        packet_type: u8,
+        payload: &[u8],
+        last: bool,
+        packet_size: usize,
+        packet_id: &mut u8,
+    ) -> io::Result<()> {
+        if !self.plain {
+            return Err(io::ErrorKind::Unsupported.into());
+        }
+        let mut socket = self.socket.lock().unwrap();
+        self.receiving.store(false, Ordering::SeqCst);
+        let body = packet_size - PACKET_HEADER_LEN;
+        // An empty last part is still one packet, carrying the EOM status
+        let count = payload.len().div_ceil(body).max(last as usize);
+        let headers: Vec<[u8; PACKET_HEADER_LEN]> = (0..count)
+            .map(|i| {
+                let len = body.min(payload.len() - i * body);
+                let status = if last && i + 1 == count {
+                    STATUS_EOM
+                } else {
+                    0
+                };
+                let len = ((len + PACKET_HEADER_LEN) as u16).to_be_bytes();
+                let header = [packet_type, status, len[0], len[1], 0, 0, *packet_id, 0];
+                *packet_id = packet_id.wrapping_add(1);
+                header
+            })
+            .collect();
+        // All the packets go out in as few writes as the socket takes
+        let mut slices: Vec<IoSlice> = Vec::with_capacity(count * 2);
+        for (header, chunk) in headers.iter().zip(payload.chunks(body).chain([&[][..]])) {
+            slices.push(IoSlice::new(header));
+            if !chunk.is_empty() {
+                slices.push(IoSlice::new(chunk));
+            }
+        }
+        write_all_vectored(&mut socket, &mut slices)?;
+        self.bytes_sent.fetch_add(
+            (payload.len() + count * PACKET_HEADER_LEN) as u64,
+            Ordering::Relaxed,
+        );
+        if last {
+            self.receiving.store(true, Ordering::SeqCst);
+        }
+        Ok(())
+    }
+
+    /// Read the reply to a message sent with `write_packets`, returning the
+    /// message body without packet headers.
+    pub fn read_message(&self) -> io::Result<Vec<u8>> {
+        if !self.plain {
+            return Err(io::ErrorKind::Unsupported.into());
+        }
+        let mut socket = self.socket.lock().unwrap();
+        let mut message = Vec::new();
+        loop {
+            let mut header = [0u8; PACKET_HEADER_LEN];
+            socket.read_exact(&mut header)?;
+            let len = u16::from_be_bytes([header[2], header[3]]) as usize;
+            let start = message.len();
+            message.resize(start + len.saturating_sub(PACKET_HEADER_LEN), 0);
+            socket.read_exact(&mut message[start..])?;
+            // Keeps the scanner on the packet boundaries tabby reads next
+            let mut scanner = self.scanner.lock().unwrap();
+            scanner.feed(&header);
+            scanner.feed(&message[start..]);
+            if header[1] & STATUS_EOM != 0 {
+                return Ok(message);
+            }
+        }
+    }
+
+    /// Clear the attention state once the acknowledgement has been read,
+    /// returning why the request was interrupted, if it was.
+    pub fn finish(&self) -> Option<Interrupt> {
+        self.requested.store(false, Ordering::SeqCst);
+        if !self.sent.swap(false, Ordering::SeqCst) {
+            return None;
+        }
+        self.acked.store(false, Ordering::SeqCst);
+        if self.timed_out.swap(false, Ordering::SeqCst) {
+            Some(Interrupt::TimedOut)
+        } else {
+            Some(Interrupt::Cancelled)
+        }
+    }
+}
+
+fn write_all_vectored(socket: &mut TcpStream, mut slices: &mut [IoSlice]) -> io::Result<()> {
+    while !slices.is_empty() {
+        match socket.write_vectored(slices) {
+            Ok(0) => return Err(io::ErrorKind::WriteZero.into()),
+            Ok(n) => IoSlice::advance_slices(&mut slices, n),
+            Err(e) if e.kind() == io::ErrorKind::Interrupted => {}
+            Err(e) => return Err(e),
+        }
+    }
+    Ok(())
+}
+
+/// Clears the busy state and query timeout when a driver call returns.
+pub struct BusyGuard {
+    attention: Arc<Attention>,
+}
+
+impl Drop for BusyGuard {
+    fn drop(&mut self) {
+        self.attention.busy.store(false, Ordering::SeqCst);
+        // A cancel that arrived too late to be sent no longer applies
+        self.attention.requested.store(false, Ordering::SeqCst);
+        if self.attention.deadline.lock().unwrap().take().is_some() {
+            let _ = self.attention.socket.lock().unwrap().set_read_timeout(None);
+        }
+    }
+}
+
+/// The socket the TDS client runs on. It watches the reply stream for
+/// attention acknowledgements and, when a query timeout is armed, bounds
+/// each read by the time left and turns running out into an attention
+/// signal rather than an I/O error.
+pub struct TdsStream {
+    inner: TcpStream,
+    attention: Arc<Attention>,
+}
+
+impl TdsStream {
+    /// `plain` is false when tabby will run TLS on top of the stream
+    pub fn new(inner: TcpStream, plain: bool) -> io::Result<(Self, Arc<Attention>)> {
+        let attention = Arc::new(Attention {
+            socket: Mutex::new(inner.try_clone()?),
+            plain,
+            scanner: Mutex::new(PacketScanner::default()),
+            busy: AtomicBool::new(false),
+            owner: AtomicUsize::new(0),
+            receiving: AtomicBool::new(false),
+            requested: AtomicBool::new(false),
+            sent: AtomicBool::new(false),
+            acked: AtomicBool::new(false),
+            deadline: Mutex::new(None),
+            timed_out: AtomicBool::new(false),
+            requests: AtomicU64::new(0),
+            bytes_sent: AtomicU64::new(0),
+            bytes_received: AtomicU64::new(0),
+        });
+        Ok((
+            Self {
+                inner,
+                attention: attention.clone(),
+            },
+            attention,
+        ))
+    }
+}
+
+impl Read for TdsStream {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        let att = &self.attention;
+        if !att.receiving.swap(true, Ordering::SeqCst) {
+            // First read since a request was written: one round trip
+            att.requests.fetch_add(1, Ordering::Relaxed);
+            if att.requested.load(Ordering::SeqCst) {
+                att.send()?;
+            }
+        }
+        let n = loop {
+            let deadline = *att.deadline.lock().unwrap();
+            if let Some(deadline) = deadline {
+                let left = deadline.saturating_duration_since(Instant::now());
+                if left.is_zero() {
+                    // Query timeout: cancel and keep reading until the
+                    // server acknowledges
+                    att.timed_out.store(true, Ordering::SeqCst);
+                    att.send()?;
+                    *att.deadline.lock().unwrap() = None;
+                    self.inner.set_read_timeout(None)?;
+                    continue;
+                }
+                self.inner.set_read_timeout(Some(left))?;
+            }
+            match self.inner.read(buf) {
+                // Out of time: the deadline check above sends the attention
+                Err(e)
+                    if matches!(
+                        e.kind(),
+                        io::ErrorKind::WouldBlock | io::ErrorKind::TimedOut
+                    ) && deadline.is_some() => {}
+                r => break r?,
+            }
+        };
+        // Always scanned, to keep track of packet boundaries
+        if att.scanner.lock().unwrap().feed(&buf[..n]) && att.sent.load(Ordering::SeqCst) {
+            att.acked.store(true, Ordering::SeqCst);
+        }
+        att.bytes_received.fetch_add(n as u64, Ordering::Relaxed);
+        Ok(n)
+    }
+}
+
+impl Write for TdsStream {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        let _socket = self.attention.socket.lock().unwrap();
+        self.attention.receiving.store(false, Ordering::SeqCst);
+        let n = self.inner.write(buf)?;
+        self.attention
+            .bytes_sent
+            .fetch_add(n as u64, Ordering::Relaxed);
+        Ok(n)
+    }
+
+    fn write_vectored(&mut self, bufs: &[IoSlice]) -> io::Result<usize> {
+        let _socket = self.attention.socket.lock().unwrap();
+        self.attention.receiving.store(false, Ordering::SeqCst);
+        let n = self.inner.write_vectored(bufs)?;
+        self.attention
+            .bytes_sent
+            .fetch_add(n as u64, Ordering::Relaxed);
+        Ok(n)
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        self.inner.flush()
+    }
+}
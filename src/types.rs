@@ -23,6 +23,7 @@ pub const SQL_NO_DATA: SQLRETURN = 100;
 pub const SQL_ERROR: SQLRETURN = -1;
 pub const SQL_INVALID_HANDLE: SQLRETURN = -2;
 pub const SQL_NEED_DATA: SQLRETURN = 99;
+pub const SQL_STILL_EXECUTING: SQLRETURN = 2;
 
 // Handle types
 pub const SQL_HANDLE_ENV: SQLSMALLINT = 1;
@@ -38,8 +39,30 @@ pub const SQL_OV_ODBC2: SQLINTEGER = 2;
 pub const SQL_ATTR_AUTOCOMMIT: SQLINTEGER = 102;
 pub const SQL_ATTR_CONNECTION_TIMEOUT: SQLINTEGER = 113;
 pub const SQL_ATTR_LOGIN_TIMEOUT: SQLINTEGER = 103;
+pub const SQL_ATTR_PACKET_SIZE: SQLINTEGER = 112;
 pub const SQL_AUTOCOMMIT_ON: SQLUINTEGER = 1;
 pub const SQL_AUTOCOMMIT_OFF: SQLUINTEGER = 0;
+/// Connection and statement attribute
+pub const SQL_ATTR_ASYNC_ENABLE: SQLINTEGER = 4;
+pub const SQL_ASYNC_ENABLE_OFF: SQLULEN = 0;
+pub const SQL_ASYNC_ENABLE_ON: SQLULEN = 1;
+
+// Driver-specific connection attributes (SQLGetConnectAttr)
+pub const SQL_DRIVER_CONN_ATTR_BASE: SQLINTEGER = 0x4000;
+/// Connects served from this environment's connection pool
+pub const SQL_ATTR_FB_POOL_HITS: SQLINTEGER = SQL_DRIVER_CONN_ATTR_BASE + 1;
+/// Pooled connects that had to open a new session
+pub const SQL_ATTR_FB_POOL_MISSES: SQLINTEGER = SQL_DRIVER_CONN_ATTR_BASE + 2;
+/// Performance counters of the connection, or as a statement attribute of
+/// the statement (a struct of 64-bit counters, see stats::Stats). Setting
+/// it to NULL resets them.
+pub const SQL_ATTR_FB_STATS: SQLINTEGER = SQL_DRIVER_CONN_ATTR_BASE + 3;
+
+// furball_bcp_init options
+/// Take a table lock for the duration of each batch
+pub const FB_BCP_TABLOCK: SQLUINTEGER = 0x1;
+/// Check constraints on the loaded rows, which bulk copy otherwise skips
+pub const FB_BCP_CHECK_CONSTRAINTS: SQLUINTEGER = 0x2;
 
 // Data types
 pub const SQL_CHAR: SQLSMALLINT = 1;
@@ -54,6 +77,10 @@ pub const SQL_DATETIME: SQLSMALLINT = 9;
 pub const SQL_TYPE_DATE: SQLSMALLINT = 91;
 pub const SQL_TYPE_TIME: SQLSMALLINT = 92;
 pub const SQL_TYPE_TIMESTAMP: SQLSMALLINT = 93;
+// ODBC 2 codes for the date and time types
+pub const SQL_DATE: SQLSMALLINT = 9;
+pub const SQL_TIME: SQLSMALLINT = 10;
+pub const SQL_TIMESTAMP: SQLSMALLINT = 11;
 pub const SQL_BIGINT: SQLSMALLINT = -5;
 pub const SQL_TINYINT: SQLSMALLINT = -6;
 pub const SQL_BIT: SQLSMALLINT = -7;
@@ -109,6 +136,16 @@ pub const SQL_NEED_LONG_DATA_LEN: SQLUSMALLINT = 111;
 pub const SQL_GETDATA_EXTENSIONS: SQLUSMALLINT = 81;
 pub const SQL_GD_ANY_COLUMN: SQLUINTEGER = 1;
 pub const SQL_GD_ANY_ORDER: SQLUINTEGER = 2;
+pub const SQL_SCROLL_OPTIONS: SQLUSMALLINT = 44;
+pub const SQL_SO_FORWARD_ONLY: SQLUINTEGER = 0x01;
+pub const SQL_SO_KEYSET_DRIVEN: SQLUINTEGER = 0x02;
+pub const SQL_SO_DYNAMIC: SQLUINTEGER = 0x04;
+pub const SQL_SO_STATIC: SQLUINTEGER = 0x10;
+pub const SQL_SCROLL_CONCURRENCY: SQLUSMALLINT = 43;
+pub const SQL_SCCO_READ_ONLY: SQLUINTEGER = 0x01;
+pub const SQL_SCCO_LOCK: SQLUINTEGER = 0x02;
+pub const SQL_SCCO_OPT_ROWVER: SQLUINTEGER = 0x04;
+pub const SQL_SCCO_OPT_VALUES: SQLUINTEGER = 0x08;
 pub const SQL_CURSOR_COMMIT_BEHAVIOR: SQLUSMALLINT = 23;
 pub const SQL_CURSOR_ROLLBACK_BEHAVIOR: SQLUSMALLINT = 24;
 pub const SQL_TXN_CAPABLE: SQLUSMALLINT = 46;
@@ -141,12 +178,24 @@ pub const SQL_NULL_COLLATION: SQLUSMALLINT = 85;
 pub const SQL_PROCEDURES: SQLUSMALLINT = 21;
 pub const SQL_SUBQUERIES: SQLUSMALLINT = 95;
 pub const SQL_UNION: SQLUSMALLINT = 96;
+pub const SQL_PARAM_ARRAY_ROW_COUNTS: SQLUSMALLINT = 153;
+pub const SQL_PARAM_ARRAY_SELECTS: SQLUSMALLINT = 154;
+pub const SQL_PARC_NO_BATCH: SQLUINTEGER = 2;
+pub const SQL_PAS_NO_SELECT: SQLUINTEGER = 3;
+pub const SQL_ASYNC_MODE: SQLUSMALLINT = 10021;
+pub const SQL_MAX_ASYNC_CONCURRENT_STATEMENTS: SQLUSMALLINT = 10022;
+pub const SQL_ASYNC_NOTIFICATION: SQLUSMALLINT = 10025;
+pub const SQL_AM_STATEMENT: SQLUINTEGER = 2;
+pub const SQL_ASYNC_NOTIFICATION_CAPABLE: SQLUINTEGER = 1;
 
 // Nullable
 pub const SQL_NO_NULLS: SQLSMALLINT = 0;
 pub const SQL_NULLABLE: SQLSMALLINT = 1;
 pub const SQL_NULLABLE_UNKNOWN: SQLSMALLINT = 2;
 
+// SQLGetTypeInfo SEARCHABLE
+pub const SQL_SEARCHABLE: SQLSMALLINT = 3;
+
 // SQLFreeStmt options
 pub const SQL_CLOSE: SQLUSMALLINT = 0;
 pub const SQL_DROP: SQLUSMALLINT = 1;
@@ -185,12 +234,77 @@ pub const SQL_ATTR_QUERY_TIMEOUT: SQLINTEGER = 0;
 pub const SQL_ATTR_MAX_ROWS: SQLINTEGER = 1;
 pub const SQL_ATTR_NOSCAN: SQLINTEGER = 2;
 pub const SQL_ATTR_MAX_LENGTH: SQLINTEGER = 3;
+pub const SQL_ATTR_ASYNC_STMT_EVENT: SQLINTEGER = 29;
+pub const SQL_ATTR_ASYNC_STMT_PCALLBACK: SQLINTEGER = 30;
+pub const SQL_ATTR_ASYNC_STMT_PCONTEXT: SQLINTEGER = 31;
 pub const SQL_ATTR_CURSOR_SCROLLABLE: SQLINTEGER = -1;
 pub const SQL_ATTR_CURSOR_SENSITIVITY: SQLINTEGER = -2;
+pub const SQL_ATTR_ROW_BIND_TYPE: SQLINTEGER = 5;
+pub const SQL_ATTR_ROW_BIND_OFFSET_PTR: SQLINTEGER = 23;
+pub const SQL_ATTR_PARAM_BIND_OFFSET_PTR: SQLINTEGER = 17;
+pub const SQL_ATTR_PARAM_BIND_TYPE: SQLINTEGER = 18;
+pub const SQL_ATTR_PARAM_OPERATION_PTR: SQLINTEGER = 19;
+pub const SQL_ATTR_PARAM_STATUS_PTR: SQLINTEGER = 20;
+pub const SQL_ATTR_PARAMS_PROCESSED_PTR: SQLINTEGER = 21;
+pub const SQL_ATTR_PARAMSET_SIZE: SQLINTEGER = 22;
+
+// Driver-specific statement attributes
+pub const SQL_DRIVER_STMT_ATTR_BASE: SQLINTEGER = 0x4000;
+/// Memory budget in bytes for rows read ahead of the application
+pub const SQL_ATTR_FB_PREFETCH_BYTES: SQLINTEGER = SQL_DRIVER_STMT_ATTR_BASE + 1;
+/// Decode streamed rows on a background thread (SQL_TRUE / SQL_FALSE)
+pub const SQL_ATTR_FB_READ_AHEAD: SQLINTEGER = SQL_DRIVER_STMT_ATTR_BASE + 2;
+/// Run a query as this many key-partitioned queries on sessions of their
+/// own, merging the rows (0 or 1 = off)
+pub const SQL_ATTR_FB_PARTITIONS: SQLINTEGER = SQL_DRIVER_STMT_ATTR_BASE + 4;
+/// Result column the partitions are split on (a string)
+pub const SQL_ATTR_FB_PARTITION_KEY: SQLINTEGER = SQL_DRIVER_STMT_ATTR_BASE + 5;
+/// Merge the partitions in partition key order (SQL_TRUE / SQL_FALSE)
+pub const SQL_ATTR_FB_PARTITION_ORDERED: SQLINTEGER = SQL_DRIVER_STMT_ATTR_BASE + 6;
+pub const SQL_PARAM_BIND_BY_COLUMN: SQLULEN = 0;
+pub const SQL_BIND_BY_COLUMN: SQLULEN = 0;
+
+// Row status values (SQL_ATTR_ROW_STATUS_PTR)
+pub const SQL_ROW_SUCCESS: SQLUSMALLINT = 0;
+pub const SQL_ROW_NOROW: SQLUSMALLINT = 3;
+pub const SQL_ROW_ERROR: SQLUSMALLINT = 5;
+pub const SQL_ROW_SUCCESS_WITH_INFO: SQLUSMALLINT = 6;
+
+// Parameter status values (SQL_ATTR_PARAM_STATUS_PTR)
+pub const SQL_PARAM_SUCCESS: SQLUSMALLINT = 0;
+pub const SQL_PARAM_DIAG_UNAVAILABLE: SQLUSMALLINT = 1;
+pub const SQL_PARAM_ERROR: SQLUSMALLINT = 5;
+pub const SQL_PARAM_SUCCESS_WITH_INFO: SQLUSMALLINT = 6;
+pub const SQL_PARAM_UNUSED: SQLUSMALLINT = 7;
+
+// Parameter operation values (SQL_ATTR_PARAM_OPERATION_PTR)
+pub const SQL_PARAM_PROCEED: SQLUSMALLINT = 0;
+pub const SQL_PARAM_IGNORE: SQLUSMALLINT = 1;
 
 // Fetch orientation
 pub const SQL_FETCH_NEXT: SQLSMALLINT = 1;
 pub const SQL_FETCH_FIRST: SQLSMALLINT = 2;
+pub const SQL_FETCH_LAST: SQLSMALLINT = 3;
+pub const SQL_FETCH_PRIOR: SQLSMALLINT = 4;
+pub const SQL_FETCH_ABSOLUTE: SQLSMALLINT = 5;
+pub const SQL_FETCH_RELATIVE: SQLSMALLINT = 6;
+pub const SQL_FETCH_BOOKMARK: SQLSMALLINT = 8;
+
+// Cursor types (SQL_ATTR_CURSOR_TYPE)
+pub const SQL_CURSOR_FORWARD_ONLY: SQLULEN = 0;
+pub const SQL_CURSOR_KEYSET_DRIVEN: SQLULEN = 1;
+pub const SQL_CURSOR_DYNAMIC: SQLULEN = 2;
+pub const SQL_CURSOR_STATIC: SQLULEN = 3;
+
+// Concurrency (SQL_ATTR_CONCURRENCY)
+pub const SQL_CONCUR_READ_ONLY: SQLULEN = 1;
+pub const SQL_CONCUR_LOCK: SQLULEN = 2;
+pub const SQL_CONCUR_ROWVER: SQLULEN = 3;
+pub const SQL_CONCUR_VALUES: SQLULEN = 4;
+
+// SQL_ATTR_CURSOR_SCROLLABLE
+pub const SQL_NONSCROLLABLE: SQLULEN = 0;
+pub const SQL_SCROLLABLE: SQLULEN = 1;
 
 // Info return values
 pub const SQL_TC_ALL: SQLUSMALLINT = 2;
@@ -225,7 +339,7 @@ pub const SQL_LEN_DATA_AT_EXEC_OFFSET: SQLLEN = -100;
 
 // SQL_TIMESTAMP_STRUCT
 #[repr(C)]
-#[derive(Default)]
+#[derive(Clone, Copy, Default)]
 pub struct SqlTimestampStruct {
     pub year: i16,
     pub month: u16,
@@ -237,7 +351,7 @@ pub struct SqlTimestampStruct {
 }
 
 #[repr(C)]
-#[derive(Default)]
+#[derive(Clone, Copy, Default)]
 pub struct SqlDateStruct {
     pub year: i16,
     pub month: u16,
@@ -245,7 +359,7 @@ pub struct SqlDateStruct {
 }
 
 #[repr(C)]
-#[derive(Default)]
+#[derive(Clone, Copy, Default)]
 pub struct SqlTimeStruct {
     pub hour: u16,
     pub minute: u16,
@@ -253,6 +367,7 @@ pub struct SqlTimeStruct {
 }
 
 #[repr(C)]
+#[derive(Clone, Copy)]
 pub struct SqlGuid {
     pub data1: u32,
     pub data2: u16,
@@ -0,0 +1,474 @@
+//! UTF-8 / UTF-16 transcoding for the W entry points and SQL_C_WCHAR data.
+//! Runs of ASCII, which is most of what crosses the boundary (SQL text,
+//! names, formatted values), are converted a vector at a time by a kernel
+//! picked for the CPU on first use; everything else goes a character at a
+//! time, then the kernel is tried again.
+
+use std::sync::OnceLock;
+
+/// Units (or bytes) converted by the scalar loop after a kernel stops,
+/// before the kernel is tried again
+const RUN: usize = 32;
+
+/// Narrow leading ASCII UTF-16LE units from `src` (`units` of them at most)
+/// to bytes at `dst`, a whole block at a time; returns the units done
+type NarrowFn = unsafe fn(src: *const u8, units: usize, dst: *mut u8) -> usize;
+/// Widen leading ASCII bytes from `src` (`len` at most) to UTF-16 units at
+/// `dst`, which need not be aligned; returns the bytes done
+type WidenFn = unsafe fn(src: *const u8, len: usize, dst: *mut u16) -> usize;
+/// Length of the ASCII prefix of `src`, in whole blocks
+type AsciiFn = unsafe fn(src: *const u8, len: usize) -> usize;
+
+struct Kernels {
+    narrow: NarrowFn,
+    widen: WidenFn,
+    ascii: AsciiFn,
+}
+
+fn kernels() -> &'static Kernels {
+    static KERNELS: OnceLock<Kernels> = OnceLock::new();
+    KERNELS.get_or_init(detect)
+}
+
+fn detect() -> Kernels {
+    #[cfg(target_arch = "x86_64")]
+    {
+        if is_x86_feature_detected!("avx2") {
+            return Kernels {
+                narrow: x86::narrow_avx2,
+                widen: x86::widen_avx2,
+                ascii: x86::ascii_avx2,
+            };
+        }
+        Kernels {
+            narrow: x86::narrow_sse2,
+            widen: x86::widen_sse2,
+            ascii: x86::ascii_sse2,
+        }
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        Kernels {
+            narrow: neon::narrow,
+            widen: neon::widen,
+            ascii: neon::ascii,
+        }
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    {
+        Kernels {
+            narrow: scalar::narrow,
+            widen: scalar::widen,
+            ascii: scalar::ascii,
+        }
+    }
+}
+
+/// Length of `s` in UTF-16 code units, without encoding it
+pub fn utf16_len(s: &str) -> usize {
+    let bytes = s.as_bytes();
+    let k = kernels();
+    let mut i = 0;
+    let mut units = 0;
+    while i < bytes.len() {
+        // SAFETY: in bounds of `bytes`
+        let n = unsafe { (k.ascii)(bytes.as_ptr().add(i), bytes.len() - i) };
+        i += n;
+        units += n;
+        let end = (i + RUN).min(bytes.len());
+        // One unit per character, two for those of four bytes
+        for &b in &bytes[i..end] {
+            units += (b & 0xC0 != 0x80) as usize + (b >= 0xF0) as usize;
+        }
+        i = end;
+    }
+    units
+}
+
+/// Append UTF-16LE text held as bytes to `out` as UTF-8. Unpaired
+/// surrogates become U+FFFD, so `out` gets valid UTF-8 only.
+pub fn decode_le_into(bytes: &[u8], out: &mut Vec<u8>) {
+    let units = bytes.len() / 2;
+    let k = kernels();
+    let mut i = 0;
+    while i < units {
+        out.reserve(units - i);
+        let len = out.len();
+        // SAFETY: room was reserved for one byte per unit left
+        let n = unsafe {
+            (k.narrow)(
+                bytes.as_ptr().add(i * 2),
+                units - i,
+                out.as_mut_ptr().add(len),
+            )
+        };
+        unsafe { out.set_len(len + n) };
+        i += n;
+        let end = (i + RUN).min(units);
+        while i < end {
+            i = decode_char(bytes, i, units, out);
+        }
+    }
+}
+
+fn unit_at(bytes: &[u8], i: usize) -> u16 {
+    u16::from_le_bytes([bytes[i * 2], bytes[i * 2 + 1]])
+}
+
+/// Append the character at unit `i` and return the unit after it
+fn decode_char(bytes: &[u8], i: usize, units: usize, out: &mut Vec<u8>) -> usize {
+    let u = unit_at(bytes, i) as u32;
+    let (c, next) = match u {
+        0..=0x7F => {
+            out.push(u as u8);
+            return i + 1;
+        }
+        0xD800..=0xDBFF if i + 1 < units => match unit_at(bytes, i + 1) as u32 {
+            low @ 0xDC00..=0xDFFF => (0x10000 + ((u - 0xD800) << 10) + (low - 0xDC00), i + 2),
+            _ => (0xFFFD, i + 1),
+        },
+        0xD800..=0xDFFF => (0xFFFD, i + 1),
+        _ => (u, i + 1),
+    };
+    let mut utf8 = [0u8; 4];
+    // SAFETY: surrogates were replaced above, so `c` is a scalar value
+    let ch = unsafe { char::from_u32_unchecked(c) };
+    out.extend_from_slice(ch.encode_utf8(&mut utf8).as_bytes());
+    next
+}
+
+/// UTF-16LE text held as bytes, as a String
+pub fn decode_le(bytes: &[u8]) -> String {
+    let mut out = Vec::with_capacity(bytes.len() / 2);
+    decode_le_into(bytes, &mut out);
+    // SAFETY: decode_le_into writes valid UTF-8 only
+    unsafe { String::from_utf8_unchecked(out) }
+}
+
+/// UTF-16 text as a String, unpaired surrogates replaced
+pub fn decode(units: &[u16]) -> String {
+    #[cfg(target_endian = "little")]
+    // SAFETY: any initialized u16 slice is valid as bytes
+    return decode_le(unsafe {
+        std::slice::from_raw_parts(units.as_ptr() as *const u8, units.len() * 2)
+    });
+    #[cfg(target_endian = "big")]
+    String::from_utf16_lossy(units)
+}
+
+/// A SQLWCHAR string from the application: `len` units, or up to the NUL
+/// if `len` is negative (SQL_NTS). Null is the empty string.
+///
+/// # Safety
+/// `ptr` must be null or point to `len` units, or to a NUL-terminated
+/// string if `len` is negative.
+pub unsafe fn from_wide_ptr(ptr: *const u16, len: isize) -> String {
+    if ptr.is_null() {
+        return String::new();
+    }
+    let count = if len < 0 {
+        let mut n = 0;
+        while *ptr.add(n) != 0 {
+            n += 1;
+        }
+        n
+    } else {
+        len as usize
+    };
+    decode(std::slice::from_raw_parts(ptr, count))
+}
+
+/// Byte offset in `s` of the character holding UTF-16 unit `skip`, and the
+/// low surrogate to start with when `skip` falls inside a pair
+fn unit_offset(s: &str, skip: usize) -> (usize, Option<u16>) {
+    let bytes = s.as_bytes();
+    // SAFETY: in bounds of `bytes`
+    let mut i = unsafe { (kernels().ascii)(bytes.as_ptr(), skip.min(bytes.len())) };
+    let mut units = i;
+    for ch in s[i..].chars() {
+        if units == skip {
+            break;
+        }
+        let n = ch.len_utf16();
+        if units + n > skip {
+            let mut pair = [0u16; 2];
+            ch.encode_utf16(&mut pair);
+            return (i + ch.len_utf8(), Some(pair[1]));
+        }
+        units += n;
+        i += ch.len_utf8();
+    }
+    (i, None)
+}
+
+/// Encode `s` from UTF-16 unit `skip` on to `dst`, writing at most `cap`
+/// units; a pair cut by the end of the room has its high surrogate
+/// written. Returns the units written.
+///
+/// # Safety
+/// `dst` must have room for `cap` units; it need not be aligned.
+unsafe fn encode_raw(s: &str, skip: usize, dst: *mut u16, cap: usize) -> usize {
+    let (mut i, low) = unit_offset(s, skip);
+    let mut w = 0;
+    if let Some(low) = low {
+        if cap == 0 {
+            return 0;
+        }
+        dst.write_unaligned(low);
+        w = 1;
+    }
+    let bytes = s.as_bytes();
+    let k = kernels();
+    while w < cap && i < bytes.len() {
+        let n = (k.widen)(
+            bytes.as_ptr().add(i),
+            (bytes.len() - i).min(cap - w),
+            dst.add(w),
+        );
+        i += n;
+        w += n;
+        let end = (i + RUN).min(bytes.len());
+        while i < end && w < cap {
+            let ch = s[i..].chars().next().unwrap_or_default();
+            let mut pair = [0u16; 2];
+            for &unit in ch.encode_utf16(&mut pair).iter() {
+                if w == cap {
+                    return w;
+                }
+                dst.add(w).write_unaligned(unit);
+                w += 1;
+            }
+            i += ch.len_utf8();
+        }
+    }
+    w
+}
+
+/// Encode `s` from UTF-16 unit `skip` on into `dst`, as much as fits.
+/// Returns the units written.
+pub fn encode_into(s: &str, skip: usize, dst: &mut [u16]) -> usize {
+    // SAFETY: `dst` has room for its length
+    unsafe { encode_raw(s, skip, dst.as_mut_ptr(), dst.len()) }
+}
+
+/// Append `s` to `out` as UTF-16LE bytes
+pub fn encode_le_into(s: &str, out: &mut Vec<u8>) {
+    #[cfg(target_endian = "little")]
+    {
+        // Never more than two bytes of UTF-16 per byte of UTF-8
+        out.reserve(s.len() * 2);
+        let len = out.len();
+        // SAFETY: room was reserved; the units are written unaligned
+        unsafe {
+            let n = encode_raw(s, 0, out.as_mut_ptr().add(len) as *mut u16, s.len());
+            out.set_len(len + n * 2);
+        }
+    }
+    #[cfg(target_endian = "big")]
+    for unit in s.encode_utf16() {
+        out.extend_from_slice(&unit.to_le_bytes());
+    }
+}
+
+/// Write `s` NUL-terminated into an application buffer of `cap` units, as
+/// much as fits, and return its whole length in units. Nothing is encoded
+/// for a length query (null `dest` or no room).
+///
+/// # Safety
+/// `dest` must be null or have room for `cap` units.
+pub unsafe fn write_wide(s: &str, dest: *mut u16, cap: usize) -> usize {
+    if !dest.is_null() && cap > 0 {
+        let n = encode_raw(s, 0, dest, cap - 1);
+        dest.add(n).write_unaligned(0);
+    }
+    utf16_len(s)
+}
+
+/// Word-at-a-time kernels, for targets without the vector ones
+#[cfg_attr(any(target_arch = "x86_64", target_arch = "aarch64"), allow(dead_code))]
+mod scalar {
+    pub unsafe fn narrow(src: *const u8, units: usize, dst: *mut u8) -> usize {
+        let mut i = 0;
+        while i + 4 <= units {
+            let w = u64::from_le_bytes(src.add(i * 2).cast::<[u8; 8]>().read_unaligned());
+            if w & 0xFF80_FF80_FF80_FF80 != 0 {
+                break;
+            }
+            for j in 0..4 {
+                *dst.add(i + j) = (w >> (j * 16)) as u8;
+            }
+            i += 4;
+        }
+        i
+    }
+
+    pub unsafe fn widen(src: *const u8, len: usize, dst: *mut u16) -> usize {
+        let mut i = 0;
+        while i + 8 <= len {
+            let w = src.add(i).cast::<[u8; 8]>().read_unaligned();
+            if u64::from_ne_bytes(w) & 0x8080_8080_8080_8080 != 0 {
+                break;
+            }
+            for (j, &b) in w.iter().enumerate() {
+                dst.add(i + j).write_unaligned(b as u16);
+            }
+            i += 8;
+        }
+        i
+    }
+
+    pub unsafe fn ascii(src: *const u8, len: usize) -> usize {
+        let mut i = 0;
+        while i + 8 <= len {
+            let w = src.add(i).cast::<[u8; 8]>().read_unaligned();
+            if u64::from_ne_bytes(w) & 0x8080_8080_8080_8080 != 0 {
+                break;
+            }
+            i += 8;
+        }
+        i
+    }
+}
+
+/// SSE2 is part of x86_64; AVX2 is used where the CPU has it
+#[cfg(target_arch = "x86_64")]
+mod x86 {
+    use std::arch::x86_64::*;
+
+    pub unsafe fn narrow_sse2(src: *const u8, units: usize, dst: *mut u8) -> usize {
+        let high = _mm_set1_epi16(0xFF80u16 as i16);
+        let mut i = 0;
+        while i + 16 <= units {
+            let a = _mm_loadu_si128(src.add(i * 2) as *const __m128i);
+            let b = _mm_loadu_si128(src.add(i * 2 + 16) as *const __m128i);
+            let bits = _mm_and_si128(_mm_or_si128(a, b), high);
+            if _mm_movemask_epi8(_mm_cmpeq_epi16(bits, _mm_setzero_si128())) != 0xFFFF {
+                break;
+            }
+            _mm_storeu_si128(dst.add(i) as *mut __m128i, _mm_packus_epi16(a, b));
+            i += 16;
+        }
+        i
+    }
+
+    #[target_feature(enable = "avx2")]
+    pub unsafe fn narrow_avx2(src: *const u8, units: usize, dst: *mut u8) -> usize {
+        let high = _mm256_set1_epi16(0xFF80u16 as i16);
+        let mut i = 0;
+        while i + 32 <= units {
+            let a = _mm256_loadu_si256(src.add(i * 2) as *const __m256i);
+            let b = _mm256_loadu_si256(src.add(i * 2 + 32) as *const __m256i);
+            let bits = _mm256_and_si256(_mm256_or_si256(a, b), high);
+            if _mm256_testz_si256(bits, bits) == 0 {
+                break;
+            }
+            // Packing works within 128-bit lanes: put the quarters in order
+            let packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0b11_01_10_00);
+            _mm256_storeu_si256(dst.add(i) as *mut __m256i, packed);
+            i += 32;
+        }
+        i + narrow_sse2(src.add(i * 2), units - i, dst.add(i))
+    }
+
+    pub unsafe fn widen_sse2(src: *const u8, len: usize, dst: *mut u16) -> usize {
+        let zero = _mm_setzero_si128();
+        let mut i = 0;
+        while i + 16 <= len {
+            let v = _mm_loadu_si128(src.add(i) as *const __m128i);
+            if _mm_movemask_epi8(v) != 0 {
+                break;
+            }
+            _mm_storeu_si128(dst.add(i) as *mut __m128i, _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128(dst.add(i + 8) as *mut __m128i, _mm_unpackhi_epi8(v, zero));
+            i += 16;
+        }
+        i
+    }
+
+    #[target_feature(enable = "avx2")]
+    pub unsafe fn widen_avx2(src: *const u8, len: usize, dst: *mut u16) -> usize {
+        let mut i = 0;
+        while i + 32 <= len {
+            let v = _mm256_loadu_si256(src.add(i) as *const __m256i);
+            if _mm256_movemask_epi8(v) != 0 {
+                break;
+            }
+            let lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+            let hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+            _mm256_storeu_si256(dst.add(i) as *mut __m256i, lo);
+            _mm256_storeu_si256(dst.add(i + 16) as *mut __m256i, hi);
+            i += 32;
+        }
+        i + widen_sse2(src.add(i), len - i, dst.add(i))
+    }
+
+    pub unsafe fn ascii_sse2(src: *const u8, len: usize) -> usize {
+        let mut i = 0;
+        while i + 16 <= len {
+            if _mm_movemask_epi8(_mm_loadu_si128(src.add(i) as *const __m128i)) != 0 {
+                break;
+            }
+            i += 16;
+        }
+        i
+    }
+
+    #[target_feature(enable = "avx2")]
+    pub unsafe fn ascii_avx2(src: *const u8, len: usize) -> usize {
+        let mut i = 0;
+        while i + 32 <= len {
+            if _mm256_movemask_epi8(_mm256_loadu_si256(src.add(i) as *const __m256i)) != 0 {
+                break;
+            }
+            i += 32;
+        }
+        i + ascii_sse2(src.add(i), len - i)
+    }
+}
+
+/// NEON is part of aarch64
+#[cfg(target_arch = "aarch64")]
+mod neon {
+    use std::arch::aarch64::*;
+
+    pub unsafe fn narrow(src: *const u8, units: usize, dst: *mut u8) -> usize {
+        let mut i = 0;
+        while i + 16 <= units {
+            let a = vreinterpretq_u16_u8(vld1q_u8(src.add(i * 2)));
+            let b = vreinterpretq_u16_u8(vld1q_u8(src.add(i * 2 + 16)));
+            if vmaxvq_u16(vorrq_u16(a, b)) >= 0x80 {
+                break;
+            }
+            vst1q_u8(dst.add(i), vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+            i += 16;
+        }
+        i
+    }
+
+    pub unsafe fn widen(src: *const u8, len: usize, dst: *mut u16) -> usize {
+        let mut i = 0;
+        while i + 16 <= len {
+            let v = vld1q_u8(src.add(i));
+            if vmaxvq_u8(v) >= 0x80 {
+                break;
+            }
+            let lo = vmovl_u8(vget_low_u8(v));
+            let hi = vmovl_high_u8(v);
+            vst1q_u8(dst.add(i) as *mut u8, vreinterpretq_u8_u16(lo));
+            vst1q_u8(dst.add(i + 8) as *mut u8, vreinterpretq_u8_u16(hi));
+            i += 16;
+        }
+        i
+    }
+
+    pub unsafe fn ascii(src: *const u8, len: usize) -> usize {
+        let mut i = 0;
+        while i + 16 <= len {
+            if vmaxvq_u8(vld1q_u8(src.add(i))) >= 0x80 {
+                break;
+            }
+            i += 16;
+        }
+        i
+    }
+}
@@ -0,0 +1,359 @@
+#include "test_helpers.h"
+#include <benchmark/benchmark.h>
+#include <cstdlib>
+#include <memory>
+
+// furball_bench: throughput and latency of the driver against a live server.
+//
+// BENCH_DRIVER names the ODBC driver to run the suite against (default
+// Furball), e.g. BENCH_DRIVER="ODBC Driver 18 for SQL Server" for a side by
+// side run with msodbcsql; each result is labelled with the driver. Rates
+// are reported as rows/s and, where the benchmark reads values, bytes/s.
+
+static std::string bench_driver() {
+    const char* driver = std::getenv("BENCH_DRIVER");
+    return driver && *driver ? driver : "Furball";
+}
+
+// CONN_STR_UTF8 with its DRIVER= replaced by BENCH_DRIVER's
+static std::string bench_conn_str() {
+    std::string conn_str = CONN_STR_UTF8;
+    size_t start = conn_str.find('{') + 1;
+    size_t end = conn_str.find('}');
+    return conn_str.replace(start, end - start, bench_driver());
+}
+
+static bool driver_connect(SQLHDBC hdbc) {
+    std::string conn_str = bench_conn_str();
+    SQLCHAR out[1024];
+    SQLSMALLINT outlen;
+    return SQL_SUCCEEDED(SQLDriverConnect(hdbc, nullptr, (SQLCHAR*)conn_str.c_str(), SQL_NTS,
+                                          out, sizeof(out), &outlen, SQL_DRIVER_NOPROMPT));
+}
+
+// One connection shared by the benchmarks, as an application would hold it
+struct Session {
+    OdbcEnv env;
+    OdbcConn conn{env.henv};
+
+    static Session* get() {
+        static std::unique_ptr<Session> session;
+        if (!session) {
+            session.reset(new Session());
+            session->conn.connected = driver_connect(session->conn.hdbc);
+        }
+        return session->conn.connected ? session.get() : nullptr;
+    }
+};
+
+// Rows numbered 1..n, from a cross join large enough for any n used here
+static std::string numbers(int n, const std::string& columns) {
+    return "SELECT TOP " + std::to_string(n) + " " + columns +
+           " FROM (SELECT ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS n"
+           " FROM sys.all_columns a CROSS JOIN sys.all_columns b) AS t";
+}
+
+static const char* WIDE_COLUMNS =
+    "CAST(n AS INT) AS c1, CAST(n AS BIGINT) AS c2, CAST(n AS FLOAT) AS c3, "
+    "CAST(n AS DECIMAL(18,4)) AS c4, CAST('name ' + CAST(n AS VARCHAR(10)) AS VARCHAR(40)) AS c5, "
+    "DATEADD(SECOND, CAST(n AS INT), CAST('2020-01-01' AS DATETIME2)) AS c6, "
+    "CAST(n % 2 AS BIT) AS c7, CAST(n AS SMALLINT) AS c8, "
+    "CAST(REPLICATE('x', 20) AS CHAR(20)) AS c9, NEWID() AS c10";
+static const int WIDE_COLUMN_COUNT = 10;
+
+#define SESSION_OR_SKIP(state)                                 \
+    Session* session = Session::get();                         \
+    if (!session) {                                            \
+        (state).SkipWithError("cannot connect to the server"); \
+        return;                                                \
+    }                                                          \
+    (state).SetLabel(bench_driver())
+
+static void report(benchmark::State& state, int64_t rows, int64_t bytes) {
+    state.counters["rows/s"] = benchmark::Counter(double(rows), benchmark::Counter::kIsRate);
+    if (bytes > 0) state.SetBytesProcessed(bytes);
+}
+
+static void BM_ConnectDisconnect(benchmark::State& state) {
+    OdbcEnv env;
+    state.SetLabel(bench_driver());
+    for (auto _ : state) {
+        SQLHDBC hdbc;
+        SQLAllocHandle(SQL_HANDLE_DBC, env.henv, &hdbc);
+        if (!driver_connect(hdbc)) {
+            state.SkipWithError("cannot connect to the server");
+            SQLFreeHandle(SQL_HANDLE_DBC, hdbc);
+            return;
+        }
+        SQLDisconnect(hdbc);
+        SQLFreeHandle(SQL_HANDLE_DBC, hdbc);
+    }
+}
+BENCHMARK(BM_ConnectDisconnect)->Unit(benchmark::kMillisecond);
+
+static void BM_SmallQuery(benchmark::State& state) {
+    SESSION_OR_SKIP(state);
+    OdbcStmt stmt(session->conn.hdbc);
+    int64_t rows = 0;
+    for (auto _ : state) {
+        exec_direct(stmt.hstmt, "SELECT 1");
+        while (SQLFetch(stmt.hstmt) == SQL_SUCCESS) rows++;
+        SQLFreeStmt(stmt.hstmt, SQL_CLOSE);
+    }
+    report(state, rows, 0);
+}
+BENCHMARK(BM_SmallQuery)->Unit(benchmark::kMicrosecond);
+
+// Narrow scan: one INT column, read with SQLGetData or bound
+static void BM_NarrowScanGetData(benchmark::State& state) {
+    SESSION_OR_SKIP(state);
+    OdbcStmt stmt(session->conn.hdbc);
+    std::string sql = numbers(int(state.range(0)), "CAST(n AS INT) AS n");
+    int64_t rows = 0;
+    for (auto _ : state) {
+        exec_direct(stmt.hstmt, sql);
+        SQLINTEGER v;
+        SQLLEN ind;
+        while (SQLFetch(stmt.hstmt) == SQL_SUCCESS) {
+            SQLGetData(stmt.hstmt, 1, SQL_C_SLONG, &v, 0, &ind);
+            rows++;
+        }
+        SQLFreeStmt(stmt.hstmt, SQL_CLOSE);
+    }
+    report(state, rows, rows * int64_t(sizeof(SQLINTEGER)));
+}
+BENCHMARK(BM_NarrowScanGetData)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+static void BM_NarrowScanBound(benchmark::State& state) {
+    SESSION_OR_SKIP(state);
+    OdbcStmt stmt(session->conn.hdbc);
+    std::string sql = numbers(int(state.range(0)), "CAST(n AS INT) AS n");
+    const SQLULEN rowset = 1000;
+    std::vector<SQLINTEGER> vals(rowset);
+    std::vector<SQLLEN> inds(rowset);
+    SQLULEN fetched = 0;
+    SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)rowset, 0);
+    SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+    int64_t rows = 0;
+    for (auto _ : state) {
+        exec_direct(stmt.hstmt, sql);
+        SQLBindCol(stmt.hstmt, 1, SQL_C_SLONG, vals.data(), 0, inds.data());
+        while (SQL_SUCCEEDED(SQLFetch(stmt.hstmt))) rows += fetched;
+        SQLFreeStmt(stmt.hstmt, SQL_CLOSE);
+    }
+    report(state, rows, rows * int64_t(sizeof(SQLINTEGER)));
+}
+BENCHMARK(BM_NarrowScanBound)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+// Wide scan: ten columns of mixed types, all read as text with SQLGetData
+static void BM_WideScanGetData(benchmark::State& state) {
+    SESSION_OR_SKIP(state);
+    OdbcStmt stmt(session->conn.hdbc);
+    std::string sql = numbers(int(state.range(0)), WIDE_COLUMNS);
+    int64_t rows = 0, bytes = 0;
+    for (auto _ : state) {
+        exec_direct(stmt.hstmt, sql);
+        char buf[64];
+        SQLLEN ind;
+        while (SQLFetch(stmt.hstmt) == SQL_SUCCESS) {
+            for (SQLUSMALLINT col = 1; col <= WIDE_COLUMN_COUNT; col++) {
+                SQLGetData(stmt.hstmt, col, SQL_C_CHAR, buf, sizeof(buf), &ind);
+                if (ind > 0) bytes += ind;
+            }
+            rows++;
+        }
+        SQLFreeStmt(stmt.hstmt, SQL_CLOSE);
+    }
+    report(state, rows, bytes);
+}
+BENCHMARK(BM_WideScanGetData)->Arg(20000)->Unit(benchmark::kMillisecond);
+
+// Wide scan with every column bound as text, a rowset at a time
+static void BM_WideScanBound(benchmark::State& state) {
+    SESSION_OR_SKIP(state);
+    OdbcStmt stmt(session->conn.hdbc);
+    std::string sql = numbers(int(state.range(0)), WIDE_COLUMNS);
+    const SQLULEN rowset = 500;
+    const SQLLEN width = 64;
+    std::vector<char> vals(WIDE_COLUMN_COUNT * rowset * width);
+    std::vector<SQLLEN> inds(WIDE_COLUMN_COUNT * rowset);
+    SQLULEN fetched = 0;
+    SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)rowset, 0);
+    SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+    int64_t rows = 0, bytes = 0;
+    for (auto _ : state) {
+        exec_direct(stmt.hstmt, sql);
+        for (int col = 0; col < WIDE_COLUMN_COUNT; col++) {
+            SQLBindCol(stmt.hstmt, SQLUSMALLINT(col + 1), SQL_C_CHAR,
+                       &vals[col * rowset * width], width, &inds[col * rowset]);
+        }
+        while (SQL_SUCCEEDED(SQLFetch(stmt.hstmt))) {
+            for (size_t i = 0; i < WIDE_COLUMN_COUNT * rowset; i++) {
+                if (i % rowset < fetched && inds[i] > 0) bytes += inds[i];
+            }
+            rows += fetched;
+        }
+        SQLFreeStmt(stmt.hstmt, SQL_UNBIND);
+        SQLFreeStmt(stmt.hstmt, SQL_CLOSE);
+    }
+    report(state, rows, bytes);
+}
+BENCHMARK(BM_WideScanBound)->Arg(20000)->Unit(benchmark::kMillisecond);
+
+// NVARCHAR text read as SQL_C_WCHAR
+static void BM_WcharExtract(benchmark::State& state) {
+    SESSION_OR_SKIP(state);
+    OdbcStmt stmt(session->conn.hdbc);
+    std::string sql = numbers(int(state.range(0)),
+        "CAST(N'Ünïcödé text row ' + CAST(n AS NVARCHAR(10)) + REPLICATE(N'ж', 60) "
+        "AS NVARCHAR(100)) AS s1, CAST(REPLICATE(N'名', 40) AS NVARCHAR(40)) AS s2");
+    const SQLULEN rowset = 500;
+    const SQLLEN width = 128 * sizeof(SQLWCHAR);
+    std::vector<char> s1(rowset * width), s2(rowset * width);
+    std::vector<SQLLEN> i1(rowset), i2(rowset);
+    SQLULEN fetched = 0;
+    SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)rowset, 0);
+    SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+    int64_t rows = 0, bytes = 0;
+    for (auto _ : state) {
+        exec_direct(stmt.hstmt, sql);
+        SQLBindCol(stmt.hstmt, 1, SQL_C_WCHAR, s1.data(), width, i1.data());
+        SQLBindCol(stmt.hstmt, 2, SQL_C_WCHAR, s2.data(), width, i2.data());
+        while (SQL_SUCCEEDED(SQLFetch(stmt.hstmt))) {
+            for (SQLULEN i = 0; i < fetched; i++) bytes += i1[i] + i2[i];
+            rows += fetched;
+        }
+        SQLFreeStmt(stmt.hstmt, SQL_UNBIND);
+        SQLFreeStmt(stmt.hstmt, SQL_CLOSE);
+    }
+    report(state, rows, bytes);
+}
+BENCHMARK(BM_WcharExtract)->Arg(20000)->Unit(benchmark::kMillisecond);
+
+static const char* INSERT_TABLE =
+    "IF OBJECT_ID('tempdb..#bench_insert') IS NULL "
+    "CREATE TABLE #bench_insert (id INT, name VARCHAR(40), amount FLOAT)";
+
+// One SQLExecute per row of a prepared INSERT
+static void BM_InsertLoop(benchmark::State& state) {
+    SESSION_OR_SKIP(state);
+    OdbcStmt stmt(session->conn.hdbc);
+    exec_direct(stmt.hstmt, INSERT_TABLE);
+    prepare(stmt.hstmt, "INSERT INTO #bench_insert VALUES (?, ?, ?)");
+    SQLINTEGER id = 0;
+    char name[40] = "some name";
+    double amount = 0;
+    SQLLEN name_len = SQL_NTS;
+    SQLBindParameter(stmt.hstmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &id, 0,
+                     nullptr);
+    SQLBindParameter(stmt.hstmt, 2, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 40, 0, name,
+                     sizeof(name), &name_len);
+    SQLBindParameter(stmt.hstmt, 3, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_DOUBLE, 0, 0, &amount, 0,
+                     nullptr);
+    int64_t rows = 0;
+    for (auto _ : state) {
+        for (int i = 0; i < state.range(0); i++) {
+            id = i;
+            amount = i * 1.5;
+            SQLExecute(stmt.hstmt);
+            rows++;
+        }
+    }
+    report(state, rows, 0);
+    SQLFreeStmt(stmt.hstmt, SQL_RESET_PARAMS);
+    exec_direct(stmt.hstmt, "DROP TABLE #bench_insert");
+}
+BENCHMARK(BM_InsertLoop)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+// The same rows as one SQLExecute with column-wise array binding
+static void BM_InsertArray(benchmark::State& state) {
+    SESSION_OR_SKIP(state);
+    OdbcStmt stmt(session->conn.hdbc);
+    exec_direct(stmt.hstmt, INSERT_TABLE);
+    const SQLULEN n = SQLULEN(state.range(0));
+    std::vector<SQLINTEGER> ids(n);
+    std::vector<char> names(n * 40);
+    std::vector<SQLLEN> name_lens(n, SQL_NTS);
+    std::vector<double> amounts(n);
+    for (SQLULEN i = 0; i < n; i++) {
+        ids[i] = SQLINTEGER(i);
+        snprintf(&names[i * 40], 40, "some name");
+        amounts[i] = i * 1.5;
+    }
+    prepare(stmt.hstmt, "INSERT INTO #bench_insert VALUES (?, ?, ?)");
+    SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)n, 0);
+    SQLBindParameter(stmt.hstmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, ids.data(),
+                     0, nullptr);
+    SQLBindParameter(stmt.hstmt, 2, SQL_PARAM_INPUT, SQL_C_CHAR, SQL_VARCHAR, 40, 0,
+                     names.data(), 40, name_lens.data());
+    SQLBindParameter(stmt.hstmt, 3, SQL_PARAM_INPUT, SQL_C_DOUBLE, SQL_DOUBLE, 0, 0,
+                     amounts.data(), 0, nullptr);
+    int64_t rows = 0;
+    for (auto _ : state) {
+        SQLExecute(stmt.hstmt);
+        rows += int64_t(n);
+    }
+    report(state, rows, 0);
+    SQLFreeStmt(stmt.hstmt, SQL_RESET_PARAMS);
+    SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)1, 0);
+    exec_direct(stmt.hstmt, "DROP TABLE #bench_insert");
+}
+BENCHMARK(BM_InsertArray)->Arg(1000)->Unit(benchmark::kMillisecond);
+
+// VARBINARY(MAX) values of range(0) bytes, read in 64 KiB parts
+static void BM_LobRead(benchmark::State& state) {
+    SESSION_OR_SKIP(state);
+    OdbcStmt stmt(session->conn.hdbc);
+    std::string sql = numbers(10,
+        "CAST(REPLICATE(CAST('x' AS VARCHAR(MAX)), " + std::to_string(state.range(0)) +
+        ") AS VARBINARY(MAX)) AS doc");
+    std::vector<char> buf(64 * 1024);
+    int64_t rows = 0, bytes = 0;
+    for (auto _ : state) {
+        exec_direct(stmt.hstmt, sql);
+        while (SQLFetch(stmt.hstmt) == SQL_SUCCESS) {
+            SQLLEN ind;
+            SQLRETURN rc;
+            while ((rc = SQLGetData(stmt.hstmt, 1, SQL_C_BINARY, buf.data(), buf.size(),
+                                    &ind)) != SQL_NO_DATA && SQL_SUCCEEDED(rc)) {
+                bytes += (ind == SQL_NO_TOTAL || ind > SQLLEN(buf.size())) ? SQLLEN(buf.size())
+                                                                          : ind;
+            }
+            rows++;
+        }
+        SQLFreeStmt(stmt.hstmt, SQL_CLOSE);
+    }
+    report(state, rows, bytes);
+}
+BENCHMARK(BM_LobRead)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+// Catalog functions, as query tools call them on every refresh
+static void BM_CatalogTables(benchmark::State& state) {
+    SESSION_OR_SKIP(state);
+    OdbcStmt stmt(session->conn.hdbc);
+    int64_t rows = 0;
+    for (auto _ : state) {
+        SQLTables(stmt.hstmt, nullptr, 0, (SQLCHAR*)"sys", SQL_NTS, nullptr, 0,
+                  (SQLCHAR*)"VIEW", SQL_NTS);
+        while (SQLFetch(stmt.hstmt) == SQL_SUCCESS) rows++;
+        SQLFreeStmt(stmt.hstmt, SQL_CLOSE);
+    }
+    report(state, rows, 0);
+}
+BENCHMARK(BM_CatalogTables)->Unit(benchmark::kMillisecond);
+
+static void BM_CatalogColumns(benchmark::State& state) {
+    SESSION_OR_SKIP(state);
+    OdbcStmt stmt(session->conn.hdbc);
+    int64_t rows = 0;
+    for (auto _ : state) {
+        SQLColumns(stmt.hstmt, nullptr, 0, (SQLCHAR*)"sys", SQL_NTS, (SQLCHAR*)"objects",
+                   SQL_NTS, nullptr, 0);
+        while (SQLFetch(stmt.hstmt) == SQL_SUCCESS) rows++;
+        SQLFreeStmt(stmt.hstmt, SQL_CLOSE);
+    }
+    report(state, rows, 0);
+}
+BENCHMARK(BM_CatalogColumns)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,147 @@
+#include "test_helpers.h"
+
+// Arrow C Data Interface, as given in the Arrow specification
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_NULLABLE 2
+
+struct ArrowSchema {
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+    void (*release)(struct ArrowSchema*);
+    void* private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+    void (*release)(struct ArrowArray*);
+    void* private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+typedef SQLRETURN (*FetchArrowFn)(SQLHSTMT, SQLULEN, ArrowArray*, ArrowSchema*);
+
+class ArrowTest : public OdbcTest {
+protected:
+    FetchArrowFn fetch_arrow = nullptr;
+    SQLHSTMT driver_stmt = SQL_NULL_HSTMT;
+
+    void SetUp() override {
+        OdbcTest::SetUp();
+        fetch_arrow = reinterpret_cast<FetchArrowFn>(furball_symbol("furball_fetch_arrow"));
+        ASSERT_NE(fetch_arrow, nullptr);
+        // Extension entry points take the driver's handle, not the driver manager's
+        driver_stmt = stmt->hstmt;
+        ASSERT_TRUE(SQL_SUCCEEDED(SQLGetInfo(conn->hdbc, SQL_DRIVER_HSTMT, &driver_stmt,
+                                             sizeof(driver_stmt), nullptr)));
+    }
+
+    static bool is_null(const ArrowArray* col, int64_t row) {
+        auto validity = static_cast<const uint8_t*>(col->buffers[0]);
+        return validity && !(validity[row / 8] & (1 << (row % 8)));
+    }
+
+    static std::string str_at(const ArrowArray* col, int64_t row) {
+        auto offsets = static_cast<const int64_t*>(col->buffers[1]);
+        auto data = static_cast<const char*>(col->buffers[2]);
+        return std::string(data + offsets[row], offsets[row + 1] - offsets[row]);
+    }
+};
+
+TEST_F(ArrowTest, ColumnTypes) {
+    SQLRETURN rc = exec_direct(stmt->hstmt,
+        "SELECT CAST(42 AS INT) AS i, CAST(NULL AS INT) AS n, CAST(2.5 AS FLOAT) AS f, "
+        "N'hello' AS s, CAST('2024-01-02' AS DATE) AS d, "
+        "CAST(12.34 AS DECIMAL(10,2)) AS dec, CAST(1 AS BIT) AS b, "
+        "CAST(0x0102 AS VARBINARY(10)) AS bin");
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+
+    ArrowArray array;
+    ArrowSchema schema;
+    ASSERT_EQ(fetch_arrow(driver_stmt, 0, &array, &schema), SQL_SUCCESS);
+    ASSERT_STREQ(schema.format, "+s");
+    ASSERT_EQ(schema.n_children, 8);
+    ASSERT_EQ(array.n_children, 8);
+    ASSERT_EQ(array.length, 1);
+
+    const char* formats[] = {"i", "i", "g", "U", "tdD", "d:10,2", "b", "Z"};
+    for (int i = 0; i < 8; i++) {
+        EXPECT_STREQ(schema.children[i]->format, formats[i]) << "column " << i;
+    }
+    EXPECT_STREQ(schema.children[0]->name, "i");
+
+    EXPECT_EQ(static_cast<const int32_t*>(array.children[0]->buffers[1])[0], 42);
+    EXPECT_EQ(array.children[1]->null_count, 1);
+    EXPECT_TRUE(is_null(array.children[1], 0));
+    EXPECT_DOUBLE_EQ(static_cast<const double*>(array.children[2]->buffers[1])[0], 2.5);
+    EXPECT_EQ(str_at(array.children[3], 0), "hello");
+    // 2024-01-02 is day 19724 of the Unix epoch
+    EXPECT_EQ(static_cast<const int32_t*>(array.children[4]->buffers[1])[0], 19724);
+    __int128 dec;
+    memcpy(&dec, array.children[5]->buffers[1], sizeof(dec));
+    EXPECT_EQ(static_cast<int64_t>(dec), 1234);
+    EXPECT_EQ(static_cast<const uint8_t*>(array.children[6]->buffers[1])[0] & 1, 1);
+    EXPECT_EQ(str_at(array.children[7], 0), std::string("\x01\x02", 2));
+
+    array.release(&array);
+    schema.release(&schema);
+    EXPECT_EQ(array.release, nullptr);
+
+    EXPECT_EQ(fetch_arrow(driver_stmt, 0, &array, nullptr), SQL_NO_DATA);
+}
+
+TEST_F(ArrowTest, BatchesAcrossPrefetchRefills) {
+    SQLRETURN rc = exec_direct(stmt->hstmt,
+        "SELECT TOP 1000 CAST(ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS INT) AS n "
+        "FROM sys.all_columns a CROSS JOIN sys.all_columns b ORDER BY n");
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+
+    int32_t expected = 1;
+    std::vector<int64_t> lengths;
+    ArrowArray array;
+    while (fetch_arrow(driver_stmt, 300, &array, nullptr) == SQL_SUCCESS) {
+        lengths.push_back(array.length);
+        auto values = static_cast<const int32_t*>(array.children[0]->buffers[1]);
+        for (int64_t i = 0; i < array.length; i++) {
+            ASSERT_EQ(values[i], expected++);
+        }
+        array.release(&array);
+    }
+    EXPECT_EQ(lengths, (std::vector<int64_t>{300, 300, 300, 100}));
+}
+
+TEST_F(ArrowTest, EmptyResultSetHasSchema) {
+    SQLRETURN rc = exec_direct(stmt->hstmt,
+        "SELECT CAST(1 AS BIGINT) AS id, N'x' AS name WHERE 1 = 0");
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+
+    ArrowArray array;
+    array.release = nullptr;
+    ArrowSchema schema;
+    ASSERT_EQ(fetch_arrow(driver_stmt, 0, &array, &schema), SQL_NO_DATA);
+    EXPECT_EQ(array.release, nullptr);
+    ASSERT_EQ(schema.n_children, 2);
+    EXPECT_STREQ(schema.children[0]->format, "l");
+    EXPECT_STREQ(schema.children[1]->name, "name");
+    schema.release(&schema);
+}
+
+TEST_F(ArrowTest, NoResultSet) {
+    ArrowArray array;
+    EXPECT_EQ(fetch_arrow(driver_stmt, 0, &array, nullptr), SQL_ERROR);
+    EXPECT_EQ(fetch_arrow(nullptr, 0, &array, nullptr), SQL_INVALID_HANDLE);
+}
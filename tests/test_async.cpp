@@ -0,0 +1,129 @@
+#include "test_helpers.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+class AsyncTest : public OdbcTest {
+protected:
+    void SetUp() override {
+        OdbcTest::SetUp();
+        ASSERT_TRUE(SQL_SUCCEEDED(SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ASYNC_ENABLE,
+                                                 (SQLPOINTER)SQL_ASYNC_ENABLE_ON, 0)));
+    }
+
+    // Call `f` until it stops returning SQL_STILL_EXECUTING
+    static SQLRETURN complete(const std::function<SQLRETURN()>& f) {
+        SQLRETURN rc;
+        while ((rc = f()) == SQL_STILL_EXECUTING) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return rc;
+    }
+
+    std::string first_sqlstate(SQLHSTMT h) {
+        SQLCHAR state[6] = {0};
+        SQLINTEGER native;
+        SQLCHAR msg[512];
+        SQLSMALLINT len;
+        SQLGetDiagRec(SQL_HANDLE_STMT, h, 1, state, &native, msg, sizeof(msg), &len);
+        return std::string((char*)state);
+    }
+};
+
+TEST_F(AsyncTest, ReportsCapabilities) {
+    SQLUINTEGER mode = 0;
+    ASSERT_TRUE(SQL_SUCCEEDED(SQLGetInfo(conn->hdbc, SQL_ASYNC_MODE, &mode, sizeof(mode), nullptr)));
+    EXPECT_EQ(mode, (SQLUINTEGER)SQL_AM_STATEMENT);
+    SQLULEN enabled = 0;
+    ASSERT_TRUE(SQL_SUCCEEDED(SQLGetStmtAttr(stmt->hstmt, SQL_ATTR_ASYNC_ENABLE, &enabled, 0,
+                                             nullptr)));
+    EXPECT_EQ(enabled, SQL_ASYNC_ENABLE_ON);
+}
+
+TEST_F(AsyncTest, PollExecuteFetchAndMoreResults) {
+    SQLCHAR sql[] = "WAITFOR DELAY '00:00:00.300'; SELECT 7; SELECT 8";
+    SQLRETURN rc = SQLExecDirect(stmt->hstmt, sql, SQL_NTS);
+    EXPECT_EQ(rc, SQL_STILL_EXECUTING);
+    rc = complete([&] { return SQLExecDirect(stmt->hstmt, sql, SQL_NTS); });
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+
+    ASSERT_EQ(complete([&] { return SQLFetch(stmt->hstmt); }), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 7);
+    EXPECT_EQ(complete([&] { return SQLFetch(stmt->hstmt); }), SQL_NO_DATA);
+
+    ASSERT_EQ(complete([&] { return SQLMoreResults(stmt->hstmt); }), SQL_SUCCESS);
+    ASSERT_EQ(complete([&] { return SQLFetch(stmt->hstmt); }), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 8);
+    EXPECT_EQ(complete([&] { return SQLMoreResults(stmt->hstmt); }), SQL_NO_DATA);
+}
+
+TEST_F(AsyncTest, PreparedExecute) {
+    ASSERT_TRUE(SQL_SUCCEEDED(prepare(stmt->hstmt, "SELECT ? * 2")));
+    SQLINTEGER value = 21;
+    SQLLEN ind = 0;
+    ASSERT_TRUE(SQL_SUCCEEDED(SQLBindParameter(stmt->hstmt, 1, SQL_PARAM_INPUT, SQL_C_LONG,
+                                               SQL_INTEGER, 0, 0, &value, 0, &ind)));
+    SQLRETURN rc = complete([&] { return SQLExecute(stmt->hstmt); });
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    ASSERT_EQ(complete([&] { return SQLFetch(stmt->hstmt); }), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 42);
+}
+
+TEST_F(AsyncTest, ConnectionBusyWhileExecuting) {
+    SQLCHAR sql[] = "WAITFOR DELAY '00:00:01'";
+    ASSERT_EQ(SQLExecDirect(stmt->hstmt, sql, SQL_NTS), SQL_STILL_EXECUTING);
+
+    OdbcStmt other(conn->hdbc);
+    EXPECT_EQ(exec_direct(other.hstmt, "SELECT 1"), SQL_ERROR);
+    EXPECT_EQ(first_sqlstate(other.hstmt), "HY010");
+
+    EXPECT_TRUE(SQL_SUCCEEDED(complete([&] { return SQLExecDirect(stmt->hstmt, sql, SQL_NTS); })));
+    EXPECT_TRUE(SQL_SUCCEEDED(exec_direct(other.hstmt, "SELECT 1")));
+}
+
+TEST_F(AsyncTest, Cancel) {
+    SQLCHAR sql[] = "WAITFOR DELAY '00:00:10'";
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(SQLExecDirect(stmt->hstmt, sql, SQL_NTS), SQL_STILL_EXECUTING);
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_TRUE(SQL_SUCCEEDED(SQLCancel(stmt->hstmt)));
+    EXPECT_EQ(complete([&] { return SQLExecDirect(stmt->hstmt, sql, SQL_NTS); }), SQL_ERROR);
+    EXPECT_EQ(first_sqlstate(stmt->hstmt), "HY008");
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+}
+
+// Queries on separate connections run concurrently without a thread each
+// on the application's side
+TEST_F(AsyncTest, ConcurrentConnections) {
+    const int n = 8;
+    std::vector<std::unique_ptr<OdbcConn>> conns;
+    std::vector<std::unique_ptr<OdbcStmt>> stmts;
+    for (int i = 0; i < n; i++) {
+        conns.emplace_back(new OdbcConn(env->henv));
+        ASSERT_TRUE(conns.back()->connect());
+        stmts.emplace_back(new OdbcStmt(conns.back()->hdbc));
+        SQLSetStmtAttr(stmts.back()->hstmt, SQL_ATTR_ASYNC_ENABLE,
+                       (SQLPOINTER)SQL_ASYNC_ENABLE_ON, 0);
+    }
+    SQLCHAR sql[] = "WAITFOR DELAY '00:00:01'; SELECT @@SPID";
+    auto start = std::chrono::steady_clock::now();
+    std::vector<SQLRETURN> rcs(n, SQL_STILL_EXECUTING);
+    for (int i = 0; i < n; i++) {
+        rcs[i] = SQLExecDirect(stmts[i]->hstmt, sql, SQL_NTS);
+    }
+    for (bool pending = true; pending;) {
+        pending = false;
+        for (int i = 0; i < n; i++) {
+            if (rcs[i] == SQL_STILL_EXECUTING) {
+                rcs[i] = SQLExecDirect(stmts[i]->hstmt, sql, SQL_NTS);
+                pending |= rcs[i] == SQL_STILL_EXECUTING;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(3));
+    for (int i = 0; i < n; i++) {
+        EXPECT_TRUE(SQL_SUCCEEDED(rcs[i])) << get_diag(SQL_HANDLE_STMT, stmts[i]->hstmt);
+    }
+}
@@ -0,0 +1,266 @@
+#include "test_helpers.h"
+#include <algorithm>
+
+class BindColTest : public OdbcTest {};
+
+TEST_F(BindColTest, BindSingleRow) {
+    exec_direct(stmt->hstmt, "SELECT 42 AS id, N'hello' AS name");
+
+    SQLINTEGER id = 0;
+    SQLLEN id_ind = 0;
+    SQLWCHAR name[32];
+    SQLLEN name_ind = 0;
+    ASSERT_EQ(SQLBindCol(stmt->hstmt, 1, SQL_C_SLONG, &id, 0, &id_ind), SQL_SUCCESS);
+    ASSERT_EQ(SQLBindCol(stmt->hstmt, 2, SQL_C_WCHAR, name, sizeof(name), &name_ind), SQL_SUCCESS);
+
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(id, 42);
+    EXPECT_EQ(id_ind, (SQLLEN)sizeof(SQLINTEGER));
+    EXPECT_EQ(from_utf16(name, name_ind / sizeof(SQLWCHAR)), "hello");
+    EXPECT_EQ(SQLFetch(stmt->hstmt), SQL_NO_DATA);
+}
+
+TEST_F(BindColTest, BindNull) {
+    exec_direct(stmt->hstmt, "SELECT CAST(NULL AS INT) AS val");
+
+    SQLINTEGER val = 7;
+    SQLLEN ind = 0;
+    SQLBindCol(stmt->hstmt, 1, SQL_C_SLONG, &val, 0, &ind);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(ind, SQL_NULL_DATA);
+}
+
+TEST_F(BindColTest, ColumnWiseBlockFetch) {
+    exec_direct(stmt->hstmt,
+        "SELECT n FROM (VALUES (1),(2),(3),(4),(5)) AS t(n) ORDER BY n");
+
+    SQLULEN fetched = 0;
+    SQLUSMALLINT status[3];
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)3, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROW_STATUS_PTR, status, 0);
+
+    SQLINTEGER vals[3];
+    SQLLEN inds[3];
+    SQLBindCol(stmt->hstmt, 1, SQL_C_SLONG, vals, 0, inds);
+
+    ASSERT_EQ(SQLFetchScroll(stmt->hstmt, SQL_FETCH_NEXT, 0), SQL_SUCCESS);
+    EXPECT_EQ(fetched, 3u);
+    EXPECT_EQ(vals[0], 1);
+    EXPECT_EQ(vals[1], 2);
+    EXPECT_EQ(vals[2], 3);
+    EXPECT_EQ(status[2], SQL_ROW_SUCCESS);
+
+    ASSERT_EQ(SQLFetchScroll(stmt->hstmt, SQL_FETCH_NEXT, 0), SQL_SUCCESS);
+    EXPECT_EQ(fetched, 2u);
+    EXPECT_EQ(vals[0], 4);
+    EXPECT_EQ(vals[1], 5);
+    EXPECT_EQ(status[2], SQL_ROW_NOROW);
+
+    EXPECT_EQ(SQLFetchScroll(stmt->hstmt, SQL_FETCH_NEXT, 0), SQL_NO_DATA);
+}
+
+TEST_F(BindColTest, RowWiseBlockFetch) {
+    struct Row {
+        SQLINTEGER id;
+        SQLLEN id_ind;
+        SQLCHAR name[16];
+        SQLLEN name_ind;
+    };
+    Row rows[2];
+
+    exec_direct(stmt->hstmt,
+        "SELECT id, name FROM (VALUES (1, 'a'), (2, 'bb')) AS t(id, name) ORDER BY id");
+
+    SQLULEN fetched = 0;
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER)sizeof(Row), 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)2, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+    SQLBindCol(stmt->hstmt, 1, SQL_C_SLONG, &rows[0].id, 0, &rows[0].id_ind);
+    SQLBindCol(stmt->hstmt, 2, SQL_C_CHAR, rows[0].name, sizeof(rows[0].name), &rows[0].name_ind);
+
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(fetched, 2u);
+    EXPECT_EQ(rows[0].id, 1);
+    EXPECT_STREQ((char*)rows[0].name, "a");
+    EXPECT_EQ(rows[1].id, 2);
+    EXPECT_STREQ((char*)rows[1].name, "bb");
+    EXPECT_EQ(rows[1].name_ind, 2);
+}
+
+TEST_F(BindColTest, TruncationReportsInfo) {
+    exec_direct(stmt->hstmt, "SELECT 'abcdefgh' AS val");
+
+    SQLCHAR buf[4];
+    SQLLEN ind = 0;
+    SQLBindCol(stmt->hstmt, 1, SQL_C_CHAR, buf, sizeof(buf), &ind);
+    EXPECT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS_WITH_INFO);
+    EXPECT_STREQ((char*)buf, "abc");
+    EXPECT_EQ(ind, 8);
+}
+
+TEST_F(BindColTest, UnbindStopsWrites) {
+    exec_direct(stmt->hstmt, "SELECT n FROM (VALUES (1),(2)) AS t(n) ORDER BY n");
+
+    SQLINTEGER val = 0;
+    SQLLEN ind = 0;
+    SQLBindCol(stmt->hstmt, 1, SQL_C_SLONG, &val, 0, &ind);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(val, 1);
+
+    SQLFreeStmt(stmt->hstmt, SQL_UNBIND);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(val, 1);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 2);
+}
+
+TEST_F(BindColTest, BlockFetchAcrossPrefetchRefills) {
+    // Rowsets of 100 straddle the driver's read-ahead blocks
+    exec_direct(stmt->hstmt,
+        "SELECT TOP 1000 n, CASE WHEN n % 7 = 0 THEN NULL "
+        "ELSE N'row ' + CAST(n AS NVARCHAR(10)) END AS s "
+        "FROM (SELECT ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS n "
+        "FROM sys.all_columns a CROSS JOIN sys.all_columns b) AS t ORDER BY n");
+
+    const int kRows = 100;
+    SQLBIGINT n[kRows];
+    SQLLEN n_ind[kRows];
+    SQLCHAR s[kRows][32];
+    SQLLEN s_ind[kRows];
+    SQLULEN fetched = 0;
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)(SQLULEN)kRows, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+    SQLBindCol(stmt->hstmt, 1, SQL_C_SBIGINT, n, 0, n_ind);
+    SQLBindCol(stmt->hstmt, 2, SQL_C_CHAR, s, sizeof(s[0]), s_ind);
+
+    SQLBIGINT expected = 1;
+    while (SQLFetch(stmt->hstmt) == SQL_SUCCESS) {
+        ASSERT_EQ(fetched, (SQLULEN)kRows);
+        for (SQLULEN i = 0; i < fetched; i++, expected++) {
+            ASSERT_EQ(n[i], expected);
+            if (expected % 7 == 0) {
+                EXPECT_EQ(s_ind[i], SQL_NULL_DATA);
+            } else {
+                EXPECT_EQ(std::string((char*)s[i], s_ind[i]), "row " + std::to_string(expected));
+            }
+        }
+    }
+    EXPECT_EQ(expected, 1001);
+}
+
+TEST_F(BindColTest, NullVarcharAcrossPartialFinalBlock) {
+    // Leading NULLs make the column start out as placeholders, and 1000 rows
+    // in rowsets of 64 leave a short final block
+    exec_direct(stmt->hstmt,
+        "SELECT TOP 1000 n, CASE WHEN n <= 3 OR n % 5 = 0 THEN NULL "
+        "ELSE 'v' + CAST(n AS VARCHAR(10)) END AS s "
+        "FROM (SELECT ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS n "
+        "FROM sys.all_columns a CROSS JOIN sys.all_columns b) AS t ORDER BY n");
+
+    const int kRows = 64;
+    SQLBIGINT n[kRows];
+    SQLLEN n_ind[kRows];
+    SQLCHAR s[kRows][16];
+    SQLLEN s_ind[kRows];
+    SQLULEN fetched = 0;
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)(SQLULEN)kRows, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+    SQLBindCol(stmt->hstmt, 1, SQL_C_SBIGINT, n, 0, n_ind);
+    SQLBindCol(stmt->hstmt, 2, SQL_C_CHAR, s, sizeof(s[0]), s_ind);
+
+    SQLBIGINT expected = 1;
+    SQLULEN last = 0;
+    while (SQLFetch(stmt->hstmt) == SQL_SUCCESS) {
+        last = fetched;
+        for (SQLULEN i = 0; i < fetched; i++, expected++) {
+            ASSERT_EQ(n[i], expected);
+            if (expected <= 3 || expected % 5 == 0) {
+                EXPECT_EQ(s_ind[i], SQL_NULL_DATA);
+            } else {
+                EXPECT_EQ(std::string((char*)s[i], s_ind[i]), "v" + std::to_string(expected));
+            }
+        }
+    }
+    EXPECT_EQ(last, 1000u % kRows);
+    EXPECT_EQ(expected, 1001);
+}
+
+// A binding reused across result sets follows each one's column type, and
+// SQLGetData may read the same column as different C types
+TEST_F(BindColTest, ConversionFollowsColumnAndTargetType) {
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "SELECT 42; SELECT N'17'; SELECT 2.5")));
+    SQLINTEGER val = 0;
+    SQLLEN ind = 0;
+    ASSERT_EQ(SQLBindCol(stmt->hstmt, 1, SQL_C_SLONG, &val, 0, &ind), SQL_SUCCESS);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(val, 42);
+    ASSERT_EQ(SQLMoreResults(stmt->hstmt), SQL_SUCCESS);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(val, 17);
+    ASSERT_EQ(SQLMoreResults(stmt->hstmt), SQL_SUCCESS);
+    SQLFreeStmt(stmt->hstmt, SQL_UNBIND);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    double d = 0;
+    ASSERT_TRUE(SQL_SUCCEEDED(SQLGetData(stmt->hstmt, 1, SQL_C_DOUBLE, &d, 0, &ind)));
+    EXPECT_DOUBLE_EQ(d, 2.5);
+    EXPECT_EQ(get_string_col(stmt->hstmt, 1), "2.5");
+}
+
+// Unsigned C types get the value's binary form, not text
+TEST_F(BindColTest, UnsignedTargets) {
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT CAST(3000000000 AS BIGINT), 40000, CAST(200 AS TINYINT)")));
+    SQLUINTEGER big = 0;
+    SQLUSMALLINT small = 0, tiny = 0;
+    SQLLEN ind = 0;
+    ASSERT_EQ(SQLBindCol(stmt->hstmt, 1, SQL_C_ULONG, &big, 0, &ind), SQL_SUCCESS);
+    ASSERT_EQ(SQLBindCol(stmt->hstmt, 2, SQL_C_USHORT, &small, 0, &ind), SQL_SUCCESS);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(big, 3000000000u);
+    EXPECT_EQ(small, 40000);
+    ASSERT_TRUE(SQL_SUCCEEDED(SQLGetData(stmt->hstmt, 3, SQL_C_USHORT, &tiny, 0, &ind)));
+    EXPECT_EQ(tiny, 200);
+    EXPECT_EQ(ind, (SQLLEN)sizeof(SQLUSMALLINT));
+}
+
+// NVARCHAR bound as SQL_C_WCHAR is kept as UTF-16 from the wire on; the
+// text must come through intact either way, including surrogate pairs
+TEST_F(BindColTest, WideColumnAcrossRefills) {
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT TOP 3000 N'résumé ' + CAST(ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS NVARCHAR(10)) "
+        "+ NCHAR(0xD83D) + NCHAR(0xDE00) AS t, N'plain' AS p "
+        "FROM sys.all_columns a CROSS JOIN sys.all_columns b")));
+    SQLWCHAR wide[64];
+    SQLLEN wide_ind = 0;
+    ASSERT_EQ(SQLBindCol(stmt->hstmt, 1, SQL_C_WCHAR, wide, sizeof(wide), &wide_ind), SQL_SUCCESS);
+    for (int row = 1; row <= 3000; row++) {
+        ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS) << "row " << row;
+        std::string expected = "r\xc3\xa9sum\xc3\xa9 " + std::to_string(row) + "\xf0\x9f\x98\x80";
+        ASSERT_EQ(from_utf16(wide, wide_ind / sizeof(SQLWCHAR)), expected);
+        ASSERT_EQ(get_string_col(stmt->hstmt, 2), "plain");
+    }
+    EXPECT_EQ(SQLFetch(stmt->hstmt), SQL_NO_DATA);
+}
+
+// A value read in parts ends with SQL_NO_DATA
+TEST_F(BindColTest, WideGetDataInParts) {
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT REPLICATE(CAST(N'äbc' AS NVARCHAR(MAX)), 1000)")));
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    SQLWCHAR buf[101];
+    SQLLEN ind = 0;
+    size_t units = 0;
+    int parts = 0;
+    SQLRETURN rc;
+    while ((rc = SQLGetData(stmt->hstmt, 1, SQL_C_WCHAR, buf, sizeof(buf), &ind)) != SQL_NO_DATA) {
+        ASSERT_TRUE(SQL_SUCCEEDED(rc));
+        if (parts == 0) {
+            EXPECT_EQ(ind, (SQLLEN)(3000 * sizeof(SQLWCHAR)));
+        }
+        units += std::min<size_t>(ind / sizeof(SQLWCHAR), 100);
+        parts++;
+        ASSERT_LT(parts, 100);
+    }
+    EXPECT_EQ(units, 3000u);
+    EXPECT_EQ(parts, 30);
+}
@@ -0,0 +1,238 @@
+#include "test_helpers.h"
+
+#define FB_BCP_TABLOCK 0x1
+#define FB_BCP_CHECK_CONSTRAINTS 0x2
+
+typedef SQLRETURN (*BcpInitFn)(SQLHDBC, SQLCHAR*, SQLSMALLINT, SQLULEN, SQLUINTEGER);
+typedef SQLRETURN (*BcpBindFn)(SQLHDBC, SQLUSMALLINT, SQLSMALLINT, SQLPOINTER, SQLLEN, SQLLEN*);
+typedef SQLRETURN (*BcpSendRowFn)(SQLHDBC);
+typedef SQLRETURN (*BcpRowsFn)(SQLHDBC, SQLLEN*);
+typedef SQLRETURN (*GetDiagRecFn)(SQLSMALLINT, SQLHANDLE, SQLSMALLINT, SQLCHAR*, SQLINTEGER*,
+                                  SQLCHAR*, SQLSMALLINT, SQLSMALLINT*);
+
+class BulkTest : public OdbcTest {
+protected:
+    BcpInitFn bcp_init = nullptr;
+    BcpBindFn bcp_bind = nullptr;
+    BcpSendRowFn bcp_sendrow = nullptr;
+    BcpRowsFn bcp_batch = nullptr;
+    BcpRowsFn bcp_done = nullptr;
+    GetDiagRecFn driver_diag = nullptr;
+    SQLHDBC driver_dbc = SQL_NULL_HDBC;
+
+    void SetUp() override {
+        OdbcTest::SetUp();
+        bcp_init = reinterpret_cast<BcpInitFn>(furball_symbol("furball_bcp_init"));
+        bcp_bind = reinterpret_cast<BcpBindFn>(furball_symbol("furball_bcp_bind"));
+        bcp_sendrow = reinterpret_cast<BcpSendRowFn>(furball_symbol("furball_bcp_sendrow"));
+        bcp_batch = reinterpret_cast<BcpRowsFn>(furball_symbol("furball_bcp_batch"));
+        bcp_done = reinterpret_cast<BcpRowsFn>(furball_symbol("furball_bcp_done"));
+        // Diagnostics of calls made around the driver manager stay with the driver
+        driver_diag = reinterpret_cast<GetDiagRecFn>(furball_symbol("SQLGetDiagRec"));
+        ASSERT_TRUE(bcp_init && bcp_bind && bcp_sendrow && bcp_batch && bcp_done && driver_diag);
+        ASSERT_TRUE(SQL_SUCCEEDED(SQLGetInfo(conn->hdbc, SQL_DRIVER_HDBC, &driver_dbc,
+                                             sizeof(driver_dbc), nullptr)));
+    }
+
+    SQLRETURN init(const char* table, SQLULEN batch_size, SQLUINTEGER options = 0) {
+        return bcp_init(driver_dbc, (SQLCHAR*)table, SQL_NTS, batch_size, options);
+    }
+
+    std::string sqlstate() {
+        SQLCHAR state[6] = {0};
+        SQLCHAR msg[512];
+        SQLINTEGER native;
+        SQLSMALLINT len;
+        driver_diag(SQL_HANDLE_DBC, driver_dbc, 1, state, &native, msg, sizeof(msg), &len);
+        return std::string((char*)state);
+    }
+
+    int count(const std::string& table) {
+        EXPECT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "SELECT COUNT(*) FROM " + table)));
+        EXPECT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+        int n = get_int_col(stmt->hstmt, 1);
+        SQLCloseCursor(stmt->hstmt);
+        return n;
+    }
+};
+
+TEST_F(BulkTest, LoadsRowsOfSeveralTypes) {
+    drop_table("test_bulk");
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "CREATE TABLE test_bulk (id INT NOT NULL, name NVARCHAR(50), code VARCHAR(10), "
+        "amount DECIMAL(10,2), ratio FLOAT, born DATE, seen DATETIME2(3), "
+        "note NVARCHAR(MAX), flag BIT, calc AS id * 2)")));
+
+    ASSERT_EQ(init("test_bulk", 0), SQL_SUCCESS) << sqlstate();
+    SQLINTEGER id;
+    SQLWCHAR name[32];
+    SQLLEN name_ind;
+    char code[11];
+    SQLLEN code_ind = SQL_NTS;
+    char amount[16];
+    SQLLEN amount_ind = SQL_NTS;
+    double ratio;
+    SQL_DATE_STRUCT born;
+    SQL_TIMESTAMP_STRUCT seen;
+    SQLWCHAR note[16];
+    SQLLEN note_ind;
+    unsigned char flag;
+    ASSERT_EQ(bcp_bind(driver_dbc, 1, SQL_C_LONG, &id, 0, nullptr), SQL_SUCCESS);
+    ASSERT_EQ(bcp_bind(driver_dbc, 2, SQL_C_WCHAR, name, sizeof(name), &name_ind), SQL_SUCCESS);
+    ASSERT_EQ(bcp_bind(driver_dbc, 3, SQL_C_CHAR, code, sizeof(code), &code_ind), SQL_SUCCESS);
+    ASSERT_EQ(bcp_bind(driver_dbc, 4, SQL_C_CHAR, amount, sizeof(amount), &amount_ind),
+              SQL_SUCCESS);
+    ASSERT_EQ(bcp_bind(driver_dbc, 5, SQL_C_DEFAULT, &ratio, 0, nullptr), SQL_SUCCESS);
+    ASSERT_EQ(bcp_bind(driver_dbc, 6, SQL_C_TYPE_DATE, &born, 0, nullptr), SQL_SUCCESS);
+    ASSERT_EQ(bcp_bind(driver_dbc, 7, SQL_C_TYPE_TIMESTAMP, &seen, 0, nullptr), SQL_SUCCESS);
+    ASSERT_EQ(bcp_bind(driver_dbc, 8, SQL_C_WCHAR, note, sizeof(note), &note_ind), SQL_SUCCESS);
+    ASSERT_EQ(bcp_bind(driver_dbc, 9, SQL_C_BIT, &flag, 0, nullptr), SQL_SUCCESS);
+    // Computed columns cannot be loaded
+    EXPECT_EQ(bcp_bind(driver_dbc, 10, SQL_C_LONG, &id, 0, nullptr), SQL_ERROR);
+
+    for (int i = 1; i <= 500; i++) {
+        id = i;
+        std::u16string n = to_utf16("row " + std::to_string(i));
+        memcpy(name, n.data(), n.size() * sizeof(SQLWCHAR));
+        name_ind = (i % 10 == 0) ? SQL_NULL_DATA : SQLLEN(n.size() * sizeof(SQLWCHAR));
+        snprintf(code, sizeof(code), "C%d", i);
+        snprintf(amount, sizeof(amount), "%d.25", i);
+        ratio = i / 8.0;
+        born = {2000, 1, 1};
+        seen = {2024, 3, 4, 5, 6, 7, 890000000};
+        std::u16string t = to_utf16("note");
+        memcpy(note, t.data(), t.size() * sizeof(SQLWCHAR));
+        note_ind = (i == 1) ? SQL_NULL_DATA : SQLLEN(t.size() * sizeof(SQLWCHAR));
+        flag = i % 2;
+        ASSERT_EQ(bcp_sendrow(driver_dbc), SQL_SUCCESS) << "row " << i << ": " << sqlstate();
+    }
+    SQLLEN rows = 0;
+    ASSERT_EQ(bcp_done(driver_dbc, &rows), SQL_SUCCESS) << sqlstate();
+    EXPECT_EQ(rows, 500);
+
+    EXPECT_EQ(count("test_bulk"), 500);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT name, code, CAST(amount AS VARCHAR(20)), ratio, CONVERT(VARCHAR(10), born, 23), "
+        "CONVERT(VARCHAR(23), seen, 121), note, CAST(flag AS INT), calc "
+        "FROM test_bulk WHERE id = 7")));
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_string_col(stmt->hstmt, 1), "row 7");
+    EXPECT_EQ(get_string_col(stmt->hstmt, 2), "C7");
+    EXPECT_EQ(get_string_col(stmt->hstmt, 3), "7.25");
+    EXPECT_DOUBLE_EQ(get_double_col(stmt->hstmt, 4), 7 / 8.0);
+    EXPECT_EQ(get_string_col(stmt->hstmt, 5), "2000-01-01");
+    EXPECT_EQ(get_string_col(stmt->hstmt, 6), "2024-03-04 05:06:07.890");
+    EXPECT_EQ(get_string_col(stmt->hstmt, 7), "note");
+    EXPECT_EQ(get_int_col(stmt->hstmt, 8), 1);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 9), 14);
+    SQLCloseCursor(stmt->hstmt);
+
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT COUNT(*) FROM test_bulk WHERE name IS NULL OR note IS NULL")));
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 51);
+    SQLCloseCursor(stmt->hstmt);
+    drop_table("test_bulk");
+}
+
+TEST_F(BulkTest, CommitsEveryBatchSizeRows) {
+    drop_table("test_bulk_batch");
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "CREATE TABLE test_bulk_batch (id INT)")));
+
+    ASSERT_EQ(init("test_bulk_batch", 100, FB_BCP_TABLOCK), SQL_SUCCESS) << sqlstate();
+    SQLINTEGER id;
+    ASSERT_EQ(bcp_bind(driver_dbc, 1, SQL_C_LONG, &id, 0, nullptr), SQL_SUCCESS);
+    for (id = 0; id < 250; id++) {
+        ASSERT_EQ(bcp_sendrow(driver_dbc), SQL_SUCCESS) << sqlstate();
+    }
+    // Two full batches are committed; the open one keeps the connection busy
+    EXPECT_EQ(exec_direct(stmt->hstmt, "SELECT 1"), SQL_ERROR);
+    SQLLEN rows = 0;
+    ASSERT_EQ(bcp_batch(driver_dbc, &rows), SQL_SUCCESS) << sqlstate();
+    EXPECT_EQ(rows, 50);
+    EXPECT_EQ(count("test_bulk_batch"), 250);
+
+    id = 250;
+    ASSERT_EQ(bcp_sendrow(driver_dbc), SQL_SUCCESS);
+    ASSERT_EQ(bcp_done(driver_dbc, &rows), SQL_SUCCESS) << sqlstate();
+    EXPECT_EQ(rows, 251);
+    EXPECT_EQ(count("test_bulk_batch"), 251);
+    drop_table("test_bulk_batch");
+}
+
+TEST_F(BulkTest, Errors) {
+    EXPECT_EQ(init("no_such_table_bulk", 0), SQL_ERROR);
+    EXPECT_EQ(sqlstate(), "42S02");
+    EXPECT_EQ(bcp_sendrow(driver_dbc), SQL_ERROR);
+    EXPECT_EQ(sqlstate(), "HY010");
+
+    drop_table("test_bulk_check");
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "CREATE TABLE test_bulk_check (id INT NOT NULL CHECK (id > 0), tag VARCHAR(3))")));
+    ASSERT_EQ(init("test_bulk_check", 0, FB_BCP_CHECK_CONSTRAINTS), SQL_SUCCESS) << sqlstate();
+    SQLINTEGER id = 1;
+    char tag[8] = "abcd";
+    SQLLEN tag_ind = SQL_NTS;
+    SQLLEN id_ind = 0;
+    ASSERT_EQ(bcp_bind(driver_dbc, 1, SQL_C_LONG, &id, 0, &id_ind), SQL_SUCCESS);
+    ASSERT_EQ(bcp_bind(driver_dbc, 2, SQL_C_CHAR, tag, sizeof(tag), &tag_ind), SQL_SUCCESS);
+    EXPECT_EQ(bcp_sendrow(driver_dbc), SQL_ERROR);
+    EXPECT_EQ(sqlstate(), "22001");
+    tag[3] = 0;
+    id_ind = SQL_NULL_DATA;
+    EXPECT_EQ(bcp_sendrow(driver_dbc), SQL_ERROR);
+    EXPECT_EQ(sqlstate(), "23000");
+
+    // The server rejects the batch when a row fails a CHECK constraint
+    id_ind = 0;
+    id = -1;
+    ASSERT_EQ(bcp_sendrow(driver_dbc), SQL_SUCCESS) << sqlstate();
+    SQLLEN rows = -1;
+    EXPECT_EQ(bcp_done(driver_dbc, &rows), SQL_ERROR);
+    EXPECT_EQ(sqlstate(), "23000");
+    EXPECT_EQ(rows, 0);
+    EXPECT_EQ(count("test_bulk_check"), 0);
+    drop_table("test_bulk_check");
+}
+
+// Text for a varchar column is converted to the column's code page, and
+// refused where the driver cannot
+TEST_F(BulkTest, NarrowTextInColumnCodePage) {
+    drop_table("test_bulk_cp");
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "CREATE TABLE test_bulk_cp (a VARCHAR(10) COLLATE Latin1_General_CI_AS, "
+        "b VARCHAR(10) COLLATE Latin1_General_CI_AS, "
+        "c VARCHAR(10) COLLATE Cyrillic_General_CI_AS)")));
+
+    ASSERT_EQ(init("test_bulk_cp", 0), SQL_SUCCESS) << sqlstate();
+    char a[16] = "\xE2\x82\xAC\xC3\xA9";  // UTF-8 "€é"
+    SQLLEN a_ind = SQL_NTS;
+    std::u16string b = to_utf16("\xE2\x80\x9C\xC5\xB8\xE2\x80\x9D");  // "“Ÿ”"
+    SQLLEN b_ind = b.size() * sizeof(char16_t);
+    char c[16] = "abc";
+    SQLLEN c_ind = SQL_NTS;
+    ASSERT_EQ(bcp_bind(driver_dbc, 1, SQL_C_CHAR, a, sizeof(a), &a_ind), SQL_SUCCESS);
+    ASSERT_EQ(bcp_bind(driver_dbc, 2, SQL_C_WCHAR, (SQLPOINTER)b.data(), 0, &b_ind),
+              SQL_SUCCESS);
+    ASSERT_EQ(bcp_bind(driver_dbc, 3, SQL_C_CHAR, c, sizeof(c), &c_ind), SQL_SUCCESS);
+    ASSERT_EQ(bcp_sendrow(driver_dbc), SQL_SUCCESS) << sqlstate();
+
+    // Not ASCII, in a code page other than 1252
+    strcpy(c, "\xC3\xA9");
+    EXPECT_EQ(bcp_sendrow(driver_dbc), SQL_ERROR);
+    EXPECT_EQ(sqlstate(), "HYC00");
+    SQLLEN rows = 0;
+    ASSERT_EQ(bcp_done(driver_dbc, &rows), SQL_SUCCESS) << sqlstate();
+    EXPECT_EQ(rows, 1);
+
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT CASE WHEN a = N'\xE2\x82\xAC\xC3\xA9' AND DATALENGTH(a) = 2 THEN 1 ELSE 0 END, "
+        "CASE WHEN b = N'\xE2\x80\x9C\xC5\xB8\xE2\x80\x9D' AND DATALENGTH(b) = 3 "
+        "THEN 1 ELSE 0 END, c FROM test_bulk_cp")));
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 1);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 2), 1);
+    EXPECT_EQ(get_string_col(stmt->hstmt, 3), "abc");
+    SQLCloseCursor(stmt->hstmt);
+    drop_table("test_bulk_cp");
+}
@@ -0,0 +1,110 @@
+#include "test_helpers.h"
+#include <chrono>
+#include <thread>
+
+class CancelTest : public OdbcTest {
+protected:
+    std::string first_sqlstate() {
+        SQLWCHAR state[6];
+        SQLINTEGER native;
+        SQLWCHAR msg[1024];
+        SQLSMALLINT len;
+        SQLGetDiagRecW(SQL_HANDLE_STMT, stmt->hstmt, 1, state, &native, msg, 1024, &len);
+        return from_utf16(state, 5);
+    }
+
+    void expect_connection_usable() {
+        SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+        ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "SELECT 42")))
+            << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+        ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+        EXPECT_EQ(get_int_col(stmt->hstmt, 1), 42);
+    }
+};
+
+TEST_F(CancelTest, QueryTimeout) {
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER)1, 0);
+    auto start = std::chrono::steady_clock::now();
+    SQLRETURN rc = exec_direct(stmt->hstmt, "WAITFOR DELAY '00:00:10'");
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(rc, SQL_ERROR);
+    EXPECT_EQ(first_sqlstate(), "HYT00");
+    EXPECT_LT(elapsed, std::chrono::seconds(5));
+
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER)0, 0);
+    expect_connection_usable();
+}
+
+// The timeout covers the whole call, not each wait for the next packet: a
+// batch that keeps sending messages still times out
+TEST_F(CancelTest, QueryTimeoutSpansTrickledReply) {
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER)2, 0);
+    auto start = std::chrono::steady_clock::now();
+    SQLRETURN rc = exec_direct(stmt->hstmt,
+        "DECLARE @i INT = 0; WHILE @i < 10 BEGIN "
+        "RAISERROR('tick', 0, 1) WITH NOWAIT; WAITFOR DELAY '00:00:01'; SET @i += 1; END");
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_EQ(rc, SQL_ERROR);
+    EXPECT_NE(get_diag(SQL_HANDLE_STMT, stmt->hstmt).find("HYT00"), std::string::npos);
+    EXPECT_LT(elapsed, std::chrono::seconds(6));
+
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER)0, 0);
+    expect_connection_usable();
+}
+
+TEST_F(CancelTest, CancelFromAnotherThread) {
+    std::thread canceller([this] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        SQLCancel(stmt->hstmt);
+    });
+    SQLRETURN rc = exec_direct(stmt->hstmt, "WAITFOR DELAY '00:00:10'");
+    canceller.join();
+    EXPECT_EQ(rc, SQL_ERROR);
+    EXPECT_EQ(first_sqlstate(), "HY008");
+    expect_connection_usable();
+}
+
+// Closing a cursor over a large result cancels it instead of reading it all
+TEST_F(CancelTest, CloseCursorEarly) {
+    SQLRETURN rc = exec_direct(stmt->hstmt,
+        "SELECT a.object_id FROM sys.all_objects a CROSS JOIN sys.all_objects b");
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(SQL_SUCCEEDED(SQLCloseCursor(stmt->hstmt)));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+    expect_connection_usable();
+}
+
+TEST_F(CancelTest, CancelReadAhead) {
+    // 0x4002 = SQL_ATTR_FB_READ_AHEAD
+    SQLSetStmtAttr(stmt->hstmt, 0x4002, (SQLPOINTER)1, 0);
+    SQLRETURN rc = exec_direct(stmt->hstmt,
+        "SELECT a.object_id FROM sys.all_objects a CROSS JOIN sys.all_objects b "
+        "CROSS JOIN sys.all_objects c");
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+
+    EXPECT_TRUE(SQL_SUCCEEDED(SQLCancel(stmt->hstmt)));
+    while ((rc = SQLFetch(stmt->hstmt)) == SQL_SUCCESS) {
+    }
+    EXPECT_EQ(rc, SQL_ERROR);
+    EXPECT_EQ(first_sqlstate(), "HY008");
+    expect_connection_usable();
+}
+
+// SQLCancel on an idle statement does not interrupt another statement's
+// request on the same connection
+TEST_F(CancelTest, CancelOtherStatementIgnored) {
+    OdbcStmt other(conn->hdbc);
+    std::thread canceller([&other] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        SQLCancel(other.hstmt);
+    });
+    SQLRETURN rc = exec_direct(stmt->hstmt, "WAITFOR DELAY '00:00:01'; SELECT 7");
+    canceller.join();
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 7);
+}
@@ -47,3 +47,46 @@ TEST_F(CatalogTest, PrimaryKeysW) {
     EXPECT_EQ(count, 1);
     drop_table("test_cat_pk");
 }
+
+// Catalog results are cached per connection; DDL on the connection drops
+// them, so a table it creates or drops shows up at once
+TEST_F(CatalogTest, CachedTablesFollowDdl) {
+    drop_table("test_cat_cache");
+    auto wtable = to_utf16("test_cat_cache");
+    auto count_tables = [&]() {
+        SQLRETURN rc = SQLTablesW(stmt->hstmt, nullptr, 0, nullptr, 0,
+            (SQLWCHAR*)wtable.c_str(), (SQLSMALLINT)wtable.size(), nullptr, 0);
+        EXPECT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+        int count = 0;
+        while (SQLFetch(stmt->hstmt) == SQL_SUCCESS) count++;
+        SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+        return count;
+    };
+
+    EXPECT_EQ(count_tables(), 0);
+    EXPECT_EQ(count_tables(), 0);
+    exec_direct(stmt->hstmt, "CREATE TABLE test_cat_cache (id INT)");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    EXPECT_EQ(count_tables(), 1);
+    drop_table("test_cat_cache");
+    EXPECT_EQ(count_tables(), 0);
+}
+
+TEST_F(CatalogTest, TypeInfoForOneType) {
+    SQLRETURN rc = SQLGetTypeInfo(stmt->hstmt, SQL_TYPE_TIMESTAMP);
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    std::vector<std::string> names;
+    while (SQLFetch(stmt->hstmt) == SQL_SUCCESS) {
+        names.push_back(get_string_col(stmt->hstmt, 1));
+        EXPECT_EQ(get_int_col(stmt->hstmt, 2), SQL_TYPE_TIMESTAMP);
+    }
+    EXPECT_EQ(names, (std::vector<std::string>{"datetime2", "datetime"}));
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+
+    rc = SQLGetTypeInfo(stmt->hstmt, SQL_INTEGER);
+    ASSERT_TRUE(SQL_SUCCEEDED(rc));
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_string_col(stmt->hstmt, 1), "int");
+    EXPECT_EQ(get_int_col(stmt->hstmt, 3), 10);
+    EXPECT_EQ(SQLFetch(stmt->hstmt), SQL_NO_DATA);
+}
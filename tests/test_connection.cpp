@@ -1,4 +1,5 @@
 #include "test_helpers.h"
+#include <cstdio>
 
 // a) Connection tests
 
@@ -70,3 +71,188 @@ TEST(Connection, AutocommitAttribute) {
         (SQLPOINTER)SQL_AUTOCOMMIT_ON, 0);
     EXPECT_TRUE(SQL_SUCCEEDED(rc));
 }
+
+TEST(Connection, PoolingReusesSession) {
+    OdbcEnv env;
+    std::string conn_str = std::string(CONN_STR_UTF8) + ";Pooling=yes";
+    auto connect_and_get_spid = [&](SQLHDBC hdbc) {
+        SQLCHAR out[1024];
+        SQLSMALLINT outlen;
+        SQLRETURN rc = SQLDriverConnect(hdbc, nullptr, (SQLCHAR*)conn_str.c_str(),
+            SQL_NTS, out, 1024, &outlen, SQL_DRIVER_NOPROMPT);
+        EXPECT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_DBC, hdbc);
+        OdbcStmt stmt(hdbc);
+        exec_direct(stmt.hstmt, "SELECT @@SPID");
+        EXPECT_EQ(SQLFetch(stmt.hstmt), SQL_SUCCESS);
+        return get_int_col(stmt.hstmt, 1);
+    };
+
+    SQLHDBC hdbc;
+    SQLAllocHandle(SQL_HANDLE_DBC, env.henv, &hdbc);
+    int first = connect_and_get_spid(hdbc);
+    SQLDisconnect(hdbc);
+    int second = connect_and_get_spid(hdbc);
+    EXPECT_EQ(first, second);
+
+    // Driver-specific pool counters (SQL_DRIVER_CONN_ATTR_BASE + 1 / + 2)
+    SQLULEN hits = 0, misses = 0;
+    SQLGetConnectAttr(hdbc, 0x4001, &hits, 0, nullptr);
+    SQLGetConnectAttr(hdbc, 0x4002, &misses, 0, nullptr);
+    EXPECT_EQ(hits, 1u);
+    EXPECT_EQ(misses, 1u);
+
+    SQLDisconnect(hdbc);
+    SQLFreeHandle(SQL_HANDLE_DBC, hdbc);
+}
+
+// Connect with extra keywords and return the session's encrypt_option
+static std::string connect_encrypt_option(const std::string& extra) {
+    OdbcEnv env;
+    OdbcConn conn(env.henv);
+    std::string conn_str = std::string(CONN_STR_UTF8) + extra;
+    SQLCHAR out[1024];
+    SQLSMALLINT outlen;
+    SQLRETURN rc = SQLDriverConnect(conn.hdbc, nullptr, (SQLCHAR*)conn_str.c_str(), SQL_NTS,
+        out, 1024, &outlen, SQL_DRIVER_NOPROMPT);
+    EXPECT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_DBC, conn.hdbc);
+    if (!SQL_SUCCEEDED(rc)) return "";
+    conn.connected = true;
+    OdbcStmt stmt(conn.hdbc);
+    exec_direct(stmt.hstmt,
+        "SELECT encrypt_option FROM sys.dm_exec_connections WHERE session_id = @@SPID");
+    EXPECT_EQ(SQLFetch(stmt.hstmt), SQL_SUCCESS);
+    return get_string_col(stmt.hstmt, 1);
+}
+
+// Nothing is encrypted unless asked: cancel and bulk copy need the
+// session's packets in the clear
+TEST(Connection, NotEncryptedByDefault) {
+    EXPECT_EQ(connect_encrypt_option(""), "FALSE");
+    EXPECT_EQ(connect_encrypt_option(";Encrypt=yes"), "TRUE");
+    EXPECT_EQ(connect_encrypt_option(";Encrypt=no"), "FALSE");
+}
+
+// Without TLS there is no certificate to validate, so the server's
+// self-signed one needs no TrustServerCertificate
+TEST(Connection, UnencryptedWithoutTrustServerCertificate) {
+    std::string conn_str = CONN_STR_UTF8;
+    conn_str.erase(conn_str.find(";TrustServerCertificate=yes"));
+    OdbcEnv env;
+    OdbcConn conn(env.henv);
+    SQLCHAR out[1024];
+    SQLSMALLINT outlen;
+    SQLRETURN rc = SQLDriverConnect(conn.hdbc, nullptr, (SQLCHAR*)conn_str.c_str(), SQL_NTS,
+        out, 1024, &outlen, SQL_DRIVER_NOPROMPT);
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_DBC, conn.hdbc);
+    conn.connected = true;
+    OdbcStmt stmt(conn.hdbc);
+    exec_direct(stmt.hstmt, "SELECT 1");
+    ASSERT_EQ(SQLFetch(stmt.hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt.hstmt, 1), 1);
+}
+
+// An encrypted session cannot signal attention: a partly read result is
+// read to its end, and cancel and query timeout are refused
+TEST(Connection, EncryptedClosesPartlyFetchedCursor) {
+    OdbcEnv env;
+    OdbcConn conn(env.henv);
+    std::string conn_str = std::string(CONN_STR_UTF8) + ";Encrypt=yes";
+    SQLCHAR out[1024];
+    SQLSMALLINT outlen;
+    SQLRETURN rc = SQLDriverConnect(conn.hdbc, nullptr, (SQLCHAR*)conn_str.c_str(), SQL_NTS,
+        out, 1024, &outlen, SQL_DRIVER_NOPROMPT);
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_DBC, conn.hdbc);
+    conn.connected = true;
+    OdbcStmt stmt(conn.hdbc);
+
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt.hstmt,
+        "SELECT TOP 100000 a.object_id FROM sys.all_columns a CROSS JOIN sys.all_columns b")));
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(SQLFetch(stmt.hstmt), SQL_SUCCESS);
+    }
+    ASSERT_EQ(SQLCloseCursor(stmt.hstmt), SQL_SUCCESS) << get_diag(SQL_HANDLE_STMT, stmt.hstmt);
+
+    // Re-executing after a few rows closes the stream the same way
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt.hstmt,
+        "SELECT TOP 100000 a.object_id FROM sys.all_columns a CROSS JOIN sys.all_columns b")));
+    ASSERT_EQ(SQLFetch(stmt.hstmt), SQL_SUCCESS);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt.hstmt, "SELECT 42")))
+        << get_diag(SQL_HANDLE_STMT, stmt.hstmt);
+    ASSERT_EQ(SQLFetch(stmt.hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt.hstmt, 1), 42);
+    SQLFreeStmt(stmt.hstmt, SQL_CLOSE);
+
+    EXPECT_EQ(SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER)5, 0), SQL_ERROR);
+    EXPECT_NE(get_diag(SQL_HANDLE_STMT, stmt.hstmt).find("HYC00"), std::string::npos);
+    EXPECT_EQ(SQLCancel(stmt.hstmt), SQL_ERROR);
+    EXPECT_NE(get_diag(SQL_HANDLE_STMT, stmt.hstmt).find("HYC00"), std::string::npos);
+}
+
+TEST(Connection, MultiSubnetFailover) {
+    EXPECT_EQ(connect_encrypt_option(";MultiSubnetFailover=yes"), "FALSE");
+    EXPECT_EQ(connect_encrypt_option(";MultiSubnetFailover=yes;Encrypt=yes"), "TRUE");
+}
+
+TEST(Connection, TraceFile) {
+    std::string path = "/tmp/furball_trace_test.log";
+    std::remove(path.c_str());
+    OdbcEnv env;
+    OdbcConn conn(env.henv);
+    std::string conn_str = std::string(CONN_STR_UTF8) + ";Trace=" + path;
+    SQLCHAR out[1024];
+    SQLSMALLINT outlen;
+    ASSERT_TRUE(SQL_SUCCEEDED(SQLDriverConnect(conn.hdbc, nullptr, (SQLCHAR*)conn_str.c_str(),
+        SQL_NTS, out, 1024, &outlen, SQL_DRIVER_NOPROMPT)));
+    conn.connected = true;
+    {
+        OdbcStmt stmt(conn.hdbc);
+        exec_direct(stmt.hstmt, "SELECT 1 AS traced");
+        EXPECT_EQ(SQLFetch(stmt.hstmt), SQL_SUCCESS);
+        EXPECT_EQ(SQLFetch(stmt.hstmt), SQL_NO_DATA);
+    }
+    // The trace is written out when the connection closes
+    SQLDisconnect(conn.hdbc);
+    conn.connected = false;
+
+    FILE* f = fopen(path.c_str(), "r");
+    ASSERT_NE(f, nullptr);
+    std::string trace;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) trace.append(buf, n);
+    fclose(f);
+    std::remove(path.c_str());
+    EXPECT_NE(trace.find("connect server="), std::string::npos) << trace;
+    EXPECT_NE(trace.find("rows=1 "), std::string::npos) << trace;
+    EXPECT_NE(trace.find("SELECT 1 AS traced"), std::string::npos) << trace;
+}
+
+TEST(Connection, PacketSize) {
+    OdbcEnv env;
+    OdbcConn conn(env.henv);
+    std::string conn_str = std::string(CONN_STR_UTF8) + ";Packet Size=32767;SocketBufferSize=1048576";
+    SQLCHAR out[1024];
+    SQLSMALLINT outlen;
+    SQLRETURN rc = SQLDriverConnect(conn.hdbc, nullptr, (SQLCHAR*)conn_str.c_str(), SQL_NTS,
+        out, 1024, &outlen, SQL_DRIVER_NOPROMPT);
+    // The session runs at the packet size tabby logs in with
+    ASSERT_EQ(rc, SQL_SUCCESS_WITH_INFO) << get_diag(SQL_HANDLE_DBC, conn.hdbc);
+    EXPECT_NE(get_diag(SQL_HANDLE_DBC, conn.hdbc).find("01S02"), std::string::npos);
+    conn.connected = true;
+
+    SQLULEN size = 0;
+    ASSERT_EQ(SQLGetConnectAttr(conn.hdbc, SQL_ATTR_PACKET_SIZE, &size, 0, nullptr), SQL_SUCCESS);
+    EXPECT_EQ(size, 4096u);
+    EXPECT_EQ(SQLSetConnectAttr(conn.hdbc, SQL_ATTR_PACKET_SIZE, (SQLPOINTER)8192, 0), SQL_ERROR);
+
+    OdbcStmt stmt(conn.hdbc);
+    // A reply of many packets through the resized socket buffers
+    exec_direct(stmt.hstmt,
+        "SELECT v, DATALENGTH(v) FROM (SELECT REPLICATE(CONVERT(VARCHAR(MAX), 'x'), 100000) AS v) t");
+    ASSERT_EQ(SQLFetch(stmt.hstmt), SQL_SUCCESS);
+    char buf[200001];
+    SQLLEN ind = 0;
+    EXPECT_EQ(SQLGetData(stmt.hstmt, 1, SQL_C_CHAR, buf, sizeof(buf), &ind), SQL_SUCCESS);
+    EXPECT_EQ(ind, 100000);
+    EXPECT_EQ(get_int_col(stmt.hstmt, 2), 100000);
+}
@@ -0,0 +1,158 @@
+#include "test_helpers.h"
+
+// Scrollable cursors: SQL_ATTR_CURSOR_TYPE other than forward-only opens a
+// cursor, and each SQLFetchScroll reads one rowset from it. A static
+// read-only cursor holds its rows on the client; the others are server
+// cursors.
+class CursorTest : public OdbcTest {
+protected:
+    SQLULEN fetched = 0;
+    SQLINTEGER vals[10];
+    SQLLEN inds[10];
+
+    void open(SQLULEN cursor_type, SQLULEN rowset) {
+        ASSERT_TRUE(SQL_SUCCEEDED(SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_CURSOR_TYPE,
+            (SQLPOINTER)cursor_type, 0)));
+        SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)rowset, 0);
+        SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+        SQLRETURN ret = exec_direct(stmt->hstmt,
+            "SELECT TOP 1000 CAST(ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS INT) AS n "
+            "FROM sys.all_columns a CROSS JOIN sys.all_columns b ORDER BY n");
+        ASSERT_TRUE(SQL_SUCCEEDED(ret)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+        SQLBindCol(stmt->hstmt, 1, SQL_C_SLONG, vals, 0, inds);
+    }
+
+    void expect_rowset(SQLSMALLINT orientation, SQLLEN offset, int first, SQLULEN n) {
+        SQLRETURN ret = SQLFetchScroll(stmt->hstmt, orientation, offset);
+        ASSERT_TRUE(SQL_SUCCEEDED(ret)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+        ASSERT_EQ(fetched, n);
+        for (SQLULEN i = 0; i < n; i++) {
+            EXPECT_EQ(vals[i], first + (int)i) << "row " << i;
+        }
+    }
+};
+
+TEST_F(CursorTest, StaticScroll) {
+    open(SQL_CURSOR_STATIC, 10);
+    expect_rowset(SQL_FETCH_NEXT, 0, 1, 10);
+    expect_rowset(SQL_FETCH_NEXT, 0, 11, 10);
+    expect_rowset(SQL_FETCH_ABSOLUTE, 501, 501, 10);
+    expect_rowset(SQL_FETCH_PRIOR, 0, 491, 10);
+    expect_rowset(SQL_FETCH_RELATIVE, 100, 591, 10);
+    expect_rowset(SQL_FETCH_LAST, 0, 991, 10);
+    expect_rowset(SQL_FETCH_ABSOLUTE, -20, 981, 10);
+    expect_rowset(SQL_FETCH_FIRST, 0, 1, 10);
+    EXPECT_EQ(SQLFetchScroll(stmt->hstmt, SQL_FETCH_PRIOR, 0), SQL_NO_DATA);
+    expect_rowset(SQL_FETCH_NEXT, 0, 1, 10);
+}
+
+TEST_F(CursorTest, BeforeStartAndPastEnd) {
+    open(SQL_CURSOR_STATIC, 10);
+    EXPECT_EQ(SQLFetchScroll(stmt->hstmt, SQL_FETCH_ABSOLUTE, 0), SQL_NO_DATA);
+    EXPECT_EQ(fetched, 0u);
+    expect_rowset(SQL_FETCH_RELATIVE, 5, 5, 10);
+    expect_rowset(SQL_FETCH_ABSOLUTE, 996, 996, 5);
+    EXPECT_EQ(SQLFetchScroll(stmt->hstmt, SQL_FETCH_NEXT, 0), SQL_NO_DATA);
+}
+
+TEST_F(CursorTest, KeysetAndDynamic) {
+    for (SQLULEN type : {SQL_CURSOR_KEYSET_DRIVEN, SQL_CURSOR_DYNAMIC}) {
+        SCOPED_TRACE(type);
+        open(type, 5);
+        expect_rowset(SQL_FETCH_LAST, 0, 996, 5);
+        expect_rowset(SQL_FETCH_PRIOR, 0, 991, 5);
+        expect_rowset(SQL_FETCH_FIRST, 0, 1, 5);
+        // The query may not support the requested type; the attribute says
+        // which cursor the server opened
+        SQLULEN got = 0;
+        SQLGetStmtAttr(stmt->hstmt, SQL_ATTR_CURSOR_TYPE, &got, 0, nullptr);
+        EXPECT_NE(got, (SQLULEN)SQL_CURSOR_FORWARD_ONLY);
+        ASSERT_EQ(SQLCloseCursor(stmt->hstmt), SQL_SUCCESS);
+        SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_CURSOR_TYPE, (SQLPOINTER)SQL_CURSOR_FORWARD_ONLY, 0);
+    }
+}
+
+TEST_F(CursorTest, ParameterizedCursor) {
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_CURSOR_TYPE, (SQLPOINTER)SQL_CURSOR_STATIC, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)2, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+    ASSERT_TRUE(SQL_SUCCEEDED(prepare(stmt->hstmt,
+        "SELECT n FROM (VALUES (1),(2),(3),(4),(5)) AS t(n) WHERE n > ? ORDER BY n")));
+    SQLINTEGER min = 1;
+    SQLBindParameter(stmt->hstmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG, SQL_INTEGER, 0, 0, &min, 0,
+                     nullptr);
+    ASSERT_TRUE(SQL_SUCCEEDED(SQLExecute(stmt->hstmt))) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    SQLBindCol(stmt->hstmt, 1, SQL_C_SLONG, vals, 0, inds);
+    expect_rowset(SQL_FETCH_LAST, 0, 4, 2);
+    expect_rowset(SQL_FETCH_FIRST, 0, 2, 2);
+}
+
+// A static cursor's rows past BufferBytes= are spilled, and read back
+// wherever the cursor moves
+TEST(ClientCursor, ScrollsSpilledRows) {
+    OdbcEnv env;
+    OdbcConn conn(env.henv);
+    std::string conn_str = std::string(CONN_STR_UTF8) + ";BufferBytes=65536";
+    SQLCHAR out[1024];
+    SQLSMALLINT outlen;
+    ASSERT_TRUE(SQL_SUCCEEDED(SQLDriverConnect(conn.hdbc, nullptr, (SQLCHAR*)conn_str.c_str(),
+        SQL_NTS, out, 1024, &outlen, SQL_DRIVER_NOPROMPT)));
+    conn.connected = true;
+    OdbcStmt stmt(conn.hdbc);
+
+    SQLULEN fetched = 0;
+    SQLINTEGER vals[10];
+    SQLLEN inds[10];
+    SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_CURSOR_TYPE, (SQLPOINTER)SQL_CURSOR_STATIC, 0);
+    SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)10, 0);
+    SQLSetStmtAttr(stmt.hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &fetched, 0);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt.hstmt,
+        "SELECT TOP 50000 CAST(ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS INT) AS n, "
+        "REPLICATE('x', 100) AS pad FROM sys.all_columns a CROSS JOIN sys.all_columns b "
+        "ORDER BY n"))) << get_diag(SQL_HANDLE_STMT, stmt.hstmt);
+    SQLBindCol(stmt.hstmt, 1, SQL_C_SLONG, vals, 0, inds);
+
+    FbStats stats{};
+    SQLGetStmtAttr(stmt.hstmt, FB_ATTR_STATS, &stats, sizeof(stats), nullptr);
+    EXPECT_GT(stats.spill_bytes, 0u);
+    SQLLEN count = 0;
+    SQLRowCount(stmt.hstmt, &count);
+    EXPECT_EQ(count, 50000);
+
+    auto expect_rowset = [&](SQLSMALLINT orientation, SQLLEN offset, int first, SQLULEN n) {
+        SQLRETURN ret = SQLFetchScroll(stmt.hstmt, orientation, offset);
+        ASSERT_TRUE(SQL_SUCCEEDED(ret)) << get_diag(SQL_HANDLE_STMT, stmt.hstmt);
+        ASSERT_EQ(fetched, n);
+        for (SQLULEN i = 0; i < n; i++) {
+            EXPECT_EQ(vals[i], first + (int)i) << "row " << i;
+        }
+    };
+    expect_rowset(SQL_FETCH_LAST, 0, 49991, 10);
+    expect_rowset(SQL_FETCH_ABSOLUTE, 25000, 25000, 10);
+    expect_rowset(SQL_FETCH_PRIOR, 0, 24990, 10);
+    expect_rowset(SQL_FETCH_FIRST, 0, 1, 10);
+    expect_rowset(SQL_FETCH_RELATIVE, 40000, 40001, 10);
+    expect_rowset(SQL_FETCH_ABSOLUTE, -5, 49996, 5);
+    EXPECT_EQ(get_string_col(stmt.hstmt, 2), std::string(100, 'x'));
+    EXPECT_EQ(SQLFetchScroll(stmt.hstmt, SQL_FETCH_NEXT, 0), SQL_NO_DATA);
+    expect_rowset(SQL_FETCH_PRIOR, 0, 49991, 10);
+}
+
+// A rowset that would start before the first row but reaches it starts
+// there, with a warning
+TEST_F(CursorTest, FetchBeforeFirstRowsetWarns) {
+    open(SQL_CURSOR_STATIC, 10);
+    expect_rowset(SQL_FETCH_ABSOLUTE, 5, 5, 10);
+    EXPECT_EQ(SQLFetchScroll(stmt->hstmt, SQL_FETCH_PRIOR, 0), SQL_SUCCESS_WITH_INFO);
+    EXPECT_NE(get_diag(SQL_HANDLE_STMT, stmt->hstmt).find("01S06"), std::string::npos);
+    EXPECT_EQ(vals[0], 1);
+    EXPECT_EQ(SQLFetchScroll(stmt->hstmt, SQL_FETCH_RELATIVE, -11), SQL_NO_DATA);
+    expect_rowset(SQL_FETCH_NEXT, 0, 1, 10);
+}
+
+TEST_F(CursorTest, ForwardOnlyRejectsScrolling) {
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "SELECT 1")));
+    EXPECT_EQ(SQLFetchScroll(stmt->hstmt, SQL_FETCH_LAST, 0), SQL_ERROR);
+    EXPECT_NE(get_diag(SQL_HANDLE_STMT, stmt->hstmt).find("HY106"), std::string::npos);
+    EXPECT_EQ(SQLFetchScroll(stmt->hstmt, SQL_FETCH_NEXT, 0), SQL_SUCCESS);
+}
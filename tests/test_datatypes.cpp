@@ -1,4 +1,5 @@
 #include "test_helpers.h"
+#include <algorithm>
 
 class DataTypesTest : public OdbcTest {
 protected:
@@ -139,3 +140,67 @@ TEST_F(DataTypesTest, UniqueIdentifier) {
 // Money types
 TEST_F(DataTypesTest, Money) { roundtrip_string("MONEY", "1234.5600", "1234.5600"); }
 TEST_F(DataTypesTest, SmallMoney) { roundtrip_string("SMALLMONEY", "99.99", "99.9900"); }
+
+// Formatted values read as SQL_C_WCHAR in chunks smaller than the text
+TEST_F(DataTypesTest, WideTextInChunks) {
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT CAST(-12345678901234567890.1234567 AS DECIMAL(38,7)), "
+        "CAST('6F9619FF-8B86-D011-B42D-00CF4FC964FF' AS UNIQUEIDENTIFIER)")));
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    const char* expected[] = {"-12345678901234567890.1234567", "6F9619FF-8B86-D011-B42D-00CF4FC964FF"};
+    for (SQLUSMALLINT col = 1; col <= 2; col++) {
+        std::string got;
+        SQLWCHAR buf[8];
+        SQLLEN ind = 0;
+        SQLRETURN rc;
+        while ((rc = SQLGetData(stmt->hstmt, col, SQL_C_WCHAR, buf, sizeof(buf), &ind)) !=
+               SQL_NO_DATA) {
+            ASSERT_TRUE(SQL_SUCCEEDED(rc));
+            SQLLEN chars = std::min<SQLLEN>(ind / sizeof(SQLWCHAR), 7);
+            got += from_utf16(buf, chars);
+        }
+        EXPECT_EQ(got, expected[col - 1]);
+    }
+}
+
+// Non-ASCII text through the W entry points and SQL_C_WCHAR: ASCII runs
+// longer than a vector, two- and three-byte characters and surrogate pairs,
+// read whole, by length query and in chunks that split a pair
+TEST_F(DataTypesTest, WideTextRoundTrip) {
+    const std::string text =
+        "plain ascii text running well past one vector width, "
+        "caf\xC3\xA9 na\xC3\xAFve \xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E "
+        "\xF0\x9F\x98\x80 \xF0\x9D\x84\x9E and ascii again to the end";
+    const std::u16string units = to_utf16(text);
+    drop_table("test_dt");
+    exec_direct(stmt->hstmt, "CREATE TABLE test_dt (val NVARCHAR(200))");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "INSERT INTO test_dt VALUES (N'" + text + "')")));
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT val AS [caf\xC3\xA9 \xE6\x97\xA5], val FROM test_dt")));
+
+    SQLWCHAR name[64];
+    SQLSMALLINT name_len = 0;
+    ASSERT_TRUE(SQL_SUCCEEDED(SQLDescribeColW(stmt->hstmt, 1, name, 64, &name_len,
+                                              nullptr, nullptr, nullptr, nullptr)));
+    EXPECT_EQ(name_len, 6);
+    EXPECT_EQ(from_utf16(name, name_len), "caf\xC3\xA9 \xE6\x97\xA5");
+
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_string_col(stmt->hstmt, 1), text);
+
+    // Length query first, then the text seven units at a time
+    SQLLEN ind = 0;
+    ASSERT_TRUE(SQL_SUCCEEDED(SQLGetData(stmt->hstmt, 2, SQL_C_WCHAR, nullptr, 0, &ind)));
+    EXPECT_EQ(ind, (SQLLEN)(units.size() * sizeof(SQLWCHAR)));
+    std::u16string got;
+    SQLWCHAR buf[8];
+    SQLRETURN rc;
+    while ((rc = SQLGetData(stmt->hstmt, 2, SQL_C_WCHAR, buf, sizeof(buf), &ind)) != SQL_NO_DATA) {
+        ASSERT_TRUE(SQL_SUCCEEDED(rc));
+        got.append(reinterpret_cast<const char16_t*>(buf),
+                   std::min<SQLLEN>(ind / sizeof(SQLWCHAR), 7));
+    }
+    EXPECT_EQ(got, units);
+}
@@ -1,4 +1,5 @@
 #include "test_helpers.h"
+#include <algorithm>
 
 class ExecutionTest : public OdbcTest {};
 
@@ -95,3 +96,185 @@ TEST_F(ExecutionTest, FreeStmtClose) {
     rc = exec_direct(stmt->hstmt, "SELECT 2");
     EXPECT_TRUE(SQL_SUCCEEDED(rc));
 }
+
+TEST_F(ExecutionTest, MoreResultsAfterFetchingAll) {
+    exec_direct(stmt->hstmt, "SELECT 1; SELECT 2");
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 1);
+    EXPECT_EQ(SQLFetch(stmt->hstmt), SQL_NO_DATA);
+
+    ASSERT_EQ(SQLMoreResults(stmt->hstmt), SQL_SUCCESS);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 2);
+    EXPECT_EQ(SQLFetch(stmt->hstmt), SQL_NO_DATA);
+    EXPECT_EQ(SQLMoreResults(stmt->hstmt), SQL_NO_DATA);
+}
+
+// 0x4002 = SQL_ATTR_FB_READ_AHEAD
+TEST_F(ExecutionTest, ReadAheadThread) {
+    ASSERT_EQ(SQLSetStmtAttr(stmt->hstmt, 0x4002, (SQLPOINTER)1, 0), SQL_SUCCESS);
+    exec_direct(stmt->hstmt,
+        "SELECT TOP 5000 ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS n "
+        "FROM sys.all_columns a CROSS JOIN sys.all_columns b ORDER BY n; SELECT 7");
+    long long expected = 1;
+    while (SQLFetch(stmt->hstmt) == SQL_SUCCESS) {
+        ASSERT_EQ(get_int_col(stmt->hstmt, 1), expected++);
+    }
+    EXPECT_EQ(expected, 5001);
+
+    ASSERT_EQ(SQLMoreResults(stmt->hstmt), SQL_SUCCESS);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 7);
+
+    // Closing part way through hands the session back in a usable state
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    exec_direct(stmt->hstmt,
+        "SELECT a.object_id FROM sys.all_objects a CROSS JOIN sys.all_objects b");
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    exec_direct(stmt->hstmt, "SELECT 42");
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 42);
+}
+
+// Result sets with MAX columns are read a rowset at a time, read-ahead or not
+TEST_F(ExecutionTest, LargeValuesReadInParts) {
+    ASSERT_EQ(SQLSetStmtAttr(stmt->hstmt, 0x4002, (SQLPOINTER)1, 0), SQL_SUCCESS);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT TOP 20 ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS n, "
+        "CAST(REPLICATE(CAST('x' AS VARCHAR(MAX)), 3000000) AS VARBINARY(MAX)) AS doc "
+        "FROM sys.all_columns ORDER BY n")));
+    std::vector<unsigned char> buf(1 << 20);
+    for (int row = 1; row <= 20; row++) {
+        ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+        EXPECT_EQ(get_int_col(stmt->hstmt, 1), row);
+        SQLLEN ind = 0;
+        size_t total = 0;
+        SQLRETURN rc;
+        while ((rc = SQLGetData(stmt->hstmt, 2, SQL_C_BINARY, buf.data(), buf.size(), &ind)) !=
+               SQL_NO_DATA) {
+            ASSERT_TRUE(SQL_SUCCEEDED(rc));
+            size_t got = std::min<size_t>(ind, buf.size());
+            ASSERT_EQ(buf[0], 'x');
+            total += got;
+        }
+        EXPECT_EQ(total, 3000000u);
+    }
+    EXPECT_EQ(SQLFetch(stmt->hstmt), SQL_NO_DATA);
+}
+
+TEST_F(ExecutionTest, StatementStats) {
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT TOP 1000 ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS n "
+        "FROM sys.all_columns a CROSS JOIN sys.all_columns b ORDER BY n")));
+    int rows = 0;
+    char text[32];
+    SQLLEN ind;
+    while (SQLFetch(stmt->hstmt) == SQL_SUCCESS) {
+        // BIGINT read as text: a conversion through the value's text form
+        SQLGetData(stmt->hstmt, 1, SQL_C_CHAR, text, sizeof(text), &ind);
+        rows++;
+    }
+    ASSERT_EQ(rows, 1000);
+
+    FbStats stats{};
+    SQLINTEGER len = 0;
+    ASSERT_EQ(SQLGetStmtAttr(stmt->hstmt, FB_ATTR_STATS, &stats, sizeof(stats), &len),
+              SQL_SUCCESS);
+    EXPECT_EQ(len, (SQLINTEGER)sizeof(FbStats));
+    EXPECT_EQ(stats.executions, 1u);
+    EXPECT_EQ(stats.rows_fetched, 1000u);
+    EXPECT_EQ(stats.get_data_calls, 1000u);
+    EXPECT_EQ(stats.text_conversions, 1000u);
+    EXPECT_GE(stats.round_trips, 1u);
+    EXPECT_GT(stats.bytes_sent, 0u);
+    EXPECT_GT(stats.bytes_received, 1000u);
+    EXPECT_GE(stats.prefetch_refills, 1u);
+    EXPECT_LE(stats.first_row_us, stats.last_row_us);
+
+    // The connection counts its statements' work as well
+    FbStats conn_stats{};
+    SQLGetConnectAttr(conn->hdbc, FB_ATTR_STATS, &conn_stats, sizeof(conn_stats), nullptr);
+    EXPECT_GE(conn_stats.rows_fetched, 1000u);
+    EXPECT_GE(conn_stats.bytes_received, stats.bytes_received);
+
+    // Setting the attribute to NULL resets the counters
+    ASSERT_EQ(SQLSetStmtAttr(stmt->hstmt, FB_ATTR_STATS, nullptr, 0), SQL_SUCCESS);
+    SQLGetStmtAttr(stmt->hstmt, FB_ATTR_STATS, &stats, sizeof(stats), nullptr);
+    EXPECT_EQ(stats.rows_fetched, 0u);
+    EXPECT_EQ(stats.executions, 0u);
+}
+
+// Partitions run on sessions of their own, so the rows are in a real table
+TEST_F(ExecutionTest, PartitionedExtract) {
+    drop_table("test_partitioned");
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT TOP 5000 CAST(ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS INT) AS id, "
+        "CAST(NULL AS NVARCHAR(20)) AS name INTO test_partitioned "
+        "FROM sys.all_columns a CROSS JOIN sys.all_columns b")));
+    exec_direct(stmt->hstmt, "UPDATE test_partitioned SET name = CONCAT(N'row ', id)");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+
+    ASSERT_EQ(SQLSetStmtAttr(stmt->hstmt, FB_ATTR_PARTITIONS, (SQLPOINTER)4, 0), SQL_SUCCESS);
+    ASSERT_EQ(SQLSetStmtAttr(stmt->hstmt, FB_ATTR_PARTITION_KEY, (SQLPOINTER) "id", SQL_NTS),
+              SQL_SUCCESS);
+    char key[16] = {};
+    SQLINTEGER len = 0;
+    SQLGetStmtAttr(stmt->hstmt, FB_ATTR_PARTITION_KEY, key, sizeof(key), &len);
+    EXPECT_STREQ(key, "id");
+    EXPECT_EQ(len, 2);
+
+    // Unordered: every row once, in whatever order the partitions deliver
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "SELECT id, name FROM test_partitioned")))
+        << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    std::vector<bool> seen(5001, false);
+    int rows = 0;
+    while (SQLFetch(stmt->hstmt) == SQL_SUCCESS) {
+        int id = get_int_col(stmt->hstmt, 1);
+        ASSERT_TRUE(id >= 1 && id <= 5000 && !seen[id]);
+        seen[id] = true;
+        rows++;
+    }
+    EXPECT_EQ(rows, 5000);
+
+    // Ordered by a text key: merged in binary order
+    ASSERT_EQ(SQLSetStmtAttr(stmt->hstmt, FB_ATTR_PARTITION_KEY, (SQLPOINTER) "name", SQL_NTS),
+              SQL_SUCCESS);
+    ASSERT_EQ(SQLSetStmtAttr(stmt->hstmt, FB_ATTR_PARTITION_ORDERED, (SQLPOINTER)1, 0),
+              SQL_SUCCESS);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "SELECT id, name FROM test_partitioned")))
+        << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    std::string prev;
+    rows = 0;
+    char name[32];
+    SQLLEN ind;
+    while (SQLFetch(stmt->hstmt) == SQL_SUCCESS) {
+        SQLGetData(stmt->hstmt, 2, SQL_C_CHAR, name, sizeof(name), &ind);
+        ASSERT_LE(prev, std::string(name));
+        prev = name;
+        rows++;
+    }
+    EXPECT_EQ(rows, 5000);
+
+    // Closing part way through leaves the connection usable
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "SELECT id FROM test_partitioned")));
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+
+    // A top-level ORDER BY cannot go in a derived table: run unpartitioned
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt,
+        "SELECT id FROM test_partitioned WHERE id <= 3 ORDER BY id DESC")))
+        << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    for (int id = 3; id >= 1; id--) {
+        ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+        EXPECT_EQ(get_int_col(stmt->hstmt, 1), id);
+    }
+    EXPECT_EQ(SQLFetch(stmt->hstmt), SQL_NO_DATA);
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    SQLSetStmtAttr(stmt->hstmt, FB_ATTR_PARTITIONS, (SQLPOINTER)0, 0);
+    exec_direct(stmt->hstmt, "SELECT 42");
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 42);
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    drop_table("test_partitioned");
+}
@@ -34,3 +34,38 @@ TEST_F(GetDataTest, LargeString) {
     std::string result = get_string_col(stmt->hstmt, 1);
     EXPECT_EQ(result.size(), 4000u);
 }
+
+TEST_F(GetDataTest, SmallPrefetchBudget) {
+    // 0x4001 = SQL_ATTR_FB_PREFETCH_BYTES; far below one refill of these rows
+    ASSERT_EQ(SQLSetStmtAttr(stmt->hstmt, 0x4001, (SQLPOINTER)(SQLULEN)4096, 0), SQL_SUCCESS);
+    SQLULEN budget = 0;
+    SQLGetStmtAttr(stmt->hstmt, 0x4001, &budget, 0, nullptr);
+    EXPECT_EQ(budget, 4096u);
+
+    exec_direct(stmt->hstmt,
+        "SELECT TOP 300 n, REPLICATE(N'W', 2000) AS val "
+        "FROM (SELECT ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS n "
+        "FROM sys.all_columns) AS t ORDER BY n");
+    int expected = 1;
+    while (SQLFetch(stmt->hstmt) == SQL_SUCCESS) {
+        ASSERT_EQ(get_int_col(stmt->hstmt, 1), expected++);
+        ASSERT_EQ(get_string_col(stmt->hstmt, 2).size(), 2000u);
+    }
+    EXPECT_EQ(expected, 301);
+}
+
+TEST_F(GetDataTest, EmptyValueReadsOnceAsZeroLength) {
+    exec_direct(stmt->hstmt, "SELECT N'' AS w, CAST(0x AS VARBINARY(10)) AS b");
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+
+    SQLWCHAR wbuf[8] = {'x', 'x'};
+    SQLLEN ind = -5;
+    EXPECT_EQ(SQLGetData(stmt->hstmt, 1, SQL_C_WCHAR, wbuf, sizeof(wbuf), &ind), SQL_SUCCESS);
+    EXPECT_EQ(ind, 0);
+    EXPECT_EQ(wbuf[0], 0);
+
+    unsigned char bbuf[8];
+    ind = -5;
+    EXPECT_EQ(SQLGetData(stmt->hstmt, 2, SQL_C_BINARY, bbuf, sizeof(bbuf), &ind), SQL_SUCCESS);
+    EXPECT_EQ(ind, 0);
+}
@@ -10,6 +10,8 @@
 #include <codecvt>
 #include <locale>
 #include <iostream>
+#include <dlfcn.h>
+#include <link.h>
 
 // Connection string matching pyodbc pattern
 static const char* CONN_STR_UTF8 =
@@ -120,6 +122,41 @@ inline bool is_null_col(SQLHSTMT stmt, SQLUSMALLINT col) {
     return ind == SQL_NULL_DATA;
 }
 
+// The driver manager loaded the driver by the path in odbcinst.ini; find it
+// among the loaded objects rather than loading a second copy
+inline int find_furball(struct dl_phdr_info* info, size_t, void* out) {
+    if (info->dlpi_name && strstr(info->dlpi_name, "libfurball")) {
+        *static_cast<std::string*>(out) = info->dlpi_name;
+        return 1;
+    }
+    return 0;
+}
+
+// Look up a driver extension entry point; needs a connection made first
+inline void* furball_symbol(const char* name) {
+    std::string path;
+    dl_iterate_phdr(find_furball, &path);
+    if (path.empty()) return nullptr;
+    void* lib = dlopen(path.c_str(), RTLD_NOW | RTLD_NOLOAD);
+    return lib ? dlsym(lib, name) : nullptr;
+}
+
+// SQL_ATTR_FB_STATS (0x4003), a connection and statement attribute
+static const SQLINTEGER FB_ATTR_STATS = 0x4003;
+struct FbStats {
+    uint64_t round_trips, bytes_sent, bytes_received;
+    uint64_t first_row_us, last_row_us;
+    uint64_t executions, rows_fetched;
+    uint64_t prefetch_refills, prefetch_stalls;
+    uint64_t get_data_calls, text_conversions, buffer_grows;
+    uint64_t spill_bytes;
+};
+
+// Partitioned extract statement attributes
+static const SQLINTEGER FB_ATTR_PARTITIONS = 0x4004;
+static const SQLINTEGER FB_ATTR_PARTITION_KEY = 0x4005;
+static const SQLINTEGER FB_ATTR_PARTITION_ORDERED = 0x4006;
+
 // RAII wrappers
 struct OdbcEnv {
     SQLHENV henv = SQL_NULL_HENV;
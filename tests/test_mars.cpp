@@ -0,0 +1,135 @@
+#include "test_helpers.h"
+
+// Statements on one connection interleave: a new request buffers the
+// results still open on the others instead of discarding them
+class MarsTest : public OdbcTest {
+protected:
+    OdbcStmt* other;
+
+    void SetUp() override {
+        OdbcTest::SetUp();
+        other = new OdbcStmt(conn->hdbc);
+    }
+
+    void TearDown() override {
+        delete other;
+        OdbcTest::TearDown();
+    }
+
+    static const char* numbers() {
+        return "SELECT TOP 2000 CAST(ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS INT) AS n "
+               "FROM sys.all_columns a CROSS JOIN sys.all_columns b ORDER BY n";
+    }
+
+    void expect_numbers_from(SQLHSTMT h, int next, int last) {
+        for (; next <= last; next++) {
+            ASSERT_EQ(SQLFetch(h), SQL_SUCCESS) << "row " << next;
+            ASSERT_EQ(get_int_col(h, 1), next);
+        }
+        EXPECT_EQ(SQLFetch(h), SQL_NO_DATA);
+    }
+
+    void expect_other_query() {
+        ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(other->hstmt, "SELECT 42")))
+            << get_diag(SQL_HANDLE_STMT, other->hstmt);
+        ASSERT_EQ(SQLFetch(other->hstmt), SQL_SUCCESS);
+        EXPECT_EQ(get_int_col(other->hstmt, 1), 42);
+        SQLCloseCursor(other->hstmt);
+    }
+};
+
+TEST_F(MarsTest, InterleavedFetch) {
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, numbers())));
+    for (int i = 1; i <= 10; i++) {
+        ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    }
+    expect_other_query();
+    expect_numbers_from(stmt->hstmt, 11, 2000);
+}
+
+TEST_F(MarsTest, BothStatementsStreaming) {
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, numbers())));
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(other->hstmt, numbers())));
+    // Alternate between the two cursors
+    for (int i = 2; i <= 100; i++) {
+        ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+        ASSERT_EQ(get_int_col(stmt->hstmt, 1), i);
+        ASSERT_EQ(SQLFetch(other->hstmt), SQL_SUCCESS);
+        ASSERT_EQ(get_int_col(other->hstmt, 1), i - 1);
+    }
+    // Closing the buffered cursor leaves the streaming one intact
+    SQLCloseCursor(stmt->hstmt);
+    expect_numbers_from(other->hstmt, 100, 2000);
+}
+
+TEST_F(MarsTest, LaterResultSetsAreKept) {
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "SELECT 1; SELECT 2, N'two'; SELECT 3")));
+    expect_other_query();
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 1);
+    ASSERT_EQ(SQLMoreResults(stmt->hstmt), SQL_SUCCESS);
+    SQLSMALLINT cols = 0;
+    SQLNumResultCols(stmt->hstmt, &cols);
+    EXPECT_EQ(cols, 2);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 2);
+    EXPECT_EQ(get_string_col(stmt->hstmt, 2), "two");
+    ASSERT_EQ(SQLMoreResults(stmt->hstmt), SQL_SUCCESS);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 3);
+    EXPECT_EQ(SQLMoreResults(stmt->hstmt), SQL_NO_DATA);
+}
+
+TEST_F(MarsTest, ReadAheadStatement) {
+    // 0x4002 = SQL_ATTR_FB_READ_AHEAD
+    SQLSetStmtAttr(stmt->hstmt, 0x4002, (SQLPOINTER)1, 0);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, numbers())));
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    expect_other_query();
+    expect_numbers_from(stmt->hstmt, 2, 2000);
+}
+
+// Past BufferBytes= the rows buffered for another statement go to a spill
+// file, and read back as if they had stayed in memory
+TEST(Mars, SpillsPastBufferBytes) {
+    OdbcEnv env;
+    OdbcConn conn(env.henv);
+    std::string conn_str = std::string(CONN_STR_UTF8) + ";BufferBytes=65536";
+    SQLCHAR out[1024];
+    SQLSMALLINT outlen;
+    ASSERT_TRUE(SQL_SUCCEEDED(SQLDriverConnect(conn.hdbc, nullptr, (SQLCHAR*)conn_str.c_str(),
+        SQL_NTS, out, 1024, &outlen, SQL_DRIVER_NOPROMPT)));
+    conn.connected = true;
+    OdbcStmt stmt(conn.hdbc);
+    OdbcStmt other(conn.hdbc);
+
+    std::string rows =
+        "SELECT TOP 50000 CAST(ROW_NUMBER() OVER (ORDER BY (SELECT NULL)) AS INT) AS n, "
+        "REPLICATE('x', 100) AS pad FROM sys.all_columns a CROSS JOIN sys.all_columns b ORDER BY n";
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt.hstmt, rows + "; " + rows)));
+    ASSERT_EQ(SQLFetch(stmt.hstmt), SQL_SUCCESS);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(other.hstmt, "SELECT 42")));
+    ASSERT_EQ(SQLFetch(other.hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(other.hstmt, 1), 42);
+    SQLCloseCursor(other.hstmt);
+
+    FbStats stats{};
+    SQLGetStmtAttr(stmt.hstmt, FB_ATTR_STATS, &stats, sizeof(stats), nullptr);
+    EXPECT_GT(stats.spill_bytes, 0u);
+
+    for (int n = 2; n <= 50000; n++) {
+        ASSERT_EQ(SQLFetch(stmt.hstmt), SQL_SUCCESS) << "row " << n;
+        ASSERT_EQ(get_int_col(stmt.hstmt, 1), n);
+    }
+    EXPECT_EQ(get_string_col(stmt.hstmt, 2), std::string(100, 'x'));
+    EXPECT_EQ(SQLFetch(stmt.hstmt), SQL_NO_DATA);
+
+    ASSERT_EQ(SQLMoreResults(stmt.hstmt), SQL_SUCCESS);
+    for (int n = 1; n <= 50000; n++) {
+        ASSERT_EQ(SQLFetch(stmt.hstmt), SQL_SUCCESS) << "row " << n;
+        ASSERT_EQ(get_int_col(stmt.hstmt, 1), n);
+    }
+    EXPECT_EQ(SQLFetch(stmt.hstmt), SQL_NO_DATA);
+    EXPECT_EQ(SQLMoreResults(stmt.hstmt), SQL_NO_DATA);
+}
@@ -88,3 +88,37 @@ TEST_F(MetadataTest, GetTypeInfoW) {
     while (SQLFetch(stmt->hstmt) == SQL_SUCCESS) count++;
     EXPECT_GT(count, 0);
 }
+
+// Descriptors are shared between executions returning the same columns;
+// a different shape, even by name or length alone, gets its own
+TEST_F(MetadataTest, DescribeColAcrossExecutions) {
+    struct Case {
+        const char* sql;
+        const char* name;
+        SQLSMALLINT type;
+        SQLULEN size;
+        SQLSMALLINT digits;
+    };
+    const Case cases[] = {
+        {"SELECT CAST(1 AS MONEY) AS m", "m", SQL_DECIMAL, 19, 4},
+        {"SELECT CAST(1 AS MONEY) AS m", "m", SQL_DECIMAL, 19, 4},
+        {"SELECT CAST(1 AS SMALLMONEY) AS m", "m", SQL_DECIMAL, 10, 4},
+        {"SELECT CAST(N'x' AS NVARCHAR(20)) AS m", "m", SQL_WVARCHAR, 20, 0},
+        {"SELECT CAST(N'x' AS NVARCHAR(30)) AS m", "m", SQL_WVARCHAR, 30, 0},
+        {"SELECT CAST(N'x' AS NVARCHAR(30)) AS other", "other", SQL_WVARCHAR, 30, 0},
+    };
+    for (const Case& c : cases) {
+        ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, c.sql)))
+            << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+        SQLWCHAR name[64];
+        SQLSMALLINT name_len, type, digits, nullable;
+        SQLULEN size;
+        ASSERT_TRUE(SQL_SUCCEEDED(SQLDescribeColW(stmt->hstmt, 1, name, 64, &name_len,
+            &type, &size, &digits, &nullable)));
+        EXPECT_EQ(from_utf16(name, name_len), c.name) << c.sql;
+        EXPECT_EQ(type, c.type) << c.sql;
+        EXPECT_EQ(size, c.size) << c.sql;
+        EXPECT_EQ(digits, c.digits) << c.sql;
+        SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    }
+}
@@ -1,4 +1,5 @@
 #include "test_helpers.h"
+#include <algorithm>
 
 class ParametersTest : public OdbcTest {
 protected:
@@ -257,3 +258,282 @@ TEST_F(ParametersTest, UuidParamDAE) {
     for (auto& c : upper_result) c = toupper(c);
     EXPECT_EQ(upper_result, "6F9619FF-8B86-D011-B42D-00CF4FC964FF");
 }
+
+// Column-wise parameter array with a status array and a NULL element
+TEST_F(ParametersTest, ParamArrayColumnWise) {
+    drop_table("test_param");
+    exec_direct(stmt->hstmt, "CREATE TABLE test_param (id INT, name VARCHAR(20))");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+
+    const int N = 3;
+    SQLINTEGER ids[N] = {1, 2, 3};
+    SQLLEN id_ind[N] = {0, 0, 0};
+    char names[N][20] = {"one", "two", ""};
+    SQLLEN name_ind[N] = {SQL_NTS, SQL_NTS, SQL_NULL_DATA};
+    SQLUSMALLINT status[N];
+    SQLULEN processed = 0;
+
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)N, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAM_STATUS_PTR, status, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, &processed, 0);
+
+    prepare(stmt->hstmt, "INSERT INTO test_param VALUES (?, ?)");
+    SQLBindParameter(stmt->hstmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG,
+        SQL_INTEGER, 0, 0, ids, 0, id_ind);
+    SQLBindParameter(stmt->hstmt, 2, SQL_PARAM_INPUT, SQL_C_CHAR,
+        SQL_VARCHAR, 20, 0, names, 20, name_ind);
+
+    SQLRETURN rc = SQLExecute(stmt->hstmt);
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    EXPECT_EQ(processed, (SQLULEN)N);
+    for (int i = 0; i < N; i++) EXPECT_EQ(status[i], SQL_PARAM_SUCCESS);
+
+    SQLLEN rows = 0;
+    SQLRowCount(stmt->hstmt, &rows);
+    EXPECT_EQ(rows, N);
+
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    exec_direct(stmt->hstmt,
+        "SELECT COUNT(*), SUM(id), COUNT(name) FROM test_param");
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_string_col(stmt->hstmt, 1), "3");
+    EXPECT_EQ(get_string_col(stmt->hstmt, 2), "6");
+    EXPECT_EQ(get_string_col(stmt->hstmt, 3), "2");
+}
+
+// Row-wise parameter array with one row skipped via SQL_PARAM_IGNORE
+TEST_F(ParametersTest, ParamArrayRowWiseIgnore) {
+    drop_table("test_param");
+    exec_direct(stmt->hstmt, "CREATE TABLE test_param (val INT)");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+
+    struct Row {
+        SQLINTEGER val;
+        SQLLEN ind;
+    };
+    Row rows[3] = {{10, 0}, {20, 0}, {30, 0}};
+    SQLUSMALLINT ops[3] = {SQL_PARAM_PROCEED, SQL_PARAM_IGNORE, SQL_PARAM_PROCEED};
+    SQLUSMALLINT status[3];
+
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)3, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER)sizeof(Row), 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAM_OPERATION_PTR, ops, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAM_STATUS_PTR, status, 0);
+
+    prepare(stmt->hstmt, "INSERT INTO test_param VALUES (?)");
+    SQLBindParameter(stmt->hstmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG,
+        SQL_INTEGER, 0, 0, &rows[0].val, 0, &rows[0].ind);
+
+    SQLRETURN rc = SQLExecute(stmt->hstmt);
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    EXPECT_EQ(status[0], SQL_PARAM_SUCCESS);
+    EXPECT_EQ(status[1], SQL_PARAM_UNUSED);
+    EXPECT_EQ(status[2], SQL_PARAM_SUCCESS);
+
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    exec_direct(stmt->hstmt, "SELECT SUM(val) FROM test_param");
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_string_col(stmt->hstmt, 1), "40");
+}
+
+// A failing set rolls back the whole batch it was sent in, so every row the
+// status array reports as failed really is absent
+TEST_F(ParametersTest, ParamArrayErrorRollsBackBatch) {
+    drop_table("test_param");
+    exec_direct(stmt->hstmt, "CREATE TABLE test_param (id INT PRIMARY KEY)");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+
+    const int N = 4;
+    SQLINTEGER ids[N] = {1, 2, 2, 3};
+    SQLLEN id_ind[N] = {0, 0, 0, 0};
+    SQLUSMALLINT status[N];
+    SQLULEN processed = 0;
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)(SQLULEN)N, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAM_STATUS_PTR, status, 0);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, &processed, 0);
+    prepare(stmt->hstmt, "INSERT INTO test_param VALUES (?)");
+    SQLBindParameter(stmt->hstmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG,
+        SQL_INTEGER, 0, 0, ids, 0, id_ind);
+
+    EXPECT_EQ(SQLExecute(stmt->hstmt), SQL_ERROR);
+    EXPECT_NE(get_diag(SQL_HANDLE_STMT, stmt->hstmt).find("23000"), std::string::npos);
+    EXPECT_EQ(processed, (SQLULEN)N);
+    for (int i = 0; i < N; i++) EXPECT_EQ(status[i], SQL_PARAM_DIAG_UNAVAILABLE);
+
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    SQLSetStmtAttr(stmt->hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER)1, 0);
+    exec_direct(stmt->hstmt, "SELECT COUNT(*) FROM test_param");
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 0);
+}
+
+// A '?' inside a string literal is not a parameter marker
+TEST_F(ParametersTest, QuestionMarkInLiteral) {
+    prepare(stmt->hstmt, "SELECT 'what?', ?");
+
+    SQLINTEGER val = 7;
+    SQLLEN ind = sizeof(val);
+    SQLBindParameter(stmt->hstmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG,
+        SQL_INTEGER, 0, 0, &val, 0, &ind);
+
+    SQLRETURN rc = SQLExecute(stmt->hstmt);
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_string_col(stmt->hstmt, 1), "what?");
+    EXPECT_EQ(get_int_col(stmt->hstmt, 2), 7);
+}
+
+// Doubles are sent without loss of precision
+TEST_F(ParametersTest, FloatParamExactRoundTrip) {
+    prepare(stmt->hstmt, "SELECT ?");
+
+    double val = 0.1 + 0.2;
+    SQLLEN ind = sizeof(val);
+    SQLBindParameter(stmt->hstmt, 1, SQL_PARAM_INPUT, SQL_C_DOUBLE,
+        SQL_DOUBLE, 0, 0, &val, 0, &ind);
+
+    SQLRETURN rc = SQLExecute(stmt->hstmt);
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_double_col(stmt->hstmt, 1), val);
+}
+
+// Re-executing a prepared statement, and preparing the same text on a second
+// handle, reuses the connection's server-side prepared statement
+TEST_F(ParametersTest, PreparedReexecute) {
+    prepare(stmt->hstmt, "SELECT ? * 2");
+    for (SQLINTEGER val = 1; val <= 3; val++) {
+        SQLLEN ind = sizeof(val);
+        SQLBindParameter(stmt->hstmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG,
+            SQL_INTEGER, 0, 0, &val, 0, &ind);
+        SQLRETURN rc = SQLExecute(stmt->hstmt);
+        ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+        ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS);
+        EXPECT_EQ(get_int_col(stmt->hstmt, 1), val * 2);
+        SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    }
+
+    OdbcStmt other(conn->hdbc);
+    prepare(other.hstmt, "SELECT ? * 2");
+    SQLINTEGER val = 21;
+    SQLLEN ind = sizeof(val);
+    SQLBindParameter(other.hstmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG,
+        SQL_INTEGER, 0, 0, &val, 0, &ind);
+    SQLRETURN rc = SQLExecute(other.hstmt);
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, other.hstmt);
+    ASSERT_EQ(SQLFetch(other.hstmt), SQL_SUCCESS);
+    EXPECT_EQ(get_int_col(other.hstmt, 1), 42);
+}
+
+// A DAE value larger than the driver's buffer arrives intact, including the
+// quotes and surrogate pairs split between SQLPutData calls
+TEST_F(ParametersTest, LargeParamDAEInChunks) {
+    drop_table("test_param");
+    exec_direct(stmt->hstmt,
+        "CREATE TABLE test_param (id INT, name NVARCHAR(MAX), data VARBINARY(MAX))");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+
+    prepare(stmt->hstmt, "INSERT INTO test_param VALUES (?, ?, ?)");
+    SQLINTEGER id = 7;
+    SQLLEN id_ind = sizeof(id);
+    SQLBindParameter(stmt->hstmt, 1, SQL_PARAM_INPUT, SQL_C_SLONG,
+        SQL_INTEGER, 0, 0, &id, 0, &id_ind);
+    SQLLEN name_ind = SQL_DATA_AT_EXEC;
+    SQLBindParameter(stmt->hstmt, 2, SQL_PARAM_INPUT, SQL_C_WCHAR,
+        SQL_WLONGVARCHAR, 0, 0, (SQLPOINTER)2, 0, &name_ind);
+    SQLLEN data_ind = SQL_DATA_AT_EXEC;
+    SQLBindParameter(stmt->hstmt, 3, SQL_PARAM_INPUT, SQL_C_BINARY,
+        SQL_LONGVARBINARY, 0, 0, (SQLPOINTER)3, 0, &data_ind);
+
+    const int reps = 250000;
+    std::u16string unit = to_utf16("ab'c\xF0\x9F\x98\x80");
+    std::u16string text;
+    for (int i = 0; i < reps; i++) text += unit;
+    std::vector<unsigned char> bytes(3 * 1024 * 1024 + 5);
+    for (size_t i = 0; i < bytes.size(); i++) bytes[i] = (unsigned char)(i * 7);
+
+    ASSERT_EQ(SQLExecute(stmt->hstmt), SQL_NEED_DATA);
+    SQLPOINTER token;
+    ASSERT_EQ(SQLParamData(stmt->hstmt, &token), SQL_NEED_DATA);
+    EXPECT_EQ(token, (SQLPOINTER)2);
+    const char* p = (const char*)text.data();
+    size_t left = text.size() * sizeof(char16_t);
+    while (left > 0) {
+        // An odd piece size splits characters between calls
+        size_t n = std::min(left, (size_t)65535);
+        ASSERT_TRUE(SQL_SUCCEEDED(SQLPutData(stmt->hstmt, (SQLPOINTER)p, n)))
+            << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+        p += n;
+        left -= n;
+    }
+    ASSERT_EQ(SQLParamData(stmt->hstmt, &token), SQL_NEED_DATA);
+    EXPECT_EQ(token, (SQLPOINTER)3);
+    for (size_t off = 0; off < bytes.size(); off += 100000) {
+        size_t n = std::min(bytes.size() - off, (size_t)100000);
+        ASSERT_TRUE(SQL_SUCCEEDED(SQLPutData(stmt->hstmt, bytes.data() + off, n)))
+            << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    }
+    SQLRETURN rc = SQLParamData(stmt->hstmt, &token);
+    ASSERT_TRUE(SQL_SUCCEEDED(rc)) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    SQLLEN rows = 0;
+    SQLRowCount(stmt->hstmt, &rows);
+    EXPECT_EQ(rows, 1);
+
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    exec_direct(stmt->hstmt,
+        "SELECT id, DATALENGTH(name), "
+        "CASE WHEN name = REPLICATE(CAST(N'ab''c' + NCHAR(0xD83D) + NCHAR(0xDE00) "
+        "AS NVARCHAR(MAX)), 250000) THEN 1 ELSE 0 END, "
+        "DATALENGTH(data), CAST(SUBSTRING(data, 1048577, 1) AS INT) FROM test_param");
+    ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 7);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 2), (int)(text.size() * sizeof(char16_t)));
+    EXPECT_EQ(get_int_col(stmt->hstmt, 3), 1);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 4), (int)bytes.size());
+    EXPECT_EQ(get_int_col(stmt->hstmt, 5), (int)bytes[1048576]);
+}
+
+// Staged values of two statements on one connection share the session's
+// staging table without disturbing each other
+TEST_F(ParametersTest, StagedDAEOnTwoStatements) {
+    drop_table("test_param");
+    exec_direct(stmt->hstmt, "CREATE TABLE test_param (id INT, data VARBINARY(MAX))");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    OdbcStmt other(conn->hdbc);
+
+    // Past the driver's 1 MiB buffer, so both values go to the staging table
+    std::vector<unsigned char> bytes(1536 * 1024);
+    SQLINTEGER ids[2] = {1, 2};
+    SQLLEN id_ind = sizeof(SQLINTEGER);
+    SQLLEN data_ind[2] = {SQL_DATA_AT_EXEC, SQL_DATA_AT_EXEC};
+    SQLHSTMT handles[2] = {stmt->hstmt, other.hstmt};
+    SQLPOINTER token;
+    for (int i = 0; i < 2; i++) {
+        prepare(handles[i], "INSERT INTO test_param VALUES (?, ?)");
+        SQLBindParameter(handles[i], 1, SQL_PARAM_INPUT, SQL_C_SLONG,
+            SQL_INTEGER, 0, 0, &ids[i], 0, &id_ind);
+        SQLBindParameter(handles[i], 2, SQL_PARAM_INPUT, SQL_C_BINARY,
+            SQL_LONGVARBINARY, 0, 0, (SQLPOINTER)2, 0, &data_ind[i]);
+        ASSERT_EQ(SQLExecute(handles[i]), SQL_NEED_DATA);
+        ASSERT_EQ(SQLParamData(handles[i], &token), SQL_NEED_DATA);
+        std::fill(bytes.begin(), bytes.end(), (unsigned char)(0x10 * (i + 1)));
+        ASSERT_TRUE(SQL_SUCCEEDED(SQLPutData(handles[i], bytes.data(), bytes.size())))
+            << get_diag(SQL_HANDLE_STMT, handles[i]);
+    }
+    // The second statement runs first; the first one's row must survive it
+    for (int i : {1, 0}) {
+        ASSERT_TRUE(SQL_SUCCEEDED(SQLParamData(handles[i], &token)))
+            << get_diag(SQL_HANDLE_STMT, handles[i]);
+        SQLFreeStmt(handles[i], SQL_CLOSE);
+    }
+
+    exec_direct(stmt->hstmt,
+        "SELECT id, DATALENGTH(data), CAST(SUBSTRING(data, 1048577, 1) AS INT) "
+        "FROM test_param ORDER BY id");
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(SQLFetch(stmt->hstmt), SQL_SUCCESS) << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+        EXPECT_EQ(get_int_col(stmt->hstmt, 1), i + 1);
+        EXPECT_EQ(get_int_col(stmt->hstmt, 2), (int)bytes.size());
+        EXPECT_EQ(get_int_col(stmt->hstmt, 3), 0x10 * (i + 1));
+    }
+}
@@ -0,0 +1,59 @@
+#include "test_helpers.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Handles used from several threads at once: calls on one connection are
+// serialized, calls on different connections run in parallel
+class ThreadsTest : public OdbcTest {
+protected:
+    static constexpr int kThreads = 4;
+
+    static int count_rows(SQLHSTMT h, const char* sql) {
+        if (!SQL_SUCCEEDED(exec_direct(h, sql))) return -1;
+        int n = 0;
+        while (SQLFetch(h) == SQL_SUCCESS) n++;
+        SQLCloseCursor(h);
+        return n;
+    }
+};
+
+TEST_F(ThreadsTest, StatementsShareConnection) {
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([this, &failures] {
+            OdbcStmt s(conn->hdbc);
+            for (int i = 0; i < 20; i++) {
+                if (count_rows(s.hstmt, "SELECT TOP 100 object_id FROM sys.all_objects") != 100) {
+                    failures++;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(failures.load(), 0);
+}
+
+TEST_F(ThreadsTest, ConnectionsRunInParallel) {
+    std::vector<OdbcConn*> conns;
+    for (int t = 0; t < kThreads; t++) {
+        conns.push_back(new OdbcConn(env->henv));
+        ASSERT_TRUE(conns.back()->connect()) << get_diag(SQL_HANDLE_DBC, conns.back()->hdbc);
+    }
+    std::atomic<int> failures{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (auto* c : conns) {
+        threads.emplace_back([c, &failures] {
+            OdbcStmt s(c->hdbc);
+            if (count_rows(s.hstmt, "WAITFOR DELAY '00:00:01'; SELECT 1") != 1) failures++;
+        });
+    }
+    for (auto& t : threads) t.join();
+    // One second each, not one after the other
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(kThreads - 1));
+    EXPECT_EQ(failures.load(), 0);
+    for (auto* c : conns) delete c;
+}
@@ -78,3 +78,71 @@ TEST_F(TransactionsTest, RollbackVerification) {
     SQLSetConnectAttr(conn->hdbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_ON, 0);
     drop_table("test_tx");
 }
+
+// The implicit transaction is opened by the first statement's own batch; a
+// first statement that fails to compile leaves nothing to end
+TEST_F(TransactionsTest, FailedFirstStatement) {
+    drop_table("test_tx");
+    exec_direct(stmt->hstmt, "CREATE TABLE test_tx (id INT)");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+
+    SQLSetConnectAttr(conn->hdbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_OFF, 0);
+    EXPECT_EQ(exec_direct(stmt->hstmt, "SELEC 1"), SQL_ERROR);
+    EXPECT_EQ(SQLEndTran(SQL_HANDLE_DBC, conn->hdbc, SQL_ROLLBACK), SQL_SUCCESS)
+        << get_diag(SQL_HANDLE_DBC, conn->hdbc);
+
+    exec_direct(stmt->hstmt, "INSERT INTO test_tx VALUES (1)");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    exec_direct(stmt->hstmt, "SELECT @@TRANCOUNT");
+    SQLFetch(stmt->hstmt);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 1);
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    EXPECT_EQ(SQLEndTran(SQL_HANDLE_DBC, conn->hdbc, SQL_COMMIT), SQL_SUCCESS);
+
+    SQLSetConnectAttr(conn->hdbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_ON, 0);
+    exec_direct(stmt->hstmt, "SELECT COUNT(*) FROM test_tx");
+    SQLFetch(stmt->hstmt);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 1);
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    drop_table("test_tx");
+}
+
+// After a first statement that fails to compile, the next one still runs in
+// the transaction, so a rollback undoes it
+TEST_F(TransactionsTest, RollbackAfterFailedFirstStatement) {
+    drop_table("test_tx");
+    exec_direct(stmt->hstmt, "CREATE TABLE test_tx (id INT)");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+
+    SQLSetConnectAttr(conn->hdbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_OFF, 0);
+    EXPECT_EQ(exec_direct(stmt->hstmt, "SELEC 1"), SQL_ERROR);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "INSERT INTO test_tx VALUES (1)")))
+        << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    EXPECT_EQ(SQLEndTran(SQL_HANDLE_DBC, conn->hdbc, SQL_ROLLBACK), SQL_SUCCESS);
+
+    SQLSetConnectAttr(conn->hdbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_ON, 0);
+    exec_direct(stmt->hstmt, "SELECT COUNT(*) FROM test_tx");
+    SQLFetch(stmt->hstmt);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 0);
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    drop_table("test_tx");
+}
+
+// CREATE VIEW must start its batch: the BEGIN goes ahead on its own
+TEST_F(TransactionsTest, CreateViewInTransaction) {
+    exec_direct(stmt->hstmt, "DROP VIEW IF EXISTS test_tx_view");
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+
+    SQLSetConnectAttr(conn->hdbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_OFF, 0);
+    ASSERT_TRUE(SQL_SUCCEEDED(exec_direct(stmt->hstmt, "CREATE VIEW test_tx_view AS SELECT 1 AS n")))
+        << get_diag(SQL_HANDLE_STMT, stmt->hstmt);
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+    EXPECT_EQ(SQLEndTran(SQL_HANDLE_DBC, conn->hdbc, SQL_ROLLBACK), SQL_SUCCESS);
+
+    SQLSetConnectAttr(conn->hdbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER)SQL_AUTOCOMMIT_ON, 0);
+    exec_direct(stmt->hstmt, "SELECT COUNT(*) FROM sys.views WHERE name = 'test_tx_view'");
+    SQLFetch(stmt->hstmt);
+    EXPECT_EQ(get_int_col(stmt->hstmt, 1), 0);
+    SQLFreeStmt(stmt->hstmt, SQL_CLOSE);
+}